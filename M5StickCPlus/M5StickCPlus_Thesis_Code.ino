@@ -22,8 +22,25 @@
 // On time of the readings display screen, in msec
 #define READINGS_SCREEN_ON_TIME_MSEC 5000
 
-// Maximum length of string to be read over UART
-#define UART_STR_LEN 30
+// Maximum length of string to be read over UART (enough for the readings of
+// up to 7 tanks, of which tanks 1 and 2 are displayed)
+#define UART_STR_LEN 64
+
+// Maximum length of analytics string to be read over UART
+#define ANALYTICS_STR_LEN 64
+
+// Maximum length of the additional dashboard fields posted for each tank
+#define DASHBOARD_FIELDS_LEN 96
+
+// Maximum length of events string to be read over UART
+#define EVENTS_STR_LEN 16
+
+// Number of event bits for each tank in the events mask
+#define EVENT_BITS_PER_TANK 4
+
+// Wake line driven high by the Raspberry Pi Pico when an event is raised
+// (threshold crossing, valve state change or analytics alarm)
+#define WAKE_LINE_PIN GPIO_NUM_33
 
 // UART scan timeout, in msec
 #define UART_SCAN_TIMEOUT_MSEC 10000
@@ -98,6 +115,30 @@ void request_readings() {
     Serial2.print("R");
 }
 
+/**
+ * @brief Analytics request function. This function handles tank analytics 
+ *        requests (rates, forecasts and leak flags), which are sent to the 
+ *        Raspberry Pi Pico via UART. 
+ * @param None. 
+ * @retval None. 
+ */
+void request_analytics() {
+    // 'A' is a request for the most recent tank analytics
+    Serial2.print("A");
+}
+
+/**
+ * @brief Events request function. This function handles requests for the 
+ *        events which caused the Raspberry Pi Pico to drive the wake line
+ *        (which also releases the wake line). 
+ * @param None. 
+ * @retval None. 
+ */
+void request_events() {
+    // 'E' is a request for the events raised since the last request
+    Serial2.print("E");
+}
+
 /**
  * @brief String split function. This function takes the string received 
  *        via UART from the Raspberry Pi Pico and splits it to extract the 
@@ -123,6 +164,12 @@ void split_str(char *string, char *first_value, char *second_value) {
         // When we read a 'T', first tank height has been extracted and second 
         // tank height is the only tank height left to extract. 
         if (string[i] == 'T') {
+            // Only tanks 1 and 2 are displayed, so stop at tank 3 (sent by
+            // Picos built for more tanks)
+            if (i > second_val_index) {
+                break;
+            }
+
             // Set second value index, and as per the agreed message format
             // the index of the second equals is two elements past the second
             // value index. 
@@ -180,6 +227,103 @@ bool scan_uart(char *first_value, char *second_value) {
     return false;
 }
 
+/**
+ * @brief Scan response function. This function handles scanning for a 
+ *        response from the Raspberry Pi Pico via UART, up to the agreed 
+ *        termination character (which is '!'). 
+ * @param response Char array populated with the response (without the
+ *        termination character)
+ * @param response_len Length of the response char array
+ * @retval true if a response was received, false if the scan timed out. 
+ */
+bool scan_response(char *response, uint8_t response_len) {
+    uint8_t len = 0;
+
+    int start_scan_timestamp = millis();
+    while ((millis() - start_scan_timestamp) < UART_SCAN_TIMEOUT_MSEC) {
+        if (!Serial2.available()) {
+            continue;
+        }
+
+        char receivedChar = Serial2.read();
+        if (receivedChar == '!') {
+            response[len] = '\0';
+            return true;
+        }
+
+        if (len < (response_len - 1)) {
+            response[len++] = receivedChar;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Scan analytics function. This function handles scanning for the 
+ *        analytics response from the Raspberry Pi Pico via UART, and splits
+ *        it into the fields posted for each tank (with respect to the agreed
+ *        string format, which is "A1=R,E,F,LA2=R,E,F,L!", where R is the rate
+ *        in cm/min, E and F are the time-to-empty and time-to-full in min
+ *        (-1 if not applicable), and L is the leak flag). 
+ * @param tank_1_fields Char array populated with the tank 1 dashboard fields
+ * @param tank_2_fields Char array populated with the tank 2 dashboard fields
+ * @param fields_len Length of each fields char array
+ * @retval true if a response was received, false if the scan timed out. 
+ */
+bool scan_analytics(char *tank_1_fields, char *tank_2_fields, uint8_t fields_len) {
+    char receivedString[ANALYTICS_STR_LEN] = {'\0'};
+    if (!scan_response(receivedString, ANALYTICS_STR_LEN)) {
+        return false;
+    }
+
+    float rate[2], time_to_empty[2], time_to_full[2];
+    int leak[2];
+    if (sscanf(receivedString, "A1=%f,%f,%f,%dA2=%f,%f,%f,%d", &rate[0], 
+            &time_to_empty[0], &time_to_full[0], &leak[0], &rate[1], 
+            &time_to_empty[1], &time_to_full[1], &leak[1]) != 8) {
+        return false;
+    }
+
+    snprintf(tank_1_fields, fields_len, "&field2=%.2f&field3=%.0f&field4=%.0f&field5=%d", 
+            rate[0], time_to_empty[0], time_to_full[0], leak[0]);
+    snprintf(tank_2_fields, fields_len, "&field2=%.2f&field3=%.0f&field4=%.0f&field5=%d", 
+            rate[1], time_to_empty[1], time_to_full[1], leak[1]);
+
+    return true;
+}
+
+/**
+ * @brief Scan events function. This function handles scanning for the events
+ *        response from the Raspberry Pi Pico via UART (with respect to the 
+ *        agreed string format, which is "E=X!", where X is the event mask in
+ *        hex), and appends each tank's events to its dashboard fields. 
+ * @param tank_1_fields Char array holding the tank 1 dashboard fields
+ * @param tank_2_fields Char array holding the tank 2 dashboard fields
+ * @param fields_len Length of each fields char array
+ * @retval true if a response was received, false if the scan timed out. 
+ */
+bool scan_events(char *tank_1_fields, char *tank_2_fields, uint8_t fields_len) {
+    char receivedString[EVENTS_STR_LEN] = {'\0'};
+    if (!scan_response(receivedString, EVENTS_STR_LEN)) {
+        return false;
+    }
+
+    unsigned long events = 0;
+    if (sscanf(receivedString, "E=%lx", &events) != 1) {
+        return false;
+    }
+
+    // Each tank has EVENT_BITS_PER_TANK event bits, tank 1's being lowest
+    unsigned long tank_mask = (1UL << EVENT_BITS_PER_TANK) - 1;
+    snprintf(tank_1_fields + strlen(tank_1_fields), fields_len - strlen(tank_1_fields), 
+            "&field6=%lu", events & tank_mask);
+    snprintf(tank_2_fields + strlen(tank_2_fields), fields_len - strlen(tank_2_fields), 
+            "&field6=%lu", (events >> EVENT_BITS_PER_TANK) & tank_mask);
+
+    return true;
+}
+
 /**
  * @brief Height values screen print function. This function handles 
  *        printing the most recent water tank height values to the display 
@@ -284,9 +428,12 @@ bool wifi_connect() {
  * 
  * @param tank_1_reading Water height reading for tank 1
  * @param tank_2_reading Water height reading for tank 2
+ * @param tank_1_fields Additional dashboard fields for tank 1 (analytics)
+ * @param tank_2_fields Additional dashboard fields for tank 2 (analytics)
  * @retval None. 
  */
-void transmit_level_readings(char *tank_1_reading, char *tank_2_reading) {
+void transmit_level_readings(char *tank_1_reading, char *tank_2_reading, 
+        char *tank_1_fields, char *tank_2_fields) {
     HTTPClient http;
 
     // Connect to server and set the content-type header
@@ -294,8 +441,8 @@ void transmit_level_readings(char *tank_1_reading, char *tank_2_reading) {
     http.addHeader("Content-Type", "application/x-www-form-urlencoded");
 
     // Post readings
-    http.POST(String(TANK_1_API_KEY) + String(tank_1_reading));
-    http.POST(String(TANK_2_API_KEY) + String(tank_2_reading));
+    http.POST(String(TANK_1_API_KEY) + String(tank_1_reading) + String(tank_1_fields));
+    http.POST(String(TANK_2_API_KEY) + String(tank_2_reading) + String(tank_2_fields));
 
     http.end();
 }
@@ -327,6 +474,11 @@ void busy_sleep(void) {
             break;
         }
 
+        // Check if the Raspberry Pi Pico has raised an event
+        if (digitalRead(WAKE_LINE_PIN) == HIGH) {
+            break;
+        }
+
         delay(10);
     }
 }
@@ -347,6 +499,9 @@ void setup() {
     pinMode(M5_BUTTON_HOME, INPUT_PULLUP);
     esp_sleep_enable_ext0_wakeup(GPIO_NUM_37, 0);
 
+    // Wake line is driven by the Raspberry Pi Pico, held low while idle. 
+    pinMode(WAKE_LINE_PIN, INPUT_PULLDOWN);
+
     // Set display to be black. 
     M5.Lcd.fillScreen(BLACK);
 }
@@ -398,9 +553,24 @@ void loop() {
             print_values_screen(tank_1_value, tank_2_value);
         }
 
+        // Request analytics, which are posted alongside the readings (and
+        // left out if they couldn't be fetched). 
+        char tank_1_fields[DASHBOARD_FIELDS_LEN] = {'\0'}, tank_2_fields[DASHBOARD_FIELDS_LEN] = {'\0'};
+        request_analytics();
+        if (!scan_analytics(tank_1_fields, tank_2_fields, DASHBOARD_FIELDS_LEN)) {
+            tank_1_fields[0] = '\0';
+            tank_2_fields[0] = '\0';
+        }
+
+        // Fetch the events raised since the last upload (this releases the
+        // wake line, so it must be done every cycle). 
+        request_events();
+        scan_events(tank_1_fields, tank_2_fields, DASHBOARD_FIELDS_LEN);
+
         if (wifi_connect()) {
             // Send readings to dashboard
-            transmit_level_readings(tank_1_value, tank_2_value);
+            transmit_level_readings(tank_1_value, tank_2_value, tank_1_fields, 
+                    tank_2_fields);
         }
     
     // If UART did time out and visual mode is on, print timeout
@@ -423,6 +593,15 @@ void loop() {
         can_sleep = true;
     }
 
+    // Wake early if the Raspberry Pi Pico raises an event. If the wake line
+    // is still held (events couldn't be fetched), it isn't used as a wake 
+    // source, as it would wake the device immediately. 
+    if (digitalRead(WAKE_LINE_PIN) == LOW) {
+        esp_sleep_enable_ext1_wakeup((1ULL << WAKE_LINE_PIN), ESP_EXT1_WAKEUP_ANY_HIGH);
+    } else {
+        esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_EXT1);
+    }
+
     // If device can deep sleep, put device into deep sleep
     if (can_sleep) {
         M5.Axp.DeepSleep(SLEEP_SEC(SLEEP_TIMEOUT_SEC));
@@ -0,0 +1,320 @@
+ /**
+ **************************************************************
+ * @file bench_host.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Hot path microbenchmark tool. This tool runs the benchmark suite
+ *        (see mylib/bench) on the host, or reads results printed by the
+ *        benchmark firmware, and compares them against a stored baseline.
+ *        On the host, the suite is run in several processes and each case's
+ *        median is taken across them, as a process's memory layout alone 
+ *        can move a case by tens of percent. Cases slower than the baseline
+ *        by more than the tolerance (widened by the spread of the results)
+ *        are flagged as regressions. 
+ *
+ *        Usage: bench [-n iterations] [-p processes] [-r results] 
+ *                     [-b baseline] [-t tolerance (%)]
+ ***************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "bench.h"
+
+// Default iterations per run of each case. 
+#define BENCH_HOST_ITERATIONS 200000
+
+// Default number of processes the suite is run in, and the most allowed.
+#define BENCH_HOST_PROCESSES 5
+#define BENCH_HOST_MAX_PROCESSES 32
+
+// Default tolerance before a slower case is flagged as a regression (in %).
+#define BENCH_DEFAULT_TOLERANCE_PCT 10.0
+
+// Maximum number of results read from a file. 
+#define BENCH_MAX_RESULTS 64
+
+// Maximum length of a line read from a file. 
+#define BENCH_LINE_LEN 256
+
+/**
+ * @brief Benchmark clock function. 
+ * @param None. 
+ * @retval Monotonic time, in nsec. 
+ */
+static uint64_t bench_clock_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+/**
+ * @brief Suite run function. This function runs every case in a child 
+ *        process (so each run gets a fresh memory layout), and reads the 
+ *        results back over a pipe. 
+ * @param iterations Number of iterations per run. 
+ * @param results Array populated with the results. 
+ * @retval true if the results were read, false otherwise. 
+ */
+static bool run_suite_process(uint32_t iterations, struct bench_result *results) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return false;
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        close(fds[0]);
+        for (int i = 0; i < bench_num_cases; i++) {
+            struct bench_result result;
+            bench_run_case(&bench_cases[i], iterations, bench_clock_ns, &result);
+            if (write(fds[1], &result, sizeof(result)) != sizeof(result)) {
+                _exit(1);
+            }
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    bool ok = true;
+    for (int i = 0; (i < bench_num_cases) && ok; i++) {
+        ok = (read(fds[0], &results[i], sizeof(results[i])) == sizeof(results[i]));
+    }
+    close(fds[0]);
+
+    int status;
+    waitpid(pid, &status, 0);
+
+    return ok && WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+}
+
+/**
+ * @brief Suite run function. This function runs every case in each of a 
+ *        number of processes, and reports each case's median across the
+ *        processes, with their interquartile range as the spread. 
+ * @param iterations Number of iterations per run. 
+ * @param processes Number of processes. 
+ * @param results Array populated with the results. 
+ * @retval true if every process ran, false otherwise. 
+ */
+static bool run_suite(uint32_t iterations, int processes, struct bench_result *results) {
+    static struct bench_result runs[BENCH_HOST_MAX_PROCESSES][BENCH_MAX_RESULTS];
+
+    for (int p = 0; p < processes; p++) {
+        if (!run_suite_process(iterations, runs[p])) {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < bench_num_cases; i++) {
+        double ns[BENCH_HOST_MAX_PROCESSES];
+
+        // Sort the processes' results (insertion sort)
+        for (int p = 0; p < processes; p++) {
+            int j = p;
+            while ((j > 0) && (ns[j - 1] > runs[p][i].ns_per_op)) {
+                ns[j] = ns[j - 1];
+                j--;
+            }
+            ns[j] = runs[p][i].ns_per_op;
+        }
+
+        results[i] = runs[0][i];
+        if (processes > 1) {
+            results[i].ns_per_op = ns[processes / 2];
+            results[i].spread_pct = (ns[processes / 2] <= 0.0) ? 0.0 
+                    : (((ns[(3 * processes) / 4] - ns[processes / 4]) * 100.0) 
+                    / ns[processes / 2]);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Results load function. This function reads the results from a
+ *        file (other lines, e.g. from the benchmark firmware, are ignored).
+ * @param path Path of the file. 
+ * @param results Array populated with the results. 
+ * @retval Number of results read, or -1 if the file couldn't be opened. 
+ */
+static int load_results(const char *path, struct bench_result *results) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    char line[BENCH_LINE_LEN];
+    int num_results = 0;
+    while ((num_results < BENCH_MAX_RESULTS) && (fgets(line, sizeof(line), file) != NULL)) {
+        if (bench_parse_result(line, &results[num_results])) {
+            num_results++;
+        }
+    }
+
+    fclose(file);
+    return num_results;
+}
+
+/**
+ * @brief Baseline compare function. This function compares each result
+ *        against the baseline result of the same name. A case is a 
+ *        regression if it is slower by more than the tolerance plus the 
+ *        mean spread of the two results (so cases which vary more between
+ *        runs need a larger change to be flagged). Cases run for a 
+ *        different number of iterations aren't compared. 
+ * @param results Array of results. 
+ * @param num_results Number of results. 
+ * @param baseline Array of baseline results. 
+ * @param num_baseline Number of baseline results. 
+ * @param tolerance_pct Tolerance before a slower case is a regression. 
+ * @param mismatches Pointer populated with the number of cases not 
+ *        compared as their iterations differ. 
+ * @retval Number of regressions. 
+ */
+static int compare_results(const struct bench_result *results, int num_results, 
+        const struct bench_result *baseline, int num_baseline, double tolerance_pct,
+        int *mismatches) {
+    int regressions = 0;
+    (*mismatches) = 0;
+
+    for (int i = 0; i < num_results; i++) {
+        const struct bench_result *base = NULL;
+        for (int j = 0; j < num_baseline; j++) {
+            if (strcmp(results[i].name, baseline[j].name) == 0) {
+                base = &baseline[j];
+                break;
+            }
+        }
+
+        // New cases have nothing to compare against
+        if ((base == NULL) || (base->ns_per_op <= 0.0)) {
+            printf("compare=%s ns_per_op=%.2f baseline_ns_per_op=none\n", 
+                    results[i].name, results[i].ns_per_op);
+            continue;
+        }
+
+        // Per-op times from different iteration counts include different
+        // shares of the loop and timing overhead
+        if (base->iterations != results[i].iterations) {
+            fprintf(stderr, "%s: %lu iterations, baseline has %lu, not compared\n", 
+                    results[i].name, (unsigned long)results[i].iterations, 
+                    (unsigned long)base->iterations);
+            printf("compare=%s iterations=%lu baseline_iterations=%lu mismatch=1\n", 
+                    results[i].name, (unsigned long)results[i].iterations, 
+                    (unsigned long)base->iterations);
+            (*mismatches)++;
+            continue;
+        }
+
+        double change_pct = ((results[i].ns_per_op - base->ns_per_op) * 100.0) 
+                / base->ns_per_op;
+        double limit_pct = tolerance_pct + ((results[i].spread_pct + base->spread_pct) / 2.0);
+        int regression = (change_pct > limit_pct);
+        regressions += regression;
+
+        printf("compare=%s ns_per_op=%.2f baseline_ns_per_op=%.2f change_pct=%+.1f "
+                "limit_pct=%.1f regression=%d\n", results[i].name, results[i].ns_per_op, 
+                base->ns_per_op, change_pct, limit_pct, regression);
+    }
+
+    return regressions;
+}
+
+int main(int argc, char **argv) {
+    uint32_t iterations = BENCH_HOST_ITERATIONS;
+    int processes = BENCH_HOST_PROCESSES;
+    const char *results_path = NULL;
+    const char *baseline_path = NULL;
+    double tolerance_pct = BENCH_DEFAULT_TOLERANCE_PCT;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:p:r:b:t:")) != -1) {
+        switch (opt) {
+            case 'n':
+                iterations = strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                processes = atoi(optarg);
+                break;
+            case 'r':
+                results_path = optarg;
+                break;
+            case 'b':
+                baseline_path = optarg;
+                break;
+            case 't':
+                tolerance_pct = atof(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-n iterations] [-p processes] [-r results] "
+                        "[-b baseline] [-t tolerance (%%)]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if ((processes < 1) || (processes > BENCH_HOST_MAX_PROCESSES)) {
+        fprintf(stderr, "%s: 1 to %d processes are allowed\n", argv[0], 
+                BENCH_HOST_MAX_PROCESSES);
+        return 2;
+    }
+
+    struct bench_result results[BENCH_MAX_RESULTS];
+    int num_results;
+
+    if (results_path != NULL) {
+        // Results from elsewhere (e.g. the benchmark firmware)
+        num_results = load_results(results_path, results);
+        if (num_results < 0) {
+            return 2;
+        }
+    } else {
+        num_results = bench_num_cases;
+        if (!run_suite(iterations, processes, results)) {
+            return 2;
+        }
+
+        for (int i = 0; i < num_results; i++) {
+            bench_print_result(&results[i], 0);
+        }
+    }
+
+    if (baseline_path == NULL) {
+        return 0;
+    }
+
+    struct bench_result baseline[BENCH_MAX_RESULTS];
+    int num_baseline = load_results(baseline_path, baseline);
+    if (num_baseline < 0) {
+        return 2;
+    }
+
+    int mismatches;
+    int regressions = compare_results(results, num_results, baseline, num_baseline, 
+            tolerance_pct, &mismatches);
+    printf("regressions=%d mismatches=%d\n", regressions, mismatches);
+
+    // A comparison with mismatched cases is incomplete, so it fails even 
+    // without regressions
+    if (regressions > 0) {
+        return 1;
+    }
+
+    return (mismatches > 0) ? 2 : 0;
+}
@@ -0,0 +1,231 @@
+ /** 
+ **************************************************************
+ * @file capture.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Telemetry capture tool. This tool reads the telemetry stream from
+ *        the Raspberry Pi Pico's USB CDC port (firmware built with 
+ *        TELEMETRY_STREAM), and writes every valid record straight to disk.
+ *        Bytes which aren't part of a valid record (e.g. stdio text, or a 
+ *        record cut off when the capture started) are skipped by searching
+ *        for the next sync bytes. 
+ * 
+ *        Usage: capture <device> <output file> [duration (sec)]
+ *************************************************************** 
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <time.h>
+#include "telemetry_record.h"
+
+// Size of the buffer which the stream is read into, in bytes. 
+#define CAPTURE_BUFFER_LEN 4096
+
+// Number of records written between flushes of the output file. 
+#define CAPTURE_FLUSH_RECORDS 64
+
+// Struct holding capture statistics. 
+struct capture_stats {
+    unsigned long records;          // Valid records written
+    unsigned long crc_errors;       // Records with a bad header/CRC
+    unsigned long skipped_bytes;    // Bytes outside valid records
+    unsigned long dropped;          // Records dropped by the firmware
+    unsigned long seq_gaps;         // Frames missing from the sequence
+    unsigned long deadline_misses;  // Supervisor deadline misses (as of 
+                                    // the last record)
+    unsigned long worst_late_us;    // Worst deadline miss lateness
+    unsigned long foreign_records;  // Records with another tank count
+    unsigned int foreign_tanks;     // Tank count of those records
+};
+
+// Set by the SIGINT handler to stop capturing. 
+static volatile sig_atomic_t stop = 0;
+
+/**
+ * @brief SIGINT handler. This handler stops the capture. 
+ * @param sig Signal number. 
+ * @retval None. 
+ */
+static void handle_sigint(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+/**
+ * @brief Serial port opening function. This function opens the USB CDC 
+ *        device in raw mode. 
+ * @param device Path of the device. 
+ * @retval File descriptor, or -1 on error. 
+ */
+static int open_serial(const char *device) {
+    int fd = open(device, O_RDONLY | O_NOCTTY);
+    if (fd < 0) {
+        perror(device);
+        return -1;
+    }
+
+    // Not a tty (e.g. a file or FIFO being replayed), so nothing to set
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0) {
+        return fd;
+    }
+
+    cfmakeraw(&tio);
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tio);
+    tcflush(fd, TCIFLUSH);
+
+    return fd;
+}
+
+/**
+ * @brief Stream parsing function. This function extracts every complete 
+ *        record from the start of the buffer, writing valid records to the
+ *        output file. 
+ * @param buffer Buffer holding received bytes. 
+ * @param len Number of bytes in the buffer. 
+ * @param out Output file. 
+ * @param stats Pointer to capture statistics. 
+ * @retval Number of bytes consumed from the start of the buffer (the rest 
+ *         is an incomplete record). 
+ */
+static size_t parse_stream(const uint8_t *buffer, size_t len, FILE *out,
+        struct capture_stats *stats) {
+    static uint32_t expected_seq = 0;
+    static int have_seq = 0;
+    size_t pos = 0;
+
+    while ((len - pos) >= sizeof(struct telemetry_record)) {
+        // Search for the sync bytes
+        if ((buffer[pos] != (TELEMETRY_SYNC & 0xFF)) 
+                || (buffer[pos + 1] != (TELEMETRY_SYNC >> 8))) {
+            pos++;
+            stats->skipped_bytes++;
+            continue;
+        }
+
+        struct telemetry_record record;
+        memcpy(&record, &buffer[pos], sizeof(record));
+
+        // Records from a build with a different tank count are skipped 
+        // whole (once complete), and counted so the mismatch is reported
+        uint8_t num_tanks = telemetry_record_tanks(&buffer[pos], len - pos);
+        if (!telemetry_record_valid(&record) && (num_tanks != 0) 
+                && (num_tanks != TELEMETRY_NUM_TANKS)) {
+            size_t length = telemetry_record_length(num_tanks);
+            if ((len - pos) < length) {
+                break;
+            }
+
+            uint16_t crc = buffer[pos + length - 2] | (buffer[pos + length - 1] << 8);
+            if (crc == telemetry_crc16(&buffer[pos], length - sizeof(crc))) {
+                pos += length;
+                stats->foreign_records++;
+                stats->foreign_tanks = num_tanks;
+                continue;
+            }
+        }
+
+        // Sync bytes may appear inside a record, so skip past them only
+        if (!telemetry_record_valid(&record)) {
+            pos++;
+            stats->crc_errors++;
+            stats->skipped_bytes++;
+            continue;
+        }
+
+        fwrite(&record, sizeof(record), 1, out);
+        pos += sizeof(record);
+
+        stats->records++;
+        stats->dropped += record.dropped;
+        stats->deadline_misses = record.deadline_misses;
+        stats->worst_late_us = record.worst_lateness_us;
+        if (have_seq && (record.seq != expected_seq)) {
+            stats->seq_gaps += (record.seq - expected_seq);
+        }
+        expected_seq = record.seq + 1;
+        have_seq = 1;
+
+        if ((stats->records % CAPTURE_FLUSH_RECORDS) == 0) {
+            fflush(out);
+        }
+    }
+
+    return pos;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <device> <output file> [duration (sec)]\n", argv[0]);
+        return 1;
+    }
+
+    double duration_sec = (argc > 3) ? atof(argv[3]) : 0.0;
+
+    int fd = open_serial(argv[1]);
+    if (fd < 0) {
+        return 1;
+    }
+
+    FILE *out = fopen(argv[2], "wb");
+    if (out == NULL) {
+        perror(argv[2]);
+        close(fd);
+        return 1;
+    }
+
+    signal(SIGINT, handle_sigint);
+
+    struct capture_stats stats = {0};
+    static uint8_t buffer[CAPTURE_BUFFER_LEN];
+    size_t len = 0;
+
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (!stop) {
+        ssize_t received = read(fd, &buffer[len], sizeof(buffer) - len);
+        if (received <= 0) {
+            break;
+        }
+        len += received;
+
+        // Keep any incomplete record at the start of the buffer
+        size_t consumed = parse_stream(buffer, len, out, &stats);
+        memmove(buffer, &buffer[consumed], len - consumed);
+        len -= consumed;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double elapsed = (now.tv_sec - start.tv_sec) + ((now.tv_nsec - start.tv_nsec) / 1e9);
+        if ((duration_sec > 0.0) && (elapsed >= duration_sec)) {
+            break;
+        }
+    }
+
+    fclose(out);
+    close(fd);
+
+    fprintf(stderr, "records=%lu crc_errors=%lu skipped_bytes=%lu dropped=%lu seq_gaps=%lu "
+            "deadline_misses=%lu worst_late_us=%lu\n",
+            stats.records, stats.crc_errors, stats.skipped_bytes, stats.dropped, 
+            stats.seq_gaps, stats.deadline_misses, stats.worst_late_us);
+
+    if (stats.foreign_records > 0) {
+        fprintf(stderr, "Skipped %lu records with %u tanks, capture is built with %u "
+                "(rebuild with -DNUM_TANKS=%u)\n", stats.foreign_records, 
+                stats.foreign_tanks, TELEMETRY_NUM_TANKS, stats.foreign_tanks);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,327 @@
+ /**
+ **************************************************************
+ * @file debounce_test.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Debouncer test. This tool drives the firmware's switch debouncer
+ *        (see mylib/debounce) with synthetic bounce storms, the way the
+ *        control enable switch does (edges from the GPIO interrupt, polls
+ *        from a hardware timer alarm, which sometimes can't be scheduled
+ *        during a storm). Storms are bursts of edges with gaps shorter than
+ *        the settle time, some ending at the level they started from, sent
+ *        either far enough apart for every change to be reported, or closer
+ *        together than the rate limit. Every event must report a change to the level the input
+ *        is at, timestamped with the edge it has been stable since, no
+ *        sooner than the settle time and rate limit allow and no later. The
+ *        final level must always be reported, and storms far enough apart
+ *        must give exactly one event per change. Results are reported as
+ *        key=value lines, and the exit status is non-zero on any failure.
+ *
+ *        Usage: debounce_test [-n storms per run] [-r runs] [-s seed]
+ ***************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "debounce.h"
+
+// Debouncer timing (as for the control enable switch, see ctrl.h).
+#define DEBOUNCE_TEST_SETTLE_US 20000
+#define DEBOUNCE_TEST_MIN_INTERVAL_US 500000
+
+// Defaults for the command line options.
+#define DEBOUNCE_TEST_DEFAULT_STORMS 50
+#define DEBOUNCE_TEST_DEFAULT_RUNS 200
+#define DEBOUNCE_TEST_DEFAULT_SEED 1
+
+// Longest storm (in edges), and the edge table size.
+#define DEBOUNCE_TEST_MAX_STORM_EDGES 40
+#define DEBOUNCE_TEST_MAX_EDGES 100000
+
+// Chance (in 1/256) of an alarm not being scheduled for an edge.
+#define DEBOUNCE_TEST_ALARM_FAIL_CHANCE 32
+
+// Storm spacing modes.
+#define DEBOUNCE_TEST_SEPARATE 0    // Every change can be reported
+#define DEBOUNCE_TEST_RATE_LIMIT 1  // Changes within the rate limit
+#define DEBOUNCE_TEST_NUM_MODES 2
+
+// Struct holding a synthetic input (its edges, and the level after each).
+struct test_input {
+    bool initial_level;
+    uint32_t num_edges;
+    uint64_t edge_us[DEBOUNCE_TEST_MAX_EDGES];
+    bool edge_level[DEBOUNCE_TEST_MAX_EDGES];
+    bool storm_end[DEBOUNCE_TEST_MAX_EDGES];    // Last edge of its storm
+    uint32_t changes;               // Storms which changed the level
+    bool fail_alarms;               // Whether alarms can fail to schedule
+};
+
+// Struct holding the results of a run.
+struct test_result {
+    uint32_t events;
+    uint32_t failures;
+    uint32_t alarm_failures;
+};
+
+// Input driven in a run.
+static struct test_input input;
+
+// PRNG state.
+static uint64_t prng_state;
+
+/**
+ * @brief PRNG function (splitmix64).
+ * @param None.
+ * @retval Pseudo-random number.
+ */
+static uint64_t test_rand(void) {
+    uint64_t z = (prng_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief PRNG range function.
+ * @param min Smallest value.
+ * @param max Largest value.
+ * @retval Pseudo-random number from min to max (inclusive).
+ */
+static uint64_t test_rand_range(uint64_t min, uint64_t max) {
+    return min + (test_rand() % (max - min + 1));
+}
+
+/**
+ * @brief Input build function. This function builds an input of storms,
+ *        each a burst of edges with gaps shorter than the settle time.
+ * @param storms Number of storms.
+ * @param mode Storm spacing (DEBOUNCE_TEST_*).
+ * @retval None.
+ */
+static void test_build_input(uint32_t storms, uint8_t mode) {
+    bool level = test_rand() & 1;
+    uint64_t now = test_rand_range(0, DEBOUNCE_TEST_MIN_INTERVAL_US);
+
+    input.initial_level = level;
+    input.num_edges = 0;
+    input.changes = 0;
+    input.fail_alarms = (test_rand() & 1);
+
+    for (uint32_t storm = 0; storm < storms; storm++) {
+        uint32_t edges = test_rand_range(1, DEBOUNCE_TEST_MAX_STORM_EDGES);
+        bool start_level = level;
+
+        for (uint32_t i = 0; i < edges; i++) {
+            if (i > 0) {
+                now += test_rand_range(1, DEBOUNCE_TEST_SETTLE_US - 1);
+            }
+
+            level = !level;
+            input.edge_us[input.num_edges] = now;
+            input.edge_level[input.num_edges] = level;
+            input.storm_end[input.num_edges] = (i == (edges - 1));
+            input.num_edges++;
+        }
+
+        if (level != start_level) {
+            input.changes++;
+        }
+
+        // Leave the storm settled, then either wait out the rate limit
+        // (so every change is reported) or start the next storm within it.
+        if (mode == DEBOUNCE_TEST_SEPARATE) {
+            now += DEBOUNCE_TEST_SETTLE_US + DEBOUNCE_TEST_MIN_INTERVAL_US
+                    + test_rand_range(1, DEBOUNCE_TEST_MIN_INTERVAL_US);
+        } else {
+            now += test_rand_range(DEBOUNCE_TEST_SETTLE_US,
+                    DEBOUNCE_TEST_SETTLE_US + DEBOUNCE_TEST_MIN_INTERVAL_US);
+        }
+    }
+}
+
+/**
+ * @brief Input level function.
+ * @param edge Number of edges which have occurred.
+ * @retval Level of the input after those edges.
+ */
+static bool test_level(uint32_t edge) {
+    return (edge == 0) ? input.initial_level : input.edge_level[edge - 1];
+}
+
+/**
+ * @brief Failure report function.
+ * @param result Pointer to the run results.
+ * @param run Run number.
+ * @param what Failure description.
+ * @param at_us Time of the failure, in usec.
+ * @retval None.
+ */
+static void test_fail(struct test_result *result, uint32_t run, const char *what,
+        uint64_t at_us) {
+    if (result->failures == 0) {
+        fprintf(stderr, "run %u: %s at %llu us\n", run, what, (unsigned long long)at_us);
+    }
+
+    result->failures++;
+}
+
+/**
+ * @brief Run function. This function feeds the input's edges to a
+ *        debouncer, calls debounce_poll() whenever the simulated alarm
+ *        fires, and checks every event (and the level left reported).
+ * @param run Run number.
+ * @param mode Storm spacing (DEBOUNCE_TEST_*).
+ * @param result Pointer to the run results.
+ * @retval None.
+ */
+static void test_run(uint32_t run, uint8_t mode, struct test_result *result) {
+    struct debouncer db;
+    debounce_init(&db, input.initial_level, DEBOUNCE_TEST_SETTLE_US,
+            DEBOUNCE_TEST_MIN_INTERVAL_US);
+
+    bool reported = input.initial_level;
+    bool any_event = false;
+    uint64_t last_event_us = 0;
+    uint64_t poll_us = UINT64_MAX;
+    uint32_t edge = 0;
+    uint32_t events = 0;
+
+    while ((edge < input.num_edges) || (poll_us != UINT64_MAX)) {
+        // Edges are handled before a poll due at the same time
+        if ((edge < input.num_edges) && (input.edge_us[edge] <= poll_us)) {
+            uint64_t now = input.edge_us[edge];
+            edge++;
+
+            if (debounce_edge(&db, now)) {
+                // The alarm for the last edge of a storm is always
+                // scheduled, otherwise nothing would sample the storm's
+                // final level until the next edge
+                if (input.fail_alarms && !input.storm_end[edge - 1]
+                        && ((test_rand() & 0xFF) < DEBOUNCE_TEST_ALARM_FAIL_CHANCE)) {
+                    debounce_cancel(&db);
+                    result->alarm_failures++;
+                } else {
+                    poll_us = now + DEBOUNCE_TEST_SETTLE_US;
+                }
+            }
+            continue;
+        }
+
+        uint64_t now = poll_us;
+        struct debounce_event event;
+        bool emitted;
+        uint32_t resample_us = debounce_poll(&db, test_level(edge), now, &event, &emitted);
+        poll_us = (resample_us > 0) ? (now + resample_us) : UINT64_MAX;
+
+        if (!emitted) {
+            continue;
+        }
+
+        events++;
+
+        // The event must report a change, to the level the input is at,
+        // since the last edge
+        if (event.level == reported) {
+            test_fail(result, run, "repeated level", now);
+        }
+        if (event.level != test_level(edge)) {
+            test_fail(result, run, "wrong level", now);
+        }
+        if ((edge == 0) || (event.timestamp_us != input.edge_us[edge - 1])) {
+            test_fail(result, run, "wrong timestamp", now);
+        }
+
+        // It must be emitted as soon as the settle time and rate limit
+        // allow (no sooner, and no later)
+        uint64_t due_us = event.timestamp_us + DEBOUNCE_TEST_SETTLE_US;
+        if (any_event && ((last_event_us + DEBOUNCE_TEST_MIN_INTERVAL_US) > due_us)) {
+            due_us = last_event_us + DEBOUNCE_TEST_MIN_INTERVAL_US;
+        }
+        if (now != due_us) {
+            test_fail(result, run, (now < due_us) ? "early event" : "late event", now);
+        }
+
+        reported = event.level;
+        any_event = true;
+        last_event_us = now;
+    }
+
+    // The final level must never be lost
+    if (reported != test_level(input.num_edges)) {
+        test_fail(result, run, "final level lost", input.edge_us[input.num_edges - 1]);
+    }
+
+    // Storms far enough apart give exactly one event per change
+    if ((mode == DEBOUNCE_TEST_SEPARATE) && (events != input.changes)) {
+        test_fail(result, run, "event count differs from level changes",
+                input.edge_us[input.num_edges - 1]);
+    }
+
+    result->events += events;
+}
+
+int main(int argc, char **argv) {
+    uint32_t storms = DEBOUNCE_TEST_DEFAULT_STORMS;
+    uint32_t runs = DEBOUNCE_TEST_DEFAULT_RUNS;
+    uint64_t seed = DEBOUNCE_TEST_DEFAULT_SEED;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:r:s:")) != -1) {
+        switch (opt) {
+            case 'n':
+                storms = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                runs = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-n storms per run] [-r runs] [-s seed]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+
+    if ((storms == 0) || (runs == 0)
+            || (((uint64_t)storms * DEBOUNCE_TEST_MAX_STORM_EDGES) > DEBOUNCE_TEST_MAX_EDGES)) {
+        fprintf(stderr, "%s: 1 to %u storms per run and at least one run are required\n",
+                argv[0], DEBOUNCE_TEST_MAX_EDGES / DEBOUNCE_TEST_MAX_STORM_EDGES);
+        return 2;
+    }
+
+    static const char *mode_names[DEBOUNCE_TEST_NUM_MODES] = {"separate", "rate_limited"};
+    bool ok = true;
+    prng_state = seed;
+
+    for (uint8_t mode = 0; mode < DEBOUNCE_TEST_NUM_MODES; mode++) {
+        struct test_result result = {0, 0, 0};
+        uint64_t edges = 0;
+        uint64_t changes = 0;
+
+        for (uint32_t run = 0; run < runs; run++) {
+            test_build_input(storms, mode);
+            test_run(run, mode, &result);
+            edges += input.num_edges;
+            changes += input.changes;
+        }
+
+        printf("mode=%s runs=%u edges=%llu changes=%llu events=%u alarm_failures=%u "
+                "failures=%u\n", mode_names[mode], runs, (unsigned long long)edges,
+                (unsigned long long)changes, result.events, result.alarm_failures,
+                result.failures);
+
+        if (result.failures > 0) {
+            ok = false;
+        }
+    }
+
+    printf("result=%s\n", ok ? "pass" : "FAIL");
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,1358 @@
+ /**
+ **************************************************************
+ * @file gateway.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Site gateway daemon. This daemon polls many Pico nodes over serial
+ *        (USB-serial adapters on each node's UART, or pseudo-terminals of 
+ *        host stand-in nodes, see node.c) from a single epoll event loop 
+ *        with non-blocking I/O. Each poll cycle, every request is sent to a
+ *        node back-to-back (pipelined), and the node's replies are matched 
+ *        to requests by their first character. Requests which aren't 
+ *        answered in time are retried, and each node's request latency is 
+ *        reported. Replies are printed to stdout, one per line. With a 
+ *        store directory, each cycle's replies are also stored as one sample
+ *        per tank (see store.c), once every request of the cycle has been 
+ *        answered or abandoned. Range queries over the store are answered 
+ *        on a Unix socket (see query_server.c). With a broker, each 
+ *        completed cycle is also published over MQTT, as one line per tank
+ *        on the node's readings topic (and a line on its events topic if 
+ *        events were raised), in batches spooled to disk until delivered 
+ *        (see publisher.c). 
+ *
+ *        Nodes given as "<device>@<id>" (node ID in hex) share an RS-485 
+ *        multi-drop bus on the device with the other nodes given on it (see
+ *        multidrop.h). Each poll interval, a latch broadcast makes every 
+ *        node on the bus take its heights at the same moment, then the 
+ *        nodes are polled in turn with one request frame each (heights 
+ *        requests become latched heights requests), leaving the line 
+ *        turnaround time between transactions. Each bus's round time is 
+ *        reported with the line time its frames and replies take. 
+ *
+ *        Usage: gateway [-i poll interval (ms)] [-t timeout (ms)] 
+ *                       [-r retries] [-q requests] [-s report interval (s)]
+ *                       [-c cycles] [-n] [-d store dir] [-F flush interval (s)]
+ *                       [-y] [-Q query socket] [-M broker host:port] 
+ *                       [-P qos] [-B batch time (ms)] [-Z batch size (bytes)]
+ *                       [-S spool dir] [-b baud] <device>[@id] 
+ *                       [device[@id] ...]
+ ***************************************************************
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include "meas_pipeline.h"
+#include "alert_events.h"
+#include "serialise.h"
+#include "store.h"
+#include "query_server.h"
+#include "publisher.h"
+#include "multidrop.h"
+
+// Maximum number of nodes. 
+#define GATEWAY_MAX_NODES 256
+
+// Maximum number of request types sent each poll cycle (R/A/E/S). 
+#define GATEWAY_MAX_REQUESTS 4
+
+// Receive buffer size (the longest reply polled for, analytics, with a 
+// multi-drop prefix and the terminating null). Replies grow with NUM_TANKS. 
+#define GATEWAY_RX_LEN (MULTIDROP_PREFIX_LEN + SERIALISE_ANALYTICS_LEN)
+
+_Static_assert(SERIALISE_ANALYTICS_LEN >= (1 + SERIALISE_READINGS_LEN), 
+        "Analytics isn't the longest reply");
+_Static_assert((SERIALISE_ANALYTICS_LEN >= SERIALISE_EVENTS_LEN) 
+        && (SERIALISE_ANALYTICS_LEN >= SERIALISE_STATE_LEN), "Analytics isn't the longest reply");
+
+// Defaults for the command line options. 
+#define GATEWAY_DEFAULT_POLL_MS 1000
+#define GATEWAY_DEFAULT_TIMEOUT_MS 500
+#define GATEWAY_DEFAULT_RETRIES 2
+#define GATEWAY_DEFAULT_REQUESTS "RAES"
+#define GATEWAY_DEFAULT_REPORT_SEC 10
+#define GATEWAY_DEFAULT_FLUSH_SEC 10
+#define GATEWAY_DEFAULT_SPOOL_DIR "mqtt_spool"
+#define GATEWAY_DEFAULT_BAUD 9600
+
+// Time between attempts to reopen a device which has gone away (in msec). 
+#define GATEWAY_REOPEN_MS 2000
+
+// Latency histogram, in buckets of GATEWAY_LATENCY_BUCKET_US up to 2 sec 
+// (the last bucket holds every latency beyond the range). 
+#define GATEWAY_LATENCY_BUCKET_US 250
+#define GATEWAY_LATENCY_BUCKETS 8000
+
+// Maximum number of events handled per epoll wait. 
+#define GATEWAY_MAX_EVENTS 64
+
+// Epoll IDs below this are bus indices, and the query server's sockets 
+// use IDs from it. The publisher's connection uses the ID after them. 
+#define GATEWAY_QUERY_EPOLL_BASE GATEWAY_MAX_NODES
+#define GATEWAY_PUBLISHER_EPOLL_ID (GATEWAY_QUERY_EPOLL_BASE + 1 + QUERY_MAX_CLIENTS)
+
+// Struct holding a request in flight. 
+struct request {
+    char type;                  // Request character
+    bool active;
+    uint8_t attempts;
+    uint64_t first_sent_us;     // Latency is measured from the first attempt
+    uint64_t deadline_us;
+};
+
+// Struct holding the request statistics of a node. 
+struct node_stats {
+    uint64_t requests;
+    uint64_t replies;
+    uint64_t timeouts;
+    uint64_t retries;
+    uint64_t failures;          // Requests abandoned after every retry
+    uint64_t stray;             // Replies with no matching request
+    uint64_t overruns;          // Cycles skipped while requests in flight
+    uint64_t missed_latches;    // Latched heights requests with no latch
+    uint64_t latency_sum_us;
+    uint64_t latency_max_us;
+    uint32_t latency_hist[GATEWAY_LATENCY_BUCKETS];
+};
+
+// Struct holding the replies of a node's current poll cycle, stored once 
+// the cycle completes. Valve states and leak flags carry over from earlier
+// cycles if their requests aren't answered. 
+struct node_cycle {
+    bool pending;               // Cycle started and not yet stored
+    int64_t ts_ms;              // Wall clock time the cycle started
+    bool have_heights;
+    float heights[NUM_TANKS];
+    uint32_t state;             // SERIALISE_STATE_* bits of each tank
+    uint32_t events;            // ALERT_TANK_EVENT() bits
+    bool leak[NUM_TANKS];
+};
+
+// Struct holding the state of a node. 
+struct node {
+    const char *path;           // Device argument (with the node ID if any)
+    struct bus *bus;
+    struct node *bus_next;      // Next node polled on the bus
+    uint8_t id;                 // Multi-drop node ID (0 if point-to-point)
+    uint64_t cycles;            // Poll cycles started
+    uint64_t txn_start_us;
+    struct request requests[GATEWAY_MAX_REQUESTS];
+    struct node_stats stats;
+    struct node_cycle cycle;
+    struct store_series *series[NUM_TANKS];     // NULL without a store
+    struct publisher *publisher;                // NULL without a broker
+    struct publisher_topic *topics[PUBLISHER_NUM_CLASSES];
+};
+
+// Struct holding the round statistics of a multi-drop bus. 
+struct bus_stats {
+    uint64_t rounds;
+    uint64_t round_sum_us;
+    uint64_t round_max_us;
+    uint64_t line_sum_us;       // Line time of the frames and replies
+    uint64_t transactions;
+    uint64_t txn_sum_us;
+    uint64_t txn_max_us;
+    uint64_t stray;             // Replies not from the node being polled
+};
+
+// Struct holding the state of a serial line, used by one node (point-to-
+// point), or shared by the nodes on a multi-drop bus. 
+struct bus {
+    char *path;
+    int fd;                     // -1 while the device is closed
+    uint64_t reopen_us;
+    uint64_t next_poll_us;
+    char rx[GATEWAY_RX_LEN];
+    size_t rx_len;
+    bool multidrop;
+    struct node *nodes;         // First node polled
+    uint32_t num_nodes;
+    bool round_active;          // Round started, and not every node polled
+    struct node *active;        // Node being (or next to be) polled
+    bool transacting;           // Request frame sent to the active node
+    uint64_t round_start_us;
+    uint64_t next_send_us;      // End of the line turnaround
+    uint64_t round_line_us;
+    size_t txn_request_len;     // Characters of the active transaction
+    size_t txn_reply_len;
+    struct bus_stats stats;
+};
+
+// Struct holding the gateway configuration. 
+struct gateway_cfg {
+    uint64_t poll_us;
+    uint64_t timeout_us;
+    uint8_t retries;
+    const char *requests;
+    uint64_t report_us;
+    uint64_t cycles;            // Poll cycles before exiting (0 for no limit)
+    bool print_replies;
+    const char *store_dir;      // NULL to not store samples
+    uint64_t flush_us;
+    bool store_sync;
+    const char *query_path;     // NULL to not answer queries
+    struct publisher_cfg publisher;     // Broker NULL to not publish
+    uint32_t baud;
+};
+
+// Set by the signal handler to stop the gateway. 
+static volatile sig_atomic_t stop = 0;
+
+/**
+ * @brief Signal handler. 
+ * @param signum Signal number. 
+ * @retval None. 
+ */
+static void handle_signal(int signum) {
+    (void)signum;
+    stop = 1;
+}
+
+/**
+ * @brief Monotonic time function. 
+ * @param None. 
+ * @retval Monotonic time, in usec. 
+ */
+static uint64_t now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
+/**
+ * @brief Wall clock time function. 
+ * @param None. 
+ * @retval Time since the epoch, in msec. 
+ */
+static uint64_t wall_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return ((uint64_t)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+/**
+ * @brief Reply type function. This function maps the first character of a
+ *        reply to the request it answers. 
+ * @param first First character of the reply. 
+ * @retval Request character, or 0 if not a reply. 
+ */
+static char reply_request_type(char first) {
+    switch (first) {
+        case 'T':
+            return 'R';
+        case 'A':
+            return 'A';
+        case 'E':
+            return 'E';
+        case 'S':
+            return 'S';
+        case MULTIDROP_LATCH:
+            return MULTIDROP_LATCH;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Cycle store function. This function stores and publishes a node's
+ *        completed poll cycle as a sample of each of its tanks (if the 
+ *        cycle's heights were received), and publishes the cycle's events. 
+ * @param node Pointer to the node. 
+ * @retval None. 
+ */
+static void node_store_cycle(struct node *node) {
+    struct node_cycle *cycle = &node->cycle;
+
+    for (uint8_t i = 0; i < GATEWAY_MAX_REQUESTS; i++) {
+        if (node->requests[i].active) {
+            return;
+        }
+    }
+
+    if (!cycle->pending) {
+        return;
+    }
+    cycle->pending = false;
+
+    char line[PUBLISHER_MAX_LINE_LEN];
+    int len;
+
+    for (uint8_t i = 0; (i < NUM_TANKS) && cycle->have_heights; i++) {
+        struct store_sample sample = {
+            .ts_ms = cycle->ts_ms,
+            .height_cm = cycle->heights[i],
+            .state = (cycle->state >> (i * SERIALISE_STATE_BITS_PER_TANK)) 
+                    & ((1 << SERIALISE_STATE_BITS_PER_TANK) - 1),
+            .status = ((cycle->events >> (i * ALERT_EVENT_BITS_PER_TANK)) 
+                    & ((1 << ALERT_EVENT_BITS_PER_TANK) - 1)) 
+                    | (cycle->leak[i] ? STORE_STATUS_LEAK : 0),
+        };
+
+        if ((node->series[i] != NULL) && !store_append(node->series[i], &sample)) {
+            fprintf(stderr, "node=%s tank=%u store append failed\n", node->path, i + 1);
+        }
+
+        // "<ts ms>,<tank>,<height>,<state>,<status>"
+        if (node->publisher != NULL) {
+            len = snprintf(line, sizeof(line), "%lld,%u,%.1f,%u,%u\n", 
+                    (long long)cycle->ts_ms, i + 1, cycle->heights[i], sample.state, 
+                    sample.status);
+            publisher_add(node->publisher, node->topics[PUBLISHER_CLASS_READINGS], line, 
+                    len, cycle->ts_ms);
+        }
+    }
+
+    // "<ts ms>,<events>", published even if the heights weren't received
+    if ((node->publisher != NULL) && (cycle->events != 0)) {
+        len = snprintf(line, sizeof(line), "%lld,%x\n", (long long)cycle->ts_ms, 
+                (unsigned int)cycle->events);
+        publisher_add(node->publisher, node->topics[PUBLISHER_CLASS_EVENTS], line, len, 
+                cycle->ts_ms);
+    }
+}
+
+/**
+ * @brief Reply parse function. This function records the fields of a reply 
+ *        in the node's current poll cycle. 
+ * @param cycle Pointer to the node's poll cycle. 
+ * @param reply Reply string (without its termination character). 
+ * @retval None. 
+ */
+static void cycle_parse_reply(struct node_cycle *cycle, const char *reply) {
+    const char *pos = reply;
+    char *end;
+
+    switch (reply[0]) {
+        case MULTIDROP_LATCH:
+            // "LT1=25.3T2=40.1", the heights latched by the last broadcast
+            // (or "L" alone if the node missed it)
+            pos++;
+            // Fall through
+        case 'T':
+            // "T1=25.3T2=40.1"
+            for (uint8_t i = 0; i < NUM_TANKS; i++) {
+                if ((pos[0] != 'T') || (pos[1] != ('1' + i)) || (pos[2] != '=')) {
+                    return;
+                }
+                cycle->heights[i] = strtof(&pos[3], &end);
+
+                // Heights are sent clamped to 0 - 999.9 cm, so anything else
+                // (or nothing) is a garbled reply
+                if ((end == &pos[3]) || !isfinite(cycle->heights[i]) 
+                        || (cycle->heights[i] < 0.0f) 
+                        || (cycle->heights[i] > (SERIALISE_HEIGHT_MAX_TENTHS / 10.0f))) {
+                    return;
+                }
+                pos = end;
+            }
+            cycle->have_heights = true;
+            break;
+        case 'A':
+            // "A1=-0.25,120,-1,0A2=0.00,-1,-1,0", the leak flag is last
+            for (uint8_t i = 0; i < NUM_TANKS; i++) {
+                pos = strchr(pos, ',');
+                pos = (pos != NULL) ? strchr(pos + 1, ',') : NULL;
+                pos = (pos != NULL) ? strchr(pos + 1, ',') : NULL;
+                if (pos == NULL) {
+                    return;
+                }
+                pos++;
+                cycle->leak[i] = (*pos == '1');
+            }
+            break;
+        case 'E':
+            cycle->events = strtoul(&reply[2], NULL, 16);
+            break;
+        case 'S':
+            cycle->state = strtoul(&reply[2], NULL, 16);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Line speed function. 
+ * @param baud Baud rate. 
+ * @retval termios speed of the baud rate, or B0 if it isn't supported. 
+ */
+static speed_t baud_speed(uint32_t baud) {
+    switch (baud) {
+        case 9600:
+            return B9600;
+        case 19200:
+            return B19200;
+        case 38400:
+            return B38400;
+        case 57600:
+            return B57600;
+        case 115200:
+            return B115200;
+        case 230400:
+            return B230400;
+        case 460800:
+            return B460800;
+        case 921600:
+            return B921600;
+        default:
+            return B0;
+    }
+}
+
+/**
+ * @brief In flight function. 
+ * @param node Pointer to the node. 
+ * @retval true if any of the node's requests are in flight (or waiting for
+ *         the node's turn on a multi-drop bus), false otherwise. 
+ */
+static bool node_in_flight(const struct node *node) {
+    for (uint8_t i = 0; i < GATEWAY_MAX_REQUESTS; i++) {
+        if (node->requests[i].active) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Bus open function. This function opens a bus's device in 
+ *        non-blocking mode (configured as the Pico's UART, 8N1 at the 
+ *        configured baud rate, if it is a terminal), and adds it to the 
+ *        epoll set. 
+ * @param bus Pointer to the bus. 
+ * @param index Index of the bus. 
+ * @param cfg Pointer to the gateway configuration. 
+ * @param epoll_fd epoll file descriptor. 
+ * @retval true if the device was opened, false otherwise. 
+ */
+static bool bus_open(struct bus *bus, uint32_t index, const struct gateway_cfg *cfg, 
+        int epoll_fd) {
+    bus->fd = open(bus->path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (bus->fd < 0) {
+        return false;
+    }
+
+    if (isatty(bus->fd)) {
+        struct termios tio;
+        tcgetattr(bus->fd, &tio);
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, baud_speed(cfg->baud));
+        cfsetospeed(&tio, baud_speed(cfg->baud));
+        tio.c_cflag |= (CLOCAL | CREAD);
+        tcsetattr(bus->fd, TCSANOW, &tio);
+        tcflush(bus->fd, TCIOFLUSH);
+    }
+
+    struct epoll_event event = {.events = EPOLLIN, .data.u32 = index};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, bus->fd, &event) != 0) {
+        perror("epoll_ctl");
+        close(bus->fd);
+        bus->fd = -1;
+        return false;
+    }
+
+    bus->rx_len = 0;
+    return true;
+}
+
+/**
+ * @brief Bus close function. This function closes a bus's device (e.g. 
+ *        after it has been unplugged), abandons the requests of its nodes 
+ *        (and its round), and schedules it to be reopened. 
+ * @param bus Pointer to the bus. 
+ * @param epoll_fd epoll file descriptor. 
+ * @retval None. 
+ */
+static void bus_close(struct bus *bus, int epoll_fd) {
+    fprintf(stderr, "bus=%s closed\n", bus->path);
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, bus->fd, NULL);
+    close(bus->fd);
+    bus->fd = -1;
+    bus->reopen_us = now_us() + (GATEWAY_REOPEN_MS * 1000);
+    bus->round_active = false;
+    bus->transacting = false;
+
+    for (struct node *node = bus->nodes; node != NULL; node = node->bus_next) {
+        for (uint8_t i = 0; i < GATEWAY_MAX_REQUESTS; i++) {
+            if (node->requests[i].active) {
+                node->requests[i].active = false;
+                node->stats.failures++;
+            }
+        }
+
+        node_store_cycle(node);
+    }
+}
+
+/**
+ * @brief Request send function. This function writes request characters to
+ *        a node, in a request frame addressed to it on a multi-drop bus. 
+ * @param node Pointer to the node. 
+ * @param str Request characters. 
+ * @param len Number of request characters. 
+ * @retval None. 
+ */
+static void node_send(struct node *node, const char *str, size_t len) {
+    char frame[MULTIDROP_REQUEST_LEN];
+
+    if (node->id != 0) {
+        len = multidrop_request(frame, node->id, str, len);
+        str = frame;
+        node->bus->txn_request_len += len;
+    }
+
+    // Requests are a few bytes, so a full output buffer means the node has
+    // stopped reading, and the requests will time out. 
+    if ((write(node->bus->fd, str, len) < 0) && (errno != EAGAIN)) {
+        perror(node->bus->path);
+    }
+}
+
+/**
+ * @brief Poll cycle function. This function starts a node's poll cycle, 
+ *        unless requests from the last cycle are still in flight. On a 
+ *        point-to-point line, every request is sent back-to-back. On a 
+ *        multi-drop bus, the requests wait for the node's turn (see 
+ *        node_transact()), and heights requests become latched heights 
+ *        requests. 
+ * @param node Pointer to the node. 
+ * @param cfg Pointer to the gateway configuration. 
+ * @param now Current time, in usec. 
+ * @retval None. 
+ */
+static void node_poll(struct node *node, const struct gateway_cfg *cfg, uint64_t now) {
+    if ((cfg->cycles != 0) && (node->cycles >= cfg->cycles)) {
+        return;
+    }
+
+    if (node_in_flight(node)) {
+        node->stats.overruns++;
+        return;
+    }
+
+    char types[GATEWAY_MAX_REQUESTS];
+    uint8_t num_requests = 0;
+    for (const char *type = cfg->requests; (*type != '\0') 
+            && (num_requests < GATEWAY_MAX_REQUESTS); type++) {
+        struct request *request = &node->requests[num_requests];
+        request->type = ((node->id != 0) && (*type == 'R')) ? MULTIDROP_LATCH : *type;
+        request->active = true;
+        request->attempts = 1;
+        request->first_sent_us = now;
+        request->deadline_us = (node->id != 0) ? UINT64_MAX : (now + cfg->timeout_us);
+        types[num_requests++] = request->type;
+        node->stats.requests++;
+    }
+
+    if (node->id == 0) {
+        node_send(node, types, num_requests);
+    }
+    node->cycles++;
+
+    node->cycle.pending = true;
+    node->cycle.ts_ms = wall_ms();
+    node->cycle.have_heights = false;
+    node->cycle.events = 0;
+}
+
+/**
+ * @brief Transaction function. This function sends a node's waiting 
+ *        requests in one request frame, now it is the node's turn on its 
+ *        multi-drop bus. 
+ * @param node Pointer to the node. 
+ * @param cfg Pointer to the gateway configuration. 
+ * @param now Current time, in usec. 
+ * @retval None. 
+ */
+static void node_transact(struct node *node, const struct gateway_cfg *cfg, uint64_t now) {
+    char types[GATEWAY_MAX_REQUESTS];
+    uint8_t num_requests = 0;
+
+    for (uint8_t i = 0; i < GATEWAY_MAX_REQUESTS; i++) {
+        struct request *request = &node->requests[i];
+        if (request->active) {
+            request->first_sent_us = now;
+            request->deadline_us = now + cfg->timeout_us;
+            types[num_requests++] = request->type;
+        }
+    }
+
+    node->txn_start_us = now;
+    node->bus->txn_request_len = 0;
+    node->bus->txn_reply_len = 0;
+    node_send(node, types, num_requests);
+}
+
+/**
+ * @brief Timeout check function. This function retries each request which
+ *        has timed out (together, in one frame on a multi-drop bus), or 
+ *        abandons it once it has been retried the configured number of 
+ *        times. 
+ * @param node Pointer to the node. 
+ * @param cfg Pointer to the gateway configuration. 
+ * @param now Current time, in usec. 
+ * @retval None. 
+ */
+static void node_check_timeouts(struct node *node, const struct gateway_cfg *cfg, 
+        uint64_t now) {
+    char types[GATEWAY_MAX_REQUESTS];
+    uint8_t num_retries = 0;
+
+    for (uint8_t i = 0; i < GATEWAY_MAX_REQUESTS; i++) {
+        struct request *request = &node->requests[i];
+        if (!request->active || (now < request->deadline_us)) {
+            continue;
+        }
+
+        node->stats.timeouts++;
+        if (request->attempts > cfg->retries) {
+            request->active = false;
+            node->stats.failures++;
+            continue;
+        }
+
+        request->attempts++;
+        request->deadline_us = now + cfg->timeout_us;
+        node->stats.retries++;
+        types[num_retries++] = request->type;
+    }
+
+    if (num_retries > 0) {
+        node_send(node, types, num_retries);
+    }
+
+    node_store_cycle(node);
+}
+
+/**
+ * @brief Reply handler. This function matches a complete reply (without 
+ *        its termination character) to its request, records the request's
+ *        latency, and outputs the reply. 
+ * @param node Pointer to the node. 
+ * @param reply Reply string. 
+ * @param cfg Pointer to the gateway configuration. 
+ * @param now Current time, in usec. 
+ * @retval None. 
+ */
+static void node_handle_reply(struct node *node, const char *reply, 
+        const struct gateway_cfg *cfg, uint64_t now) {
+    char type = reply_request_type(reply[0]);
+    struct request *request = NULL;
+
+    for (uint8_t i = 0; i < GATEWAY_MAX_REQUESTS; i++) {
+        if (node->requests[i].active && (node->requests[i].type == type)) {
+            request = &node->requests[i];
+            break;
+        }
+    }
+
+    // Late replies to abandoned requests, and line noise, are discarded
+    if (request == NULL) {
+        node->stats.stray++;
+        return;
+    }
+
+    request->active = false;
+    uint64_t latency = now - request->first_sent_us;
+    uint32_t bucket = latency / GATEWAY_LATENCY_BUCKET_US;
+    node->stats.latency_hist[(bucket < GATEWAY_LATENCY_BUCKETS) ? bucket 
+            : (GATEWAY_LATENCY_BUCKETS - 1)]++;
+    node->stats.latency_sum_us += latency;
+    if (latency > node->stats.latency_max_us) {
+        node->stats.latency_max_us = latency;
+    }
+    node->stats.replies++;
+
+    if (cfg->print_replies) {
+        printf("%llu %s %s\n", (unsigned long long)wall_ms(), node->path, reply);
+    }
+
+    // "L" alone: the node missed the latch broadcast, so it has no heights 
+    // taken with the other nodes' (and the cycle stores none)
+    if ((type == MULTIDROP_LATCH) && (reply[1] == '\0')) {
+        node->stats.missed_latches++;
+    }
+
+    cycle_parse_reply(&node->cycle, reply);
+    node_store_cycle(node);
+}
+
+/**
+ * @brief Bus reply handler. This function passes a complete reply (without
+ *        its termination character) to its node. On a multi-drop bus, the 
+ *        reply's prefix must be that of the node being polled, and is 
+ *        stripped. 
+ * @param bus Pointer to the bus. 
+ * @param cfg Pointer to the gateway configuration. 
+ * @param now Current time, in usec. 
+ * @retval None. 
+ */
+static void bus_handle_reply(struct bus *bus, const struct gateway_cfg *cfg, uint64_t now) {
+    uint8_t id;
+
+    if (!bus->multidrop) {
+        node_handle_reply(bus->nodes, bus->rx, cfg, now);
+        return;
+    }
+
+    if (!multidrop_reply_id(bus->rx, &id) || !bus->transacting || (id != bus->active->id)) {
+        bus->stats.stray++;
+        return;
+    }
+
+    bus->txn_reply_len += bus->rx_len + 1;
+    node_handle_reply(bus->active, &bus->rx[MULTIDROP_PREFIX_LEN], cfg, now);
+}
+
+/**
+ * @brief Receive function. This function reads everything available from a
+ *        bus, and handles each complete ('!'-terminated) reply. 
+ * @param bus Pointer to the bus. 
+ * @param cfg Pointer to the gateway configuration. 
+ * @param epoll_fd epoll file descriptor. 
+ * @retval None. 
+ */
+static void bus_receive(struct bus *bus, const struct gateway_cfg *cfg, int epoll_fd) {
+    char buf[GATEWAY_RX_LEN];
+
+    while (true) {
+        ssize_t len = read(bus->fd, buf, sizeof(buf));
+        if (len < 0) {
+            if (errno == EAGAIN) {
+                return;
+            }
+
+            bus_close(bus, epoll_fd);
+            return;
+        } else if (len == 0) {
+            bus_close(bus, epoll_fd);
+            return;
+        }
+
+        uint64_t now = now_us();
+        for (ssize_t i = 0; i < len; i++) {
+            if (buf[i] == '!') {
+                bus->rx[bus->rx_len] = '\0';
+                bus_handle_reply(bus, cfg, now);
+                bus->rx_len = 0;
+            } else if (bus->rx_len < (GATEWAY_RX_LEN - 1)) {
+                bus->rx[bus->rx_len++] = buf[i];
+            } else {
+                // Too long to be a reply, so resynchronise on the next '!'
+                bus->rx_len = 0;
+                bus->stats.stray++;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Bus poll function. This function starts a poll cycle of a bus's 
+ *        nodes. On a multi-drop bus, a round is started with a latch 
+ *        broadcast, unless the last round is still in progress. 
+ * @param bus Pointer to the bus. 
+ * @param cfg Pointer to the gateway configuration. 
+ * @param now Current time, in usec. 
+ * @retval None. 
+ */
+static void bus_poll(struct bus *bus, const struct gateway_cfg *cfg, uint64_t now) {
+    if (!bus->multidrop) {
+        node_poll(bus->nodes, cfg, now);
+        return;
+    }
+
+    if (bus->round_active) {
+        for (struct node *node = bus->nodes; node != NULL; node = node->bus_next) {
+            node->stats.overruns++;
+        }
+        return;
+    }
+
+    bool started = false;
+    for (struct node *node = bus->nodes; node != NULL; node = node->bus_next) {
+        node_poll(node, cfg, now);
+        started |= node_in_flight(node);
+    }
+
+    if (!started) {
+        return;
+    }
+
+    // Every node's heights are latched at once, however late it is polled
+    uint32_t turnaround_us = multidrop_turnaround_us(cfg->baud);
+    bus->round_line_us = 0;
+    if (strchr(cfg->requests, 'R') != NULL) {
+        char frame[MULTIDROP_REQUEST_LEN];
+        char latch = MULTIDROP_LATCH;
+        size_t len = multidrop_request(frame, MULTIDROP_BROADCAST_ID, &latch, 1);
+        if ((write(bus->fd, frame, len) < 0) && (errno != EAGAIN)) {
+            perror(bus->path);
+        }
+        bus->round_line_us = (len * multidrop_char_us(cfg->baud)) + turnaround_us;
+    }
+
+    bus->round_active = true;
+    bus->round_start_us = now;
+    bus->active = bus->nodes;
+    bus->transacting = false;
+    bus->next_send_us = now + bus->round_line_us;
+}
+
+/**
+ * @brief Bus round function. This function advances a multi-drop bus's 
+ *        round: once the node being polled has answered (or its requests 
+ *        have been abandoned), the next node with requests waiting is sent 
+ *        its request frame after the line turnaround time. The round ends
+ *        when every node has been polled. 
+ * @param bus Pointer to the bus. 
+ * @param cfg Pointer to the gateway configuration. 
+ * @param now Current time, in usec. 
+ * @retval None. 
+ */
+static void bus_step(struct bus *bus, const struct gateway_cfg *cfg, uint64_t now) {
+    while (bus->round_active) {
+        struct node *node = bus->active;
+
+        if (node == NULL) {
+            uint64_t round_us = now - bus->round_start_us;
+            bus->round_active = false;
+            bus->stats.rounds++;
+            bus->stats.round_sum_us += round_us;
+            bus->stats.round_max_us = (round_us > bus->stats.round_max_us) 
+                    ? round_us : bus->stats.round_max_us;
+            bus->stats.line_sum_us += bus->round_line_us;
+            return;
+        }
+
+        if (bus->transacting) {
+            if (node_in_flight(node)) {
+                return;
+            }
+
+            uint64_t txn_us = now - node->txn_start_us;
+            bus->stats.transactions++;
+            bus->stats.txn_sum_us += txn_us;
+            bus->stats.txn_max_us = (txn_us > bus->stats.txn_max_us) 
+                    ? txn_us : bus->stats.txn_max_us;
+            bus->round_line_us += multidrop_transaction_us(cfg->baud, bus->txn_request_len, 
+                    bus->txn_reply_len);
+
+            bus->transacting = false;
+            bus->active = node->bus_next;
+            bus->next_send_us = now + multidrop_turnaround_us(cfg->baud);
+            continue;
+        }
+
+        // Nodes which have run their cycles are skipped
+        if (!node_in_flight(node)) {
+            bus->active = node->bus_next;
+            continue;
+        }
+
+        if (now < bus->next_send_us) {
+            return;
+        }
+
+        node_transact(node, cfg, now);
+        bus->transacting = true;
+        return;
+    }
+}
+
+/**
+ * @brief Latency percentile function. 
+ * @param stats Pointer to the node's statistics. 
+ * @param pct Percentile. 
+ * @retval Latency at the percentile (upper edge of its bucket), in msec. 
+ */
+static double latency_percentile_ms(const struct node_stats *stats, double pct) {
+    uint64_t target = (uint64_t)((stats->replies * pct) / 100.0);
+    uint64_t count = 0;
+
+    for (uint32_t i = 0; i < GATEWAY_LATENCY_BUCKETS; i++) {
+        count += stats->latency_hist[i];
+        if ((count > target) || (count == stats->replies)) {
+            return ((i + 1) * GATEWAY_LATENCY_BUCKET_US) / 1000.0;
+        }
+    }
+
+    return 0.0;
+}
+
+/**
+ * @brief Report function. This function prints the request statistics of
+ *        every node, and the round statistics of every multi-drop bus (since
+ *        the gateway started), to stderr. 
+ * @param nodes Array of nodes. 
+ * @param num_nodes Number of nodes. 
+ * @param buses Array of buses. 
+ * @param num_buses Number of buses. 
+ * @retval None. 
+ */
+static void report_stats(const struct node *nodes, uint32_t num_nodes, 
+        const struct bus *buses, uint32_t num_buses) {
+    for (uint32_t i = 0; i < num_nodes; i++) {
+        const struct node_stats *stats = &nodes[i].stats;
+        double avg_ms = (stats->replies == 0) ? 0.0 
+                : (stats->latency_sum_us / 1000.0) / stats->replies;
+
+        fprintf(stderr, "node=%s requests=%llu replies=%llu timeouts=%llu retries=%llu "
+                "failures=%llu stray=%llu overruns=%llu missed_latches=%llu lat_avg_ms=%.2f "
+                "lat_p50_ms=%.1f lat_p99_ms=%.1f lat_max_ms=%.2f\n", nodes[i].path, 
+                (unsigned long long)stats->requests, (unsigned long long)stats->replies, 
+                (unsigned long long)stats->timeouts, (unsigned long long)stats->retries, 
+                (unsigned long long)stats->failures, (unsigned long long)stats->stray, 
+                (unsigned long long)stats->overruns, 
+                (unsigned long long)stats->missed_latches, avg_ms, 
+                latency_percentile_ms(stats, 50.0), latency_percentile_ms(stats, 99.0), 
+                stats->latency_max_us / 1000.0);
+    }
+
+    for (uint32_t i = 0; i < num_buses; i++) {
+        const struct bus_stats *stats = &buses[i].stats;
+        if (!buses[i].multidrop) {
+            continue;
+        }
+
+        fprintf(stderr, "bus=%s nodes=%u rounds=%llu stray=%llu round_avg_ms=%.1f "
+                "round_max_ms=%.1f line_avg_ms=%.1f txn_avg_ms=%.2f txn_max_ms=%.2f\n", 
+                buses[i].path, buses[i].num_nodes, (unsigned long long)stats->rounds, 
+                (unsigned long long)stats->stray, 
+                (stats->rounds == 0) ? 0.0 : (stats->round_sum_us / 1000.0) / stats->rounds, 
+                stats->round_max_us / 1000.0, 
+                (stats->rounds == 0) ? 0.0 : (stats->line_sum_us / 1000.0) / stats->rounds, 
+                (stats->transactions == 0) ? 0.0 
+                : (stats->txn_sum_us / 1000.0) / stats->transactions, 
+                stats->txn_max_us / 1000.0);
+    }
+}
+
+/**
+ * @brief Bus add function. This function adds a node to the bus on its 
+ *        device, adding the bus if it is the first node on the device. A 
+ *        node given as "<device>@<id>" is on a multi-drop bus, otherwise it
+ *        has the device to itself. 
+ * @param node Pointer to the node (with its path set). 
+ * @param buses Array of buses. 
+ * @param num_buses Pointer to the number of buses. 
+ * @retval true if the node was added, false if its device is already used 
+ *         by a node with its ID (or by a node of the other kind). 
+ */
+static bool bus_add(struct node *node, struct bus *buses, uint32_t *num_buses) {
+    const char *at = strrchr(node->path, '@');
+    size_t path_len = strlen(node->path);
+    char *end;
+
+    node->id = 0;
+    if ((at != NULL) && (strlen(at) == 3)) {
+        unsigned long id = strtoul(at + 1, &end, 16);
+        if ((*end == '\0') && (id >= MULTIDROP_MIN_ID) && (id <= MULTIDROP_MAX_ID)) {
+            node->id = id;
+            path_len = at - node->path;
+        }
+    }
+
+    struct bus *bus = NULL;
+    for (uint32_t i = 0; i < *num_buses; i++) {
+        if ((strlen(buses[i].path) == path_len) 
+                && (strncmp(buses[i].path, node->path, path_len) == 0)) {
+            bus = &buses[i];
+            break;
+        }
+    }
+
+    if (bus == NULL) {
+        bus = &buses[(*num_buses)++];
+        bus->path = strndup(node->path, path_len);
+        bus->multidrop = (node->id != 0);
+        bus->nodes = node;
+    } else {
+        if (!bus->multidrop || (node->id == 0)) {
+            return false;
+        }
+
+        struct node *last = bus->nodes;
+        while (true) {
+            if (last->id == node->id) {
+                return false;
+            } else if (last->bus_next == NULL) {
+                break;
+            }
+            last = last->bus_next;
+        }
+        last->bus_next = node;
+    }
+
+    node->bus = bus;
+    bus->num_nodes++;
+    return (bus->path != NULL);
+}
+
+int main(int argc, char **argv) {
+    struct gateway_cfg cfg = {
+        .poll_us = GATEWAY_DEFAULT_POLL_MS * 1000,
+        .timeout_us = GATEWAY_DEFAULT_TIMEOUT_MS * 1000,
+        .retries = GATEWAY_DEFAULT_RETRIES,
+        .requests = GATEWAY_DEFAULT_REQUESTS,
+        .report_us = GATEWAY_DEFAULT_REPORT_SEC * 1000000ULL,
+        .cycles = 0,
+        .print_replies = true,
+        .store_dir = NULL,
+        .flush_us = GATEWAY_DEFAULT_FLUSH_SEC * 1000000ULL,
+        .store_sync = false,
+        .query_path = NULL,
+        .publisher = {
+            .broker = NULL,
+            .prefix = PUBLISHER_DEFAULT_PREFIX,
+            .spool_dir = GATEWAY_DEFAULT_SPOOL_DIR,
+            .batch_ms = PUBLISHER_DEFAULT_BATCH_MS,
+            .batch_bytes = PUBLISHER_DEFAULT_BATCH_BYTES,
+            .spool_max_bytes = PUBLISHER_DEFAULT_SPOOL_MAX_MB * 1024ULL * 1024,
+            .qos = PUBLISHER_DEFAULT_QOS,
+        },
+        .baud = GATEWAY_DEFAULT_BAUD,
+    };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:t:r:q:s:c:nd:F:yQ:M:P:B:Z:S:b:")) != -1) {
+        switch (opt) {
+            case 'i':
+                cfg.poll_us = strtoull(optarg, NULL, 0) * 1000;
+                break;
+            case 't':
+                cfg.timeout_us = strtoull(optarg, NULL, 0) * 1000;
+                break;
+            case 'r':
+                cfg.retries = strtoul(optarg, NULL, 0);
+                break;
+            case 'q':
+                cfg.requests = optarg;
+                break;
+            case 's':
+                cfg.report_us = strtoull(optarg, NULL, 0) * 1000000;
+                break;
+            case 'c':
+                cfg.cycles = strtoull(optarg, NULL, 0);
+                break;
+            case 'n':
+                cfg.print_replies = false;
+                break;
+            case 'd':
+                cfg.store_dir = optarg;
+                break;
+            case 'F':
+                cfg.flush_us = strtoull(optarg, NULL, 0) * 1000000;
+                break;
+            case 'y':
+                cfg.store_sync = true;
+                break;
+            case 'Q':
+                cfg.query_path = optarg;
+                break;
+            case 'M':
+                cfg.publisher.broker = optarg;
+                break;
+            case 'P':
+                if (!publisher_parse_qos(&cfg.publisher, optarg)) {
+                    fprintf(stderr, "%s: invalid QoS %s\n", argv[0], optarg);
+                    return 2;
+                }
+                break;
+            case 'B':
+                cfg.publisher.batch_ms = strtoul(optarg, NULL, 0);
+                break;
+            case 'Z':
+                cfg.publisher.batch_bytes = strtoul(optarg, NULL, 0);
+                break;
+            case 'S':
+                cfg.publisher.spool_dir = optarg;
+                break;
+            case 'b':
+                cfg.baud = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-i poll interval (ms)] [-t timeout (ms)] "
+                        "[-r retries] [-q requests] [-s report interval (s)] [-c cycles] "
+                        "[-n] [-d store dir] [-F flush interval (s)] [-y] [-Q query socket] "
+                        "[-M broker host:port] [-P qos] [-B batch time (ms)] "
+                        "[-Z batch size (bytes)] [-S spool dir] [-b baud] <device>[@id] "
+                        "[device[@id] ...]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if ((cfg.query_path != NULL) && (cfg.store_dir == NULL)) {
+        fprintf(stderr, "%s: queries (-Q) need a store (-d)\n", argv[0]);
+        return 2;
+    }
+
+    if (cfg.publisher.batch_bytes < PUBLISHER_MAX_LINE_LEN) {
+        fprintf(stderr, "%s: the batch size must be at least %d bytes\n", argv[0], 
+                PUBLISHER_MAX_LINE_LEN);
+        return 2;
+    }
+
+    if (baud_speed(cfg.baud) == B0) {
+        fprintf(stderr, "%s: unsupported baud rate %u\n", argv[0], cfg.baud);
+        return 2;
+    }
+
+    uint32_t num_nodes = argc - optind;
+    if ((num_nodes == 0) || (num_nodes > GATEWAY_MAX_NODES) || (cfg.poll_us == 0) 
+            || (cfg.flush_us == 0)) {
+        fprintf(stderr, "%s: between 1 and %d devices, and non-zero poll and flush "
+                "intervals, are required\n", argv[0], GATEWAY_MAX_NODES);
+        return 2;
+    }
+
+    int epoll_fd = epoll_create1(0);
+    if (epoll_fd < 0) {
+        perror("epoll_create1");
+        return 1;
+    }
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    struct node *nodes = calloc(num_nodes, sizeof(struct node));
+    struct bus *buses = calloc(num_nodes, sizeof(struct bus));
+    if ((nodes == NULL) || (buses == NULL)) {
+        perror("calloc");
+        return 1;
+    }
+
+    // Nodes sharing a device are polled in the order given
+    uint32_t num_buses = 0;
+    for (uint32_t i = 0; i < num_nodes; i++) {
+        nodes[i].path = argv[optind + i];
+        if (!bus_add(&nodes[i], buses, &num_buses)) {
+            fprintf(stderr, "%s: %s is already used by another node\n", argv[0], 
+                    nodes[i].path);
+            return 2;
+        }
+    }
+
+    struct store store;
+    if ((cfg.store_dir != NULL) && !store_open(&store, cfg.store_dir, cfg.store_sync)) {
+        return 1;
+    }
+
+    // The client identifier is unique per host, so gateways at different 
+    // sites don't take over each other's session. 
+    char client_id[64];
+    char host[32] = "";
+    gethostname(host, sizeof(host) - 1);
+    snprintf(client_id, sizeof(client_id), "gateway-%s", host);
+    cfg.publisher.client_id = client_id;
+
+    struct publisher *publisher = NULL;
+    if (cfg.publisher.broker != NULL) {
+        publisher = malloc(sizeof(struct publisher));
+        if ((publisher == NULL) || !publisher_open(publisher, &cfg.publisher, epoll_fd, 
+                GATEWAY_PUBLISHER_EPOLL_ID)) {
+            return 1;
+        }
+    }
+
+    // Polls are staggered across the interval, to spread the load
+    uint64_t start = now_us();
+    for (uint32_t i = 0; i < num_nodes; i++) {
+        for (uint8_t j = 0; (j < NUM_TANKS) && (cfg.store_dir != NULL); j++) {
+            nodes[i].series[j] = store_series(&store, nodes[i].path, j + 1);
+            if (nodes[i].series[j] == NULL) {
+                fprintf(stderr, "%s: can't open the store's series for %s\n", argv[0], 
+                        nodes[i].path);
+                return 1;
+            }
+        }
+
+        nodes[i].publisher = publisher;
+        for (uint8_t j = 0; (j < PUBLISHER_NUM_CLASSES) && (publisher != NULL); j++) {
+            nodes[i].topics[j] = publisher_topic(publisher, nodes[i].path, j);
+            if (nodes[i].topics[j] == NULL) {
+                fprintf(stderr, "%s: can't create the topics for %s\n", argv[0], 
+                        nodes[i].path);
+                return 1;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < num_buses; i++) {
+        buses[i].next_poll_us = start + ((cfg.poll_us * i) / num_buses);
+        if (!bus_open(&buses[i], i, &cfg, epoll_fd)) {
+            perror(buses[i].path);
+            buses[i].reopen_us = start;
+        }
+    }
+
+    struct query_server query_server;
+    if ((cfg.query_path != NULL) && !query_server_open(&query_server, cfg.query_path, &store, 
+            epoll_fd, GATEWAY_QUERY_EPOLL_BASE)) {
+        return 1;
+    }
+
+    uint64_t next_report_us = start + cfg.report_us;
+    uint64_t next_flush_us = start + cfg.flush_us;
+
+    while (!stop) {
+        uint64_t now = now_us();
+        uint64_t wake_us = next_report_us;
+        if ((cfg.store_dir != NULL) && (next_flush_us < wake_us)) {
+            wake_us = next_flush_us;
+        }
+
+        // Poll cycles, bus rounds, timeouts and reopening, and when to next
+        // wake for them. With a cycle limit, the gateway stops once every 
+        // node has run its cycles and has no requests in flight (or its bus
+        // is closed). 
+        bool done = (cfg.cycles != 0);
+        for (uint32_t i = 0; i < num_buses; i++) {
+            struct bus *bus = &buses[i];
+
+            if (bus->fd < 0) {
+                if ((now >= bus->reopen_us) && !bus_open(bus, i, &cfg, epoll_fd)) {
+                    bus->reopen_us = now + (GATEWAY_REOPEN_MS * 1000);
+                }
+
+                if (bus->fd < 0) {
+                    wake_us = (bus->reopen_us < wake_us) ? bus->reopen_us : wake_us;
+                    for (struct node *node = bus->nodes; node != NULL; node = node->bus_next) {
+                        done &= (node->cycles >= cfg.cycles);
+                    }
+                    continue;
+                }
+            }
+
+            for (struct node *node = bus->nodes; node != NULL; node = node->bus_next) {
+                node_check_timeouts(node, &cfg, now);
+            }
+            bus_step(bus, &cfg, now);
+
+            if (now >= bus->next_poll_us) {
+                bus_poll(bus, &cfg, now);
+                bus_step(bus, &cfg, now);
+                bus->next_poll_us += cfg.poll_us;
+
+                // Cycles missed while the device was closed aren't made up
+                if (bus->next_poll_us <= now) {
+                    bus->next_poll_us = now + cfg.poll_us;
+                }
+            }
+
+            wake_us = (bus->next_poll_us < wake_us) ? bus->next_poll_us : wake_us;
+            if (bus->round_active && !bus->transacting && (bus->next_send_us < wake_us)) {
+                wake_us = bus->next_send_us;
+            }
+
+            for (struct node *node = bus->nodes; node != NULL; node = node->bus_next) {
+                done &= (node->cycles >= cfg.cycles) && !bus->round_active;
+                for (uint8_t j = 0; j < GATEWAY_MAX_REQUESTS; j++) {
+                    if (node->requests[j].active) {
+                        done = false;
+                        if (node->requests[j].deadline_us < wake_us) {
+                            wake_us = node->requests[j].deadline_us;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (now >= next_report_us) {
+            report_stats(nodes, num_nodes, buses, num_buses);
+            if (publisher != NULL) {
+                publisher_report(publisher, stderr);
+            }
+            next_report_us += cfg.report_us;
+        }
+
+        // Batches due to be queued, reconnecting and keep alive pings 
+        if (publisher != NULL) {
+            publisher_poll(publisher, now);
+            uint64_t publisher_wake_us = publisher_next_wake_us(publisher);
+            wake_us = (publisher_wake_us < wake_us) ? publisher_wake_us : wake_us;
+        }
+
+        // Buffered samples are committed periodically, so they can be 
+        // scanned (and survive a crash) before their blocks fill. 
+        if ((cfg.store_dir != NULL) && (now >= next_flush_us)) {
+            store_flush(&store);
+            next_flush_us += cfg.flush_us;
+        }
+
+        if (done) {
+            break;
+        }
+
+        // Line turnarounds need sub-millisecond waits
+        uint64_t wait_us = (wake_us > now) ? (wake_us - now) : 0;
+        struct timespec timeout = {
+            .tv_sec = wait_us / 1000000,
+            .tv_nsec = (wait_us % 1000000) * 1000,
+        };
+        struct epoll_event events[GATEWAY_MAX_EVENTS];
+        int num_events = epoll_pwait2(epoll_fd, events, GATEWAY_MAX_EVENTS, &timeout, NULL);
+
+        for (int i = 0; i < num_events; i++) {
+            if (events[i].data.u32 == GATEWAY_PUBLISHER_EPOLL_ID) {
+                publisher_handle(publisher, events[i].events);
+                continue;
+            } else if (events[i].data.u32 >= GATEWAY_QUERY_EPOLL_BASE) {
+                query_server_handle(&query_server, events[i].data.u32, events[i].events);
+                continue;
+            }
+
+            struct bus *bus = &buses[events[i].data.u32];
+            if (bus->fd >= 0) {
+                bus_receive(bus, &cfg, epoll_fd);
+            }
+        }
+
+        fflush(stdout);
+    }
+
+    report_stats(nodes, num_nodes, buses, num_buses);
+
+    // Batches still being coalesced are spooled, to be published after the
+    // next start if not yet delivered. 
+    if (publisher != NULL) {
+        publisher_report(publisher, stderr);
+        publisher_close(publisher);
+        free(publisher);
+    }
+
+    if (cfg.query_path != NULL) {
+        query_server_close(&query_server);
+        unlink(cfg.query_path);
+    }
+
+    if (cfg.store_dir != NULL) {
+        store_close(&store);
+    }
+
+    for (uint32_t i = 0; i < num_buses; i++) {
+        if (buses[i].fd >= 0) {
+            close(buses[i].fd);
+        }
+        free(buses[i].path);
+    }
+
+    free(nodes);
+    free(buses);
+    close(epoll_fd);
+    return 0;
+}
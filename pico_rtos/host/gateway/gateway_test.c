@@ -0,0 +1,184 @@
+ /**
+ **************************************************************
+ * @file gateway_test.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Gateway receive test. This tool runs the gateway against a
+ *        pseudo-terminal standing in for a node on a multi-drop bus, and
+ *        answers its request frame with the longest reply the gateway polls
+ *        for from a node built with the same NUM_TANKS: an analytics reply
+ *        with every field at its widest. It must be printed by the gateway
+ *        whole, with no timeouts, retries or stray replies. Build with
+ *        -DNUM_TANKS=7 to check the longest reply of any build. Results are
+ *        reported as key=value lines, and the exit status is non-zero on
+ *        any failure.
+ *
+ *        Usage: gateway_test <gateway binary>
+ ***************************************************************
+ */
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "serialise.h"
+#include "multidrop.h"
+
+// Node ID the gateway polls, and the request it sends.
+#define GATEWAY_TEST_NODE_ID "01"
+#define GATEWAY_TEST_REQUESTS "A"
+
+// Time allowed for the gateway's request and exit, in msec.
+#define GATEWAY_TEST_TIMEOUT_MS 5000
+
+// Gateway output and node path buffer sizes.
+#define GATEWAY_TEST_OUTPUT_LEN 8192
+#define GATEWAY_TEST_PATH_LEN 256
+
+/**
+ * @brief Analytics reply function. This function writes the longest
+ *        analytics reply (without its termination character): every rate at
+ *        -999.99 cm/min, both forecasts at 99999 min, and the leak flag set.
+ * @param out Buffer written to (SERIALISE_ANALYTICS_LEN chars).
+ * @retval Length of the reply.
+ */
+static size_t test_analytics_reply(char *out) {
+    size_t len = 0;
+
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        len += sprintf(&out[len], "A%u=-%u.99,%u,%u,1", i + 1,
+                SERIALISE_RATE_MAX_HUNDREDTHS / 100, SERIALISE_FORECAST_MAX_MIN,
+                SERIALISE_FORECAST_MAX_MIN);
+    }
+
+    return len;
+}
+
+/**
+ * @brief Output check function. This function checks the gateway printed
+ *        a reply whole.
+ * @param output Gateway output.
+ * @param node Node path, as printed by the gateway.
+ * @param reply Reply (without its termination character).
+ * @retval true if the reply was printed.
+ */
+static bool test_printed(const char *output, const char *node, const char *reply) {
+    char line[GATEWAY_TEST_PATH_LEN + SERIALISE_ANALYTICS_LEN + 3];
+    snprintf(line, sizeof(line), " %s %s\n", node, reply);
+
+    return strstr(output, line) != NULL;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <gateway binary>\n", argv[0]);
+        return 2;
+    }
+
+    // Pseudo-terminal standing in for the node's UART
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0)) {
+        perror("posix_openpt");
+        return 1;
+    }
+
+    const char *slave_path = ptsname(master);
+    int slave = open(slave_path, O_RDWR | O_NOCTTY);
+    if (slave < 0) {
+        perror(slave_path);
+        return 1;
+    }
+
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    char node[GATEWAY_TEST_PATH_LEN];
+    snprintf(node, sizeof(node), "%s@%s", slave_path, GATEWAY_TEST_NODE_ID);
+
+    int output_pipe[2];
+    if (pipe(output_pipe) != 0) {
+        perror("pipe");
+        return 1;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(output_pipe[1], STDOUT_FILENO);
+        dup2(output_pipe[1], STDERR_FILENO);
+        close(output_pipe[0]);
+        execl(argv[1], argv[1], "-q", GATEWAY_TEST_REQUESTS, "-c", "1", "-r", "0", "-t", "2000",
+                node, (char *)NULL);
+        perror(argv[1]);
+        _exit(127);
+    }
+    close(output_pipe[1]);
+
+    // Wait for the request frame, then answer it
+    char frame[MULTIDROP_REQUEST_LEN];
+    size_t frame_len = 0;
+    struct pollfd pfd = {.fd = master, .events = POLLIN};
+    while ((frame_len < (sizeof(frame) - 1)) && (poll(&pfd, 1, GATEWAY_TEST_TIMEOUT_MS) > 0)) {
+        if (read(master, &frame[frame_len], 1) != 1) {
+            break;
+        }
+        if (frame[frame_len++] == MULTIDROP_END) {
+            break;
+        }
+    }
+    frame[frame_len] = '\0';
+
+    char analytics[SERIALISE_ANALYTICS_LEN];
+    size_t analytics_len = test_analytics_reply(analytics);
+
+    char reply[MULTIDROP_PREFIX_LEN + SERIALISE_ANALYTICS_LEN];
+    int reply_len = snprintf(reply, sizeof(reply), "#%s%s%c", GATEWAY_TEST_NODE_ID,
+            analytics, MULTIDROP_END);
+    if (write(master, reply, reply_len) != reply_len) {
+        perror("write");
+    }
+
+    // Collect the gateway's output until it exits
+    static char output[GATEWAY_TEST_OUTPUT_LEN];
+    size_t output_len = 0;
+    pfd.fd = output_pipe[0];
+    while ((output_len < (sizeof(output) - 1)) && (poll(&pfd, 1, GATEWAY_TEST_TIMEOUT_MS) > 0)) {
+        ssize_t len = read(output_pipe[0], &output[output_len], sizeof(output) - 1 - output_len);
+        if (len <= 0) {
+            break;
+        }
+        output_len += len;
+    }
+    output[output_len] = '\0';
+
+    kill(pid, SIGTERM);
+    int status;
+    waitpid(pid, &status, 0);
+
+    bool frame_ok = (strcmp(frame, "@" GATEWAY_TEST_NODE_ID GATEWAY_TEST_REQUESTS "!") == 0);
+    bool analytics_ok = (analytics_len == (SERIALISE_ANALYTICS_LEN - 2))
+            && test_printed(output, node, analytics);
+    bool stats_ok = (strstr(output, " replies=1 timeouts=0 retries=0 failures=0 stray=0 ") != NULL)
+            && (strstr(output, " stray=0 round_avg_ms=") != NULL);
+    bool ok = frame_ok && analytics_ok && stats_ok;
+
+    printf("tanks=%u frame=%s reply_len=%d\n", NUM_TANKS, frame, reply_len);
+    printf("analytics=%s stats=%s\n", analytics_ok ? "ok" : "FAIL", stats_ok ? "ok" : "FAIL");
+    printf("result=%s\n", ok ? "pass" : "FAIL");
+    if (!ok) {
+        fprintf(stderr, "%s", output);
+    }
+
+    return ok ? 0 : 1;
+}
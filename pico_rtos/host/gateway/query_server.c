@@ -0,0 +1,376 @@
+ /**
+ **************************************************************
+ * @file query_server.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Gateway range query server file. This file handles functionality
+ *        specific to answering range queries over the gateway's store on a
+ *        Unix socket, from the gateway's event loop (non-blocking, with
+ *        responses buffered per client). Each query is one line:
+ *
+ *            <node> <tank> <from ms> <to ms> <resolution (s)> [raw]
+ *
+ *        and is answered with "OK level=<s> rows=<n> records=<n>
+ *        samples=<n> us=<n>" (level 0 if answered from the samples),
+ *        followed by n rows of "<start ms>,<min>,<max>,<mean>,<last>,
+ *        <count>", or with "ERR <reason>". "raw" forces the query to be
+ *        answered from the samples, for comparison against the rollups.
+ ***************************************************************
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "query_server.h"
+
+// Maximum length of one result row.
+#define QUERY_ROW_LEN 96
+
+// Struct holding a growable buffer of result rows.
+struct query_rows {
+    char *buf;
+    size_t len;
+    size_t cap;
+    bool failed;                // Set if the buffer couldn't grow
+};
+
+/**
+ * @brief Buffer reserve function. This function grows a buffer so that at
+ *        least len more bytes fit.
+ * @param buf Pointer to the buffer.
+ * @param used Bytes used in the buffer.
+ * @param cap Pointer to the buffer's capacity.
+ * @param len Bytes needed.
+ * @retval true if the bytes fit, false otherwise.
+ */
+static bool query_reserve(char **buf, size_t used, size_t *cap, size_t len) {
+    if ((used + len) <= *cap) {
+        return true;
+    }
+
+    size_t new_cap = (*cap == 0) ? 4096 : *cap;
+    while (new_cap < (used + len)) {
+        new_cap *= 2;
+    }
+
+    char *new_buf = realloc(*buf, new_cap);
+    if (new_buf == NULL) {
+        return false;
+    }
+
+    *buf = new_buf;
+    *cap = new_cap;
+    return true;
+}
+
+/**
+ * @brief Row callback. This function formats a result row into the buffer
+ *        of rows.
+ * @param row Pointer to the row.
+ * @param ctx Pointer to the buffer of rows.
+ * @retval None.
+ */
+static void query_add_row(const struct rollup_row *row, void *ctx) {
+    struct query_rows *rows = ctx;
+
+    if (!query_reserve(&rows->buf, rows->len, &rows->cap, QUERY_ROW_LEN)) {
+        rows->failed = true;
+        return;
+    }
+
+    rows->len += snprintf(&rows->buf[rows->len], QUERY_ROW_LEN, "%lld,%.2f,%.2f,%.3f,%.2f,%u\n",
+            (long long)row->start_ms, row->min, row->max, row->mean, row->last, row->count);
+}
+
+/**
+ * @brief Response function. This function appends a response to a client's
+ *        output.
+ * @param client Pointer to the client.
+ * @param str Response.
+ * @param len Length of the response.
+ * @retval None.
+ */
+static void query_respond(struct query_client *client, const char *str, size_t len) {
+    if (!query_reserve(&client->out, client->out_len, &client->out_cap, len)) {
+        client->closing = true;
+        return;
+    }
+
+    memcpy(&client->out[client->out_len], str, len);
+    client->out_len += len;
+}
+
+/**
+ * @brief Query function. This function parses and answers one query line.
+ * @param server Pointer to the query server.
+ * @param client Pointer to the client.
+ * @param line Query line (without its newline).
+ * @retval None.
+ */
+static void query_answer(struct query_server *server, struct query_client *client,
+        const char *line) {
+    char node[QUERY_LINE_LEN], mode[8] = "";
+    unsigned int tank;
+    long long from_ms, to_ms, resolution_sec;
+    char header[128];
+
+    int fields = sscanf(line, "%255s %u %lld %lld %lld %7s", node, &tank, &from_ms, &to_ms,
+            &resolution_sec, mode);
+    if ((fields < 5) || (resolution_sec <= 0) || (to_ms < from_ms)
+            || ((fields == 6) && (strcmp(mode, "raw") != 0))) {
+        const char *err = "ERR usage: <node> <tank> <from ms> <to ms> <resolution (s)> [raw]\n";
+        query_respond(client, err, strlen(err));
+        return;
+    }
+
+    if ((((to_ms - from_ms) / 1000) / resolution_sec) >= QUERY_MAX_ROWS) {
+        const char *err = "ERR too many rows, use a coarser resolution\n";
+        query_respond(client, err, strlen(err));
+        return;
+    }
+
+    const struct store_series *series = store_find(server->store, node, tank);
+    if (series == NULL) {
+        const char *err = "ERR no such series\n";
+        query_respond(client, err, strlen(err));
+        return;
+    }
+
+    struct timespec start, end;
+    struct query_rows rows = {0};
+    struct rollup_query_stats stats;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    rollup_query(server->store, series, from_ms, to_ms, resolution_sec * 1000,
+            (fields == 5), query_add_row, &rows, &stats);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (rows.failed) {
+        const char *err = "ERR out of memory\n";
+        query_respond(client, err, strlen(err));
+    } else {
+        long long elapsed_us = ((end.tv_sec - start.tv_sec) * 1000000LL)
+                + ((end.tv_nsec - start.tv_nsec) / 1000);
+        int len = snprintf(header, sizeof(header), "OK level=%lld rows=%llu records=%llu "
+                "samples=%llu us=%lld\n", (long long)(stats.level_width_ms / 1000),
+                (unsigned long long)stats.rows, (unsigned long long)stats.records_read,
+                (unsigned long long)stats.samples_read, elapsed_us);
+        query_respond(client, header, len);
+        query_respond(client, rows.buf, rows.len);
+    }
+
+    free(rows.buf);
+}
+
+/**
+ * @brief Client close function.
+ * @param server Pointer to the query server.
+ * @param client Pointer to the client.
+ * @retval None.
+ */
+static void query_client_close(struct query_server *server, struct query_client *client) {
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    free(client->out);
+    memset(client, 0, sizeof(struct query_client));
+    client->fd = -1;
+}
+
+/**
+ * @brief Client write function. This function writes as much of a client's
+ *        pending output as the socket accepts, and waits for the socket to
+ *        be writable (instead of readable) while output remains.
+ * @param server Pointer to the query server.
+ * @param client Pointer to the client.
+ * @param id Epoll ID of the client.
+ * @retval None.
+ */
+static void query_client_write(struct query_server *server, struct query_client *client,
+        uint32_t id) {
+    while (client->out_pos < client->out_len) {
+        ssize_t len = write(client->fd, &client->out[client->out_pos],
+                client->out_len - client->out_pos);
+        if (len < 0) {
+            if (errno == EAGAIN) {
+                break;
+            }
+
+            query_client_close(server, client);
+            return;
+        }
+
+        client->out_pos += len;
+    }
+
+    bool pending = (client->out_pos < client->out_len);
+    if (!pending) {
+        client->out_pos = 0;
+        client->out_len = 0;
+
+        if (client->closing) {
+            query_client_close(server, client);
+            return;
+        }
+    }
+
+    struct epoll_event event = {.events = pending ? EPOLLOUT : EPOLLIN, .data.u32 = id};
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+}
+
+/**
+ * @brief Client read function. This function reads everything available
+ *        from a client, and answers each complete query line.
+ * @param server Pointer to the query server.
+ * @param client Pointer to the client.
+ * @retval None.
+ */
+static void query_client_read(struct query_server *server, struct query_client *client) {
+    char buf[QUERY_LINE_LEN];
+
+    while (!client->closing) {
+        ssize_t len = read(client->fd, buf, sizeof(buf));
+        if (len < 0) {
+            if (errno != EAGAIN) {
+                client->closing = true;
+            }
+            return;
+        } else if (len == 0) {
+            // Clients may close their end once they have sent their queries
+            client->closing = true;
+            return;
+        }
+
+        for (ssize_t i = 0; i < len; i++) {
+            if (buf[i] == '\n') {
+                client->in[client->in_len] = '\0';
+                query_answer(server, client, client->in);
+                client->in_len = 0;
+            } else if (client->in_len < (QUERY_LINE_LEN - 1)) {
+                client->in[client->in_len++] = buf[i];
+            } else {
+                const char *err = "ERR line too long\n";
+                query_respond(client, err, strlen(err));
+                client->closing = true;
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Query server open function. This function listens on a Unix
+ *        socket (replacing any stale socket file), and adds the socket to
+ *        the gateway's epoll set.
+ * @param server Pointer to the query server.
+ * @param path Path of the socket.
+ * @param store Pointer to the store queried.
+ * @param epoll_fd epoll file descriptor.
+ * @param epoll_base First epoll ID used by the server.
+ * @retval true if the server was opened, false otherwise.
+ */
+bool query_server_open(struct query_server *server, const char *path,
+        const struct store *store, int epoll_fd, uint32_t epoll_base) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: socket path too long\n", path);
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+
+    server->epoll_fd = epoll_fd;
+    server->epoll_base = epoll_base;
+    server->store = store;
+    for (uint32_t i = 0; i < QUERY_MAX_CLIENTS; i++) {
+        memset(&server->clients[i], 0, sizeof(struct query_client));
+        server->clients[i].fd = -1;
+    }
+
+    server->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (server->listen_fd < 0) {
+        perror("socket");
+        return false;
+    }
+
+    unlink(path);
+    if ((bind(server->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+            || (listen(server->listen_fd, QUERY_MAX_CLIENTS) != 0)) {
+        perror(path);
+        close(server->listen_fd);
+        return false;
+    }
+
+    struct epoll_event event = {.events = EPOLLIN, .data.u32 = epoll_base};
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &event) != 0) {
+        perror("epoll_ctl");
+        close(server->listen_fd);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Query server event handler. This function accepts new clients, and
+ *        reads queries from and writes responses to connected clients.
+ * @param server Pointer to the query server.
+ * @param id Epoll ID of the event.
+ * @param events Epoll events.
+ * @retval None.
+ */
+void query_server_handle(struct query_server *server, uint32_t id, uint32_t events) {
+    if (id == server->epoll_base) {
+        int fd;
+        while ((fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK)) >= 0) {
+            uint32_t i = 0;
+            while ((i < QUERY_MAX_CLIENTS) && (server->clients[i].fd >= 0)) {
+                i++;
+            }
+
+            struct epoll_event event = {.events = EPOLLIN, .data.u32 = server->epoll_base + 1 + i};
+            if ((i == QUERY_MAX_CLIENTS) || (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd,
+                    &event) != 0)) {
+                close(fd);
+                continue;
+            }
+
+            server->clients[i].fd = fd;
+        }
+        return;
+    }
+
+    struct query_client *client = &server->clients[id - server->epoll_base - 1];
+    if (client->fd < 0) {
+        return;
+    }
+
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        query_client_read(server, client);
+    }
+
+    query_client_write(server, client, id);
+}
+
+/**
+ * @brief Query server close function. This function closes every client,
+ *        and the listening socket.
+ * @param server Pointer to the query server.
+ * @retval None.
+ */
+void query_server_close(struct query_server *server) {
+    for (uint32_t i = 0; i < QUERY_MAX_CLIENTS; i++) {
+        if (server->clients[i].fd >= 0) {
+            query_client_close(server, &server->clients[i]);
+        }
+    }
+
+    close(server->listen_fd);
+}
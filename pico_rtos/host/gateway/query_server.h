@@ -0,0 +1,57 @@
+ /**
+ **************************************************************
+ * @file query_server.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the gateway's range query server.
+ ***************************************************************
+ */
+
+#ifndef QUERY_SERVER_H
+#define QUERY_SERVER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "store.h"
+
+// Maximum number of clients connected at once.
+#define QUERY_MAX_CLIENTS 16
+
+// Maximum length of a query line (including its newline).
+#define QUERY_LINE_LEN 256
+
+// Maximum number of buckets a query may cover (so one query can't tie up
+// the gateway's event loop).
+#define QUERY_MAX_ROWS 200000
+
+// Struct holding a connected client.
+struct query_client {
+    int fd;                     // -1 if the slot is free
+    char in[QUERY_LINE_LEN];
+    size_t in_len;
+    char *out;                  // Responses not yet written
+    size_t out_len;
+    size_t out_pos;
+    size_t out_cap;
+    bool closing;               // Close once the responses are written
+};
+
+// Struct holding the query server. Its sockets are added to the gateway's
+// epoll set with data.u32 from epoll_base (the listening socket) to
+// epoll_base + QUERY_MAX_CLIENTS.
+struct query_server {
+    int listen_fd;
+    int epoll_fd;
+    uint32_t epoll_base;
+    const struct store *store;
+    struct query_client clients[QUERY_MAX_CLIENTS];
+};
+
+// Function prototypes
+bool query_server_open(struct query_server *server, const char *path,
+        const struct store *store, int epoll_fd, uint32_t epoll_base);
+void query_server_handle(struct query_server *server, uint32_t id, uint32_t events);
+void query_server_close(struct query_server *server);
+
+#endif
@@ -0,0 +1,231 @@
+ /**
+ **************************************************************
+ * @file mcp3208_bench.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief MCP3208 scan benchmark. This tool runs the firmware's MCP3208 scan
+ *        (command table, decoding and decimation, see mylib/mcp3208)
+ *        against a simulated MCP3208 for 1 to 7 tanks (each tank's
+ *        pressure channel, plus the shared offset/reference channel). For
+ *        each tank count it checks the scan's bus timing and every
+ *        conversion against the device's protocol, compares each decimated
+ *        reading with the channel's input, and times the decimation (the
+ *        only per-frame CPU work, as DMA moves the conversions). Frames are
+ *        taken at varying points of the scan, with the part of the ring
+ *        the DMA may still be writing filled with garbage, which must be
+ *        left out of every reading. Results are reported as key=value
+ *        lines, one per tank count.
+ *
+ *        Usage: mcp3208_bench [-b SPI clock (Hz)] [-r conversion rate (Hz)]
+ *                             [-f frames] [-n noise (counts)] [-s seed]
+ ***************************************************************
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "mcp3208_sim.h"
+
+// Defaults for the command line options.
+#define MCP3208_BENCH_DEFAULT_FRAMES 20
+#define MCP3208_BENCH_DEFAULT_NOISE 1.0
+#define MCP3208_BENCH_DEFAULT_SEED 1
+
+// Number of times the decimation is repeated when it is timed.
+#define MCP3208_BENCH_TIMING_REPEATS 2000
+
+// Step in the number of conversions run between frames (prime, so frames
+// are taken at every point of the ring).
+#define MCP3208_BENCH_FRAME_STEP 613
+
+// Byte written over the part of the ring the DMA may be writing when a
+// frame is taken (decodes as a full scale conversion).
+#define MCP3208_BENCH_GARBAGE 0xFF
+
+// Largest error (in decimated counts) allowed between a decimated reading
+// and its channel's input (one 12-bit count).
+#define MCP3208_BENCH_MAX_ERR_COUNTS (1 << OVERSAMPLE_EXTRA_BITS)
+
+// Scan ring and command table (as in the firmware).
+static uint32_t scan_ring[MCP3208_RING_WORDS];
+static uint32_t scan_commands[MCP3208_NUM_CHANNELS];
+
+// Readings written by the timed decimation (kept so it isn't optimised
+// away).
+static volatile uint16_t decimated_sink;
+
+/**
+ * @brief CPU time function.
+ * @param None.
+ * @retval CPU time used by the process, in nsec.
+ */
+static uint64_t cpu_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return ((uint64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+/**
+ * @brief Input function. This function gives the input (in 12-bit counts)
+ *        of a channel in use, spread across the range and off the integer
+ *        counts so oversampling has something to resolve.
+ * @param channel Channel.
+ * @retval Input, in 12-bit counts.
+ */
+static double bench_input_counts(uint8_t channel) {
+    return 200.37 + (channel * 480.0);
+}
+
+/**
+ * @brief Garbage fill function. This function fills the ring from the DMA
+ *        write address up to the first row read by the next decimation
+ *        (the torn word and the rows the DMA may write during it) with
+ *        garbage. The scan overwrites it as it carries on.
+ * @param write_offset Offset of the DMA write address in the ring (bytes).
+ * @retval None.
+ */
+static void bench_fill_garbage(uint32_t write_offset) {
+    uint8_t *ring = (uint8_t *)scan_ring;
+    uint32_t row_bytes = MCP3208_NUM_CHANNELS * MCP3208_CONVERSION_BYTES;
+    uint32_t end = ((write_offset / row_bytes) + MCP3208_SCAN_GAP_ROWS
+            - MCP3208_SCAN_MARGIN_ROWS) * row_bytes;
+
+    for (uint32_t i = write_offset; i < end; i++) {
+        ring[i % MCP3208_RING_BYTES] = MCP3208_BENCH_GARBAGE;
+    }
+}
+
+/**
+ * @brief Tank count run function. This function runs the scan with a
+ *        number of channels in use (the rest grounded), and reports it.
+ * @param tanks Number of tanks.
+ * @param baud SPI clock rate.
+ * @param rate Conversion rate.
+ * @param frames Number of frames taken.
+ * @param noise Input noise (std. deviation, in 12-bit counts).
+ * @param seed Seed for the input noise.
+ * @retval true if the scan met the device's protocol and timing, and every
+ *         reading was within MCP3208_BENCH_MAX_ERR_COUNTS of its input.
+ */
+static bool bench_run(uint8_t tanks, uint32_t baud, uint32_t rate, uint32_t frames,
+        double noise, uint64_t seed) {
+    uint8_t channels = tanks + 1;
+    struct mcp3208_sim adc;
+    struct mcp3208_sim_scan scan;
+
+    mcp3208_sim_init(&adc, noise, seed);
+    for (uint8_t channel = 0; channel < channels; channel++) {
+        adc.input_counts[channel] = bench_input_counts(channel);
+    }
+
+    mcp3208_sim_scan_init(&scan, baud, rate);
+
+    // Fill the ring before the first frame (the firmware's settle time)
+    mcp3208_sim_scan_run(&scan, &adc, scan_commands, scan_ring, MCP3208_RING_WORDS);
+
+    double max_err = 0.0;
+    for (uint32_t i = 0; i < frames; i++) {
+        uint16_t raw[MCP3208_NUM_CHANNELS];
+        bench_fill_garbage(scan.ring_index);
+        mcp3208_scan_decimate(scan_ring, scan.ring_index, raw);
+
+        for (uint8_t channel = 0; channel < MCP3208_NUM_CHANNELS; channel++) {
+            double expected = (channel < channels) ? bench_input_counts(channel) : 0.0;
+            double err = fabs(raw[channel] - (expected * (1 << OVERSAMPLE_EXTRA_BITS)));
+            max_err = (err > max_err) ? err : max_err;
+        }
+
+        mcp3208_sim_scan_run(&scan, &adc, scan_commands, scan_ring,
+                1 + (((uint64_t)i * MCP3208_BENCH_FRAME_STEP) % MCP3208_RING_WORDS));
+    }
+
+    // Every channel is converted equally often, whatever is in use (to
+    // within one, as the scan stops mid-row)
+    uint64_t min_conversions = adc.conversions[0], max_conversions = adc.conversions[0];
+    for (uint8_t channel = 1; channel < MCP3208_NUM_CHANNELS; channel++) {
+        uint64_t n = adc.conversions[channel];
+        min_conversions = (n < min_conversions) ? n : min_conversions;
+        max_conversions = (n > max_conversions) ? n : max_conversions;
+    }
+
+    // Time the decimation of the final ring
+    uint64_t start_ns = cpu_ns();
+    for (uint32_t i = 0; i < MCP3208_BENCH_TIMING_REPEATS; i++) {
+        uint16_t raw[MCP3208_NUM_CHANNELS];
+        mcp3208_scan_decimate(scan_ring, scan.ring_index, raw);
+        decimated_sink = raw[i % MCP3208_NUM_CHANNELS];
+    }
+    double frame_ns = (double)(cpu_ns() - start_ns) / MCP3208_BENCH_TIMING_REPEATS;
+
+    uint32_t conversion_ns = mcp3208_conversion_ns(baud);
+    uint32_t tick_ns = 1000000000 / rate;
+    uint32_t read_us = mcp3208_scan_read_us(rate);
+    bool ok = (adc.errors == 0) && ((max_conversions - min_conversions) <= 1)
+            && (max_err <= MCP3208_BENCH_MAX_ERR_COUNTS);
+
+    printf("tanks=%u channels=%u conv_per_s=%u scans_per_s=%u ring_fill_ms=%u "
+            "cs_low_ns=%u cs_high_ns=%d bus_util=%.2f conversions=%llu errors=%llu "
+            "max_err_counts=%.1f decimate_us_per_frame=%.2f read_limit_us=%u "
+            "ns_per_conversion=%.2f ns_per_used_sample=%.2f ok=%d\n",
+            tanks, channels, rate, rate / MCP3208_NUM_CHANNELS, mcp3208_ring_fill_ms(rate),
+            conversion_ns, (int)tick_ns - (int)conversion_ns, (double)conversion_ns / tick_ns,
+            (unsigned long long)scan.conversions, (unsigned long long)adc.errors, max_err,
+            frame_ns / 1000.0, read_us, frame_ns / (MCP3208_SCAN_ROWS * MCP3208_NUM_CHANNELS),
+            frame_ns / (MCP3208_SCAN_ROWS * channels), ok);
+
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    uint32_t baud = MCP3208_SPI_BAUD;
+    uint32_t rate = MCP3208_CONVERSION_RATE;
+    uint32_t frames = MCP3208_BENCH_DEFAULT_FRAMES;
+    double noise = MCP3208_BENCH_DEFAULT_NOISE;
+    uint64_t seed = MCP3208_BENCH_DEFAULT_SEED;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:r:f:n:s:")) != -1) {
+        switch (opt) {
+            case 'b':
+                baud = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                rate = strtoul(optarg, NULL, 0);
+                break;
+            case 'f':
+                frames = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                noise = strtod(optarg, NULL);
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-b SPI clock (Hz)] [-r conversion rate (Hz)] "
+                        "[-f frames] [-n noise (counts)] [-s seed]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if ((baud == 0) || (rate == 0) || (frames == 0) || (noise < 0.0)) {
+        fprintf(stderr, "%s: an SPI clock, a conversion rate and frames are required\n",
+                argv[0]);
+        return 2;
+    }
+
+    mcp3208_scan_commands(scan_commands);
+
+    bool ok = true;
+    for (uint8_t tanks = 1; tanks < MCP3208_NUM_CHANNELS; tanks++) {
+        ok &= bench_run(tanks, baud, rate, frames, noise, seed);
+    }
+
+    return ok ? 0 : 1;
+}
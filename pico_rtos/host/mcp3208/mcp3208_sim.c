@@ -0,0 +1,215 @@
+ /**
+ **************************************************************
+ * @file mcp3208_sim.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Simulated MCP3208 file. This file handles simulating an MCP3208
+ *        clock by clock on its SPI lines (so the command words and decoding
+ *        shared with the firmware are checked against the device's
+ *        protocol), and simulating the firmware's DMA scan of it: one
+ *        conversion per pacing timer tick, each sent from the command table
+ *        and received into the scan ring as four back-to-back bytes with
+ *        chip select held low.
+ ***************************************************************
+ */
+
+#include <math.h>
+#include "mcp3208_sim.h"
+
+/**
+ * @brief Simulated MCP3208 initialise function. All inputs start at 0.
+ * @param adc Pointer to the simulated MCP3208.
+ * @param noise_counts Input noise (std. deviation, in 12-bit counts).
+ * @param seed Seed for the input noise.
+ * @retval None.
+ */
+void mcp3208_sim_init(struct mcp3208_sim *adc, double noise_counts, uint64_t seed) {
+    for (uint8_t channel = 0; channel < MCP3208_NUM_CHANNELS; channel++) {
+        adc->input_counts[channel] = 0.0;
+        adc->conversions[channel] = 0;
+    }
+
+    adc->noise_counts = noise_counts;
+    plant_rng_seed(&adc->rng, seed);
+    adc->selected = false;
+    adc->deselected_ns = 0;
+    adc->state = MCP3208_SIM_WAIT_START;
+    adc->bits = 0;
+    adc->command = 0;
+    adc->result = 0;
+    adc->errors = 0;
+}
+
+/**
+ * @brief Sample function. This function converts a channel's input, with
+ *        noise, clamped to the 12-bit range.
+ * @param adc Pointer to the simulated MCP3208.
+ * @param channel Channel converted.
+ * @retval Conversion result.
+ */
+static uint16_t mcp3208_sim_sample(struct mcp3208_sim *adc, uint8_t channel) {
+    double counts = adc->input_counts[channel]
+            + (plant_rng_gaussian(&adc->rng) * adc->noise_counts);
+    counts = floor(counts + 0.5);
+
+    if (counts < 0.0) {
+        return 0;
+    } else if (counts > RES_LEVELS) {
+        return RES_LEVELS;
+    }
+
+    return (uint16_t)counts;
+}
+
+/**
+ * @brief Chip select function. Chip select rising ends a conversion (one
+ *        which hasn't clocked out all of its result is an error), and it
+ *        must stay high for at least MCP3208_CS_HIGH_NS before falling.
+ * @param adc Pointer to the simulated MCP3208.
+ * @param selected true if chip select is low.
+ * @param now_ns Time of the edge, in nsec.
+ * @retval None.
+ */
+void mcp3208_sim_select(struct mcp3208_sim *adc, bool selected, uint64_t now_ns) {
+    if (selected == adc->selected) {
+        return;
+    }
+
+    if (selected) {
+        if ((adc->deselected_ns > 0) && ((now_ns - adc->deselected_ns) < MCP3208_CS_HIGH_NS)) {
+            adc->errors++;
+        }
+
+        adc->state = MCP3208_SIM_WAIT_START;
+        adc->bits = 0;
+    } else {
+        if (adc->state != MCP3208_SIM_DONE) {
+            adc->errors++;
+        }
+
+        adc->deselected_ns = now_ns;
+    }
+
+    adc->selected = selected;
+}
+
+/**
+ * @brief Clock function. This function clocks one bit: the output bit is
+ *        shifted out for the clock, then the input bit is taken.
+ * @param adc Pointer to the simulated MCP3208.
+ * @param din Input bit.
+ * @retval Output bit (floating outputs read as 1).
+ */
+static uint8_t mcp3208_sim_clock(struct mcp3208_sim *adc, uint8_t din) {
+    uint8_t dout = 1;
+
+    switch (adc->state) {
+        case MCP3208_SIM_WAIT_START:
+            if (din) {
+                adc->state = MCP3208_SIM_COMMAND;
+                adc->bits = 0;
+                adc->command = 0;
+            }
+            break;
+        case MCP3208_SIM_COMMAND:
+            adc->command = (adc->command << 1) | din;
+            if (++adc->bits == MCP3208_SIM_COMMAND_BITS) {
+                adc->state = MCP3208_SIM_SAMPLE;
+            }
+            break;
+        case MCP3208_SIM_SAMPLE:
+            // Only single-ended conversions are used by the scan
+            if ((adc->command & 0x8) == 0) {
+                adc->errors++;
+            }
+            adc->result = mcp3208_sim_sample(adc, adc->command & 0x7);
+            adc->conversions[adc->command & 0x7]++;
+            adc->state = MCP3208_SIM_NULL;
+            break;
+        case MCP3208_SIM_NULL:
+            dout = 0;
+            adc->state = MCP3208_SIM_DATA;
+            adc->bits = 0;
+            break;
+        case MCP3208_SIM_DATA:
+            dout = (adc->result >> (11 - adc->bits)) & 1;
+            if (++adc->bits == 12) {
+                adc->state = MCP3208_SIM_DONE;
+            }
+            break;
+        default:
+            dout = 0;
+            break;
+    }
+
+    return dout;
+}
+
+/**
+ * @brief Transfer function. This function clocks one byte, most significant
+ *        bit first.
+ * @param adc Pointer to the simulated MCP3208.
+ * @param tx Byte sent to the MCP3208.
+ * @retval Byte received from the MCP3208.
+ */
+uint8_t mcp3208_sim_transfer(struct mcp3208_sim *adc, uint8_t tx) {
+    uint8_t rx = 0;
+
+    for (int8_t bit = 7; bit >= 0; bit--) {
+        uint8_t dout = adc->selected ? mcp3208_sim_clock(adc, (tx >> bit) & 1) : 1;
+        rx = (rx << 1) | dout;
+    }
+
+    return rx;
+}
+
+/**
+ * @brief Simulated scan initialise function.
+ * @param scan Pointer to the simulated scan.
+ * @param baud SPI clock rate.
+ * @param rate Conversion rate (pacing timer ticks per sec).
+ * @retval None.
+ */
+void mcp3208_sim_scan_init(struct mcp3208_sim_scan *scan, uint32_t baud, uint32_t rate) {
+    scan->baud = baud;
+    scan->rate = rate;
+    scan->conversions = 0;
+    scan->command_index = 0;
+    scan->ring_index = 0;
+}
+
+/**
+ * @brief Simulated scan run function. This function runs the scan for a
+ *        number of pacing timer ticks. On each tick chip select falls, the
+ *        transmit channel sends the next command word from the command
+ *        table (wrapping), the receive channel writes the received bytes
+ *        into the scan ring (wrapping), and chip select rises once the
+ *        last byte is clocked.
+ * @param scan Pointer to the simulated scan.
+ * @param adc Pointer to the simulated MCP3208.
+ * @param commands Command table (MCP3208_NUM_CHANNELS words).
+ * @param ring Scan ring (MCP3208_RING_WORDS words).
+ * @param num_conversions Number of ticks run.
+ * @retval None.
+ */
+void mcp3208_sim_scan_run(struct mcp3208_sim_scan *scan, struct mcp3208_sim *adc,
+        const uint32_t *commands, uint32_t *ring, uint64_t num_conversions) {
+    const uint8_t *tx = (const uint8_t *)commands;
+    uint8_t *rx = (uint8_t *)ring;
+    uint32_t conversion_ns = mcp3208_conversion_ns(scan->baud);
+
+    for (uint64_t i = 0; i < num_conversions; i++) {
+        uint64_t start_ns = (scan->conversions * 1000000000ull) / scan->rate;
+
+        mcp3208_sim_select(adc, true, start_ns);
+
+        for (uint8_t byte = 0; byte < MCP3208_CONVERSION_BYTES; byte++) {
+            rx[scan->ring_index] = mcp3208_sim_transfer(adc, tx[scan->command_index]);
+            scan->command_index = (scan->command_index + 1) % MCP3208_COMMANDS_BYTES;
+            scan->ring_index = (scan->ring_index + 1) % MCP3208_RING_BYTES;
+        }
+
+        mcp3208_sim_select(adc, false, start_ns + conversion_ns);
+        scan->conversions++;
+    }
+}
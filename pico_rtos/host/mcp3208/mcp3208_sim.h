@@ -0,0 +1,66 @@
+ /**
+ **************************************************************
+ * @file mcp3208_sim.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the simulated MCP3208 and its DMA scan.
+ ***************************************************************
+ */
+
+#ifndef MCP3208_SIM_H
+#define MCP3208_SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "plant.h"
+#include "mcp3208_scan.h"
+
+// Conversion states, clock by clock after chip select falls: leading zeros
+// until the start bit, the single-ended bit and D2-D0, the sample clock
+// (output floating), the null bit, the 12 result bits, then zeros until
+// chip select rises.
+#define MCP3208_SIM_WAIT_START 0
+#define MCP3208_SIM_COMMAND 1
+#define MCP3208_SIM_SAMPLE 2
+#define MCP3208_SIM_NULL 3
+#define MCP3208_SIM_DATA 4
+#define MCP3208_SIM_DONE 5
+
+// Number of command bits after the start bit (single-ended, D2, D1, D0).
+#define MCP3208_SIM_COMMAND_BITS 4
+
+// Struct holding a simulated MCP3208.
+struct mcp3208_sim {
+    double input_counts[MCP3208_NUM_CHANNELS];  // Input of each channel (12-bit counts)
+    double noise_counts;                        // Input noise (std. dev., counts)
+    struct plant_rng rng;
+    bool selected;
+    uint64_t deselected_ns;                     // Time chip select last rose
+    uint8_t state;
+    uint8_t bits;                               // Bits of the current state
+    uint8_t command;
+    uint16_t result;
+    uint64_t conversions[MCP3208_NUM_CHANNELS];
+    uint64_t errors;                            // Malformed or mistimed conversions
+};
+
+// Struct holding the simulated DMA scan (the pacing timer, the transmit
+// channel's place in the command table, and the receive channel's place
+// in the scan ring).
+struct mcp3208_sim_scan {
+    uint32_t baud;
+    uint32_t rate;
+    uint64_t conversions;
+    uint32_t command_index;
+    uint32_t ring_index;
+};
+
+// Function prototypes
+void mcp3208_sim_init(struct mcp3208_sim *adc, double noise_counts, uint64_t seed);
+void mcp3208_sim_select(struct mcp3208_sim *adc, bool selected, uint64_t now_ns);
+uint8_t mcp3208_sim_transfer(struct mcp3208_sim *adc, uint8_t tx);
+void mcp3208_sim_scan_init(struct mcp3208_sim_scan *scan, uint32_t baud, uint32_t rate);
+void mcp3208_sim_scan_run(struct mcp3208_sim_scan *scan, struct mcp3208_sim *adc,
+        const uint32_t *commands, uint32_t *ring, uint64_t num_conversions);
+
+#endif
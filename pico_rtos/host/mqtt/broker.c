@@ -0,0 +1,466 @@
+ /**
+ **************************************************************
+ * @file broker.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief MQTT broker stand-in. This tool accepts MQTT 3.1.1 clients over
+ *        TCP and acknowledges their CONNECT, PUBLISH (QoS 1) and PINGREQ
+ *        packets, but doesn't forward anything: it counts the messages,
+ *        lines and bytes published to it, and the latency of each line
+ *        (from the wall clock time at the start of the line, as published
+ *        by the gateway, to its arrival). With an up time, the broker goes
+ *        away (closing its clients and listening socket) for the down time
+ *        after every up time, to exercise a publisher's spooling and
+ *        reconnecting. Statistics are reported as key=value lines.
+ *
+ *        Usage: mqtt_broker [-p port] [-u up time (s)] [-w down time (s)]
+ *                           [-s report interval (s)]
+ ***************************************************************
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "mqtt.h"
+
+// Defaults for the command line options.
+#define BROKER_DEFAULT_PORT 1883
+#define BROKER_DEFAULT_DOWN_SEC 10
+#define BROKER_DEFAULT_REPORT_SEC 10
+
+// Maximum number of clients connected at once.
+#define BROKER_MAX_CLIENTS 64
+
+// Receive buffer size (longer than the longest batch published), and send
+// buffer size (for acknowledgements).
+#define BROKER_RX_LEN (128 * 1024)
+#define BROKER_TX_LEN (64 * 1024)
+
+// Line latency histogram, in buckets of BROKER_LATENCY_BUCKET_MS up to
+// 60 sec.
+#define BROKER_LATENCY_BUCKET_MS 10
+#define BROKER_LATENCY_BUCKETS 6000
+
+// Epoll ID of the listening socket (clients use their index).
+#define BROKER_LISTEN_EPOLL_ID BROKER_MAX_CLIENTS
+
+// Maximum number of events handled per epoll wait.
+#define BROKER_MAX_EVENTS 64
+
+// Struct holding a connected client.
+struct broker_client {
+    int fd;                     // -1 if the slot is free
+    bool connected;             // CONNECT received
+    uint8_t *rx;
+    size_t rx_len;
+    uint8_t tx[BROKER_TX_LEN];
+    size_t tx_len;
+};
+
+// Struct holding the broker statistics.
+struct broker_stats {
+    uint64_t connects;
+    uint64_t messages;
+    uint64_t lines;
+    uint64_t bytes;
+    int64_t latency_max_ms;
+    uint32_t latency_hist[BROKER_LATENCY_BUCKETS];
+};
+
+// Set by the signal handler to stop the broker.
+static volatile sig_atomic_t stop = 0;
+
+/**
+ * @brief Signal handler.
+ * @param signum Signal number.
+ * @retval None.
+ */
+static void handle_signal(int signum) {
+    (void)signum;
+    stop = 1;
+}
+
+/**
+ * @brief Monotonic time function.
+ * @param None.
+ * @retval Monotonic time, in usec.
+ */
+static uint64_t now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
+/**
+ * @brief Wall clock time function.
+ * @param None.
+ * @retval Time since the epoch, in msec.
+ */
+static int64_t wall_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return ((int64_t)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+/**
+ * @brief Listen function. This function opens the listening socket, and
+ *        adds it to the epoll set.
+ * @param port TCP port.
+ * @param epoll_fd epoll file descriptor.
+ * @retval Listening socket, or -1 on failure.
+ */
+static int broker_listen(uint16_t port, int epoll_fd) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port),
+            .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    struct epoll_event event = {.events = EPOLLIN, .data.u32 = BROKER_LISTEN_EPOLL_ID};
+    if ((bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) || (listen(fd, 16) != 0)
+            || (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)) {
+        perror("listen");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Client close function.
+ * @param client Pointer to the client.
+ * @param epoll_fd epoll file descriptor.
+ * @retval None.
+ */
+static void client_close(struct broker_client *client, int epoll_fd) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    client->fd = -1;
+}
+
+/**
+ * @brief Client send function. This function queues a packet for a client
+ *        and writes as much as the socket accepts. A client which stops
+ *        reading its acknowledgements is closed.
+ * @param client Pointer to the client.
+ * @param packet Packet.
+ * @param len Length of the packet.
+ * @param epoll_fd epoll file descriptor.
+ * @retval None.
+ */
+static void client_send(struct broker_client *client, const uint8_t *packet, size_t len,
+        int epoll_fd) {
+    if ((client->tx_len + len) > BROKER_TX_LEN) {
+        client_close(client, epoll_fd);
+        return;
+    }
+
+    memcpy(&client->tx[client->tx_len], packet, len);
+    client->tx_len += len;
+
+    ssize_t sent = send(client->fd, client->tx, client->tx_len, MSG_NOSIGNAL);
+    if ((sent < 0) && (errno != EAGAIN)) {
+        client_close(client, epoll_fd);
+        return;
+    } else if (sent > 0) {
+        memmove(client->tx, &client->tx[sent], client->tx_len - sent);
+        client->tx_len -= sent;
+    }
+}
+
+/**
+ * @brief PUBLISH handler. This function counts a published batch, and the
+ *        latency of each of its lines.
+ * @param publish Pointer to the PUBLISH fields.
+ * @param stats Pointer to the broker statistics.
+ * @retval None.
+ */
+static void broker_count(const struct mqtt_publish *publish, struct broker_stats *stats) {
+    int64_t now_ms = wall_ms();
+    const char *pos = (const char *)publish->payload;
+    const char *end = pos + publish->payload_len;
+
+    stats->messages++;
+    stats->bytes += publish->payload_len;
+
+    while (pos < end) {
+        const char *newline = memchr(pos, '\n', end - pos);
+        newline = (newline != NULL) ? newline : end;
+
+        int64_t ts_ms = 0;
+        for (; (pos < newline) && (*pos >= '0') && (*pos <= '9'); pos++) {
+            ts_ms = (ts_ms * 10) + (*pos - '0');
+        }
+
+        int64_t latency_ms = (now_ms > ts_ms) ? (now_ms - ts_ms) : 0;
+        uint32_t bucket = latency_ms / BROKER_LATENCY_BUCKET_MS;
+        stats->latency_hist[(bucket < BROKER_LATENCY_BUCKETS) ? bucket
+                : (BROKER_LATENCY_BUCKETS - 1)]++;
+        stats->latency_max_ms = (latency_ms > stats->latency_max_ms) ? latency_ms
+                : stats->latency_max_ms;
+        stats->lines++;
+        pos = newline + 1;
+    }
+}
+
+/**
+ * @brief Client receive function. This function reads everything available
+ *        from a client, and answers each complete packet.
+ * @param client Pointer to the client.
+ * @param stats Pointer to the broker statistics.
+ * @param epoll_fd epoll file descriptor.
+ * @retval None.
+ */
+static void client_receive(struct broker_client *client, struct broker_stats *stats,
+        int epoll_fd) {
+    while (client->fd >= 0) {
+        ssize_t len = read(client->fd, &client->rx[client->rx_len],
+                BROKER_RX_LEN - client->rx_len);
+        if ((len == 0) || ((len < 0) && (errno != EAGAIN))) {
+            client_close(client, epoll_fd);
+            return;
+        } else if (len < 0) {
+            return;
+        }
+        client->rx_len += len;
+
+        struct mqtt_packet packet;
+        long packet_len;
+        size_t pos = 0;
+        while ((client->fd >= 0) && ((packet_len = mqtt_parse(&client->rx[pos],
+                client->rx_len - pos, &packet)) > 0)) {
+            uint8_t reply[MQTT_CONNACK_LEN];
+            struct mqtt_publish publish;
+            uint16_t keepalive_sec;
+
+            if (!client->connected) {
+                if (!mqtt_parse_connect(&packet, &keepalive_sec)) {
+                    client_close(client, epoll_fd);
+                    return;
+                }
+                client->connected = true;
+                stats->connects++;
+                client_send(client, reply, mqtt_connack(reply, 0), epoll_fd);
+            } else if (mqtt_parse_publish(&packet, &publish)) {
+                broker_count(&publish, stats);
+                if (publish.qos == 1) {
+                    client_send(client, reply, mqtt_puback(reply, publish.packet_id),
+                            epoll_fd);
+                }
+            } else if (packet.type == MQTT_PINGREQ) {
+                client_send(client, reply, mqtt_empty(reply, MQTT_PINGRESP), epoll_fd);
+            } else if (packet.type == MQTT_DISCONNECT) {
+                client_close(client, epoll_fd);
+                return;
+            }
+
+            pos += packet_len;
+        }
+
+        if ((client->fd >= 0) && ((packet_len < 0)
+                || ((pos == 0) && (client->rx_len == BROKER_RX_LEN)))) {
+            client_close(client, epoll_fd);
+            return;
+        } else if (client->fd >= 0) {
+            memmove(client->rx, &client->rx[pos], client->rx_len - pos);
+            client->rx_len -= pos;
+        }
+    }
+}
+
+/**
+ * @brief Latency percentile function.
+ * @param stats Pointer to the broker statistics.
+ * @param pct Percentile.
+ * @retval Line latency at the percentile (upper edge of its bucket), in
+ *         msec.
+ */
+static uint32_t latency_percentile_ms(const struct broker_stats *stats, double pct) {
+    uint64_t target = (uint64_t)((stats->lines * pct) / 100.0);
+    uint64_t count = 0;
+
+    if (stats->lines == 0) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < BROKER_LATENCY_BUCKETS; i++) {
+        count += stats->latency_hist[i];
+        if ((count > target) || (count == stats->lines)) {
+            return (i + 1) * BROKER_LATENCY_BUCKET_MS;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Report function. This function prints the broker statistics (since
+ *        it started) to stderr.
+ * @param stats Pointer to the broker statistics.
+ * @param up Broker up (listening).
+ * @retval None.
+ */
+static void report_stats(const struct broker_stats *stats, bool up) {
+    fprintf(stderr, "broker up=%d connects=%llu messages=%llu lines=%llu bytes=%llu "
+            "lat_p50_ms=%u lat_p99_ms=%u lat_max_ms=%lld\n", up,
+            (unsigned long long)stats->connects, (unsigned long long)stats->messages,
+            (unsigned long long)stats->lines, (unsigned long long)stats->bytes,
+            latency_percentile_ms(stats, 50.0), latency_percentile_ms(stats, 99.0),
+            (long long)stats->latency_max_ms);
+}
+
+int main(int argc, char **argv) {
+    uint16_t port = BROKER_DEFAULT_PORT;
+    uint64_t up_us = 0;
+    uint64_t down_us = BROKER_DEFAULT_DOWN_SEC * 1000000ULL;
+    uint64_t report_us = BROKER_DEFAULT_REPORT_SEC * 1000000ULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:u:w:s:")) != -1) {
+        switch (opt) {
+            case 'p':
+                port = strtoul(optarg, NULL, 0);
+                break;
+            case 'u':
+                up_us = strtoull(optarg, NULL, 0) * 1000000;
+                break;
+            case 'w':
+                down_us = strtoull(optarg, NULL, 0) * 1000000;
+                break;
+            case 's':
+                report_us = strtoull(optarg, NULL, 0) * 1000000;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-p port] [-u up time (s)] [-w down time (s)] "
+                        "[-s report interval (s)]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (report_us == 0) {
+        fprintf(stderr, "%s: the report interval must be non-zero\n", argv[0]);
+        return 2;
+    }
+
+    int epoll_fd = epoll_create1(0);
+    struct broker_client *clients = calloc(BROKER_MAX_CLIENTS, sizeof(struct broker_client));
+    struct broker_stats *stats = calloc(1, sizeof(struct broker_stats));
+    if ((epoll_fd < 0) || (clients == NULL) || (stats == NULL)) {
+        perror("broker");
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < BROKER_MAX_CLIENTS; i++) {
+        clients[i].fd = -1;
+        clients[i].rx = malloc(BROKER_RX_LEN);
+        if (clients[i].rx == NULL) {
+            perror("malloc");
+            return 1;
+        }
+    }
+
+    int listen_fd = broker_listen(port, epoll_fd);
+    if (listen_fd < 0) {
+        return 1;
+    }
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    uint64_t now = now_us();
+    uint64_t next_report_us = now + report_us;
+    uint64_t next_outage_us = (up_us > 0) ? (now + up_us) : UINT64_MAX;
+
+    while (!stop) {
+        now = now_us();
+
+        if (now >= next_report_us) {
+            report_stats(stats, listen_fd >= 0);
+            next_report_us += report_us;
+        }
+
+        // Going away closes every client, so their unacknowledged batches
+        // have to be published again
+        if (now >= next_outage_us) {
+            if (listen_fd >= 0) {
+                fprintf(stderr, "broker going away for %llu s\n",
+                        (unsigned long long)(down_us / 1000000));
+                for (uint32_t i = 0; i < BROKER_MAX_CLIENTS; i++) {
+                    if (clients[i].fd >= 0) {
+                        client_close(&clients[i], epoll_fd);
+                    }
+                }
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, listen_fd, NULL);
+                close(listen_fd);
+                listen_fd = -1;
+                next_outage_us = now + down_us;
+            } else {
+                fprintf(stderr, "broker back\n");
+                listen_fd = broker_listen(port, epoll_fd);
+                if (listen_fd < 0) {
+                    return 1;
+                }
+                next_outage_us = now + up_us;
+            }
+        }
+
+        uint64_t wake_us = (next_outage_us < next_report_us) ? next_outage_us : next_report_us;
+        int timeout_ms = (wake_us > now) ? (int)(((wake_us - now) + 999) / 1000) : 0;
+        struct epoll_event events[BROKER_MAX_EVENTS];
+        int num_events = epoll_wait(epoll_fd, events, BROKER_MAX_EVENTS, timeout_ms);
+
+        for (int i = 0; i < num_events; i++) {
+            if (events[i].data.u32 != BROKER_LISTEN_EPOLL_ID) {
+                struct broker_client *client = &clients[events[i].data.u32];
+                if (client->fd >= 0) {
+                    client_receive(client, stats, epoll_fd);
+                }
+                continue;
+            }
+
+            int fd;
+            while ((listen_fd >= 0) && ((fd = accept4(listen_fd, NULL, NULL,
+                    SOCK_NONBLOCK)) >= 0)) {
+                uint32_t slot;
+                for (slot = 0; (slot < BROKER_MAX_CLIENTS) && (clients[slot].fd >= 0); slot++) {
+                }
+
+                struct epoll_event event = {.events = EPOLLIN, .data.u32 = slot};
+                if ((slot == BROKER_MAX_CLIENTS)
+                        || (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)) {
+                    close(fd);
+                    continue;
+                }
+
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                clients[slot].fd = fd;
+                clients[slot].connected = false;
+                clients[slot].rx_len = 0;
+                clients[slot].tx_len = 0;
+            }
+        }
+    }
+
+    report_stats(stats, listen_fd >= 0);
+    return 0;
+}
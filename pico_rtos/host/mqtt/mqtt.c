@@ -0,0 +1,221 @@
+ /**
+ **************************************************************
+ * @file mqtt.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief MQTT packet file. This file handles functionality specific to
+ *        encoding and decoding the MQTT 3.1.1 packets used by the gateway's
+ *        publisher and the broker stand-in (CONNECT/CONNACK, PUBLISH/PUBACK
+ *        at QoS 0 and 1, PINGREQ/PINGRESP and DISCONNECT). It has no I/O.
+ ***************************************************************
+ */
+
+#include <string.h>
+#include "mqtt.h"
+
+/**
+ * @brief Fixed header write function. This function writes a packet's type
+ *        byte and remaining length (7 bits per byte, least significant
+ *        first).
+ * @param out Buffer written to.
+ * @param type Packet type.
+ * @param flags Packet flags.
+ * @param remaining_len Length of the rest of the packet.
+ * @retval Length of the fixed header.
+ */
+static size_t mqtt_put_fixed_header(uint8_t *out, uint8_t type, uint8_t flags,
+        size_t remaining_len) {
+    size_t len = 0;
+    out[len++] = (type << 4) | (flags & 0x0F);
+
+    do {
+        uint8_t byte = remaining_len & 0x7F;
+        remaining_len >>= 7;
+        out[len++] = byte | ((remaining_len > 0) ? 0x80 : 0);
+    } while (remaining_len > 0);
+
+    return len;
+}
+
+/**
+ * @brief String write function. This function writes a length-prefixed
+ *        string.
+ * @param out Buffer written to.
+ * @param str String.
+ * @param len Length of the string.
+ * @retval Number of bytes written.
+ */
+static size_t mqtt_put_string(uint8_t *out, const char *str, uint16_t len) {
+    out[0] = len >> 8;
+    out[1] = len & 0xFF;
+    memcpy(&out[2], str, len);
+    return len + 2;
+}
+
+/**
+ * @brief CONNECT encode function. This function writes a CONNECT packet with
+ *        a clean session, and no will, username or password.
+ * @param out Buffer written to (at least 14 + strlen(client_id) bytes).
+ * @param client_id Client identifier.
+ * @param keepalive_sec Keep alive interval, in sec.
+ * @retval Length of the packet.
+ */
+size_t mqtt_connect(uint8_t *out, const char *client_id, uint16_t keepalive_sec) {
+    uint16_t id_len = strlen(client_id);
+    size_t len = mqtt_put_fixed_header(out, MQTT_CONNECT, 0, 10 + 2 + id_len);
+
+    len += mqtt_put_string(&out[len], "MQTT", 4);
+    out[len++] = 4;                         // Protocol level (3.1.1)
+    out[len++] = 0x02;                      // Clean session
+    out[len++] = keepalive_sec >> 8;
+    out[len++] = keepalive_sec & 0xFF;
+    len += mqtt_put_string(&out[len], client_id, id_len);
+
+    return len;
+}
+
+/**
+ * @brief CONNACK encode function.
+ * @param out Buffer written to (MQTT_CONNACK_LEN bytes).
+ * @param return_code Connect return code (0 if accepted).
+ * @retval Length of the packet.
+ */
+size_t mqtt_connack(uint8_t *out, uint8_t return_code) {
+    size_t len = mqtt_put_fixed_header(out, MQTT_CONNACK, 0, 2);
+    out[len++] = 0;                         // No session present
+    out[len++] = return_code;
+    return len;
+}
+
+/**
+ * @brief PUBLISH header encode function. This function writes a PUBLISH
+ *        packet up to its payload (which the caller writes after it).
+ * @param out Buffer written to (at least MQTT_MAX_FIXED_HEADER_LEN + 4 +
+ *        topic_len bytes).
+ * @param topic Topic name.
+ * @param topic_len Length of the topic name.
+ * @param qos QoS level (0 or 1).
+ * @param packet_id Packet identifier (QoS 1 only).
+ * @param payload_len Length of the payload.
+ * @retval Length of the packet before its payload.
+ */
+size_t mqtt_publish_header(uint8_t *out, const char *topic, uint16_t topic_len,
+        uint8_t qos, uint16_t packet_id, size_t payload_len) {
+    size_t id_len = (qos > 0) ? 2 : 0;
+    size_t len = mqtt_put_fixed_header(out, MQTT_PUBLISH, qos << 1,
+            2 + topic_len + id_len + payload_len);
+
+    len += mqtt_put_string(&out[len], topic, topic_len);
+    if (qos > 0) {
+        out[len++] = packet_id >> 8;
+        out[len++] = packet_id & 0xFF;
+    }
+
+    return len;
+}
+
+/**
+ * @brief PUBACK encode function.
+ * @param out Buffer written to (MQTT_PUBACK_LEN bytes).
+ * @param packet_id Packet identifier of the PUBLISH acknowledged.
+ * @retval Length of the packet.
+ */
+size_t mqtt_puback(uint8_t *out, uint16_t packet_id) {
+    size_t len = mqtt_put_fixed_header(out, MQTT_PUBACK, 0, 2);
+    out[len++] = packet_id >> 8;
+    out[len++] = packet_id & 0xFF;
+    return len;
+}
+
+/**
+ * @brief Empty packet encode function. This function writes a packet with
+ *        no body (PINGREQ, PINGRESP or DISCONNECT).
+ * @param out Buffer written to (MQTT_EMPTY_LEN bytes).
+ * @param type Packet type.
+ * @retval Length of the packet.
+ */
+size_t mqtt_empty(uint8_t *out, uint8_t type) {
+    return mqtt_put_fixed_header(out, type, 0, 0);
+}
+
+/**
+ * @brief Packet parse function. This function finds the first complete
+ *        packet in a receive buffer.
+ * @param buf Receive buffer.
+ * @param len Number of bytes in the buffer.
+ * @param packet Pointer to the packet found.
+ * @retval Length of the packet, 0 if the buffer doesn't yet hold a complete
+ *         packet, or -1 if the buffer doesn't start with a valid packet.
+ */
+long mqtt_parse(const uint8_t *buf, size_t len, struct mqtt_packet *packet) {
+    size_t remaining_len = 0;
+    size_t pos = 1;
+
+    for (uint8_t shift = 0; ; shift += 7) {
+        if (pos >= len) {
+            return 0;
+        } else if (shift > 21) {
+            return -1;
+        }
+
+        uint8_t byte = buf[pos++];
+        remaining_len |= (size_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+
+    if ((len - pos) < remaining_len) {
+        return 0;
+    }
+
+    packet->type = buf[0] >> 4;
+    packet->flags = buf[0] & 0x0F;
+    packet->body = &buf[pos];
+    packet->body_len = remaining_len;
+    return pos + remaining_len;
+}
+
+/**
+ * @brief PUBLISH parse function.
+ * @param packet Pointer to a received PUBLISH packet.
+ * @param publish Pointer to the fields of the packet.
+ * @retval true if the packet is a valid PUBLISH, false otherwise.
+ */
+bool mqtt_parse_publish(const struct mqtt_packet *packet, struct mqtt_publish *publish) {
+    if ((packet->type != MQTT_PUBLISH) || (packet->body_len < 2)) {
+        return false;
+    }
+
+    publish->qos = (packet->flags >> 1) & 0x03;
+    publish->topic_len = (packet->body[0] << 8) | packet->body[1];
+    publish->topic = (const char *)&packet->body[2];
+
+    size_t pos = 2 + publish->topic_len;
+    size_t id_len = (publish->qos > 0) ? 2 : 0;
+    if ((publish->qos > 1) || ((pos + id_len) > packet->body_len)) {
+        return false;
+    }
+
+    publish->packet_id = (publish->qos > 0)
+            ? ((packet->body[pos] << 8) | packet->body[pos + 1]) : 0;
+    publish->payload = &packet->body[pos + id_len];
+    publish->payload_len = packet->body_len - (pos + id_len);
+    return true;
+}
+
+/**
+ * @brief CONNECT parse function.
+ * @param packet Pointer to a received CONNECT packet.
+ * @param keepalive_sec Pointer to the client's keep alive interval, in sec.
+ * @retval true if the packet is a valid MQTT 3.1.1 CONNECT, false otherwise.
+ */
+bool mqtt_parse_connect(const struct mqtt_packet *packet, uint16_t *keepalive_sec) {
+    if ((packet->type != MQTT_CONNECT) || (packet->body_len < 10)
+            || (memcmp(packet->body, "\x00\x04MQTT\x04", 7) != 0)) {
+        return false;
+    }
+
+    *keepalive_sec = (packet->body[8] << 8) | packet->body[9];
+    return true;
+}
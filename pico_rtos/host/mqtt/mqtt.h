@@ -0,0 +1,68 @@
+ /**
+ **************************************************************
+ * @file mqtt.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the MQTT 3.1.1 packet encoder/decoder.
+ ***************************************************************
+ */
+
+#ifndef MQTT_H
+#define MQTT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Packet types (the top 4 bits of a packet's first byte).
+#define MQTT_CONNECT 1
+#define MQTT_CONNACK 2
+#define MQTT_PUBLISH 3
+#define MQTT_PUBACK 4
+#define MQTT_PINGREQ 12
+#define MQTT_PINGRESP 13
+#define MQTT_DISCONNECT 14
+
+// Maximum length of a packet's fixed header (type byte and a 4 byte
+// remaining length).
+#define MQTT_MAX_FIXED_HEADER_LEN 5
+
+// Maximum remaining length of a packet.
+#define MQTT_MAX_REMAINING_LEN 268435455
+
+// Length of a CONNACK, PUBACK or packet with no body (e.g. PINGREQ).
+#define MQTT_CONNACK_LEN 4
+#define MQTT_PUBACK_LEN 4
+#define MQTT_EMPTY_LEN 2
+
+// Struct holding a received packet. The body points into the receive
+// buffer.
+struct mqtt_packet {
+    uint8_t type;
+    uint8_t flags;              // Low 4 bits of the first byte
+    const uint8_t *body;
+    size_t body_len;
+};
+
+// Struct holding the fields of a received PUBLISH packet.
+struct mqtt_publish {
+    const char *topic;          // Not null terminated
+    uint16_t topic_len;
+    uint8_t qos;
+    uint16_t packet_id;         // 0 for QoS 0
+    const uint8_t *payload;
+    size_t payload_len;
+};
+
+// Function prototypes
+size_t mqtt_connect(uint8_t *out, const char *client_id, uint16_t keepalive_sec);
+size_t mqtt_connack(uint8_t *out, uint8_t return_code);
+size_t mqtt_publish_header(uint8_t *out, const char *topic, uint16_t topic_len,
+        uint8_t qos, uint16_t packet_id, size_t payload_len);
+size_t mqtt_puback(uint8_t *out, uint16_t packet_id);
+size_t mqtt_empty(uint8_t *out, uint8_t type);
+long mqtt_parse(const uint8_t *buf, size_t len, struct mqtt_packet *packet);
+bool mqtt_parse_publish(const struct mqtt_packet *packet, struct mqtt_publish *publish);
+bool mqtt_parse_connect(const struct mqtt_packet *packet, uint16_t *keepalive_sec);
+
+#endif
@@ -0,0 +1,292 @@
+ /**
+ **************************************************************
+ * @file mqtt_bench.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief MQTT publisher benchmark. This tool drives the gateway's publisher
+ *        (see publisher.c) from its own event loop, with the readings of
+ *        many simulated nodes (one line per tank per reading, as the gateway
+ *        publishes them, and an occasional event line), for a fixed time. It
+ *        then waits for everything queued to be delivered, and reports the
+ *        publisher's statistics with the throughput and CPU time per line
+ *        as key=value lines.
+ *
+ *        Usage: mqtt_bench [-n nodes] [-r readings per sec per node]
+ *                          [-t time (s)] [-B batch time (ms)]
+ *                          [-Z batch size (bytes)] [-P qos] [-S spool dir]
+ *                          [-s report interval (s)] <broker host:port>
+ ***************************************************************
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include "publisher.h"
+
+// Defaults for the command line options.
+#define MQTT_BENCH_DEFAULT_NODES 256
+#define MQTT_BENCH_DEFAULT_RATE 10
+#define MQTT_BENCH_DEFAULT_SEC 10
+#define MQTT_BENCH_DEFAULT_SPOOL "mqtt_bench_spool"
+#define MQTT_BENCH_DEFAULT_REPORT_SEC 5
+
+// Number of tanks of each simulated node, and the proportion of readings
+// which also raise an event (1 in MQTT_BENCH_EVENT_ONE_IN).
+#define MQTT_BENCH_TANKS 2
+#define MQTT_BENCH_EVENT_ONE_IN 100
+
+// Time readings are generated for at once (in usec), and the longest the
+// tool waits for queued batches to be delivered at the end (in sec).
+#define MQTT_BENCH_TICK_US 1000
+#define MQTT_BENCH_DRAIN_SEC 60
+
+// Epoll ID of the publisher's connection.
+#define MQTT_BENCH_EPOLL_ID 0
+
+// Set by the signal handler to stop the benchmark.
+static volatile sig_atomic_t stop = 0;
+
+/**
+ * @brief Signal handler.
+ * @param signum Signal number.
+ * @retval None.
+ */
+static void handle_signal(int signum) {
+    (void)signum;
+    stop = 1;
+}
+
+/**
+ * @brief Monotonic time function.
+ * @param None.
+ * @retval Monotonic time, in usec.
+ */
+static uint64_t now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
+/**
+ * @brief Wall clock time function.
+ * @param None.
+ * @retval Time since the epoch, in msec.
+ */
+static int64_t wall_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return ((int64_t)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+/**
+ * @brief CPU time function.
+ * @param None.
+ * @retval User and system CPU time used by the process, in sec.
+ */
+static double cpu_sec(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + (usage.ru_utime.tv_usec / 1e6) + usage.ru_stime.tv_sec
+            + (usage.ru_stime.tv_usec / 1e6);
+}
+
+/**
+ * @brief Reading function. This function adds one simulated reading of a
+ *        node to its topics.
+ * @param pub Pointer to the publisher.
+ * @param topics Topics of the node.
+ * @param reading Index of the reading (across every node).
+ * @param ts_ms Wall clock time of the reading, in msec.
+ * @retval None.
+ */
+static void add_reading(struct publisher *pub, struct publisher_topic **topics,
+        uint64_t reading, int64_t ts_ms) {
+    char line[PUBLISHER_MAX_LINE_LEN];
+
+    for (uint8_t tank = 1; tank <= MQTT_BENCH_TANKS; tank++) {
+        int len = snprintf(line, sizeof(line), "%lld,%u,%.1f,%u,%u\n", (long long)ts_ms,
+                tank, 20.0 + ((reading * 7 + tank * 13) % 400) / 10.0,
+                (unsigned int)((reading / 60) % 3), 0);
+        publisher_add(pub, topics[PUBLISHER_CLASS_READINGS], line, len, ts_ms);
+    }
+
+    if ((reading % MQTT_BENCH_EVENT_ONE_IN) == 0) {
+        int len = snprintf(line, sizeof(line), "%lld,%x\n", (long long)ts_ms, 0x1);
+        publisher_add(pub, topics[PUBLISHER_CLASS_EVENTS], line, len, ts_ms);
+    }
+}
+
+/**
+ * @brief Drained function.
+ * @param pub Pointer to the publisher.
+ * @retval true if every line added has been delivered, false otherwise.
+ */
+static bool drained(const struct publisher *pub) {
+    for (uint32_t i = 0; i < pub->num_topics; i++) {
+        if (pub->topics[i]->batch_len > 0) {
+            return false;
+        }
+    }
+
+    return (pub->acked.seq == pub->tail_seq) && (pub->acked.offset == pub->tail_size);
+}
+
+int main(int argc, char **argv) {
+    struct publisher_cfg cfg = {
+        .client_id = "mqtt_bench",
+        .prefix = PUBLISHER_DEFAULT_PREFIX,
+        .spool_dir = MQTT_BENCH_DEFAULT_SPOOL,
+        .batch_ms = PUBLISHER_DEFAULT_BATCH_MS,
+        .batch_bytes = PUBLISHER_DEFAULT_BATCH_BYTES,
+        .spool_max_bytes = PUBLISHER_DEFAULT_SPOOL_MAX_MB * 1024ULL * 1024,
+        .qos = PUBLISHER_DEFAULT_QOS,
+    };
+    uint32_t num_nodes = MQTT_BENCH_DEFAULT_NODES;
+    double rate = MQTT_BENCH_DEFAULT_RATE;
+    uint64_t run_us = MQTT_BENCH_DEFAULT_SEC * 1000000ULL;
+    uint64_t report_us = MQTT_BENCH_DEFAULT_REPORT_SEC * 1000000ULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:r:t:B:Z:P:S:s:")) != -1) {
+        switch (opt) {
+            case 'n':
+                num_nodes = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                rate = strtod(optarg, NULL);
+                break;
+            case 't':
+                run_us = strtoull(optarg, NULL, 0) * 1000000;
+                break;
+            case 'B':
+                cfg.batch_ms = strtoul(optarg, NULL, 0);
+                break;
+            case 'Z':
+                cfg.batch_bytes = strtoul(optarg, NULL, 0);
+                break;
+            case 'P':
+                if (!publisher_parse_qos(&cfg, optarg)) {
+                    fprintf(stderr, "%s: invalid QoS %s\n", argv[0], optarg);
+                    return 2;
+                }
+                break;
+            case 'S':
+                cfg.spool_dir = optarg;
+                break;
+            case 's':
+                report_us = strtoull(optarg, NULL, 0) * 1000000;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-n nodes] [-r readings per sec per node] "
+                        "[-t time (s)] [-B batch time (ms)] [-Z batch size (bytes)] "
+                        "[-P qos] [-S spool dir] [-s report interval (s)] "
+                        "<broker host:port>\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if ((optind != (argc - 1)) || (num_nodes == 0) || (rate <= 0.0) || (report_us == 0)
+            || (cfg.batch_bytes < PUBLISHER_MAX_LINE_LEN)) {
+        fprintf(stderr, "%s: a broker, nodes, a rate, a report interval and a batch size of "
+                "at least %d bytes are required\n", argv[0], PUBLISHER_MAX_LINE_LEN);
+        return 2;
+    }
+    cfg.broker = argv[optind];
+
+    int epoll_fd = epoll_create1(0);
+    struct publisher *pub = malloc(sizeof(struct publisher));
+    struct publisher_topic **topics = calloc(num_nodes * PUBLISHER_NUM_CLASSES,
+            sizeof(struct publisher_topic *));
+    if ((epoll_fd < 0) || (pub == NULL) || (topics == NULL)) {
+        perror("mqtt_bench");
+        return 1;
+    }
+
+    if (!publisher_open(pub, &cfg, epoll_fd, MQTT_BENCH_EPOLL_ID)) {
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < num_nodes; i++) {
+        char node[32];
+        snprintf(node, sizeof(node), "node%u", i);
+        for (uint8_t j = 0; j < PUBLISHER_NUM_CLASSES; j++) {
+            topics[(i * PUBLISHER_NUM_CLASSES) + j] = publisher_topic(pub, node, j);
+            if (topics[(i * PUBLISHER_NUM_CLASSES) + j] == NULL) {
+                perror("publisher_topic");
+                return 1;
+            }
+        }
+    }
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Readings are generated at the total rate, round robin across nodes
+    uint64_t start = now_us();
+    uint64_t end = start + run_us;
+    uint64_t drain_end = end + (MQTT_BENCH_DRAIN_SEC * 1000000ULL);
+    uint64_t next_report_us = start + report_us;
+    uint64_t readings = 0;
+    double start_cpu = cpu_sec();
+
+    while (!stop) {
+        uint64_t now = now_us();
+
+        if (now < end) {
+            uint64_t due = (uint64_t)(((now - start) / 1e6) * rate * num_nodes);
+            int64_t ts_ms = wall_ms();
+            for (; readings < due; readings++) {
+                add_reading(pub, &topics[(readings % num_nodes) * PUBLISHER_NUM_CLASSES],
+                        readings / num_nodes, ts_ms);
+            }
+        }
+
+        publisher_poll(pub, now);
+        if ((now >= end) && (drained(pub) || (now >= drain_end))) {
+            break;
+        }
+
+        if (now >= next_report_us) {
+            publisher_report(pub, stderr);
+            next_report_us += report_us;
+        }
+
+        uint64_t wake_us = publisher_next_wake_us(pub);
+        wake_us = ((now < end) && ((now + MQTT_BENCH_TICK_US) < wake_us))
+                ? (now + MQTT_BENCH_TICK_US) : wake_us;
+        wake_us = (next_report_us < wake_us) ? next_report_us : wake_us;
+
+        int timeout_ms = (wake_us > now) ? (int)(((wake_us - now) + 999) / 1000) : 0;
+        struct epoll_event events[8];
+        int num_events = epoll_wait(epoll_fd, events, 8, timeout_ms);
+        for (int i = 0; i < num_events; i++) {
+            publisher_handle(pub, events[i].events);
+        }
+    }
+
+    double elapsed = (now_us() - start) / 1e6;
+    double cpu = cpu_sec() - start_cpu;
+
+    publisher_report(pub, stdout);
+    printf("nodes=%u readings=%llu lines=%llu run_s=%.1f elapsed_s=%.1f drained=%d "
+            "lines_per_s=%.0f cpu_s=%.2f cpu_ns_per_line=%.0f\n", num_nodes,
+            (unsigned long long)readings, (unsigned long long)pub->stats.lines,
+            run_us / 1e6, elapsed, drained(pub), pub->stats.acked_lines / elapsed, cpu,
+            (pub->stats.lines == 0) ? 0.0 : (cpu * 1e9) / pub->stats.lines);
+
+    publisher_close(pub);
+    free(pub);
+    free(topics);
+    close(epoll_fd);
+    return 0;
+}
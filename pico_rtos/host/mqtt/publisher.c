@@ -0,0 +1,1089 @@
+ /**
+ **************************************************************
+ * @file publisher.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Batched MQTT publisher file. This file handles functionality
+ *        specific to publishing the gateway's readings and events over one
+ *        persistent MQTT connection, driven from the gateway's event loop
+ *        (non-blocking). Lines added to a topic are coalesced into a batch,
+ *        which is queued once it is old enough or large enough. Queued
+ *        batches are appended to a spool on disk and published from it in
+ *        order, so batches survive the broker being unreachable (and the
+ *        gateway restarting). The spool position is only advanced past a
+ *        batch once it has been sent (QoS 0) or acknowledged (QoS 1), and
+ *        unacknowledged batches are published again after a reconnect.
+ ***************************************************************
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <netdb.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "mqtt.h"
+#include "publisher.h"
+
+// Name of each topic class.
+static const char *const publisher_class_names[PUBLISHER_NUM_CLASSES] = PUBLISHER_CLASS_NAMES;
+
+// CRC-32 (IEEE 802.3) lookup table, generated on first use.
+static uint32_t publisher_crc_table[256];
+static bool publisher_crc_table_ready = false;
+
+// Struct holding the spool position saved to disk.
+struct publisher_saved_pos {
+    struct publisher_spool_pos pos;
+    uint32_t crc;
+};
+
+/**
+ * @brief CRC-32 update function.
+ * @param crc CRC of the preceding bytes (0xFFFFFFFF initially, and the
+ *        final CRC is inverted).
+ * @param data Bytes being added.
+ * @param len Number of bytes.
+ * @retval CRC including the bytes.
+ */
+static uint32_t publisher_crc_update(uint32_t crc, const void *data, size_t len) {
+    const uint8_t *bytes = data;
+
+    if (!publisher_crc_table_ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t value = i;
+            for (uint8_t bit = 0; bit < 8; bit++) {
+                value = (value & 1) ? ((value >> 1) ^ 0xEDB88320) : (value >> 1);
+            }
+            publisher_crc_table[i] = value;
+        }
+        publisher_crc_table_ready = true;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        crc = publisher_crc_table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+/**
+ * @brief Spool record CRC function.
+ * @param record Pointer to the record header.
+ * @param topic Topic name.
+ * @param payload Payload.
+ * @retval CRC of the record.
+ */
+static uint32_t publisher_record_crc(const struct publisher_spool_record *record,
+        const void *topic, const void *payload) {
+    size_t start = offsetof(struct publisher_spool_record, payload_len);
+    uint32_t crc = publisher_crc_update(0xFFFFFFFF, (const uint8_t *)record + start,
+            sizeof(struct publisher_spool_record) - start);
+    crc = publisher_crc_update(crc, topic, record->topic_len);
+    crc = publisher_crc_update(crc, payload, record->payload_len);
+    return crc ^ 0xFFFFFFFF;
+}
+
+/**
+ * @brief Monotonic time function.
+ * @param None.
+ * @retval Monotonic time, in usec.
+ */
+static uint64_t publisher_now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
+/**
+ * @brief Wall clock time function.
+ * @param None.
+ * @retval Time since the epoch, in msec.
+ */
+static int64_t publisher_wall_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return ((int64_t)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+/**
+ * @brief QoS parse function. This function sets the QoS level of topic
+ *        classes from a specification such as "readings=0,events=1".
+ * @param cfg Pointer to the publisher configuration.
+ * @param spec QoS specification.
+ * @retval true if the specification is valid, false otherwise.
+ */
+bool publisher_parse_qos(struct publisher_cfg *cfg, const char *spec) {
+    while (*spec != '\0') {
+        const char *equals = strchr(spec, '=');
+        if (equals == NULL) {
+            return false;
+        }
+
+        uint8_t i;
+        for (i = 0; i < PUBLISHER_NUM_CLASSES; i++) {
+            size_t len = strlen(publisher_class_names[i]);
+            if (((size_t)(equals - spec) == len)
+                    && (strncmp(spec, publisher_class_names[i], len) == 0)) {
+                break;
+            }
+        }
+
+        if ((i == PUBLISHER_NUM_CLASSES) || ((equals[1] != '0') && (equals[1] != '1'))
+                || ((equals[2] != ',') && (equals[2] != '\0'))) {
+            return false;
+        }
+
+        cfg->qos[i] = equals[1] - '0';
+        spec = (equals[2] == ',') ? &equals[3] : &equals[2];
+    }
+
+    return true;
+}
+
+/**
+ * @brief Spool segment path function.
+ * @param pub Pointer to the publisher.
+ * @param seq Segment number.
+ * @param path Buffer written to (PATH_MAX chars).
+ * @retval None.
+ */
+static void publisher_segment_path(const struct publisher *pub, uint32_t seq, char *path) {
+    snprintf(path, PATH_MAX, "%s/spool-%08u.dat", pub->cfg.spool_dir, seq);
+}
+
+/**
+ * @brief Spool segment size function.
+ * @param pub Pointer to the publisher.
+ * @param seq Segment number.
+ * @retval Size of the segment, in bytes.
+ */
+static uint32_t publisher_segment_size(const struct publisher *pub, uint32_t seq) {
+    if (seq == pub->tail_seq) {
+        return pub->tail_size;
+    }
+
+    char path[PATH_MAX];
+    struct stat st;
+    publisher_segment_path(pub, seq, path);
+    return (stat(path, &st) == 0) ? st.st_size : 0;
+}
+
+/**
+ * @brief Spool read function. This function reads the batch at a spool
+ *        position (header into record, topic and payload into the record
+ *        buffer), and checks it.
+ * @param pub Pointer to the publisher.
+ * @param pos Spool position.
+ * @param record Pointer to the record header read.
+ * @retval true if a valid batch was read, false otherwise.
+ */
+static bool publisher_spool_read(struct publisher *pub, struct publisher_spool_pos pos,
+        struct publisher_spool_record *record) {
+    if ((pub->read_fd < 0) || (pub->read_seq != pos.seq)) {
+        char path[PATH_MAX];
+        if (pub->read_fd >= 0) {
+            close(pub->read_fd);
+        }
+        publisher_segment_path(pub, pos.seq, path);
+        pub->read_fd = open(path, O_RDONLY);
+        pub->read_seq = pos.seq;
+        if (pub->read_fd < 0) {
+            return false;
+        }
+    }
+
+    if ((pread(pub->read_fd, record, sizeof(*record), pos.offset) != sizeof(*record))
+            || (record->magic != PUBLISHER_SPOOL_MAGIC)
+            || (record->topic_len >= PUBLISHER_TOPIC_LEN)
+            || (record->payload_len > PUBLISHER_MAX_BATCH_BYTES)) {
+        return false;
+    }
+
+    ssize_t len = record->topic_len + record->payload_len;
+    if ((pread(pub->read_fd, pub->record, len, pos.offset + sizeof(*record)) != len)
+            || (publisher_record_crc(record, pub->record, &pub->record[record->topic_len])
+            != record->crc)) {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Spool position save function. This function records the position
+ *        of the first undelivered batch, so delivery resumes from it after a
+ *        restart.
+ * @param pub Pointer to the publisher.
+ * @retval None.
+ */
+static void publisher_save_pos(struct publisher *pub) {
+    struct publisher_saved_pos saved = {.pos = pub->acked};
+    saved.crc = publisher_crc_update(0xFFFFFFFF, &saved.pos, sizeof(saved.pos)) ^ 0xFFFFFFFF;
+
+    if (pwrite(pub->pos_fd, &saved, sizeof(saved), 0) != sizeof(saved)) {
+        perror("publisher: spool position");
+    }
+}
+
+/**
+ * @brief Spool open function. This function finds the spool's segments,
+ *        resumes from the saved position, and truncates a partly written
+ *        batch at the end of the spool (e.g. from a crash).
+ * @param pub Pointer to the publisher.
+ * @retval true if the spool was opened, false otherwise.
+ */
+static bool publisher_spool_open(struct publisher *pub) {
+    char path[PATH_MAX];
+
+    if ((mkdir(pub->cfg.spool_dir, 0755) != 0) && (errno != EEXIST)) {
+        perror(pub->cfg.spool_dir);
+        return false;
+    }
+
+    DIR *dir = opendir(pub->cfg.spool_dir);
+    if (dir == NULL) {
+        perror(pub->cfg.spool_dir);
+        return false;
+    }
+
+    bool found = false;
+    struct dirent *entry;
+    pub->oldest_seq = 0;
+    pub->tail_seq = 0;
+    while ((entry = readdir(dir)) != NULL) {
+        unsigned int seq;
+        if (sscanf(entry->d_name, "spool-%8u.dat", &seq) == 1) {
+            pub->oldest_seq = (!found || (seq < pub->oldest_seq)) ? seq : pub->oldest_seq;
+            pub->tail_seq = (!found || (seq > pub->tail_seq)) ? seq : pub->tail_seq;
+            found = true;
+        }
+    }
+    closedir(dir);
+
+    snprintf(path, PATH_MAX, "%s/spool.pos", pub->cfg.spool_dir);
+    pub->pos_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (pub->pos_fd < 0) {
+        perror(path);
+        return false;
+    }
+
+    struct publisher_saved_pos saved;
+    bool saved_valid = (pread(pub->pos_fd, &saved, sizeof(saved), 0) == sizeof(saved))
+            && (saved.crc == (publisher_crc_update(0xFFFFFFFF, &saved.pos,
+            sizeof(saved.pos)) ^ 0xFFFFFFFF)) && (saved.pos.seq >= pub->oldest_seq)
+            && (saved.pos.seq <= pub->tail_seq);
+    pub->acked = saved_valid ? saved.pos
+            : (struct publisher_spool_pos){.seq = pub->oldest_seq, .offset = 0};
+
+    publisher_segment_path(pub, pub->tail_seq, path);
+    pub->tail_fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (pub->tail_fd < 0) {
+        perror(path);
+        return false;
+    }
+
+    struct stat st;
+    fstat(pub->tail_fd, &st);
+    pub->tail_size = st.st_size;
+
+    // Batches in the tail segment which are yet to be delivered are checked,
+    // and anything from the first invalid one is dropped.
+    struct publisher_spool_pos pos = {.seq = pub->tail_seq,
+            .offset = (pub->acked.seq == pub->tail_seq) ? pub->acked.offset : 0};
+    struct publisher_spool_record record;
+    pos.offset = (pos.offset > pub->tail_size) ? 0 : pos.offset;
+    while ((pos.offset < pub->tail_size) && publisher_spool_read(pub, pos, &record)) {
+        pos.offset += sizeof(record) + record.topic_len + record.payload_len;
+    }
+
+    if (pos.offset < pub->tail_size) {
+        fprintf(stderr, "publisher: %s: dropped %u invalid bytes\n", path,
+                pub->tail_size - pos.offset);
+        if (ftruncate(pub->tail_fd, pos.offset) != 0) {
+            perror(path);
+        }
+        pub->tail_size = pos.offset;
+    }
+
+    if ((pub->acked.seq == pub->tail_seq) && (pub->acked.offset > pub->tail_size)) {
+        pub->acked.offset = pub->tail_size;
+    }
+
+    pub->spool_bytes = 0;
+    for (uint32_t seq = pub->oldest_seq; seq <= pub->tail_seq; seq++) {
+        pub->spool_bytes += publisher_segment_size(pub, seq);
+    }
+
+    pub->send = pub->acked;
+    pub->resend_end = pub->acked;
+    return true;
+}
+
+/**
+ * @brief Broker address resolve function.
+ * @param pub Pointer to the publisher.
+ * @retval true if the broker's "host:port" was resolved, false otherwise.
+ */
+static bool publisher_resolve(struct publisher *pub) {
+    char host[256];
+    const char *colon = strrchr(pub->cfg.broker, ':');
+    if ((colon == NULL) || ((size_t)(colon - pub->cfg.broker) >= sizeof(host))) {
+        fprintf(stderr, "publisher: broker must be host:port\n");
+        return false;
+    }
+
+    memcpy(host, pub->cfg.broker, colon - pub->cfg.broker);
+    host[colon - pub->cfg.broker] = '\0';
+
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *result;
+    int err = getaddrinfo(host, colon + 1, &hints, &result);
+    if (err != 0) {
+        fprintf(stderr, "publisher: %s: %s\n", pub->cfg.broker, gai_strerror(err));
+        return false;
+    }
+
+    memcpy(&pub->addr, result->ai_addr, result->ai_addrlen);
+    pub->addr_len = result->ai_addrlen;
+    freeaddrinfo(result);
+    return true;
+}
+
+/**
+ * @brief Publisher open function. This function opens the spool and
+ *        resolves the broker's address. The publisher connects on its
+ *        first poll.
+ * @param pub Pointer to the publisher.
+ * @param cfg Pointer to the publisher configuration.
+ * @param epoll_fd epoll file descriptor.
+ * @param epoll_id Epoll ID of the publisher's connection.
+ * @retval true if the publisher was opened, false otherwise.
+ */
+bool publisher_open(struct publisher *pub, const struct publisher_cfg *cfg, int epoll_fd,
+        uint32_t epoll_id) {
+    memset(pub, 0, sizeof(struct publisher));
+    pub->cfg = *cfg;
+    if (pub->cfg.batch_bytes > PUBLISHER_MAX_BATCH_BYTES) {
+        pub->cfg.batch_bytes = PUBLISHER_MAX_BATCH_BYTES;
+    }
+
+    pub->epoll_fd = epoll_fd;
+    pub->epoll_id = epoll_id;
+    pub->fd = -1;
+    pub->read_fd = -1;
+    pub->state = PUBLISHER_DISCONNECTED;
+    pub->reconnect_delay_ms = PUBLISHER_RECONNECT_MIN_MS;
+    pub->reconnect_us = publisher_now_us();
+    pub->next_packet_id = 1;
+
+    pub->tx = malloc(PUBLISHER_TX_LEN);
+    pub->record = malloc(PUBLISHER_TOPIC_LEN + PUBLISHER_MAX_BATCH_BYTES);
+    if ((pub->tx == NULL) || (pub->record == NULL)) {
+        perror("publisher");
+        return false;
+    }
+
+    return publisher_resolve(pub) && publisher_spool_open(pub);
+}
+
+/**
+ * @brief Topic function. This function returns the topic of a class for a
+ *        node ("<prefix>/<node>/<class>", with characters of the node's name
+ *        which can't be used in a topic level replaced), creating it on
+ *        first use.
+ * @param pub Pointer to the publisher.
+ * @param node Name of the node.
+ * @param topic_class Topic class (PUBLISHER_CLASS_*).
+ * @retval Pointer to the topic, or NULL if it couldn't be created.
+ */
+struct publisher_topic *publisher_topic(struct publisher *pub, const char *node,
+        uint8_t topic_class) {
+    char name[PUBLISHER_TOPIC_LEN];
+    int len = snprintf(name, sizeof(name), "%s/", pub->cfg.prefix);
+
+    while (*node == '/') {
+        node++;
+    }
+    for (; (*node != '\0') && (len < (PUBLISHER_TOPIC_LEN - 24)); node++) {
+        char c = *node;
+        name[len++] = ((c == '/') || (c == '+') || (c == '#')) ? '_' : c;
+    }
+    snprintf(&name[len], sizeof(name) - len, "/%s", publisher_class_names[topic_class]);
+
+    for (uint32_t i = 0; i < pub->num_topics; i++) {
+        if (strcmp(pub->topics[i]->name, name) == 0) {
+            return pub->topics[i];
+        }
+    }
+
+    struct publisher_topic **topics = realloc(pub->topics,
+            (pub->num_topics + 1) * sizeof(struct publisher_topic *));
+    struct publisher_topic *topic = calloc(1, sizeof(struct publisher_topic));
+    if (topics != NULL) {
+        pub->topics = topics;
+    }
+    if ((topics == NULL) || (topic == NULL)) {
+        free(topic);
+        return NULL;
+    }
+
+    topic->batch = malloc(pub->cfg.batch_bytes + PUBLISHER_MAX_LINE_LEN);
+    if (topic->batch == NULL) {
+        free(topic);
+        return NULL;
+    }
+
+    memcpy(topic->name, name, sizeof(name));
+    topic->name_len = strlen(name);
+    topic->qos = pub->cfg.qos[topic_class];
+    pub->topics[pub->num_topics++] = topic;
+    return topic;
+}
+
+/**
+ * @brief Batch queue function. This function appends a topic's batch to the
+ *        spool, starting a new spool segment once the current one is full.
+ * @param pub Pointer to the publisher.
+ * @param topic Pointer to the topic.
+ * @retval None.
+ */
+static void publisher_queue_batch(struct publisher *pub, struct publisher_topic *topic) {
+    if (topic->batch_len == 0) {
+        return;
+    }
+
+    struct publisher_spool_record record = {
+        .magic = PUBLISHER_SPOOL_MAGIC,
+        .payload_len = topic->batch_len,
+        .topic_len = topic->name_len,
+        .qos = topic->qos,
+        .lines = topic->batch_lines,
+        .first_ms = topic->batch_first_ms,
+    };
+    record.crc = publisher_record_crc(&record, topic->name, topic->batch);
+
+    struct iovec iov[3] = {
+        {.iov_base = &record, .iov_len = sizeof(record)},
+        {.iov_base = topic->name, .iov_len = topic->name_len},
+        {.iov_base = topic->batch, .iov_len = topic->batch_len},
+    };
+    ssize_t len = sizeof(record) + topic->name_len + topic->batch_len;
+
+    if (writev(pub->tail_fd, iov, 3) != len) {
+        // A partly written batch would corrupt the ones after it
+        perror("publisher: spool");
+        if (ftruncate(pub->tail_fd, pub->tail_size) != 0) {
+            perror("publisher: spool");
+        }
+    } else {
+        pub->tail_size += len;
+        pub->spool_bytes += len;
+        pub->stats.batches++;
+    }
+
+    topic->batch_len = 0;
+    topic->batch_lines = 0;
+
+    if (pub->tail_size >= PUBLISHER_SPOOL_SEGMENT_BYTES) {
+        char path[PATH_MAX];
+        publisher_segment_path(pub, pub->tail_seq + 1, path);
+        int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        if (fd < 0) {
+            perror(path);
+            return;
+        }
+
+        close(pub->tail_fd);
+        pub->tail_fd = fd;
+        pub->tail_seq++;
+        pub->tail_size = 0;
+    }
+}
+
+/**
+ * @brief Line add function. This function adds a line to a topic's batch,
+ *        queueing the batch once it reaches the batch size.
+ * @param pub Pointer to the publisher.
+ * @param topic Pointer to the topic.
+ * @param line Line (including its newline).
+ * @param len Length of the line (at most PUBLISHER_MAX_LINE_LEN).
+ * @param ts_ms Wall clock time of the line's reading, in msec.
+ * @retval None.
+ */
+void publisher_add(struct publisher *pub, struct publisher_topic *topic, const char *line,
+        size_t len, int64_t ts_ms) {
+    if (len > PUBLISHER_MAX_LINE_LEN) {
+        return;
+    }
+
+    if (topic->batch_len == 0) {
+        topic->batch_first_ms = ts_ms;
+        topic->batch_start_us = publisher_now_us();
+    }
+
+    memcpy(&topic->batch[topic->batch_len], line, len);
+    topic->batch_len += len;
+    topic->batch_lines++;
+    pub->stats.lines++;
+
+    if (topic->batch_len >= pub->cfg.batch_bytes) {
+        publisher_queue_batch(pub, topic);
+    }
+}
+
+/**
+ * @brief Epoll update function. This function waits for the connection to
+ *        be writable only while there is output waiting to be sent.
+ * @param pub Pointer to the publisher.
+ * @param waiting Output waiting to be sent.
+ * @retval None.
+ */
+static void publisher_wait_writable(struct publisher *pub, bool waiting) {
+    if (waiting != pub->tx_waiting) {
+        struct epoll_event event = {.events = EPOLLIN | (waiting ? EPOLLOUT : 0),
+                .data.u32 = pub->epoll_id};
+        epoll_ctl(pub->epoll_fd, EPOLL_CTL_MOD, pub->fd, &event);
+        pub->tx_waiting = waiting;
+    }
+}
+
+/**
+ * @brief Disconnect function. This function closes the connection, and
+ *        schedules a reconnect (backing off exponentially). Batches which
+ *        weren't acknowledged will be published again.
+ * @param pub Pointer to the publisher.
+ * @param reason Reason for disconnecting.
+ * @param now Current time, in usec.
+ * @retval None.
+ */
+static void publisher_disconnect(struct publisher *pub, const char *reason, uint64_t now) {
+    if (pub->fd >= 0) {
+        epoll_ctl(pub->epoll_fd, EPOLL_CTL_DEL, pub->fd, NULL);
+        close(pub->fd);
+        pub->fd = -1;
+    }
+
+    if (pub->state == PUBLISHER_CONNECTED) {
+        pub->stats.disconnects++;
+    }
+    fprintf(stderr, "publisher: %s: %s\n", pub->cfg.broker, reason);
+
+    pub->state = PUBLISHER_DISCONNECTED;
+    pub->reconnect_us = now + (pub->reconnect_delay_ms * 1000ULL);
+    pub->reconnect_delay_ms = ((pub->reconnect_delay_ms * 2) < PUBLISHER_RECONNECT_MAX_MS)
+            ? (pub->reconnect_delay_ms * 2) : PUBLISHER_RECONNECT_MAX_MS;
+
+    if ((pub->send.seq > pub->resend_end.seq) || ((pub->send.seq == pub->resend_end.seq)
+            && (pub->send.offset > pub->resend_end.offset))) {
+        pub->resend_end = pub->send;
+    }
+    pub->send = pub->acked;
+    pub->inflight_count = 0;
+    pub->tx_len = 0;
+    pub->tx_pos = 0;
+    pub->rx_len = 0;
+    pub->tx_waiting = false;
+    pub->ping_pending = false;
+}
+
+/**
+ * @brief Connect function. This function starts a non-blocking connection
+ *        to the broker.
+ * @param pub Pointer to the publisher.
+ * @param now Current time, in usec.
+ * @retval None.
+ */
+static void publisher_connect(struct publisher *pub, uint64_t now) {
+    pub->fd = socket(pub->addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (pub->fd < 0) {
+        publisher_disconnect(pub, strerror(errno), now);
+        return;
+    }
+
+    int one = 1;
+    setsockopt(pub->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct epoll_event event = {.events = EPOLLIN | EPOLLOUT, .data.u32 = pub->epoll_id};
+    if (((connect(pub->fd, (struct sockaddr *)&pub->addr, pub->addr_len) != 0)
+            && (errno != EINPROGRESS))
+            || (epoll_ctl(pub->epoll_fd, EPOLL_CTL_ADD, pub->fd, &event) != 0)) {
+        publisher_disconnect(pub, strerror(errno), now);
+        return;
+    }
+
+    pub->state = PUBLISHER_CONNECTING;
+    pub->tx_waiting = true;
+    pub->deadline_us = now + (PUBLISHER_CONNECT_TIMEOUT_MS * 1000ULL);
+}
+
+/**
+ * @brief Send function. This function writes as much waiting output as the
+ *        connection accepts.
+ * @param pub Pointer to the publisher.
+ * @param now Current time, in usec.
+ * @retval None.
+ */
+static void publisher_flush(struct publisher *pub, uint64_t now) {
+    while (pub->tx_pos < pub->tx_len) {
+        ssize_t len = send(pub->fd, &pub->tx[pub->tx_pos], pub->tx_len - pub->tx_pos,
+                MSG_NOSIGNAL);
+        if (len < 0) {
+            if (errno == EAGAIN) {
+                break;
+            }
+
+            publisher_disconnect(pub, strerror(errno), now);
+            return;
+        }
+
+        pub->tx_pos += len;
+        pub->last_tx_us = now;
+    }
+
+    if (pub->tx_pos == pub->tx_len) {
+        pub->tx_pos = 0;
+        pub->tx_len = 0;
+    }
+
+    publisher_wait_writable(pub, pub->tx_len > 0);
+}
+
+/**
+ * @brief Delivery function. This function advances the spool position past
+ *        the delivered batches at the head of the in-flight window, and
+ *        deletes spool segments which have been completely delivered.
+ * @param pub Pointer to the publisher.
+ * @retval None.
+ */
+static void publisher_advance(struct publisher *pub) {
+    bool advanced = false;
+    int64_t now_ms = publisher_wall_ms();
+
+    while ((pub->inflight_count > 0) && pub->inflight[pub->inflight_head].acked) {
+        struct publisher_inflight *entry = &pub->inflight[pub->inflight_head];
+        pub->acked = entry->end;
+
+        // Corrupt spool records are skipped with an entry of no lines
+        if (entry->lines > 0) {
+            int64_t latency_ms = now_ms - entry->first_ms;
+            uint32_t bucket = (latency_ms < 0) ? 0 : (latency_ms / PUBLISHER_LATENCY_BUCKET_MS);
+            pub->stats.latency_hist[(bucket < PUBLISHER_LATENCY_BUCKETS) ? bucket
+                    : (PUBLISHER_LATENCY_BUCKETS - 1)]++;
+            pub->stats.acked++;
+            pub->stats.acked_lines += entry->lines;
+        }
+
+        pub->inflight_head = (pub->inflight_head + 1) % PUBLISHER_MAX_INFLIGHT;
+        pub->inflight_count--;
+        advanced = true;
+    }
+
+    if (!advanced) {
+        return;
+    }
+
+    publisher_save_pos(pub);
+
+    while (pub->oldest_seq < pub->acked.seq) {
+        char path[PATH_MAX];
+        pub->spool_bytes -= publisher_segment_size(pub, pub->oldest_seq);
+        publisher_segment_path(pub, pub->oldest_seq, path);
+        unlink(path);
+        pub->oldest_seq++;
+    }
+}
+
+/**
+ * @brief In-flight add function.
+ * @param pub Pointer to the publisher.
+ * @param packet_id Packet identifier (0 for QoS 0).
+ * @param end Spool position after the batch.
+ * @param record Pointer to the batch's header (NULL for a skipped record).
+ * @retval None.
+ */
+static void publisher_add_inflight(struct publisher *pub, uint16_t packet_id,
+        struct publisher_spool_pos end, const struct publisher_spool_record *record) {
+    struct publisher_inflight *entry = &pub->inflight[(pub->inflight_head
+            + pub->inflight_count) % PUBLISHER_MAX_INFLIGHT];
+
+    entry->packet_id = packet_id;
+    entry->acked = (packet_id == 0);
+    entry->end = end;
+    entry->first_ms = (record != NULL) ? record->first_ms : 0;
+    entry->lines = (record != NULL) ? record->lines : 0;
+    pub->inflight_count++;
+}
+
+/**
+ * @brief Publish function. This function publishes queued batches from the
+ *        spool, while the in-flight window and send buffer have room.
+ * @param pub Pointer to the publisher.
+ * @param now Current time, in usec.
+ * @retval None.
+ */
+static void publisher_pump(struct publisher *pub, uint64_t now) {
+    while (pub->state == PUBLISHER_CONNECTED) {
+        // QoS 0 batches (and acknowledged ones) leave the window at once
+        if (pub->inflight_count == PUBLISHER_MAX_INFLIGHT) {
+            publisher_advance(pub);
+        }
+        if ((pub->tx_len - pub->tx_pos) > PUBLISHER_TX_LOW_WATER) {
+            publisher_flush(pub, now);
+        }
+        if ((pub->state != PUBLISHER_CONNECTED)
+                || (pub->inflight_count == PUBLISHER_MAX_INFLIGHT)
+                || ((pub->tx_len - pub->tx_pos) > PUBLISHER_TX_LOW_WATER)) {
+            break;
+        }
+
+        if ((pub->send.seq < pub->tail_seq)
+                && (pub->send.offset >= publisher_segment_size(pub, pub->send.seq))) {
+            pub->send.seq++;
+            pub->send.offset = 0;
+            continue;
+        } else if ((pub->send.seq == pub->tail_seq) && (pub->send.offset >= pub->tail_size)) {
+            break;
+        }
+
+        struct publisher_spool_record record;
+        if (!publisher_spool_read(pub, pub->send, &record)) {
+            // The rest of the segment can't be trusted, so it is skipped
+            pub->stats.corrupt++;
+            pub->send.offset = publisher_segment_size(pub, pub->send.seq);
+            publisher_add_inflight(pub, 0, pub->send, NULL);
+            continue;
+        }
+
+        if ((pub->tx_pos > 0) && ((pub->tx_len + MQTT_MAX_FIXED_HEADER_LEN + 4
+                + record.topic_len + record.payload_len) > PUBLISHER_TX_LEN)) {
+            memmove(pub->tx, &pub->tx[pub->tx_pos], pub->tx_len - pub->tx_pos);
+            pub->tx_len -= pub->tx_pos;
+            pub->tx_pos = 0;
+        }
+
+        uint16_t packet_id = 0;
+        if (record.qos > 0) {
+            packet_id = pub->next_packet_id++;
+            pub->next_packet_id += (pub->next_packet_id == 0) ? 1 : 0;
+        }
+
+        pub->tx_len += mqtt_publish_header(&pub->tx[pub->tx_len], (const char *)pub->record,
+                record.topic_len, record.qos, packet_id, record.payload_len);
+        memcpy(&pub->tx[pub->tx_len], &pub->record[record.topic_len], record.payload_len);
+        pub->tx_len += record.payload_len;
+
+        bool resend = (pub->send.seq < pub->resend_end.seq) || ((pub->send.seq
+                == pub->resend_end.seq) && (pub->send.offset < pub->resend_end.offset));
+        pub->stats.resent += resend ? 1 : 0;
+        pub->stats.published++;
+        pub->stats.bytes += record.payload_len;
+
+        pub->send.offset += sizeof(record) + record.topic_len + record.payload_len;
+        publisher_add_inflight(pub, packet_id, pub->send, &record);
+    }
+
+    if (pub->state == PUBLISHER_CONNECTED) {
+        publisher_flush(pub, now);
+        publisher_advance(pub);
+    }
+}
+
+/**
+ * @brief Packet handler. This function handles a packet from the broker.
+ * @param pub Pointer to the publisher.
+ * @param packet Pointer to the packet.
+ * @param now Current time, in usec.
+ * @retval None.
+ */
+static void publisher_handle_packet(struct publisher *pub, const struct mqtt_packet *packet,
+        uint64_t now) {
+    if (packet->type == MQTT_CONNACK) {
+        if ((pub->state != PUBLISHER_CONNACK_WAIT) || (packet->body_len != 2)
+                || (packet->body[1] != 0)) {
+            publisher_disconnect(pub, "connection refused", now);
+            return;
+        }
+
+        pub->state = PUBLISHER_CONNECTED;
+        pub->reconnect_delay_ms = PUBLISHER_RECONNECT_MIN_MS;
+        pub->stats.connects++;
+        fprintf(stderr, "publisher: %s: connected\n", pub->cfg.broker);
+    } else if ((packet->type == MQTT_PUBACK) && (packet->body_len == 2)) {
+        uint16_t packet_id = (packet->body[0] << 8) | packet->body[1];
+
+        for (uint32_t i = 0; i < pub->inflight_count; i++) {
+            struct publisher_inflight *entry =
+                    &pub->inflight[(pub->inflight_head + i) % PUBLISHER_MAX_INFLIGHT];
+            if (!entry->acked && (entry->packet_id == packet_id)) {
+                entry->acked = true;
+                break;
+            }
+        }
+    } else if (packet->type == MQTT_PINGRESP) {
+        pub->ping_pending = false;
+    }
+}
+
+/**
+ * @brief Receive function. This function reads everything available from
+ *        the broker, and handles each complete packet.
+ * @param pub Pointer to the publisher.
+ * @param now Current time, in usec.
+ * @retval None.
+ */
+static void publisher_receive(struct publisher *pub, uint64_t now) {
+    while (pub->fd >= 0) {
+        ssize_t len = read(pub->fd, &pub->rx[pub->rx_len], PUBLISHER_RX_LEN - pub->rx_len);
+        if (len < 0) {
+            if (errno != EAGAIN) {
+                publisher_disconnect(pub, strerror(errno), now);
+            }
+            return;
+        } else if (len == 0) {
+            publisher_disconnect(pub, "connection closed", now);
+            return;
+        }
+
+        pub->rx_len += len;
+
+        struct mqtt_packet packet;
+        long packet_len;
+        while ((pub->fd >= 0) && ((packet_len = mqtt_parse(pub->rx, pub->rx_len, &packet)) > 0)) {
+            publisher_handle_packet(pub, &packet, now);
+            memmove(pub->rx, &pub->rx[packet_len], pub->rx_len - packet_len);
+            pub->rx_len -= packet_len;
+        }
+
+        // The broker only sends short packets, so a full buffer is an error
+        if ((pub->fd >= 0) && ((packet_len < 0) || (pub->rx_len == PUBLISHER_RX_LEN))) {
+            publisher_disconnect(pub, "invalid packet", now);
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Publisher event handler. This function handles epoll events on the
+ *        connection to the broker.
+ * @param pub Pointer to the publisher.
+ * @param events Epoll events.
+ * @retval None.
+ */
+void publisher_handle(struct publisher *pub, uint32_t events) {
+    uint64_t now = publisher_now_us();
+
+    if (pub->state == PUBLISHER_CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(pub->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0) {
+            publisher_disconnect(pub, strerror(err), now);
+            return;
+        } else if (!(events & EPOLLOUT)) {
+            return;
+        }
+
+        pub->tx_len = mqtt_connect(pub->tx, pub->cfg.client_id, PUBLISHER_KEEPALIVE_SEC);
+        pub->tx_pos = 0;
+        pub->state = PUBLISHER_CONNACK_WAIT;
+        pub->deadline_us = now + (PUBLISHER_CONNECT_TIMEOUT_MS * 1000ULL);
+        publisher_flush(pub, now);
+        return;
+    }
+
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+        publisher_receive(pub, now);
+    }
+
+    if (pub->fd >= 0) {
+        publisher_pump(pub, now);
+    }
+}
+
+/**
+ * @brief Publisher poll function. This function queues batches which have
+ *        reached their maximum age, and handles reconnecting, timeouts and
+ *        keep alive pings. While disconnected, the oldest spool segments are
+ *        dropped if the spool is over its size limit.
+ * @param pub Pointer to the publisher.
+ * @param now_us Current time, in usec.
+ * @retval None.
+ */
+void publisher_poll(struct publisher *pub, uint64_t now_us) {
+    for (uint32_t i = 0; i < pub->num_topics; i++) {
+        struct publisher_topic *topic = pub->topics[i];
+        if ((topic->batch_len > 0)
+                && (now_us >= (topic->batch_start_us + (pub->cfg.batch_ms * 1000ULL)))) {
+            publisher_queue_batch(pub, topic);
+        }
+    }
+
+    switch (pub->state) {
+        case PUBLISHER_DISCONNECTED:
+            while ((pub->spool_bytes > pub->cfg.spool_max_bytes)
+                    && (pub->oldest_seq < pub->tail_seq)) {
+                char path[PATH_MAX];
+                uint32_t size = publisher_segment_size(pub, pub->oldest_seq);
+                publisher_segment_path(pub, pub->oldest_seq, path);
+                unlink(path);
+                pub->spool_bytes -= size;
+                pub->stats.dropped_bytes += size;
+                pub->oldest_seq++;
+
+                if (pub->acked.seq < pub->oldest_seq) {
+                    pub->acked = (struct publisher_spool_pos){.seq = pub->oldest_seq};
+                    pub->send = pub->acked;
+                    publisher_save_pos(pub);
+                }
+            }
+
+            if (now_us >= pub->reconnect_us) {
+                publisher_connect(pub, now_us);
+            }
+            break;
+        case PUBLISHER_CONNECTING:
+        case PUBLISHER_CONNACK_WAIT:
+            if (now_us >= pub->deadline_us) {
+                publisher_disconnect(pub, "connect timeout", now_us);
+            }
+            break;
+        case PUBLISHER_CONNECTED:
+            if (pub->ping_pending && (now_us >= pub->deadline_us)) {
+                publisher_disconnect(pub, "keep alive timeout", now_us);
+                break;
+            } else if (!pub->ping_pending && ((now_us - pub->last_tx_us)
+                    >= (PUBLISHER_KEEPALIVE_SEC * 500000ULL))
+                    && ((pub->tx_len + MQTT_EMPTY_LEN) <= PUBLISHER_TX_LEN)) {
+                pub->tx_len += mqtt_empty(&pub->tx[pub->tx_len], MQTT_PINGREQ);
+                pub->ping_pending = true;
+                pub->deadline_us = now_us + (PUBLISHER_KEEPALIVE_SEC * 1000000ULL);
+            }
+
+            publisher_pump(pub, now_us);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Publisher wake function.
+ * @param pub Pointer to the publisher.
+ * @retval Time the publisher next needs to be polled, in usec.
+ */
+uint64_t publisher_next_wake_us(const struct publisher *pub) {
+    uint64_t wake_us = UINT64_MAX;
+
+    for (uint32_t i = 0; i < pub->num_topics; i++) {
+        const struct publisher_topic *topic = pub->topics[i];
+        uint64_t due_us = topic->batch_start_us + (pub->cfg.batch_ms * 1000ULL);
+        if ((topic->batch_len > 0) && (due_us < wake_us)) {
+            wake_us = due_us;
+        }
+    }
+
+    uint64_t state_us = UINT64_MAX;
+    if (pub->state == PUBLISHER_DISCONNECTED) {
+        state_us = pub->reconnect_us;
+    } else if ((pub->state != PUBLISHER_CONNECTED) || pub->ping_pending) {
+        state_us = pub->deadline_us;
+    } else {
+        state_us = pub->last_tx_us + (PUBLISHER_KEEPALIVE_SEC * 500000ULL);
+    }
+
+    return (state_us < wake_us) ? state_us : wake_us;
+}
+
+/**
+ * @brief Latency percentile function.
+ * @param stats Pointer to the publisher statistics.
+ * @param pct Percentile.
+ * @retval Delivery latency at the percentile (upper edge of its bucket), in
+ *         msec.
+ */
+static uint32_t publisher_latency_percentile_ms(const struct publisher_stats *stats,
+        double pct) {
+    uint64_t target = (uint64_t)((stats->acked * pct) / 100.0);
+    uint64_t count = 0;
+
+    if (stats->acked == 0) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < PUBLISHER_LATENCY_BUCKETS; i++) {
+        count += stats->latency_hist[i];
+        if ((count > target) || (count == stats->acked)) {
+            return (i + 1) * PUBLISHER_LATENCY_BUCKET_MS;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Publisher report function. This function prints the publisher's
+ *        statistics as key=value pairs.
+ * @param pub Pointer to the publisher.
+ * @param out Stream printed to.
+ * @retval None.
+ */
+void publisher_report(const struct publisher *pub, FILE *out) {
+    const struct publisher_stats *stats = &pub->stats;
+
+    fprintf(out, "publisher=%s connected=%d lines=%llu batches=%llu published=%llu "
+            "resent=%llu delivered=%llu delivered_lines=%llu bytes=%llu connects=%llu "
+            "disconnects=%llu spool_bytes=%llu dropped_bytes=%llu corrupt=%llu "
+            "lat_p50_ms=%u lat_p99_ms=%u\n", pub->cfg.broker,
+            (pub->state == PUBLISHER_CONNECTED), (unsigned long long)stats->lines,
+            (unsigned long long)stats->batches, (unsigned long long)stats->published,
+            (unsigned long long)stats->resent, (unsigned long long)stats->acked,
+            (unsigned long long)stats->acked_lines, (unsigned long long)stats->bytes,
+            (unsigned long long)stats->connects, (unsigned long long)stats->disconnects,
+            (unsigned long long)pub->spool_bytes, (unsigned long long)stats->dropped_bytes,
+            (unsigned long long)stats->corrupt, publisher_latency_percentile_ms(stats, 50.0),
+            publisher_latency_percentile_ms(stats, 99.0));
+}
+
+/**
+ * @brief Publisher close function. This function queues every open batch
+ *        (to be published after the next start, if not now), and closes the
+ *        connection and the spool.
+ * @param pub Pointer to the publisher.
+ * @retval None.
+ */
+void publisher_close(struct publisher *pub) {
+    for (uint32_t i = 0; i < pub->num_topics; i++) {
+        publisher_queue_batch(pub, pub->topics[i]);
+        free(pub->topics[i]->batch);
+        free(pub->topics[i]);
+    }
+    free(pub->topics);
+
+    if (pub->state == PUBLISHER_CONNECTED) {
+        uint8_t disconnect[MQTT_EMPTY_LEN];
+        publisher_flush(pub, publisher_now_us());
+        send(pub->fd, disconnect, mqtt_empty(disconnect, MQTT_DISCONNECT), MSG_NOSIGNAL);
+    }
+
+    if (pub->fd >= 0) {
+        close(pub->fd);
+    }
+    if (pub->read_fd >= 0) {
+        close(pub->read_fd);
+    }
+    close(pub->tail_fd);
+    close(pub->pos_fd);
+    free(pub->tx);
+    free(pub->record);
+}
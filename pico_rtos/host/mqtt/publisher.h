@@ -0,0 +1,205 @@
+ /**
+ **************************************************************
+ * @file publisher.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the gateway's batched MQTT publisher.
+ ***************************************************************
+ */
+
+#ifndef PUBLISHER_H
+#define PUBLISHER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/socket.h>
+
+// Classes of topic published for each node, their names (the last level of
+// each topic), and their default QoS levels.
+#define PUBLISHER_CLASS_READINGS 0
+#define PUBLISHER_CLASS_EVENTS 1
+#define PUBLISHER_NUM_CLASSES 2
+#define PUBLISHER_CLASS_NAMES {"readings", "events"}
+#define PUBLISHER_DEFAULT_QOS {0, 1}
+
+// Defaults for the publisher configuration.
+#define PUBLISHER_DEFAULT_PREFIX "tank_level"
+#define PUBLISHER_DEFAULT_BATCH_MS 1000
+#define PUBLISHER_DEFAULT_BATCH_BYTES 4096
+#define PUBLISHER_DEFAULT_SPOOL_MAX_MB 256
+
+// Maximum length of a topic name (including the terminating null), and of
+// one line added to a batch.
+#define PUBLISHER_TOPIC_LEN 128
+#define PUBLISHER_MAX_LINE_LEN 128
+
+// Maximum size of a batch (the batch size is clamped to it).
+#define PUBLISHER_MAX_BATCH_BYTES 65536
+
+// Batches are queued in spool segment files of about this size, which are
+// deleted once every batch in them has been published (and acknowledged,
+// for QoS 1).
+#define PUBLISHER_SPOOL_SEGMENT_BYTES (4 * 1024 * 1024)
+#define PUBLISHER_SPOOL_MAGIC 0x4C4F5053      // "SPOL"
+
+// Maximum number of batches published and not yet acknowledged.
+#define PUBLISHER_MAX_INFLIGHT 64
+
+// Connection timing.
+#define PUBLISHER_KEEPALIVE_SEC 30
+#define PUBLISHER_CONNECT_TIMEOUT_MS 5000
+#define PUBLISHER_RECONNECT_MIN_MS 500
+#define PUBLISHER_RECONNECT_MAX_MS 30000
+
+// Send and receive buffer sizes. New batches are only published while at
+// most PUBLISHER_TX_LOW_WATER bytes are waiting to be sent.
+#define PUBLISHER_TX_LEN (4 * PUBLISHER_MAX_BATCH_BYTES)
+#define PUBLISHER_TX_LOW_WATER PUBLISHER_MAX_BATCH_BYTES
+#define PUBLISHER_RX_LEN 4096
+
+// Delivery latency histogram (from a batch's first reading to its batch
+// being acknowledged, or sent for QoS 0), in buckets of
+// PUBLISHER_LATENCY_BUCKET_MS up to 60 sec.
+#define PUBLISHER_LATENCY_BUCKET_MS 10
+#define PUBLISHER_LATENCY_BUCKETS 6000
+
+// Connection states.
+#define PUBLISHER_DISCONNECTED 0
+#define PUBLISHER_CONNECTING 1        // TCP connection in progress
+#define PUBLISHER_CONNACK_WAIT 2      // CONNECT sent
+#define PUBLISHER_CONNECTED 3
+
+// Struct holding the publisher configuration.
+struct publisher_cfg {
+    const char *broker;         // "host:port"
+    const char *client_id;
+    const char *prefix;         // First level of every topic
+    const char *spool_dir;
+    uint32_t batch_ms;          // Maximum age of a batch before it is queued
+    uint32_t batch_bytes;       // Maximum size of a batch before it is queued
+    uint64_t spool_max_bytes;   // Oldest segments are dropped beyond this
+    uint8_t qos[PUBLISHER_NUM_CLASSES];
+};
+
+// Struct holding a topic, and the batch of lines being coalesced for it.
+struct publisher_topic {
+    char name[PUBLISHER_TOPIC_LEN];
+    uint16_t name_len;
+    uint8_t qos;
+    char *batch;
+    uint32_t batch_len;
+    uint32_t batch_lines;
+    int64_t batch_first_ms;     // Wall clock time of the first line
+    uint64_t batch_start_us;    // When the first line was added
+};
+
+// Struct holding the header of a batch queued in the spool. The CRC covers
+// every later field, the topic name and the payload.
+struct publisher_spool_record {
+    uint32_t magic;
+    uint32_t crc;
+    uint32_t payload_len;
+    uint16_t topic_len;
+    uint8_t qos;
+    uint8_t reserved;
+    uint32_t lines;
+    uint32_t reserved2;
+    int64_t first_ms;
+};
+
+// Struct holding a position in the spool.
+struct publisher_spool_pos {
+    uint32_t seq;               // Segment number
+    uint32_t offset;
+};
+
+// Struct holding a batch published and not yet acknowledged.
+struct publisher_inflight {
+    uint16_t packet_id;
+    bool acked;
+    struct publisher_spool_pos end;     // Spool position after the batch
+    int64_t first_ms;
+    uint32_t lines;
+};
+
+// Struct holding the publisher statistics.
+struct publisher_stats {
+    uint64_t lines;             // Lines added to batches
+    uint64_t batches;           // Batches queued
+    uint64_t published;         // Batches published (including resends)
+    uint64_t resent;            // Batches published again after a reconnect
+    uint64_t acked;             // Batches delivered
+    uint64_t acked_lines;
+    uint64_t bytes;             // Payload bytes published
+    uint64_t connects;
+    uint64_t disconnects;
+    uint64_t dropped_bytes;     // Spool dropped while over its limit
+    uint64_t corrupt;           // Spool records failing their check
+    uint32_t latency_hist[PUBLISHER_LATENCY_BUCKETS];
+};
+
+// Struct holding the publisher.
+struct publisher {
+    struct publisher_cfg cfg;
+    int epoll_fd;
+    uint32_t epoll_id;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+
+    // Connection
+    int fd;
+    uint8_t state;
+    uint64_t reconnect_us;
+    uint32_t reconnect_delay_ms;
+    uint64_t deadline_us;       // Connect/CONNACK/PINGRESP deadline
+    uint64_t last_tx_us;
+    bool ping_pending;
+    uint8_t *tx;
+    size_t tx_len;
+    size_t tx_pos;
+    bool tx_waiting;            // Waiting for the socket to be writable
+    uint8_t rx[PUBLISHER_RX_LEN];
+    size_t rx_len;
+    uint16_t next_packet_id;
+    struct publisher_inflight inflight[PUBLISHER_MAX_INFLIGHT];
+    uint32_t inflight_head;
+    uint32_t inflight_count;
+
+    // Topics
+    struct publisher_topic **topics;
+    uint32_t num_topics;
+
+    // Spool
+    uint32_t oldest_seq;
+    uint32_t tail_seq;
+    int tail_fd;
+    uint32_t tail_size;
+    int read_fd;
+    uint32_t read_seq;
+    struct publisher_spool_pos acked;   // Everything before is delivered
+    struct publisher_spool_pos send;    // Next batch to publish
+    struct publisher_spool_pos resend_end;  // End of batches being resent
+    int pos_fd;
+    uint64_t spool_bytes;
+    uint8_t *record;            // Buffer for a batch read from the spool
+
+    struct publisher_stats stats;
+};
+
+// Function prototypes
+bool publisher_parse_qos(struct publisher_cfg *cfg, const char *spec);
+bool publisher_open(struct publisher *pub, const struct publisher_cfg *cfg, int epoll_fd,
+        uint32_t epoll_id);
+struct publisher_topic *publisher_topic(struct publisher *pub, const char *node,
+        uint8_t topic_class);
+void publisher_add(struct publisher *pub, struct publisher_topic *topic, const char *line,
+        size_t len, int64_t ts_ms);
+void publisher_poll(struct publisher *pub, uint64_t now_us);
+uint64_t publisher_next_wake_us(const struct publisher *pub);
+void publisher_handle(struct publisher *pub, uint32_t events);
+void publisher_report(const struct publisher *pub, FILE *out);
+void publisher_close(struct publisher *pub);
+
+#endif
@@ -0,0 +1,624 @@
+ /**
+ **************************************************************
+ * @file node.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Stand-in node. This tool runs the firmware's measurement pipeline
+ *        and response serialiser against a simulated plant (see sim/plant.c)
+ *        in real time (or faster), and answers the Pico's UART protocol 
+ *        (R/A/E/S/C requests, and configuration updates, which are kept in 
+ *        memory) on a pseudo-terminal, so gateway software can be tested 
+ *        against many nodes without hardware. Replies can be delayed
+ *        and dropped to exercise timeouts and retries. With a node count, 
+ *        the pseudo-terminal stands in for a multi-drop bus instead, with 
+ *        that many nodes (each with its own plant, seeded in turn) answering
+ *        the request frames addressed to their IDs (see multidrop.h). With a
+ *        baud rate, replies take as long as the line would to arrive. 
+ *
+ *        Usage: node [-l link] [-s seed] [-x speedup] [-d reply delay (ms)]
+ *                    [-p drop (%)] [-k nodes] [-a first node ID] [-b baud]
+ ***************************************************************
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "meas_pipeline.h"
+#include "serialise.h"
+#include "serialise_reply.h"
+#include "multidrop.h"
+#include "config.h"
+#include "plant.h"
+
+// Simulated time between plant steps (in sec). 
+#define NODE_PLANT_STEP_SEC 0.1
+
+// Maximum number of replies waiting for their delay to elapse. 
+#define NODE_MAX_PENDING 16
+
+// Maximum number of nodes on a multi-drop bus. 
+#define NODE_MAX_NODES (MULTIDROP_MAX_ID - MULTIDROP_MIN_ID + 1)
+
+// Struct holding a reply waiting to be sent. 
+struct node_reply {
+    uint64_t due_us;
+    size_t len;
+    char str[MULTIDROP_PREFIX_LEN + CONFIG_REPLY_LEN];
+};
+
+// Struct holding the state of the node. 
+struct node {
+    struct plant_rng rng;
+    struct plant_tank tanks[NUM_TANKS];
+    struct tank_state states[NUM_TANKS];
+    struct ref_filter ref_filter;
+    struct config_block config;
+    uint64_t next_frame_us;
+    uint32_t events;                // Events raised since the last 'E'
+    uint32_t frames;
+    double now_sec;                 // Simulated time
+    uint8_t id;                     // Multi-drop node ID
+    bool latched;
+    float latched_heights[NUM_TANKS];
+};
+
+// Struct holding the state of the line shared by the nodes. 
+struct node_line {
+    bool multidrop;
+    uint32_t char_us;               // 0 to send replies without line timing
+    uint64_t tx_free_us;            // When the last reply queued is sent
+    struct multidrop_parser parser;
+    struct config_parser config_parser;
+    struct node_reply pending[NODE_MAX_PENDING];
+    uint8_t num_pending;
+};
+
+// Set by the signal handler to stop the node. 
+static volatile sig_atomic_t stop = 0;
+
+/**
+ * @brief Signal handler. 
+ * @param signum Signal number. 
+ * @retval None. 
+ */
+static void handle_signal(int signum) {
+    (void)signum;
+    stop = 1;
+}
+
+/**
+ * @brief Monotonic time function. 
+ * @param None. 
+ * @retval Monotonic time, in usec. 
+ */
+static uint64_t now_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
+/**
+ * @brief Measurement period function. 
+ * @param node Pointer to the node. 
+ * @param speedup Speedup over real time. 
+ * @retval Time between the node's measurement periods, in usec. 
+ */
+static uint64_t node_period_us(const struct node *node, double speedup) {
+    uint64_t period_us = (uint64_t)((node->config.meas.sample_period_ms * 1000.0) / speedup);
+    return (period_us == 0) ? 1 : period_us;
+}
+
+/**
+ * @brief Measurement function. This function advances the plant by one 
+ *        measurement period, and runs the resulting ADC frame through the 
+ *        pipeline with the node's configuration (as done by the measurement
+ *        and level control tasks). 
+ * @param node Pointer to the node. 
+ * @retval None. 
+ */
+static void node_measure(struct node *node) {
+    const struct meas_config *config = &node->config.meas;
+    double period_sec = config->sample_period_ms / 1000.0;
+
+    for (double t = 0.0; t < period_sec; t += NODE_PLANT_STEP_SEC) {
+        for (uint8_t i = 0; i < NUM_TANKS; i++) {
+            plant_step(&node->tanks[i], node->now_sec + t, NODE_PLANT_STEP_SEC);
+        }
+    }
+    node->now_sec += period_sec;
+
+    struct adc_frame frame;
+    plant_sample_frame(node->tanks, node->now_sec, &node->rng, &frame);
+
+    // The first frames prime the averaging windows (the warm start burst)
+    if (node->frames < meas_config_max_window_width(config)) {
+        meas_pipeline_prime(node->states, &node->ref_filter, config, &frame, node->frames, NULL);
+    } else {
+        struct pipeline_output output;
+        meas_pipeline_process(node->states, &node->ref_filter, config, &frame, &output);
+        node->events |= output.events;
+
+        for (uint8_t i = 0; i < NUM_TANKS; i++) {
+            plant_set_valves(&node->tanks[i], node->states[i].filling, 
+                    node->states[i].draining, node->now_sec);
+        }
+    }
+
+    node->frames++;
+}
+
+/**
+ * @brief Latch function. This function latches a node's latest heights (as
+ *        done by the UART task for a latch broadcast). 
+ * @param node Pointer to the node. 
+ * @retval None. 
+ */
+static void node_latch(struct node *node) {
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        node->latched_heights[i] = node->states[i].height;
+    }
+    node->latched = true;
+}
+
+/**
+ * @brief Heights source function. 
+ * @param param Pointer to the node. 
+ * @param heights Buffer written to (NUM_TANKS heights). 
+ * @retval None. 
+ */
+static void node_get_heights(void *param, float *heights) {
+    struct node *node = (struct node *)param;
+
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        heights[i] = node->states[i].height;
+    }
+}
+
+/**
+ * @brief Analytics source function. 
+ * @param param Pointer to the node. 
+ * @param analytics Buffer written to (NUM_TANKS analytics). 
+ * @retval None. 
+ */
+static void node_get_analytics(void *param, struct tank_analytics *analytics) {
+    struct node *node = (struct node *)param;
+
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        analytics[i] = node->states[i].analytics;
+    }
+}
+
+/**
+ * @brief Events source function. This function takes the events raised 
+ *        since the last 'E' request. 
+ * @param param Pointer to the node. 
+ * @retval Events raised. 
+ */
+static uint32_t node_take_events(void *param) {
+    struct node *node = (struct node *)param;
+    uint32_t events = node->events;
+
+    node->events = 0;
+    return events;
+}
+
+/**
+ * @brief Valve state source function. 
+ * @param param Pointer to the node. 
+ * @param filling Buffer written to (NUM_TANKS fill valve states). 
+ * @param draining Buffer written to (NUM_TANKS drain valve states). 
+ * @retval None. 
+ */
+static void node_get_valves(void *param, bool *filling, bool *draining) {
+    struct node *node = (struct node *)param;
+
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        filling[i] = node->states[i].filling;
+        draining[i] = node->states[i].draining;
+    }
+}
+
+/**
+ * @brief Latched heights source function. This function copies the heights
+ *        latched by the last latch broadcast, and releases the latch. 
+ * @param param Pointer to the node. 
+ * @param heights Buffer written to (NUM_TANKS heights). 
+ * @retval true if a broadcast has been received since the last reply, false
+ *         otherwise. 
+ */
+static bool node_take_latched(void *param, float *heights) {
+    struct node *node = (struct node *)param;
+
+    if (!node->latched) {
+        return false;
+    }
+
+    node->latched = false;
+    memcpy(heights, node->latched_heights, sizeof(node->latched_heights));
+    return true;
+}
+
+/**
+ * @brief Configuration source function. 
+ * @param param Pointer to the node. 
+ * @param block Pointer to struct which the block is copied into. 
+ * @retval None. 
+ */
+static void node_get_config(void *param, struct config_block *block) {
+    struct node *node = (struct node *)param;
+
+    *block = node->config;
+}
+
+// Sources of the replies to requests, as the UART task's (see 
+// serialise_reply.h). 
+static const struct serialise_reply_source node_reply_source = {
+    .get_heights = node_get_heights,
+    .get_analytics = node_get_analytics,
+    .take_events = node_take_events,
+    .get_valves = node_get_valves,
+    .take_latched = node_take_latched,
+    .get_config = node_get_config,
+};
+
+/**
+ * @brief Configuration update function. This function applies an update to
+ *        a node's configuration (as done by the UART task, but kept in 
+ *        memory rather than written to flash), and serialises the reply. 
+ * @param node Pointer to the node. 
+ * @param text Update text (between the braces). 
+ * @param out Buffer the reply is written to (CONFIG_REPLY_LEN chars). 
+ * @retval Length of the reply. 
+ */
+static size_t node_apply_update(struct node *node, const char *text, char *out) {
+    struct meas_config meas = node->config.meas;
+
+    uint8_t result = config_apply_update(text, &meas);
+    if ((result == CONFIG_OK) && !config_validate(&meas)) {
+        result = CONFIG_ERR_RANGE;
+    }
+
+    if (result != CONFIG_OK) {
+        return config_serialise_error(out, result);
+    }
+
+    config_block_init(&node->config, node->config.sequence + 1, &meas);
+    return config_serialise(out, &node->config);
+}
+
+/**
+ * @brief Reply queue function. This function queues a reply to be sent once
+ *        it is ready and the line has sent the replies before it (and, with
+ *        line timing, once its last character would have arrived), unless
+ *        it is dropped. 
+ * @param line Pointer to the line. 
+ * @param node Pointer to the replying node. 
+ * @param reply Pointer to the reply. 
+ * @param ready_us Time the node starts sending the reply, in usec. 
+ * @param drop_pct Percentage of replies dropped. 
+ * @retval None. 
+ */
+static void node_queue_reply(struct node_line *line, struct node *node,
+        struct node_reply *reply, uint64_t ready_us, double drop_pct) {
+    if ((plant_rng_uniform(&node->rng) * 100.0) < drop_pct) {
+        return;
+    }
+
+    if (line->num_pending >= NODE_MAX_PENDING) {
+        return;
+    }
+
+    uint64_t start_us = (line->tx_free_us > ready_us) ? line->tx_free_us : ready_us;
+    reply->due_us = start_us + (reply->len * line->char_us);
+    line->tx_free_us = reply->due_us;
+    line->pending[line->num_pending++] = *reply;
+}
+
+/**
+ * @brief Request handler. This function serialises the reply to a request
+ *        character, or to a configuration update the character completes 
+ *        (on a point-to-point line), and queues it to be sent after the 
+ *        reply delay. 
+ * @param line Pointer to the line. 
+ * @param node Pointer to the node. 
+ * @param request Request character. 
+ * @param delay_us Reply delay, in usec. 
+ * @param drop_pct Percentage of replies dropped. 
+ * @retval None. 
+ */
+static void node_handle_request(struct node_line *line, struct node *node, char request,
+        uint64_t delay_us, double drop_pct) {
+    struct node_reply reply;
+
+    switch (config_parse(&line->config_parser, request)) {
+        case CONFIG_PARSE_DONE:
+            reply.len = node_apply_update(node, line->config_parser.text, reply.str);
+            break;
+        case CONFIG_PARSE_PENDING:
+            return;
+        default:
+            reply.len = serialise_reply(&node_reply_source, node, request, reply.str);
+            break;
+    }
+
+    if (reply.len == 0) {
+        return;
+    }
+
+    // The request character takes one character time to arrive
+    node_queue_reply(line, node, &reply, now_us() + line->char_us + delay_us, drop_pct);
+}
+
+/**
+ * @brief Frame handler. This function acts on a complete request frame (on
+ *        a multi-drop bus, as done by the UART task). A broadcast latch
+ *        latches every node's heights (each missing it as often as it drops
+ *        a reply), and a frame addressed to one of the
+ *        nodes has each of its commands answered with a prefixed reply,
+ *        after the turnaround time and the reply delay. 
+ * @param line Pointer to the line. 
+ * @param nodes Array of nodes. 
+ * @param num_nodes Number of nodes. 
+ * @param delay_us Reply delay, in usec. 
+ * @param drop_pct Percentage of replies (and broadcasts) dropped. 
+ * @retval None. 
+ */
+static void node_handle_frame(struct node_line *line, struct node *nodes, uint32_t num_nodes,
+        uint64_t delay_us, double drop_pct) {
+    const struct multidrop_parser *frame = &line->parser;
+
+    if (frame->id == MULTIDROP_BROADCAST_ID) {
+        for (uint8_t i = 0; i < frame->num_commands; i++) {
+            for (uint32_t j = 0; (j < num_nodes) && (frame->commands[i] == MULTIDROP_LATCH);
+                    j++) {
+                // Broadcasts are missed as often as replies are dropped
+                if ((plant_rng_uniform(&nodes[j].rng) * 100.0) >= drop_pct) {
+                    node_latch(&nodes[j]);
+                }
+            }
+        }
+        return;
+    }
+
+    struct node *node = NULL;
+    for (uint32_t i = 0; i < num_nodes; i++) {
+        if (nodes[i].id == frame->id) {
+            node = &nodes[i];
+            break;
+        }
+    }
+
+    // Frames for nodes not on the bus go unanswered
+    if (node == NULL) {
+        return;
+    }
+
+    // The frame's characters take time to arrive, and the node waits for
+    // the gateway to release the line before replying. 
+    uint64_t ready_us = now_us() + ((MULTIDROP_PREFIX_LEN + frame->num_commands + 1)
+            * line->char_us) + (MULTIDROP_TURNAROUND_CHARS * line->char_us) + delay_us;
+
+    for (uint8_t i = 0; i < frame->num_commands; i++) {
+        struct node_reply reply;
+        size_t len = multidrop_reply_prefix(reply.str, node->id);
+        reply.len = serialise_reply(&node_reply_source, node, frame->commands[i], &reply.str[len]);
+        if (reply.len > 0) {
+            reply.len += len;
+            node_queue_reply(line, node, &reply, ready_us, drop_pct);
+        }
+    }
+}
+
+/**
+ * @brief Reply send function. This function sends the replies which are due
+ *        (in the order they were queued). 
+ * @param line Pointer to the line. 
+ * @param fd File descriptor of the pseudo-terminal master. 
+ * @retval None. 
+ */
+static void node_send_replies(struct node_line *line, int fd) {
+    uint64_t now = now_us();
+    uint8_t sent = 0;
+
+    while ((sent < line->num_pending) && (line->pending[sent].due_us <= now)) {
+        if (write(fd, line->pending[sent].str, line->pending[sent].len) < 0) {
+            // Nothing is reading the terminal, so the reply is lost
+            if (errno != EAGAIN) {
+                perror("write");
+            }
+        }
+        sent++;
+    }
+
+    memmove(line->pending, &line->pending[sent],
+            (line->num_pending - sent) * sizeof(line->pending[0]));
+    line->num_pending -= sent;
+}
+
+int main(int argc, char **argv) {
+    const char *link_path = NULL;
+    uint64_t seed = 1;
+    double speedup = 1.0;
+    uint32_t delay_ms = 0;
+    double drop_pct = 0.0;
+    uint32_t num_nodes = 0;
+    uint32_t first_id = MULTIDROP_MIN_ID;
+    uint32_t baud = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "l:s:x:d:p:k:a:b:")) != -1) {
+        switch (opt) {
+            case 'l':
+                link_path = optarg;
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'x':
+                speedup = atof(optarg);
+                break;
+            case 'd':
+                delay_ms = strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                drop_pct = atof(optarg);
+                break;
+            case 'k':
+                num_nodes = strtoul(optarg, NULL, 0);
+                break;
+            case 'a':
+                first_id = strtoul(optarg, NULL, 0);
+                break;
+            case 'b':
+                baud = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-l link] [-s seed] [-x speedup] "
+                        "[-d reply delay (ms)] [-p drop (%%)] [-k nodes] "
+                        "[-a first node ID] [-b baud]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (speedup <= 0.0) {
+        speedup = 1.0;
+    }
+
+    // Without a node count, a single node answers request characters
+    static struct node_line line;
+    line.multidrop = (num_nodes > 0);
+    line.char_us = (baud > 0) ? multidrop_char_us(baud) : 0;
+    multidrop_parser_init(&line.parser);
+    config_parser_init(&line.config_parser);
+    if (!line.multidrop) {
+        num_nodes = 1;
+    } else if ((first_id < MULTIDROP_MIN_ID) || ((first_id + num_nodes - 1) > MULTIDROP_MAX_ID)) {
+        fprintf(stderr, "%s: node IDs must be between %d and %d\n", argv[0], MULTIDROP_MIN_ID, 
+                MULTIDROP_MAX_ID);
+        return 2;
+    }
+
+    // Pseudo-terminal standing in for the Pico's UART
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0)) {
+        perror("posix_openpt");
+        return 1;
+    }
+
+    const char *slave_path = ptsname(master);
+    int slave = open(slave_path, O_RDWR | O_NOCTTY);
+    if (slave < 0) {
+        perror(slave_path);
+        return 1;
+    }
+
+    // Raw mode, so requests and replies pass through unchanged. The slave 
+    // is kept open, so the master doesn't see a hangup between clients.
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    if (link_path != NULL) {
+        unlink(link_path);
+        if (symlink(slave_path, link_path) != 0) {
+            perror(link_path);
+            return 1;
+        }
+    }
+
+    if (line.multidrop) {
+        printf("node pty=%s ids=%02X-%02X\n", (link_path != NULL) ? link_path : slave_path, 
+                first_id, first_id + num_nodes - 1);
+    } else {
+        printf("node pty=%s\n", (link_path != NULL) ? link_path : slave_path);
+    }
+    fflush(stdout);
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    static struct node nodes[NODE_MAX_NODES];
+    uint64_t start_us = now_us();
+    for (uint32_t i = 0; i < num_nodes; i++) {
+        struct node *node = &nodes[i];
+        plant_rng_seed(&node->rng, seed + i);
+        config_block_init(&node->config, 0, &meas_config_defaults);
+        node->next_frame_us = start_us;
+        meas_pipeline_init(node->states, &node->ref_filter, &node->config.meas);
+        for (uint8_t j = 0; j < NUM_TANKS; j++) {
+            plant_tank_init(&node->tanks[j], &plant_default_cfgs[j]);
+            node->states[j].ctrl_on = TANK_HAS_VALVES(j + 1);
+        }
+        node->id = first_id + i;
+    }
+
+    while (!stop) {
+        // Each node measures at its own configured period
+        uint64_t now = now_us();
+        uint64_t wake_us = UINT64_MAX;
+        bool measured = false;
+        for (uint32_t i = 0; i < num_nodes; i++) {
+            struct node *node = &nodes[i];
+            if (now >= node->next_frame_us) {
+                node_measure(node);
+                node->next_frame_us += node_period_us(node, speedup);
+                measured = true;
+            }
+
+            if (node->next_frame_us < wake_us) {
+                wake_us = node->next_frame_us;
+            }
+        }
+
+        if (measured) {
+            continue;
+        }
+
+        // Wait for requests until the next frame or pending reply is due
+        if ((line.num_pending > 0) && (line.pending[0].due_us < wake_us)) {
+            wake_us = line.pending[0].due_us;
+        }
+
+        // Line timing needs sub-millisecond waits
+        uint64_t wait_us = (wake_us > now) ? (wake_us - now) : 0;
+        struct timespec timeout = {
+            .tv_sec = wait_us / 1000000,
+            .tv_nsec = (wait_us % 1000000) * 1000,
+        };
+        struct pollfd pfd = {.fd = master, .events = POLLIN};
+        int ready = ppoll(&pfd, 1, &timeout, NULL);
+        if ((ready > 0) && (pfd.revents & POLLIN)) {
+            char requests[64];
+            ssize_t len = read(master, requests, sizeof(requests));
+            for (ssize_t i = 0; i < len; i++) {
+                if (!line.multidrop) {
+                    node_handle_request(&line, &nodes[0], requests[i], delay_ms * 1000ULL, 
+                            drop_pct);
+                } else if (multidrop_parse(&line.parser, requests[i])) {
+                    node_handle_frame(&line, nodes, num_nodes, delay_ms * 1000ULL, drop_pct);
+                }
+            }
+        }
+
+        node_send_replies(&line, master);
+    }
+
+    if (link_path != NULL) {
+        unlink(link_path);
+    }
+
+    close(slave);
+    close(master);
+    return 0;
+}
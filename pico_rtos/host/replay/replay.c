@@ -0,0 +1,382 @@
+ /**
+ **************************************************************
+ * @file replay.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Capture replay tool. This tool feeds the ADC frames from telemetry
+ *        captures (see capture.c) through the measurement pipeline built
+ *        from the firmware sources, as fast as the CPU allows. It reports the
+ *        pipeline throughput, writes the resulting valve command timeline,
+ *        and counts frames where the replayed valve states differ from those
+ *        recorded by the unit. Timelines from two builds of this tool (e.g.
+ *        before and after a filter or control change) can then be compared.
+ *
+ *        Usage: replay [-t timeline] [-n repeats] <capture> [capture ...]
+ *               replay -c <timeline a> <timeline b>
+ ***************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "meas_pipeline.h"
+#include "telemetry_record.h"
+
+// Maximum number of differences printed when comparing timelines.
+#define REPLAY_MAX_PRINTED_DIFFS 20
+
+// Names of the control commands (CTRL_CMD_* bit n is name n).
+static const char *ctrl_cmd_names[] = {"START_FILL", "STOP_FILL", "START_DRAIN",
+        "STOP_DRAIN"};
+#define NUM_CTRL_CMDS (sizeof(ctrl_cmd_names) / sizeof(ctrl_cmd_names[0]))
+
+// Struct holding the frames loaded from the captures.
+struct capture {
+    struct telemetry_record *records;
+    size_t num_records;
+    size_t capacity;
+};
+
+// Struct holding one entry of a valve command timeline.
+struct timeline_entry {
+    unsigned long seq;
+    unsigned long long timestamp_us;
+    unsigned tank;
+    char command[16];
+    float height;
+};
+
+// Struct holding a valve command timeline.
+struct timeline {
+    struct timeline_entry *entries;
+    size_t num_entries;
+    size_t capacity;
+};
+
+/**
+ * @brief Capture loading function. This function appends the valid records
+ *        from a capture file to the loaded frames.
+ * @param capture Pointer to the loaded frames.
+ * @param path Path of the capture file.
+ * @retval 0 on success, -1 on error.
+ */
+static int load_capture(struct capture *capture, const char *path) {
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    unsigned long invalid = 0;
+    struct telemetry_record record;
+    while (fread(&record, sizeof(record), 1, in) == 1) {
+        if (!telemetry_record_valid(&record)) {
+            // Records from a build with a different tank count don't line
+            // up with this build's, so the capture can't be replayed
+            uint8_t num_tanks = telemetry_record_tanks((const uint8_t *)&record,
+                    sizeof(record));
+            if ((num_tanks != 0) && (num_tanks != TELEMETRY_NUM_TANKS)) {
+                fprintf(stderr, "%s: captured with %u tanks, replay is built with %u "
+                        "(rebuild with -DNUM_TANKS=%u)\n", path, num_tanks,
+                        TELEMETRY_NUM_TANKS, num_tanks);
+                fclose(in);
+                return -1;
+            }
+
+            invalid++;
+            continue;
+        }
+
+        if (capture->num_records >= capture->capacity) {
+            capture->capacity = (capture->capacity == 0) ? 4096 : (capture->capacity * 2);
+            capture->records = realloc(capture->records,
+                    capture->capacity * sizeof(struct telemetry_record));
+            if (capture->records == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                fclose(in);
+                return -1;
+            }
+        }
+
+        capture->records[capture->num_records++] = record;
+    }
+
+    fclose(in);
+
+    if (invalid > 0) {
+        fprintf(stderr, "%s: skipped %lu invalid records\n", path, invalid);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Recorded state getter function. This function extracts a tank's
+ *        valve/control state bits from a record.
+ * @param record Pointer to record.
+ * @param tank_index Index of the tank (tank n is at index n - 1).
+ * @retval TELEMETRY_STATE_* bits of the tank.
+ */
+static uint32_t recorded_state(const struct telemetry_record *record, uint8_t tank_index) {
+    return (record->state >> (tank_index * TELEMETRY_STATE_BITS_PER_TANK))
+            & ((1 << TELEMETRY_STATE_BITS_PER_TANK) - 1);
+}
+
+/**
+ * @brief Replay function. This function runs every loaded frame through the
+ *        measurement pipeline. Control is enabled/disabled for each frame as
+ *        it was on the unit.
+ * @param capture Pointer to the loaded frames.
+ * @param timeline Output file for the valve command timeline, or NULL.
+ * @param mismatches Pointer populated with the number of frames where the
+ *        replayed valve states differ from the recorded ones, or NULL.
+ * @retval None.
+ */
+static void replay(const struct capture *capture, FILE *timeline, unsigned long *mismatches) {
+    static struct tank_state states[NUM_TANKS];
+    static struct ref_filter ref_filter;
+    const struct meas_config *config = &meas_config_defaults;
+    meas_pipeline_init(states, &ref_filter, config);
+
+    // The unit's warm start burst isn't captured, so the averaging windows
+    // are primed from the first captured frames instead.
+    for (uint8_t j = 0; (j < AVG_WINDOW_WIDTH) && (j < capture->num_records); j++) {
+        struct adc_frame frame;
+        frame.timestamp_us = capture->records[j].timestamp_us;
+        memcpy(frame.raw, capture->records[j].raw, sizeof(frame.raw));
+        meas_pipeline_prime(states, &ref_filter, config, &frame, j, NULL);
+    }
+
+    for (size_t n = 0; n < capture->num_records; n++) {
+        const struct telemetry_record *record = &capture->records[n];
+
+        struct adc_frame frame;
+        frame.timestamp_us = record->timestamp_us;
+        memcpy(frame.raw, record->raw, sizeof(frame.raw));
+
+        for (uint8_t i = 0; i < NUM_TANKS; i++) {
+            states[i].ctrl_on = (recorded_state(record, i) & TELEMETRY_STATE_CTRL_ON) != 0;
+        }
+
+        struct pipeline_output output;
+        meas_pipeline_process(states, &ref_filter, config, &frame, &output);
+
+        for (uint8_t i = 0; i < NUM_TANKS; i++) {
+            if (mismatches != NULL) {
+                uint32_t state = recorded_state(record, i);
+                bool filling = (state & TELEMETRY_STATE_FILLING) != 0;
+                bool draining = (state & TELEMETRY_STATE_DRAINING) != 0;
+                if ((filling != states[i].filling) || (draining != states[i].draining)) {
+                    (*mismatches)++;
+                }
+            }
+
+            if (timeline == NULL) {
+                continue;
+            }
+
+            for (uint8_t cmd = 0; cmd < NUM_CTRL_CMDS; cmd++) {
+                if (output.ctrl_commands[i] & (1 << cmd)) {
+                    fprintf(timeline, "%lu %llu T%u %s %.2f\n", (unsigned long)record->seq,
+                            (unsigned long long)record->timestamp_us, config->tanks[i].tank,
+                            ctrl_cmd_names[cmd], states[i].height);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Timeline loading function. This function loads a valve command
+ *        timeline written by a replay.
+ * @param timeline Pointer to timeline populated.
+ * @param path Path of the timeline file.
+ * @retval 0 on success, -1 on error.
+ */
+static int load_timeline(struct timeline *timeline, const char *path) {
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    struct timeline_entry entry;
+    while (fscanf(in, "%lu %llu T%u %15s %f", &entry.seq, &entry.timestamp_us,
+            &entry.tank, entry.command, &entry.height) == 5) {
+        if (timeline->num_entries >= timeline->capacity) {
+            timeline->capacity = (timeline->capacity == 0) ? 1024 : (timeline->capacity * 2);
+            timeline->entries = realloc(timeline->entries,
+                    timeline->capacity * sizeof(struct timeline_entry));
+            if (timeline->entries == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                fclose(in);
+                return -1;
+            }
+        }
+
+        timeline->entries[timeline->num_entries++] = entry;
+    }
+
+    fclose(in);
+    return 0;
+}
+
+/**
+ * @brief Timeline entry comparison function. This function orders timeline
+ *        entries by frame, then tank, then command.
+ * @param a Pointer to first entry.
+ * @param b Pointer to second entry.
+ * @retval Negative, zero or positive as a is before, equal to or after b.
+ */
+static int compare_entries(const struct timeline_entry *a, const struct timeline_entry *b) {
+    if (a->seq != b->seq) {
+        return (a->seq < b->seq) ? -1 : 1;
+    }
+
+    if (a->tank != b->tank) {
+        return (a->tank < b->tank) ? -1 : 1;
+    }
+
+    return strcmp(a->command, b->command);
+}
+
+/**
+ * @brief Timeline diff function. This function compares two valve command
+ *        timelines, printing commands which only appear in one of them.
+ * @param path_a Path of the first (e.g. baseline) timeline.
+ * @param path_b Path of the second timeline.
+ * @retval Number of differences, or -1 on error.
+ */
+static long diff_timelines(const char *path_a, const char *path_b) {
+    struct timeline a = {0}, b = {0};
+    if ((load_timeline(&a, path_a) != 0) || (load_timeline(&b, path_b) != 0)) {
+        return -1;
+    }
+
+    long diffs = 0;
+    size_t i = 0, j = 0;
+    while ((i < a.num_entries) || (j < b.num_entries)) {
+        int order;
+        if (i >= a.num_entries) {
+            order = 1;
+        } else if (j >= b.num_entries) {
+            order = -1;
+        } else {
+            order = compare_entries(&a.entries[i], &b.entries[j]);
+        }
+
+        if (order == 0) {
+            i++;
+            j++;
+            continue;
+        }
+
+        // Only in a ('-') or only in b ('+')
+        const struct timeline_entry *entry = (order < 0) ? &a.entries[i++] : &b.entries[j++];
+        if (diffs < REPLAY_MAX_PRINTED_DIFFS) {
+            printf("%c %lu %llu T%u %s %.2f\n", (order < 0) ? '-' : '+', entry->seq,
+                    entry->timestamp_us, entry->tank, entry->command, entry->height);
+        }
+        diffs++;
+    }
+
+    printf("%s: %zu commands, %s: %zu commands, %ld differences\n", path_a,
+            a.num_entries, path_b, b.num_entries, diffs);
+
+    free(a.entries);
+    free(b.entries);
+    return diffs;
+}
+
+int main(int argc, char **argv) {
+    const char *timeline_path = NULL;
+    const char *compare_path = NULL;
+    long repeats = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:n:c:")) != -1) {
+        switch (opt) {
+            case 't':
+                timeline_path = optarg;
+                break;
+            case 'n':
+                repeats = atol(optarg);
+                break;
+            case 'c':
+                compare_path = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-t timeline] [-n repeats] <capture> [capture ...]\n"
+                        "       %s -c <timeline a> <timeline b>\n", argv[0], argv[0]);
+                return 2;
+        }
+    }
+
+    // Compare two timelines, exiting with 1 if they differ
+    if (compare_path != NULL) {
+        if (optind >= argc) {
+            fprintf(stderr, "Missing second timeline\n");
+            return 2;
+        }
+
+        long diffs = diff_timelines(compare_path, argv[optind]);
+        return (diffs == 0) ? 0 : ((diffs < 0) ? 2 : 1);
+    }
+
+    if ((optind >= argc) || (repeats < 1)) {
+        fprintf(stderr, "Usage: %s [-t timeline] [-n repeats] <capture> [capture ...]\n", argv[0]);
+        return 2;
+    }
+
+    struct capture capture = {0};
+    for (int i = optind; i < argc; i++) {
+        if (load_capture(&capture, argv[i]) != 0) {
+            return 2;
+        }
+    }
+
+    FILE *timeline = NULL;
+    if (timeline_path != NULL) {
+        timeline = fopen(timeline_path, "w");
+        if (timeline == NULL) {
+            perror(timeline_path);
+            return 2;
+        }
+    }
+
+    // First pass writes the timeline and checks against the recorded states
+    unsigned long mismatches = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    replay(&capture, timeline, &mismatches);
+
+    // Further passes only measure throughput
+    for (long n = 1; n < repeats; n++) {
+        replay(&capture, NULL, NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (timeline != NULL) {
+        fclose(timeline);
+    }
+
+    double elapsed = (end.tv_sec - start.tv_sec) + ((end.tv_nsec - start.tv_nsec) / 1e9);
+    double frames = (double)capture.num_records * repeats;
+    double captured_sec = (capture.num_records > 1) ? ((capture.records[capture.num_records
+            - 1].timestamp_us - capture.records[0].timestamp_us) / 1e6) : 0.0;
+
+    printf("frames=%zu captured_sec=%.0f repeats=%ld elapsed_sec=%.3f frames_per_sec=%.0f "
+            "samples_per_sec=%.0f speedup=%.0f state_mismatches=%lu\n", capture.num_records,
+            captured_sec, repeats, elapsed, (elapsed > 0.0) ? (frames / elapsed) : 0.0,
+            (elapsed > 0.0) ? ((frames * ADC_FRAME_CHANNELS) / elapsed) : 0.0,
+            (elapsed > 0.0) ? ((captured_sec * repeats) / elapsed) : 0.0, mismatches);
+
+    free(capture.records);
+    return 0;
+}
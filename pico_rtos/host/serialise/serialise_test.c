@@ -0,0 +1,318 @@
+ /**
+ **************************************************************
+ * @file serialise_test.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Serialiser test. This tool checks the firmware's fixed-point
+ *        serialiser (see mylib/serialise) against snprintf. Readings must
+ *        match "%.1f" of each height clamped to 0 - 999.9 cm, and
+ *        serialise_fixed() must match "%.0f", "%.1f" and "%.2f" across the
+ *        clamped range of each field, negatives included. Values checked are
+ *        every exact rounding tie in range (quarters for 1 decimal place,
+ *        eighths for 2), the floats either side of every decimal half-way
+ *        point, the limits, special values, and random values. The one
+ *        accepted difference is that a negative value rounding to zero is
+ *        written without the sign ("0.0", not "-0.0"). Results are
+ *        reported as key=value lines, and the exit status is non-zero on
+ *        any mismatch.
+ *
+ *        Usage: serialise_test [-n random values] [-s seed]
+ ***************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "serialise.h"
+
+// Defaults for the command line options.
+#define SERIALISE_TEST_DEFAULT_RANDOM 2000000
+#define SERIALISE_TEST_DEFAULT_SEED 1
+
+// Number of floats checked either side of each half-way point.
+#define SERIALISE_TEST_NEIGHBOURS 2
+
+// Reference output buffer size.
+#define SERIALISE_TEST_REF_LEN 64
+
+// Struct describing a field checked with serialise_fixed().
+struct test_field {
+    const char *name;
+    uint8_t decimals;
+    int32_t limit;              // Largest scaled magnitude
+};
+
+// Fields checked, as they are sent (heights, rates and forecasts).
+static const struct test_field test_fields[] = {
+    {"forecast", 0, SERIALISE_FORECAST_MAX_MIN},
+    {"height", 1, SERIALISE_HEIGHT_MAX_TENTHS},
+    {"rate", 2, SERIALISE_RATE_MAX_HUNDREDTHS},
+};
+#define SERIALISE_TEST_NUM_FIELDS (sizeof(test_fields) / sizeof(test_fields[0]))
+
+// Struct holding a check's counts.
+struct test_result {
+    uint64_t checked;
+    uint64_t mismatches;
+};
+
+// PRNG state.
+static uint64_t prng_state;
+
+/**
+ * @brief PRNG function (splitmix64).
+ * @param None.
+ * @retval Pseudo-random number.
+ */
+static uint64_t test_rand(void) {
+    uint64_t z = (prng_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @brief Reference format function. This function formats a value with
+ *        snprintf, dropping the sign of a negative zero.
+ * @param out Buffer written to (SERIALISE_TEST_REF_LEN chars).
+ * @param value Value being formatted.
+ * @param decimals Number of decimal places.
+ * @retval None.
+ */
+static void test_reference(char *out, float value, uint8_t decimals) {
+    snprintf(out, SERIALISE_TEST_REF_LEN, "%.*f", decimals, (double)value);
+
+    // "-0", "-0.0", "-0.00" are written unsigned
+    if ((out[0] == '-') && (strspn(out + 1, "0.") == strlen(out + 1))) {
+        memmove(out, out + 1, strlen(out));
+    }
+}
+
+/**
+ * @brief Mismatch report function.
+ * @param result Pointer to the check's counts.
+ * @param what Check name.
+ * @param value Value checked.
+ * @param got Serialiser output.
+ * @param expected Reference output.
+ * @retval None.
+ */
+static void test_mismatch(struct test_result *result, const char *what, float value,
+        const char *got, const char *expected) {
+    // Only the first few are printed
+    if (result->mismatches < 10) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        fprintf(stderr, "%s: %.9g (0x%08X) gave \"%s\", expected \"%s\"\n", what,
+                (double)value, bits, got, expected);
+    }
+
+    result->mismatches++;
+}
+
+/**
+ * @brief Field check function. This function checks serialise_fixed() of
+ *        a value against the reference, with the value clamped to the field's
+ *        range.
+ * @param field Field being checked.
+ * @param value Value being checked.
+ * @param result Pointer to the check's counts.
+ * @retval None.
+ */
+static void test_field_value(const struct test_field *field, float value,
+        struct test_result *result) {
+    char got[SERIALISE_U32_MAX_LEN + SERIALISE_TEST_REF_LEN];
+    char expected[SERIALISE_TEST_REF_LEN];
+
+    char *end = serialise_fixed(got, serialise_to_fixed(value, field->decimals,
+            field->limit), field->decimals);
+    *end = '\0';
+
+    // The largest value sent, in the field's units
+    float max = (float)field->limit;
+    for (uint8_t i = 0; i < field->decimals; i++) {
+        max /= 10.0f;
+    }
+
+    // Values beyond the largest sent are clamped, and NaN is sent as 0
+    float clamped = value;
+    if (isnan(value)) {
+        clamped = 0.0f;
+    } else if (value >= max) {
+        clamped = max;
+    } else if (value <= -max) {
+        clamped = -max;
+    }
+
+    test_reference(expected, clamped, field->decimals);
+    result->checked++;
+
+    if (strcmp(got, expected) != 0) {
+        test_mismatch(result, field->name, value, got, expected);
+    }
+}
+
+/**
+ * @brief Readings check function. This function checks serialise_readings()
+ *        of a pair of heights against "%.1f" of each, clamped to 0 - 999.9 cm.
+ * @param heights Heights being checked.
+ * @param result Pointer to the check's counts.
+ * @retval None.
+ */
+static void test_readings(const float *heights, struct test_result *result) {
+    char got[SERIALISE_READINGS_LEN];
+    char expected[SERIALISE_READINGS_LEN + (NUM_TANKS * SERIALISE_TEST_REF_LEN)];
+    char *pos = expected;
+
+    size_t len = serialise_readings(got, heights);
+
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        float height = heights[i];
+        if (isnan(height) || (height < 0.0f)) {
+            height = 0.0f;
+        } else if (height > (SERIALISE_HEIGHT_MAX_TENTHS / 10.0f)) {
+            height = SERIALISE_HEIGHT_MAX_TENTHS / 10.0f;
+        }
+
+        char value[SERIALISE_TEST_REF_LEN];
+        test_reference(value, height, 1);
+        pos += sprintf(pos, "T%u=%s", i + 1, value);
+    }
+    sprintf(pos, "!");
+
+    result->checked++;
+
+    if ((len != strlen(got)) || (len >= SERIALISE_READINGS_LEN) || (strcmp(got, expected) != 0)) {
+        test_mismatch(result, "readings", heights[0], got, expected);
+    }
+}
+
+/**
+ * @brief Value check function. This function checks one value in every
+ *        field, and in the readings (as each tank's height in turn).
+ * @param value Value being checked.
+ * @param fields Array of counts, one per field.
+ * @param readings Pointer to the readings counts.
+ * @retval None.
+ */
+static void test_value(float value, struct test_result *fields,
+        struct test_result *readings) {
+    for (uint8_t i = 0; i < SERIALISE_TEST_NUM_FIELDS; i++) {
+        test_field_value(&test_fields[i], value, &fields[i]);
+    }
+
+    float heights[NUM_TANKS];
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        for (uint8_t j = 0; j < NUM_TANKS; j++) {
+            heights[j] = (i == j) ? value : (float)j;
+        }
+        test_readings(heights, readings);
+    }
+}
+
+/**
+ * @brief Neighbours check function. This function checks a value, and the
+ *        floats either side of it.
+ * @param value Value being checked.
+ * @param fields Array of counts, one per field.
+ * @param readings Pointer to the readings counts.
+ * @retval None.
+ */
+static void test_neighbours(float value, struct test_result *fields,
+        struct test_result *readings) {
+    float below = value;
+    float above = value;
+
+    test_value(value, fields, readings);
+    for (uint8_t i = 0; i < SERIALISE_TEST_NEIGHBOURS; i++) {
+        below = nextafterf(below, -INFINITY);
+        above = nextafterf(above, INFINITY);
+        test_value(below, fields, readings);
+        test_value(above, fields, readings);
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t random = SERIALISE_TEST_DEFAULT_RANDOM;
+    uint64_t seed = SERIALISE_TEST_DEFAULT_SEED;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+            case 'n':
+                random = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-n random values] [-s seed]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    struct test_result fields[SERIALISE_TEST_NUM_FIELDS];
+    struct test_result readings = {0, 0};
+    memset(fields, 0, sizeof(fields));
+    prng_state = seed;
+
+    // The widest range checked (beyond every field's limit)
+    const float range = (float)SERIALISE_FORECAST_MAX_MIN * 1.1f;
+    const int32_t range_hundredths = (int32_t)(SERIALISE_RATE_MAX_HUNDREDTHS * 1.1f);
+
+    // Every exact tie for 0 and 1 decimal places (quarters) and 2 (eighths),
+    // and the floats either side of every 0, 1 and 2 decimal place half-way
+    // point (x.5, x.x5 and x.xx5), across the height and rate ranges
+    for (int32_t eighths = -(range_hundredths * 8) / 100; eighths <= (range_hundredths * 8) / 100;
+            eighths++) {
+        test_neighbours(eighths / 8.0f, fields, &readings);
+    }
+    for (int32_t hundredths = -range_hundredths; hundredths <= range_hundredths; hundredths++) {
+        test_neighbours(hundredths / 100.0f, fields, &readings);
+        test_neighbours(((2 * hundredths) + 1) / 200.0f, fields, &readings);
+    }
+
+    // Limits of every field, and special values
+    for (uint8_t i = 0; i < SERIALISE_TEST_NUM_FIELDS; i++) {
+        float max = (float)test_fields[i].limit;
+        for (uint8_t j = 0; j < test_fields[i].decimals; j++) {
+            max /= 10.0f;
+        }
+        test_neighbours(max, fields, &readings);
+        test_neighbours(-max, fields, &readings);
+    }
+    static const float specials[] = {0.0f, -0.0f, 1e-45f, -1e-45f, 1e30f, -1e30f,
+            INFINITY, -INFINITY, NAN};
+    for (uint8_t i = 0; i < (sizeof(specials) / sizeof(specials[0])); i++) {
+        test_value(specials[i], fields, &readings);
+    }
+
+    // Random values across the range, and random bit patterns
+    for (uint32_t i = 0; i < random; i++) {
+        float value = (((test_rand() >> 11) * 0x1.0p-53) * 2.0f * range) - range;
+        test_value(value, fields, &readings);
+
+        uint32_t bits = (uint32_t)test_rand();
+        memcpy(&value, &bits, sizeof(value));
+        test_value(value, fields, &readings);
+    }
+
+    bool ok = (readings.mismatches == 0);
+    for (uint8_t i = 0; i < SERIALISE_TEST_NUM_FIELDS; i++) {
+        printf("field=%s decimals=%u checked=%llu mismatches=%llu\n", test_fields[i].name,
+                test_fields[i].decimals, (unsigned long long)fields[i].checked,
+                (unsigned long long)fields[i].mismatches);
+        if (fields[i].mismatches > 0) {
+            ok = false;
+        }
+    }
+    printf("field=readings checked=%llu mismatches=%llu\n",
+            (unsigned long long)readings.checked, (unsigned long long)readings.mismatches);
+    printf("result=%s\n", ok ? "pass" : "FAIL");
+
+    return ok ? 0 : 1;
+}
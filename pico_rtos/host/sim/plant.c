@@ -0,0 +1,288 @@
+ /**
+ **************************************************************
+ * @file plant.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Simulated tank plant file. This file handles functionality
+ *        specific to modelling each tank's water level (valve inflow,
+ *        drain outflow, uncontrolled supply and consumption), the dynamics
+ *        of its fill/drain valves, and the ADC frames read from its pressure
+ *        sensor (including noise and surface ripple). All randomness comes from a seeded
+ *        generator, so a run is deterministic for a given seed.
+ ***************************************************************
+ */
+
+#include <math.h>
+#include "plant.h"
+
+// Physical parameters of each simulated tank (tank n is at index n - 1).
+// Tank 1 is drawn down by irrigation demand and refilled through its fill
+// valve. Tank 2 is topped up by an uncontrolled supply and kept in band
+// through its drain valve. Tanks 3 to NUM_TANKS have no valves (see
+// meas_pipeline.h), so their supply and demand balance over a day (the
+// level dips by about 17 cm and recovers).
+#define PLANT_MONITORED_TANK_CFG { \
+        .tank_height_cm = 80.0, .initial_height_cm = 40.0, \
+        .fill_rate_cm_per_sec = 0.05, .drain_coeff = 0.02, \
+        .supply_cm_per_sec = 0.003, .demand_cm_per_sec = 0.003, .demand_swing = 0.2, \
+        .valve_delay_sec = 2.0, .valve_travel_sec = 5.0, \
+        .sensor_noise_counts = 20.0, .ripple_cm = 0.2, \
+    }
+
+const struct plant_tank_cfg plant_default_cfgs[NUM_TANKS] = {
+    {
+        .tank_height_cm = 80.0, .initial_height_cm = 30.0,
+        .fill_rate_cm_per_sec = 0.05, .drain_coeff = 0.02,
+        .supply_cm_per_sec = 0.0, .demand_cm_per_sec = 0.004, .demand_swing = 0.8,
+        .valve_delay_sec = 2.0, .valve_travel_sec = 5.0,
+        .sensor_noise_counts = 20.0, .ripple_cm = 0.2,
+    },
+    {
+        .tank_height_cm = 80.0, .initial_height_cm = 55.0,
+        .fill_rate_cm_per_sec = 0.05, .drain_coeff = 0.02,
+        .supply_cm_per_sec = 0.006, .demand_cm_per_sec = 0.002, .demand_swing = 0.5,
+        .valve_delay_sec = 2.0, .valve_travel_sec = 5.0,
+        .sensor_noise_counts = 20.0, .ripple_cm = 0.2,
+    },
+#if (NUM_TANKS >= 3)
+    PLANT_MONITORED_TANK_CFG,
+#endif
+#if (NUM_TANKS >= 4)
+    PLANT_MONITORED_TANK_CFG,
+#endif
+#if (NUM_TANKS >= 5)
+    PLANT_MONITORED_TANK_CFG,
+#endif
+#if (NUM_TANKS >= 6)
+    PLANT_MONITORED_TANK_CFG,
+#endif
+#if (NUM_TANKS >= 7)
+    PLANT_MONITORED_TANK_CFG,
+#endif
+};
+
+// Number of seconds in one day (period of the demand swing).
+#define PLANT_DAY_SEC 86400.0
+
+// Period of the surface ripple, in sec.
+#define PLANT_RIPPLE_PERIOD_SEC 3.7
+
+/**
+ * @brief Generator seeding function. This function seeds the pseudo-random
+ *        number generator.
+ * @param rng Pointer to generator.
+ * @param seed Seed (any value, including zero).
+ * @retval None.
+ */
+void plant_rng_seed(struct plant_rng *rng, uint64_t seed) {
+    // xorshift can't leave the all-zero state, so mix the seed first
+    rng->state = (seed * 0x9E3779B97F4A7C15ULL) ^ 0xD1B54A32D192ED03ULL;
+    if (rng->state == 0) {
+        rng->state = 1;
+    }
+
+    rng->have_spare = false;
+    rng->spare = 0.0;
+}
+
+/**
+ * @brief Uniform random number function.
+ * @param rng Pointer to generator.
+ * @retval Random number in [0, 1).
+ */
+double plant_rng_uniform(struct plant_rng *rng) {
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    uint64_t value = rng->state * 0x2545F4914F6CDD1DULL;
+
+    return (value >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/**
+ * @brief Gaussian random number function (Box-Muller).
+ * @param rng Pointer to generator.
+ * @retval Random number with zero mean and unit std. deviation.
+ */
+double plant_rng_gaussian(struct plant_rng *rng) {
+    if (rng->have_spare) {
+        rng->have_spare = false;
+        return rng->spare;
+    }
+
+    double u1 = plant_rng_uniform(rng);
+    double u2 = plant_rng_uniform(rng);
+    if (u1 < 1e-300) {
+        u1 = 1e-300;
+    }
+
+    double radius = sqrt(-2.0 * log(u1));
+    rng->spare = radius * sin(2.0 * M_PI * u2);
+    rng->have_spare = true;
+
+    return radius * cos(2.0 * M_PI * u2);
+}
+
+/**
+ * @brief Tank initialiser function.
+ * @param tank Pointer to simulated tank.
+ * @param cfg Pointer to physical parameters of the tank.
+ * @retval None.
+ */
+void plant_tank_init(struct plant_tank *tank, const struct plant_tank_cfg *cfg) {
+    tank->cfg = (*cfg);
+    tank->height_cm = cfg->initial_height_cm;
+    tank->fill_valve = (struct plant_valve){false, 0.0, 0.0};
+    tank->drain_valve = (struct plant_valve){false, 0.0, 0.0};
+}
+
+/**
+ * @brief Valve GPIO setter function. This function sets the levels of a
+ *        tank's valve GPIOs (as done by the level control task).
+ * @param tank Pointer to simulated tank.
+ * @param fill Level of the fill valve GPIO.
+ * @param drain Level of the drain valve GPIO.
+ * @param now_sec Current simulated time, in sec.
+ * @retval None.
+ */
+void plant_set_valves(struct plant_tank *tank, bool fill, bool drain, double now_sec) {
+    if (fill != tank->fill_valve.commanded) {
+        tank->fill_valve.commanded = fill;
+        tank->fill_valve.commanded_at_sec = now_sec;
+    }
+
+    if (drain != tank->drain_valve.commanded) {
+        tank->drain_valve.commanded = drain;
+        tank->drain_valve.commanded_at_sec = now_sec;
+    }
+}
+
+/**
+ * @brief Valve step function. This function moves a valve towards its
+ *        commanded position, once the actuation delay has passed.
+ * @param valve Pointer to valve.
+ * @param cfg Pointer to physical parameters of the tank.
+ * @param now_sec Current simulated time, in sec.
+ * @param dt_sec Time step, in sec.
+ * @retval None.
+ */
+static void plant_valve_step(struct plant_valve *valve, const struct plant_tank_cfg *cfg,
+        double now_sec, double dt_sec) {
+    if ((now_sec - valve->commanded_at_sec) < cfg->valve_delay_sec) {
+        return;
+    }
+
+    float step = (cfg->valve_travel_sec > 0.0) ? (dt_sec / cfg->valve_travel_sec) : 1.0;
+    if (valve->commanded) {
+        valve->opening = fminf(1.0, valve->opening + step);
+    } else {
+        valve->opening = fmaxf(0.0, valve->opening - step);
+    }
+}
+
+/**
+ * @brief Plant step function. This function advances a tank's water level
+ *        and valves by one time step.
+ * @param tank Pointer to simulated tank.
+ * @param now_sec Current simulated time, in sec.
+ * @param dt_sec Time step, in sec.
+ * @retval None.
+ */
+void plant_step(struct plant_tank *tank, double now_sec, double dt_sec) {
+    const struct plant_tank_cfg *cfg = &tank->cfg;
+
+    plant_valve_step(&tank->fill_valve, cfg, now_sec, dt_sec);
+    plant_valve_step(&tank->drain_valve, cfg, now_sec, dt_sec);
+
+    // Inflow through the fill valve and uncontrolled supply, outflow through
+    // the drain valve (which falls with head), and consumption which peaks
+    // once a day.
+    double inflow = (tank->fill_valve.opening * cfg->fill_rate_cm_per_sec)
+            + cfg->supply_cm_per_sec;
+    double outflow = tank->drain_valve.opening * cfg->drain_coeff
+            * sqrt(fmax(tank->height_cm, 0.0));
+    double demand = cfg->demand_cm_per_sec
+            * (1.0 + (cfg->demand_swing * sin((2.0 * M_PI * now_sec) / PLANT_DAY_SEC)));
+
+    tank->height_cm += (inflow - outflow - demand) * dt_sec;
+
+    // Water beyond the tank height overflows, and the tank can't go below
+    // empty.
+    if (tank->height_cm > cfg->tank_height_cm) {
+        tank->height_cm = cfg->tank_height_cm;
+    }
+
+    if (tank->height_cm < 0.0) {
+        tank->height_cm = 0.0;
+    }
+}
+
+/**
+ * @brief Sensor reading function. This function calculates the decimated
+ *        ADC reading of a tank's pressure sensor, by inverting the
+ *        calibration used by the measurement pipeline.
+ * @param tank Pointer to simulated tank.
+ * @param zero_pressure_offset Pressure sensor zero offset of the tank.
+ * @param ref_raw Decimated reading of the offset/reference channel.
+ * @param now_sec Current simulated time, in sec.
+ * @param rng Pointer to generator used for sensor noise.
+ * @retval Decimated ADC reading.
+ */
+uint16_t plant_sensor_raw(const struct plant_tank *tank, float zero_pressure_offset,
+        uint16_t ref_raw, double now_sec, struct plant_rng *rng) {
+    double height = tank->height_cm
+            + (tank->cfg.ripple_cm * sin((2.0 * M_PI * now_sec) / PLANT_RIPPLE_PERIOD_SEC));
+
+    double pressure = ((height - 1.656) / 0.0124) + zero_pressure_offset;
+    double sensor_voltage = (pressure + (4000.0 / 9.0)) / (20000.0 / 9.0);
+    double pin_voltage = (sensor_voltage * 280.0) / 500.0;
+    double raw = ((pin_voltage * OVERSAMPLED_RES_LEVELS) / VREF)
+            + (tank->cfg.sensor_noise_counts * plant_rng_gaussian(rng));
+
+    // The ADC offset is only seen when the pipeline corrects for it (the 
+    // zero pressure offsets were calibrated with it included otherwise)
+#if (REF_CHANNEL_MODE == REF_CHANNEL_GND)
+    raw += ref_raw;
+#else
+    (void)ref_raw;
+#endif
+
+    if (raw < 0.0) {
+        raw = 0.0;
+    }
+
+    if (raw > UINT16_MAX) {
+        raw = UINT16_MAX;
+    }
+
+    return (uint16_t)lround(raw);
+}
+
+/**
+ * @brief Frame generation function. This function samples the simulated
+ *        sensors as one ADC frame.
+ * @param tanks Array of simulated tanks (tank n is at index n - 1).
+ * @param now_sec Current simulated time, in sec.
+ * @param rng Pointer to generator used for sensor noise.
+ * @param frame Pointer to frame populated.
+ * @retval None.
+ */
+void plant_sample_frame(const struct plant_tank *tanks, double now_sec,
+        struct plant_rng *rng, struct adc_frame *frame) {
+    double ref = PLANT_REF_RAW + (PLANT_REF_NOISE_COUNTS * plant_rng_gaussian(rng));
+    uint16_t ref_raw = (uint16_t)lround(fmax(ref, 0.0));
+
+    frame->timestamp_us = (uint64_t)llround(now_sec * 1e6);
+    for (uint8_t channel = 0; channel < ADC_FRAME_CHANNELS; channel++) {
+        frame->raw[channel] = 0;
+    }
+    frame->raw[REF_CHANNEL] = ref_raw;
+
+    // The offset is added to the sensor reading, as it is seen by the ADC 
+    // (see plant_sensor_raw())
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        const struct tank_cfg *cfg = &meas_config_defaults.tanks[i];
+        frame->raw[cfg->pressure_channel] = plant_sensor_raw(&tanks[i],
+                cfg->zero_pressure_offset, ref_raw, now_sec, rng);
+    }
+}
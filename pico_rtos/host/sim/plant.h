@@ -0,0 +1,76 @@
+ /**
+ **************************************************************
+ * @file plant.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the simulated tank plant.
+ ***************************************************************
+ */
+
+#ifndef PLANT_H
+#define PLANT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "meas_pipeline.h"
+
+// Decimated reading and noise (std. deviation, in ADC counts) of the
+// offset/reference channel.
+#define PLANT_REF_RAW 80.0
+#define PLANT_REF_NOISE_COUNTS 4.0
+
+// Struct holding the state of the deterministic pseudo-random number
+// generator (xorshift64*), so runs are repeatable for a given seed.
+struct plant_rng {
+    uint64_t state;
+    bool have_spare;
+    double spare;
+};
+
+// Struct holding the physical parameters of a simulated tank.
+struct plant_tank_cfg {
+    float tank_height_cm;           // Height at which the tank overflows
+    float initial_height_cm;        // Height at the start of the run
+    float fill_rate_cm_per_sec;     // Rise while the fill valve is fully open
+    float drain_coeff;              // Drain outflow (cm/sec) per sqrt(cm)
+    float supply_cm_per_sec;        // Uncontrolled inflow (e.g. rainwater)
+    float demand_cm_per_sec;        // Mean consumption (e.g. irrigation)
+    float demand_swing;             // Daily swing in demand (fraction)
+    float valve_delay_sec;          // Delay before a valve starts to move
+    float valve_travel_sec;         // Time for a valve to fully open/close
+    float sensor_noise_counts;      // Sensor noise (std. dev., ADC counts)
+    float ripple_cm;                // Amplitude of surface ripple
+};
+
+// Struct holding the state of a simulated valve.
+struct plant_valve {
+    bool commanded;                 // Level of the valve GPIO
+    double commanded_at_sec;        // Time the GPIO last changed
+    float opening;                  // 0 (closed) to 1 (fully open)
+};
+
+// Struct holding the state of a simulated tank.
+struct plant_tank {
+    struct plant_tank_cfg cfg;
+    double height_cm;
+    struct plant_valve fill_valve;
+    struct plant_valve drain_valve;
+};
+
+// Default physical parameters of each simulated tank (tank n is at index
+// n - 1).
+extern const struct plant_tank_cfg plant_default_cfgs[NUM_TANKS];
+
+// Function prototypes
+void plant_rng_seed(struct plant_rng *rng, uint64_t seed);
+double plant_rng_uniform(struct plant_rng *rng);
+double plant_rng_gaussian(struct plant_rng *rng);
+void plant_tank_init(struct plant_tank *tank, const struct plant_tank_cfg *cfg);
+void plant_set_valves(struct plant_tank *tank, bool fill, bool drain, double now_sec);
+void plant_step(struct plant_tank *tank, double now_sec, double dt_sec);
+uint16_t plant_sensor_raw(const struct plant_tank *tank, float zero_pressure_offset,
+        uint16_t ref_raw, double now_sec, struct plant_rng *rng);
+void plant_sample_frame(const struct plant_tank *tanks, double now_sec,
+        struct plant_rng *rng, struct adc_frame *frame);
+
+#endif
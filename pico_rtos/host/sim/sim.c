@@ -0,0 +1,425 @@
+ /**
+ **************************************************************
+ * @file sim.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Tank simulator. This tool runs the firmware's measurement
+ *        pipeline against a simulated plant (see plant.c) under a virtual
+ *        tick, so weeks of fill/drain hysteresis behaviour can be seen in
+ *        seconds. Every measurement period, the simulated ADC frame is
+ *        processed by the pipeline, and the resulting valve states are put
+ *        on the simulated valve GPIOs (as done by the level control tasks).
+ *        Metrics are printed to stdout, and are identical for a given seed.
+ *        The firmware's wake-ups (its periodic tasks and timers, and the LED
+ *        pattern edges for the simulated status) are counted alongside, for
+ *        the kernel tick running and for low power (tickless) idle, with
+ *        the idle residency each gives.
+ *
+ *        Usage: sim [-s seed] [-d days] [-t trace.csv] [-i trace interval]
+ *                   [-a awake time per task wake-up (usec)]
+ ***************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "meas_pipeline.h"
+#include "led_pattern.h"
+#include "plant.h"
+
+// Virtual tick rate (matches configTICK_RATE_HZ in FreeRTOSConfig.h).
+#define SIM_TICK_RATE_HZ 1000
+
+// Virtual ticks between plant steps.
+#define SIM_PLANT_STEP_TICKS 100
+
+// Virtual ticks between ADC frames (the measurement task period).
+#define SIM_FRAME_TICKS (MEAS_SAMPLE_PERIOD * SIM_TICK_RATE_HZ)
+
+// Number of seconds in one day.
+#define SIM_DAY_SEC 86400.0
+
+// Firmware periods which wake the system (SUPERVISOR_PERIOD_MSEC in
+// supervisor.h, SYS_HOUSEKEEPING_PERIOD_MSEC in sys.h), in msec. These and
+// the LED timer start with the scheduler. The measurement task's period
+// starts after its warm start, so it is off their 100 msec grid.
+#define SIM_SUPERVISOR_PERIOD_MS 500
+#define SIM_HOUSEKEEPING_PERIOD_MS 1000
+#define SIM_MEAS_PHASE_MS 1
+
+// Time a core is awake for a tick with nothing to run, and by default for
+// a wake-up which runs tasks (in usec, estimates for the RP2040 at 125 MHz).
+#define SIM_TICK_AWAKE_US 3.0
+#define SIM_DEFAULT_TASK_AWAKE_US 200.0
+
+// Periodic wake sources.
+#define SIM_WAKE_MEAS 0
+#define SIM_WAKE_SUPERVISOR 1
+#define SIM_WAKE_HOUSEKEEPING 2
+#define SIM_WAKE_LED 3
+#define SIM_NUM_WAKE_SOURCES 4
+
+// Struct holding the firmware's wake-up schedule.
+struct sim_wake {
+    uint64_t next_ms[SIM_NUM_WAKE_SOURCES];     // Next wake-up of each source
+    uint8_t led_step;                           // LED pattern step
+    unsigned long wakeups;                      // Wake-ups which run tasks
+};
+
+// Struct holding the metrics gathered for a tank.
+struct sim_metrics {
+    unsigned long fill_cycles;          // Fill valve openings
+    unsigned long drain_cycles;         // Drain valve openings
+    double fill_overshoot_cm;           // Worst rise past the fill to level
+    double drain_overshoot_cm;          // Worst fall past the drain to level
+    double below_band_sec;              // Time below the min fill level
+    double above_band_sec;              // Time above the max fill level
+    double overflow_sec;                // Time at the tank height
+    double empty_sec;                   // Time empty
+    double fill_open_sec;               // Time with the fill valve open
+    double drain_open_sec;              // Time with the drain valve open
+    double min_height_cm;
+    double max_height_cm;
+    unsigned long leak_events;          // Leak alerts (false alarms here)
+
+    // Tracking of the level after a valve closes
+    bool after_fill;
+    bool after_drain;
+    double peak_after_fill_cm;
+    double trough_after_drain_cm;
+};
+
+/**
+ * @brief Metrics update function. This function updates a tank's metrics
+ *        over one plant step.
+ * @param metrics Pointer to metrics.
+ * @param tank Pointer to simulated tank.
+ * @param cfg Pointer to configuration of the tank.
+ * @param dt_sec Time step, in sec.
+ * @retval None.
+ */
+static void sim_update_metrics(struct sim_metrics *metrics, const struct plant_tank *tank,
+        const struct tank_cfg *cfg, double dt_sec) {
+    double height = tank->height_cm;
+
+    metrics->min_height_cm = fmin(metrics->min_height_cm, height);
+    metrics->max_height_cm = fmax(metrics->max_height_cm, height);
+
+    if (height < cfg->min_fill_level) {
+        metrics->below_band_sec += dt_sec;
+    }
+
+    if (height > cfg->max_fill_level) {
+        metrics->above_band_sec += dt_sec;
+    }
+
+    if (height >= tank->cfg.tank_height_cm) {
+        metrics->overflow_sec += dt_sec;
+    }
+
+    if (height <= 0.0) {
+        metrics->empty_sec += dt_sec;
+    }
+
+    if (tank->fill_valve.opening > 0.0) {
+        metrics->fill_open_sec += dt_sec;
+    }
+
+    if (tank->drain_valve.opening > 0.0) {
+        metrics->drain_open_sec += dt_sec;
+    }
+
+    // Overshoot is the furthest the level goes past the target after the
+    // valve is commanded closed (valve delay/travel and filtering lag).
+    if (metrics->after_fill) {
+        metrics->peak_after_fill_cm = fmax(metrics->peak_after_fill_cm, height);
+        metrics->fill_overshoot_cm = fmax(metrics->fill_overshoot_cm,
+                metrics->peak_after_fill_cm - cfg->fill_to_level);
+    }
+
+    if (metrics->after_drain) {
+        metrics->trough_after_drain_cm = fmin(metrics->trough_after_drain_cm, height);
+        metrics->drain_overshoot_cm = fmax(metrics->drain_overshoot_cm,
+                cfg->drain_to_level - metrics->trough_after_drain_cm);
+    }
+}
+
+/**
+ * @brief Command metrics function. This function updates a tank's metrics
+ *        as per the control commands issued for a frame.
+ * @param metrics Pointer to metrics.
+ * @param commands Control commands (CTRL_CMD_*).
+ * @param height True height of the tank, in cm.
+ * @retval None.
+ */
+static void sim_count_commands(struct sim_metrics *metrics, uint8_t commands, double height) {
+    if (commands & CTRL_CMD_START_FILL) {
+        metrics->fill_cycles++;
+        metrics->after_fill = false;
+    }
+
+    if (commands & CTRL_CMD_STOP_FILL) {
+        metrics->after_fill = true;
+        metrics->peak_after_fill_cm = height;
+    }
+
+    if (commands & CTRL_CMD_START_DRAIN) {
+        metrics->drain_cycles++;
+        metrics->after_drain = false;
+    }
+
+    if (commands & CTRL_CMD_STOP_DRAIN) {
+        metrics->after_drain = true;
+        metrics->trough_after_drain_cm = height;
+    }
+}
+
+/**
+ * @brief Wake-up schedule initialise function.
+ * @param wake Pointer to wake-up schedule.
+ * @retval None.
+ */
+static void sim_wake_init(struct sim_wake *wake) {
+    wake->next_ms[SIM_WAKE_MEAS] = SIM_MEAS_PHASE_MS;
+    wake->next_ms[SIM_WAKE_SUPERVISOR] = SIM_SUPERVISOR_PERIOD_MS;
+    wake->next_ms[SIM_WAKE_HOUSEKEEPING] = SIM_HOUSEKEEPING_PERIOD_MS;
+    wake->next_ms[SIM_WAKE_LED] = LED_STEP_PERIOD_MSEC;
+    wake->led_step = 0;
+    wake->wakeups = 0;
+}
+
+/**
+ * @brief Wake-up schedule run function. This function counts the wake-ups
+ *        before a time, where sources due at the same msec share a wake-up
+ *        (as they are due at the same tick). The LED timer is set to the
+ *        next edge of the pattern for the current status, as in led.c.
+ * @param wake Pointer to wake-up schedule.
+ * @param until_ms Time to run the schedule until, in msec.
+ * @param led_status LED status flags (LED_STATUS_*).
+ * @retval None.
+ */
+static void sim_wake_run(struct sim_wake *wake, uint64_t until_ms, uint32_t led_status) {
+    while (true) {
+        uint64_t now_ms = wake->next_ms[0];
+        for (uint8_t i = 1; i < SIM_NUM_WAKE_SOURCES; i++) {
+            now_ms = (wake->next_ms[i] < now_ms) ? wake->next_ms[i] : now_ms;
+        }
+
+        if (now_ms >= until_ms) {
+            return;
+        }
+
+        wake->wakeups++;
+
+        if (wake->next_ms[SIM_WAKE_MEAS] == now_ms) {
+            wake->next_ms[SIM_WAKE_MEAS] += MEAS_SAMPLE_PERIOD * 1000;
+        }
+
+        if (wake->next_ms[SIM_WAKE_SUPERVISOR] == now_ms) {
+            wake->next_ms[SIM_WAKE_SUPERVISOR] += SIM_SUPERVISOR_PERIOD_MS;
+        }
+
+        if (wake->next_ms[SIM_WAKE_HOUSEKEEPING] == now_ms) {
+            wake->next_ms[SIM_WAKE_HOUSEKEEPING] += SIM_HOUSEKEEPING_PERIOD_MS;
+        }
+
+        if (wake->next_ms[SIM_WAKE_LED] == now_ms) {
+            uint16_t pattern = led_pattern_select(led_status);
+            uint8_t hold_steps = led_pattern_hold_steps(pattern, wake->led_step);
+            wake->led_step = (wake->led_step + hold_steps) % LED_PATTERN_STEPS;
+            wake->next_ms[SIM_WAKE_LED] += hold_steps * LED_STEP_PERIOD_MSEC;
+        }
+    }
+}
+
+/**
+ * @brief Wake-up report function. This function prints the wake-ups per
+ *        second and idle residency (the proportion of time asleep) with the
+ *        kernel tick running, where every tick is a wake-up, and with low
+ *        power idle, where only wake-ups which run tasks remain.
+ * @param wake Pointer to wake-up schedule.
+ * @param simulated_sec Simulated time, in sec.
+ * @param task_awake_us Time awake for a wake-up which runs tasks, in usec.
+ * @retval None.
+ */
+static void sim_wake_report(const struct sim_wake *wake, double simulated_sec,
+        double task_awake_us) {
+    double task_wakeups = wake->wakeups / simulated_sec;
+    double ticks = SIM_TICK_RATE_HZ;
+    double tick_awake = ((ticks * SIM_TICK_AWAKE_US) + (task_wakeups * task_awake_us)) / 1e6;
+    double tickless_awake = (task_wakeups * (SIM_TICK_AWAKE_US + task_awake_us)) / 1e6;
+
+    printf("power task_awake_us=%.0f tick_wakeups_per_s=%.2f tick_idle_residency=%.2f%% "
+            "tickless_wakeups_per_s=%.2f tickless_idle_residency=%.2f%%\n", task_awake_us,
+            ticks, (1.0 - tick_awake) * 100.0, task_wakeups, (1.0 - tickless_awake) * 100.0);
+}
+
+int main(int argc, char **argv) {
+    uint64_t seed = 1;
+    double days = 14.0;
+    const char *trace_path = NULL;
+    double trace_interval_sec = 60.0;
+    double task_awake_us = SIM_DEFAULT_TASK_AWAKE_US;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:d:t:i:a:")) != -1) {
+        switch (opt) {
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'd':
+                days = atof(optarg);
+                break;
+            case 't':
+                trace_path = optarg;
+                break;
+            case 'i':
+                trace_interval_sec = atof(optarg);
+                break;
+            case 'a':
+                task_awake_us = atof(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-s seed] [-d days] [-t trace.csv] "
+                        "[-i trace interval (sec)] [-a task awake time (usec)]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    FILE *trace = NULL;
+    if (trace_path != NULL) {
+        trace = fopen(trace_path, "w");
+        if (trace == NULL) {
+            perror(trace_path);
+            return 2;
+        }
+
+        fprintf(trace, "time_sec");
+        for (uint8_t i = 0; i < NUM_TANKS; i++) {
+            fprintf(trace, ",t%u_true_cm,t%u_measured_cm,t%u_fill,t%u_drain", i + 1,
+                    i + 1, i + 1, i + 1);
+        }
+        fprintf(trace, "\n");
+    }
+
+    struct plant_rng rng;
+    plant_rng_seed(&rng, seed);
+
+    struct plant_tank tanks[NUM_TANKS];
+    struct sim_metrics metrics[NUM_TANKS];
+    static struct tank_state states[NUM_TANKS];
+    static struct ref_filter ref_filter;
+    const struct meas_config *config = &meas_config_defaults;
+    meas_pipeline_init(states, &ref_filter, config);
+
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        plant_tank_init(&tanks[i], &plant_default_cfgs[i]);
+        memset(&metrics[i], 0, sizeof(metrics[i]));
+        metrics[i].min_height_cm = tanks[i].height_cm;
+        metrics[i].max_height_cm = tanks[i].height_cm;
+
+        // Control is enabled for the whole run (on the tanks with valves)
+        states[i].ctrl_on = TANK_HAS_VALVES(i + 1);
+    }
+
+    // Warm start burst, as done by the measurement task at startup
+    for (uint8_t j = 0; j < AVG_WINDOW_WIDTH; j++) {
+        struct adc_frame frame;
+        plant_sample_frame(tanks, 0.0, &rng, &frame);
+        meas_pipeline_prime(states, &ref_filter, config, &frame, j, NULL);
+    }
+
+    uint64_t end_tick = (uint64_t)(days * SIM_DAY_SEC * SIM_TICK_RATE_HZ);
+    uint64_t trace_ticks = (uint64_t)(trace_interval_sec * SIM_TICK_RATE_HZ);
+    double dt_sec = (double)SIM_PLANT_STEP_TICKS / SIM_TICK_RATE_HZ;
+
+    struct sim_wake wake;
+    sim_wake_init(&wake);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (uint64_t tick = 0; tick < end_tick; tick += SIM_PLANT_STEP_TICKS) {
+        double now_sec = (double)tick / SIM_TICK_RATE_HZ;
+
+        // Measurement task period: process a frame and set the valve GPIOs
+        if ((tick % SIM_FRAME_TICKS) == 0) {
+            struct adc_frame frame;
+            struct pipeline_output output;
+            plant_sample_frame(tanks, now_sec, &rng, &frame);
+            meas_pipeline_process(states, &ref_filter, config, &frame, &output);
+
+            for (uint8_t i = 0; i < NUM_TANKS; i++) {
+                sim_count_commands(&metrics[i], output.ctrl_commands[i], tanks[i].height_cm);
+                plant_set_valves(&tanks[i], states[i].filling, states[i].draining, now_sec);
+
+                if (output.events & ALERT_TANK_EVENT(ALERT_EVENT_LEAK, config->tanks[i].tank)) {
+                    metrics[i].leak_events++;
+                }
+            }
+        }
+
+        if ((trace != NULL) && (trace_ticks > 0) && ((tick % trace_ticks) == 0)) {
+            fprintf(trace, "%.1f", now_sec);
+            for (uint8_t i = 0; i < NUM_TANKS; i++) {
+                fprintf(trace, ",%.3f,%.3f,%.2f,%.2f", tanks[i].height_cm, states[i].height,
+                        tanks[i].fill_valve.opening, tanks[i].drain_valve.opening);
+            }
+            fprintf(trace, "\n");
+        }
+
+        for (uint8_t i = 0; i < NUM_TANKS; i++) {
+            plant_step(&tanks[i], now_sec, dt_sec);
+            sim_update_metrics(&metrics[i], &tanks[i], &config->tanks[i], dt_sec);
+        }
+
+        // Firmware wake-ups over the plant step, with the LED showing the
+        // valve states (the level control tasks' wake-ups share the
+        // measurement task's, as it sends their commands)
+        uint32_t led_status = LED_STATUS_CTRL_ENABLED;
+        for (uint8_t i = 0; i < NUM_TANKS; i++) {
+            if (states[i].filling) {
+                led_status |= (i == 0) ? LED_STATUS_T1_FILLING : LED_STATUS_T2_FILLING;
+            }
+            if (states[i].draining) {
+                led_status |= (i == 0) ? LED_STATUS_T1_DRAINING : LED_STATUS_T2_DRAINING;
+            }
+        }
+        sim_wake_run(&wake, ((tick + SIM_PLANT_STEP_TICKS) * 1000) / SIM_TICK_RATE_HZ,
+                led_status);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (trace != NULL) {
+        fclose(trace);
+    }
+
+    // Metrics (deterministic for a given seed) on stdout
+    printf("seed=%llu days=%.2f\n", (unsigned long long)seed, days);
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        const struct sim_metrics *m = &metrics[i];
+        printf("T%u fill_cycles=%lu drain_cycles=%lu fill_overshoot_cm=%.2f "
+                "drain_overshoot_cm=%.2f below_band_sec=%.0f above_band_sec=%.0f "
+                "overflow_sec=%.0f empty_sec=%.0f fill_open_sec=%.0f drain_open_sec=%.0f "
+                "min_height_cm=%.2f max_height_cm=%.2f leak_events=%lu\n", config->tanks[i].tank,
+                m->fill_cycles, m->drain_cycles, m->fill_overshoot_cm, m->drain_overshoot_cm,
+                m->below_band_sec, m->above_band_sec, m->overflow_sec, m->empty_sec,
+                m->fill_open_sec, m->drain_open_sec, m->min_height_cm, m->max_height_cm,
+                m->leak_events);
+    }
+    sim_wake_report(&wake, (double)end_tick / SIM_TICK_RATE_HZ, task_awake_us);
+
+    // Run time (varies between runs) on stderr
+    double elapsed = (end.tv_sec - start.tv_sec) + ((end.tv_nsec - start.tv_nsec) / 1e9);
+    double simulated = (double)end_tick / SIM_TICK_RATE_HZ;
+    fprintf(stderr, "simulated_sec=%.0f elapsed_sec=%.3f speedup=%.0f\n", simulated,
+            elapsed, (elapsed > 0.0) ? (simulated / elapsed) : 0.0);
+
+    return 0;
+}
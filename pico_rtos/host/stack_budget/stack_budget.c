@@ -0,0 +1,227 @@
+ /**
+ **************************************************************
+ * @file stack_budget.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Stack budget tool. This tool reads the STACK/HEAP lines printed by
+ *        a STACK_BUDGET_REPORT build of the firmware (see sys.c) after a 
+ *        representative workload, and rewrites task_stacks.h with each 
+ *        measured task's stack depth set to its peak use plus a safety 
+ *        margin. The heap is resized by the change in stack sizes (stacks 
+ *        are allocated from it), plus the same margin. Defines which weren't
+ *        measured (e.g. tasks disabled in the measured build) are kept. 
+ *
+ *        Usage: stack_budget [-m margin (%)] <task_stacks.h> <report> 
+ *                            [report ...] > task_stacks.h.new
+ ***************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Default safety margin added to peak use (in %). 
+#define STACK_BUDGET_DEFAULT_MARGIN_PCT 25
+
+// Stack depths are rounded up to a multiple of this (in words), and are 
+// never set below the minimum (the kernel needs room to save a task's 
+// context, and interrupts may add to a task's stack use). 
+#define STACK_BUDGET_DEPTH_ALIGN 8
+#define STACK_BUDGET_MIN_DEPTH 128
+
+// Heap size is rounded up to a multiple of this (in bytes). 
+#define STACK_BUDGET_HEAP_ALIGN 1024
+
+// Bytes in a stack word (RP2040). 
+#define STACK_BUDGET_WORD_BYTES 4
+
+// Name of the heap size define. 
+#define STACK_BUDGET_HEAP_DEFINE "SYS_HEAP_SIZE_BYTES"
+
+// Maximum number of defines, and maximum lengths of a define name and line. 
+#define STACK_BUDGET_MAX_DEFINES 32
+#define STACK_BUDGET_NAME_LEN 64
+#define STACK_BUDGET_LINE_LEN 256
+
+// Struct holding the measurements of a define. 
+struct budget {
+    char define[STACK_BUDGET_NAME_LEN];
+    unsigned long depth;        // Stack depth (words) or heap size (bytes)
+    unsigned long peak;         // Peak use across every report
+    unsigned long new_depth;
+};
+
+/**
+ * @brief Round up function. 
+ * @param value Value being rounded. 
+ * @param align Multiple rounded up to. 
+ * @retval Rounded value. 
+ */
+static unsigned long round_up(unsigned long value, unsigned long align) {
+    return ((value + align - 1) / align) * align;
+}
+
+/**
+ * @brief Budget lookup function. This function finds the budget of a define,
+ *        adding it if not found. 
+ * @param budgets Array of budgets. 
+ * @param num_budgets Pointer to number of budgets. 
+ * @param define Name of the define. 
+ * @retval Pointer to the budget, or NULL if there are too many. 
+ */
+static struct budget *find_budget(struct budget *budgets, int *num_budgets, 
+        const char *define) {
+    for (int i = 0; i < (*num_budgets); i++) {
+        if (strcmp(budgets[i].define, define) == 0) {
+            return &budgets[i];
+        }
+    }
+
+    if ((*num_budgets) >= STACK_BUDGET_MAX_DEFINES) {
+        return NULL;
+    }
+
+    struct budget *budget = &budgets[(*num_budgets)++];
+    memset(budget, 0, sizeof(*budget));
+    snprintf(budget->define, STACK_BUDGET_NAME_LEN, "%s", define);
+    return budget;
+}
+
+/**
+ * @brief Report load function. This function reads the STACK/HEAP lines 
+ *        from a report, keeping the highest peak of each define. 
+ * @param path Path of the report. 
+ * @param budgets Array of budgets. 
+ * @param num_budgets Pointer to number of budgets. 
+ * @retval 0 on success, -1 if the report couldn't be opened. 
+ */
+static int load_report(const char *path, struct budget *budgets, int *num_budgets) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    char line[STACK_BUDGET_LINE_LEN];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char define[STACK_BUDGET_NAME_LEN];
+        unsigned long depth, peak;
+
+        if ((sscanf(line, "STACK define=%63s depth=%lu peak=%lu", define, &depth, &peak) != 3)
+                && (sscanf(line, "HEAP define=%63s size=%lu peak=%lu", define, &depth, 
+                &peak) != 3)) {
+            continue;
+        }
+
+        struct budget *budget = find_budget(budgets, num_budgets, define);
+        if (budget == NULL) {
+            continue;
+        }
+
+        budget->depth = depth;
+        if (peak > budget->peak) {
+            budget->peak = peak;
+        }
+    }
+
+    fclose(file);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    unsigned long margin_pct = STACK_BUDGET_DEFAULT_MARGIN_PCT;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:")) != -1) {
+        switch (opt) {
+            case 'm':
+                margin_pct = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-m margin (%%)] <task_stacks.h> <report> "
+                        "[report ...]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if ((argc - optind) < 2) {
+        fprintf(stderr, "Usage: %s [-m margin (%%)] <task_stacks.h> <report> "
+                "[report ...]\n", argv[0]);
+        return 2;
+    }
+
+    struct budget budgets[STACK_BUDGET_MAX_DEFINES];
+    int num_budgets = 0;
+    for (int i = optind + 1; i < argc; i++) {
+        if (load_report(argv[i], budgets, &num_budgets) != 0) {
+            return 2;
+        }
+    }
+
+    // Size each measured stack, and total the change in stack sizes
+    long stack_change_bytes = 0;
+    struct budget *heap = NULL;
+    for (int i = 0; i < num_budgets; i++) {
+        if (strcmp(budgets[i].define, STACK_BUDGET_HEAP_DEFINE) == 0) {
+            heap = &budgets[i];
+            continue;
+        }
+
+        unsigned long depth = round_up((budgets[i].peak * (100 + margin_pct)) / 100, 
+                STACK_BUDGET_DEPTH_ALIGN);
+        budgets[i].new_depth = (depth < STACK_BUDGET_MIN_DEPTH) ? STACK_BUDGET_MIN_DEPTH : depth;
+        stack_change_bytes += ((long)budgets[i].new_depth - (long)budgets[i].depth) 
+                * STACK_BUDGET_WORD_BYTES;
+
+        fprintf(stderr, "%s depth=%lu peak=%lu new_depth=%lu\n", budgets[i].define, 
+                budgets[i].depth, budgets[i].peak, budgets[i].new_depth);
+    }
+
+    // The heap's peak use changes by the change in stack sizes
+    if (heap != NULL) {
+        long peak = (long)heap->peak + stack_change_bytes;
+        if (peak < 0) {
+            peak = 0;
+        }
+
+        heap->new_depth = round_up(((unsigned long)peak * (100 + margin_pct)) / 100, 
+                STACK_BUDGET_HEAP_ALIGN);
+        fprintf(stderr, "%s size=%lu peak=%lu new_size=%lu freed_bytes=%ld\n", 
+                heap->define, heap->depth, heap->peak, heap->new_depth, 
+                (long)heap->depth - (long)heap->new_depth);
+    }
+
+    // Rewrite the header, replacing the value of each measured define
+    FILE *header = fopen(argv[optind], "r");
+    if (header == NULL) {
+        perror(argv[optind]);
+        return 2;
+    }
+
+    char line[STACK_BUDGET_LINE_LEN];
+    while (fgets(line, sizeof(line), header) != NULL) {
+        char define[STACK_BUDGET_NAME_LEN];
+        struct budget *budget = NULL;
+
+        if (sscanf(line, "#define %63s", define) == 1) {
+            for (int i = 0; i < num_budgets; i++) {
+                if ((strcmp(budgets[i].define, define) == 0) && (budgets[i].new_depth != 0)) {
+                    budget = &budgets[i];
+                    break;
+                }
+            }
+        }
+
+        if (budget != NULL) {
+            printf("#define %s %lu\n", budget->define, budget->new_depth);
+        } else {
+            fputs(line, stdout);
+        }
+    }
+
+    fclose(header);
+    return 0;
+}
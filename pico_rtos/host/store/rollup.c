@@ -0,0 +1,405 @@
+ /**
+ **************************************************************
+ * @file rollup.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Time-series store rollup file. This file handles functionality
+ *        specific to the downsampled rollups of each series: min/max/sum/
+ *        last/count buckets at several resolutions (see rollup.h), updated
+ *        incrementally as samples are appended. Each level's closed buckets
+ *        are appended to a file of fixed size records in the series'
+ *        directory. Rollups are derived from the stored samples, so a
+ *        bucket lost in a crash is rebuilt from them when the series is
+ *        reopened. Queries are answered from the coarsest level whose
+ *        buckets divide the requested resolution, and fall back to the
+ *        stored samples for resolutions finer than every level.
+ ***************************************************************
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "rollup.h"
+#include "store.h"
+
+// Width of the bucket of each level (in sec).
+static const int64_t rollup_level_widths_sec[ROLLUP_NUM_LEVELS] = ROLLUP_LEVEL_WIDTHS_SEC;
+
+// Struct holding the state of a query, as buckets at the requested
+// resolution are merged from rollup buckets or samples.
+struct rollup_merge {
+    int64_t resolution_ms;
+    int64_t from_ms;            // Start of the first bucket in the range
+    int64_t end_ms;             // End of the last bucket in the range
+    struct rollup_record bucket;
+    rollup_row_cb callback;
+    void *ctx;
+    struct rollup_query_stats *stats;
+};
+
+/**
+ * @brief Record CRC function. This function calculates the CRC-32 (IEEE
+ *        802.3) of a rollup record's fields.
+ * @param record Pointer to the record.
+ * @retval CRC-32 of the record.
+ */
+static uint32_t rollup_record_crc(const struct rollup_record *record) {
+    const uint8_t *data = (const uint8_t *)record;
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (size_t i = 0; i < offsetof(struct rollup_record, crc); i++) {
+        crc ^= data[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? ((crc >> 1) ^ 0xEDB88320) : (crc >> 1);
+        }
+    }
+
+    return crc ^ 0xFFFFFFFF;
+}
+
+/**
+ * @brief Bucket start function. This function aligns a time to the start of
+ *        the bucket it falls in.
+ * @param ts_ms Time, in msec since the epoch.
+ * @param width_ms Bucket width, in msec.
+ * @retval Start of the bucket, in msec since the epoch.
+ */
+static int64_t rollup_bucket_start(int64_t ts_ms, int64_t width_ms) {
+    int64_t rem = ts_ms % width_ms;
+    return ts_ms - ((rem < 0) ? (rem + width_ms) : rem);
+}
+
+/**
+ * @brief Bucket add function. This function adds the heights summarised by
+ *        one bucket to another (with a single sample being a bucket of one).
+ * @param bucket Pointer to the bucket added to.
+ * @param sum Sum of the heights added.
+ * @param min Minimum of the heights added.
+ * @param max Maximum of the heights added.
+ * @param last Most recent of the heights added.
+ * @param count Number of heights added.
+ * @retval None.
+ */
+static void rollup_bucket_add(struct rollup_record *bucket, double sum, float min,
+        float max, float last, uint32_t count) {
+    if (bucket->count == 0) {
+        bucket->min = min;
+        bucket->max = max;
+    } else {
+        bucket->min = (min < bucket->min) ? min : bucket->min;
+        bucket->max = (max > bucket->max) ? max : bucket->max;
+    }
+
+    bucket->sum += sum;
+    bucket->last = last;
+    bucket->count += count;
+}
+
+/**
+ * @brief Rollup open function. This function opens the file of each level
+ *        of a series' rollups. A partly written or corrupt last record (e.g.
+ *        from a crash) is truncated, to be rebuilt from the stored samples.
+ * @param rollups Pointer to the series' rollups.
+ * @param series_dir Directory of the series.
+ * @retval true if the rollups were opened, false otherwise.
+ */
+bool rollup_open(struct rollup_series *rollups, const char *series_dir) {
+    char path[STORE_PATH_LEN];
+
+    for (uint8_t i = 0; i < ROLLUP_NUM_LEVELS; i++) {
+        struct rollup_level *level = &rollups->levels[i];
+        level->width_ms = rollup_level_widths_sec[i] * 1000;
+        level->end_ms = INT64_MIN;
+        memset(&level->open, 0, sizeof(struct rollup_record));
+
+        snprintf(path, STORE_PATH_LEN, "%s/rollup-%lld.dat", series_dir,
+                (long long)rollup_level_widths_sec[i]);
+        level->fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (level->fd < 0) {
+            perror(path);
+            while (i-- > 0) {
+                close(rollups->levels[i].fd);
+            }
+            return false;
+        }
+
+        struct stat st;
+        fstat(level->fd, &st);
+        off_t num_records = st.st_size / sizeof(struct rollup_record);
+        struct rollup_record last;
+
+        while ((num_records > 0) && ((pread(level->fd, &last, sizeof(last),
+                (num_records - 1) * sizeof(struct rollup_record)) != sizeof(last))
+                || (last.crc != rollup_record_crc(&last)))) {
+            num_records--;
+        }
+
+        if (st.st_size != (off_t)(num_records * sizeof(struct rollup_record))) {
+            fprintf(stderr, "rollup: %s: truncated to %lld records\n", path,
+                    (long long)num_records);
+            if (ftruncate(level->fd, num_records * sizeof(struct rollup_record)) != 0) {
+                perror(path);
+            }
+        }
+
+        if (num_records > 0) {
+            level->end_ms = last.start_ms + level->width_ms;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Rollup resume function.
+ * @param rollups Pointer to the series' rollups.
+ * @retval Time from which stored samples must be added to the rollups to
+ *         bring every level up to date (the earliest end of a level's
+ *         closed buckets).
+ */
+int64_t rollup_resume_ms(const struct rollup_series *rollups) {
+    int64_t resume_ms = INT64_MAX;
+
+    for (uint8_t i = 0; i < ROLLUP_NUM_LEVELS; i++) {
+        if (rollups->levels[i].end_ms < resume_ms) {
+            resume_ms = rollups->levels[i].end_ms;
+        }
+    }
+
+    return resume_ms;
+}
+
+/**
+ * @brief Rollup add function. This function adds a sample to the open
+ *        bucket of each level, first closing (writing) the open bucket of a
+ *        level if the sample is beyond it. Samples within a level's closed
+ *        buckets are ignored by that level.
+ * @param rollups Pointer to the series' rollups.
+ * @param sample Pointer to the sample.
+ * @retval None.
+ */
+void rollup_add(struct rollup_series *rollups, const struct store_sample *sample) {
+    for (uint8_t i = 0; i < ROLLUP_NUM_LEVELS; i++) {
+        struct rollup_level *level = &rollups->levels[i];
+        if (sample->ts_ms < level->end_ms) {
+            continue;
+        }
+
+        int64_t start_ms = rollup_bucket_start(sample->ts_ms, level->width_ms);
+        if ((level->open.count != 0) && (start_ms != level->open.start_ms)) {
+            level->open.crc = rollup_record_crc(&level->open);
+            if (write(level->fd, &level->open, sizeof(struct rollup_record))
+                    != sizeof(struct rollup_record)) {
+                perror("rollup");
+            }
+            level->end_ms = level->open.start_ms + level->width_ms;
+            memset(&level->open, 0, sizeof(struct rollup_record));
+        }
+
+        level->open.start_ms = start_ms;
+        rollup_bucket_add(&level->open, sample->height_cm, sample->height_cm,
+                sample->height_cm, sample->height_cm, 1);
+    }
+}
+
+/**
+ * @brief Rollup close function. This function closes the file of each level
+ *        of a series' rollups (open buckets are rebuilt from the stored
+ *        samples when the series is reopened).
+ * @param rollups Pointer to the series' rollups.
+ * @retval None.
+ */
+void rollup_close(struct rollup_series *rollups) {
+    for (uint8_t i = 0; i < ROLLUP_NUM_LEVELS; i++) {
+        close(rollups->levels[i].fd);
+        rollups->levels[i].fd = -1;
+    }
+}
+
+/**
+ * @brief Merge emit function. This function outputs the bucket being
+ *        merged as a query result row.
+ * @param merge Pointer to the query state.
+ * @retval None.
+ */
+static void rollup_merge_emit(struct rollup_merge *merge) {
+    if (merge->bucket.count == 0) {
+        return;
+    }
+
+    struct rollup_row row = {
+        .start_ms = merge->bucket.start_ms,
+        .min = merge->bucket.min,
+        .max = merge->bucket.max,
+        .mean = (float)(merge->bucket.sum / merge->bucket.count),
+        .last = merge->bucket.last,
+        .count = merge->bucket.count,
+    };
+
+    merge->callback(&row, merge->ctx);
+    merge->stats->rows++;
+    memset(&merge->bucket, 0, sizeof(struct rollup_record));
+}
+
+/**
+ * @brief Merge add function. This function merges a rollup bucket (or a
+ *        sample, as a bucket of one) into the bucket at the requested
+ *        resolution containing it, outputting the previous bucket once a
+ *        later one starts.
+ * @param merge Pointer to the query state.
+ * @param input Pointer to the bucket being merged.
+ * @retval None.
+ */
+static void rollup_merge_add(struct rollup_merge *merge, const struct rollup_record *input) {
+    if ((input->start_ms < merge->from_ms) || (input->start_ms >= merge->end_ms)
+            || (input->count == 0)) {
+        return;
+    }
+
+    int64_t start_ms = rollup_bucket_start(input->start_ms, merge->resolution_ms);
+    if (start_ms != merge->bucket.start_ms) {
+        rollup_merge_emit(merge);
+        merge->bucket.start_ms = start_ms;
+    }
+
+    rollup_bucket_add(&merge->bucket, input->sum, input->min, input->max, input->last,
+            input->count);
+}
+
+/**
+ * @brief Sample merge callback. This function merges a stored sample into a
+ *        query's result.
+ * @param sample Pointer to the sample.
+ * @param ctx Pointer to the query state.
+ * @retval None.
+ */
+static void rollup_merge_sample(const struct store_sample *sample, void *ctx) {
+    struct rollup_merge *merge = ctx;
+    struct rollup_record input = {
+        .start_ms = sample->ts_ms,
+        .sum = sample->height_cm,
+        .min = sample->height_cm,
+        .max = sample->height_cm,
+        .last = sample->height_cm,
+        .count = 1,
+    };
+
+    merge->stats->samples_read++;
+    rollup_merge_add(merge, &input);
+}
+
+/**
+ * @brief Level query function. This function merges the closed buckets of
+ *        a level within a query's range (found by binary search of the
+ *        level's file), then its open bucket.
+ * @param level Pointer to the level.
+ * @param merge Pointer to the query state.
+ * @retval None.
+ */
+static void rollup_query_level(const struct rollup_level *level, struct rollup_merge *merge) {
+    struct stat st;
+    size_t num_records = 0;
+    const struct rollup_record *records = NULL;
+
+    if ((fstat(level->fd, &st) == 0) && (st.st_size >= (off_t)sizeof(struct rollup_record))) {
+        num_records = st.st_size / sizeof(struct rollup_record);
+        records = mmap(NULL, num_records * sizeof(struct rollup_record), PROT_READ,
+                MAP_SHARED, level->fd, 0);
+        if (records == MAP_FAILED) {
+            perror("rollup");
+            return;
+        }
+    }
+
+    size_t low = 0, high = num_records;
+    while (low < high) {
+        size_t mid = low + ((high - low) / 2);
+        if (records[mid].start_ms < merge->from_ms) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    for (size_t i = low; (i < num_records) && (records[i].start_ms < merge->end_ms); i++) {
+        rollup_merge_add(merge, &records[i]);
+        merge->stats->records_read++;
+    }
+
+    if (records != NULL) {
+        munmap((void *)records, num_records * sizeof(struct rollup_record));
+    }
+
+    if (level->open.count != 0) {
+        rollup_merge_add(merge, &level->open);
+        merge->stats->records_read++;
+    }
+}
+
+/**
+ * @brief Rollup query function. This function outputs the buckets at the
+ *        requested resolution covering a time range (from the start of the
+ *        bucket containing from_ms, to the end of the bucket containing
+ *        to_ms), skipping empty buckets. The query is answered from the
+ *        coarsest rollup level whose bucket width divides the resolution,
+ *        or from the samples (stored, then buffered) if there is none.
+ * @param store Pointer to the store.
+ * @param series Pointer to the series.
+ * @param from_ms Start of the time range.
+ * @param to_ms End of the time range (inclusive).
+ * @param resolution_ms Width of each result bucket, in msec.
+ * @param use_rollups false to always answer from the samples (e.g. to
+ *        compare against the rollups).
+ * @param callback Function called with each result row.
+ * @param ctx Context passed to the callback.
+ * @param stats Pointer to the query statistics (zeroed by this function).
+ * @retval true if the query was answered, false if its range is invalid.
+ */
+bool rollup_query(const struct store *store, const struct store_series *series,
+        int64_t from_ms, int64_t to_ms, int64_t resolution_ms, bool use_rollups,
+        rollup_row_cb callback, void *ctx, struct rollup_query_stats *stats) {
+    memset(stats, 0, sizeof(struct rollup_query_stats));
+    if ((resolution_ms <= 0) || (to_ms < from_ms)) {
+        return false;
+    }
+
+    struct rollup_merge merge = {
+        .resolution_ms = resolution_ms,
+        .from_ms = rollup_bucket_start(from_ms, resolution_ms),
+        .end_ms = rollup_bucket_start(to_ms, resolution_ms) + resolution_ms,
+        .callback = callback,
+        .ctx = ctx,
+        .stats = stats,
+    };
+    merge.bucket.start_ms = merge.from_ms;
+
+    const struct rollup_level *level = NULL;
+    for (uint8_t i = 0; (i < ROLLUP_NUM_LEVELS) && use_rollups; i++) {
+        if ((resolution_ms % series->rollups.levels[i].width_ms) == 0) {
+            level = &series->rollups.levels[i];
+        }
+    }
+
+    if (level != NULL) {
+        stats->level_width_ms = level->width_ms;
+        rollup_query_level(level, &merge);
+    } else {
+        struct store_scan_stats scan_stats;
+        store_scan_key(store->dir, series->key, merge.from_ms, merge.end_ms - 1,
+                STORE_COL_MASK(STORE_COL_HEIGHT), rollup_merge_sample, &merge, &scan_stats);
+
+        for (uint32_t i = 0; i < series->buf_count; i++) {
+            rollup_merge_sample(&series->buf[i], &merge);
+        }
+    }
+
+    rollup_merge_emit(&merge);
+    return true;
+}
@@ -0,0 +1,82 @@
+ /**
+ **************************************************************
+ * @file rollup.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the time-series store's downsampled rollups.
+ ***************************************************************
+ */
+
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Rollup levels, from finest to coarsest, and the width of each level's
+// buckets (in sec). Buckets are aligned to the epoch (UTC).
+#define ROLLUP_NUM_LEVELS 4
+#define ROLLUP_LEVEL_WIDTHS_SEC {60, 900, 3600, 86400}
+
+// Struct holding one bucket of a rollup level, as written to the level's
+// file once the bucket closes. The CRC covers every preceding field.
+struct rollup_record {
+    int64_t start_ms;
+    double sum;                 // Sum of heights
+    float min;
+    float max;
+    float last;                 // Most recent height
+    uint32_t count;             // Samples in the bucket
+    uint32_t crc;
+    uint32_t reserved;
+};
+
+// Struct holding one row of a query result (a bucket at the requested
+// resolution).
+struct rollup_row {
+    int64_t start_ms;
+    float min;
+    float max;
+    float mean;
+    float last;
+    uint32_t count;
+};
+
+// Struct holding one level of a series' rollups.
+struct rollup_level {
+    int64_t width_ms;
+    int fd;                     // Level's file of closed buckets
+    int64_t end_ms;             // End of the last closed bucket
+    struct rollup_record open;  // Bucket being accumulated (count 0 if none)
+};
+
+// Struct holding the rollups of a series.
+struct rollup_series {
+    struct rollup_level levels[ROLLUP_NUM_LEVELS];
+};
+
+// Struct holding the statistics of a query.
+struct rollup_query_stats {
+    int64_t level_width_ms;     // Level answering the query (0 for raw)
+    uint64_t records_read;      // Rollup buckets read
+    uint64_t samples_read;      // Raw samples read
+    uint64_t rows;
+};
+
+// Function called with each row of a query result.
+typedef void (*rollup_row_cb)(const struct rollup_row *row, void *ctx);
+
+struct store;
+struct store_series;
+struct store_sample;
+
+// Function prototypes
+bool rollup_open(struct rollup_series *rollups, const char *series_dir);
+int64_t rollup_resume_ms(const struct rollup_series *rollups);
+void rollup_add(struct rollup_series *rollups, const struct store_sample *sample);
+void rollup_close(struct rollup_series *rollups);
+bool rollup_query(const struct store *store, const struct store_series *series,
+        int64_t from_ms, int64_t to_ms, int64_t resolution_ms, bool use_rollups,
+        rollup_row_cb callback, void *ctx, struct rollup_query_stats *stats);
+
+#endif
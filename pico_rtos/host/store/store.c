@@ -0,0 +1,865 @@
+ /**
+ **************************************************************
+ * @file store.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Tank reading time-series store file. This file handles
+ *        functionality specific to storing the samples of each tank of each
+ *        node on the gateway, in append-only, memory-mapped segment files
+ *        (one directory of segments per series). Samples are buffered and
+ *        written a block at a time, with each column of the block encoded
+ *        separately: timestamps as delta-of-deltas, heights as fixed-point
+ *        deltas (both zigzag varints), and valve states and status as runs.
+ *        A block is only published (by the segment header's block count)
+ *        once its data and index entry are written, so a crash loses at
+ *        most the unpublished samples. Range scans use the block index to
+ *        decode only the blocks (and columns) they need.
+ ***************************************************************
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "store.h"
+
+// CRC-32 (IEEE 802.3) lookup table, generated on first use.
+static uint32_t store_crc_table[256];
+static bool store_crc_table_ready = false;
+
+/**
+ * @brief CRC-32 function.
+ * @param data Bytes being checked.
+ * @param len Number of bytes.
+ * @retval CRC-32 of the bytes.
+ */
+static uint32_t store_crc32(const uint8_t *data, size_t len) {
+    if (!store_crc_table_ready) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (uint8_t bit = 0; bit < 8; bit++) {
+                crc = (crc & 1) ? ((crc >> 1) ^ 0xEDB88320) : (crc >> 1);
+            }
+            store_crc_table[i] = crc;
+        }
+        store_crc_table_ready = true;
+    }
+
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc = store_crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc ^ 0xFFFFFFFF;
+}
+
+/**
+ * @brief Varint write function. This function writes an unsigned value 7
+ *        bits at a time, least significant first, with the top bit of each
+ *        byte set if more bytes follow.
+ * @param out Buffer written to.
+ * @param value Value being written.
+ * @retval Pointer to the byte after the varint.
+ */
+static uint8_t *store_put_varint(uint8_t *out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+
+    *out++ = (uint8_t)value;
+    return out;
+}
+
+/**
+ * @brief Varint read function.
+ * @param in Pointer to the varint, advanced past it.
+ * @param end End of the column being read.
+ * @param value Pointer to the value read.
+ * @retval true if a varint was read, false if the column is truncated.
+ */
+static bool store_get_varint(const uint8_t **in, const uint8_t *end, uint64_t *value) {
+    uint64_t result = 0;
+
+    for (uint8_t shift = 0; (*in < end) && (shift < 64); shift += 7) {
+        uint8_t byte = *(*in)++;
+        result |= (uint64_t)(byte & 0x7F) << shift;
+
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Zigzag encode function. This function maps signed values to
+ *        unsigned values with small magnitudes kept small (0, -1, 1, -2...
+ *        map to 0, 1, 2, 3...).
+ * @param value Signed value.
+ * @retval Zigzag encoded value.
+ */
+static uint64_t store_zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+/**
+ * @brief Zigzag decode function.
+ * @param value Zigzag encoded value.
+ * @retval Signed value.
+ */
+static int64_t store_unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/**
+ * @brief Series key function. This function forms the key of a series from
+ *        its node's name (e.g. the node's device path) and tank number.
+ *        Characters of the name which can't be used in a directory name are
+ *        replaced.
+ * @param key Buffer written to (STORE_KEY_LEN chars).
+ * @param node Name of the node.
+ * @param tank Tank number.
+ * @retval None.
+ */
+void store_series_key(char *key, const char *node, uint8_t tank) {
+    size_t len = 0;
+
+    // Leading separators (e.g. of an absolute device path) are dropped
+    while (*node == '/') {
+        node++;
+    }
+
+    for (; (*node != '\0') && (len < (STORE_KEY_LEN - 8)); node++) {
+        char c = *node;
+        bool allowed = ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z'))
+                || ((c >= '0') && (c <= '9')) || (c == '-') || (c == '.');
+        key[len++] = allowed ? c : '_';
+    }
+
+    snprintf(&key[len], STORE_KEY_LEN - len, "-t%u", tank);
+}
+
+/**
+ * @brief Segment path function.
+ * @param path Buffer written to (STORE_PATH_LEN chars).
+ * @param series_dir Directory of the series.
+ * @param segment Segment number.
+ * @retval true if the path fits, false otherwise.
+ */
+static bool store_segment_path(char *path, const char *series_dir, uint32_t segment) {
+    return snprintf(path, STORE_PATH_LEN, "%s/seg-%06u.tsd", series_dir, segment)
+            < STORE_PATH_LEN;
+}
+
+/**
+ * @brief Segment header validation function.
+ * @param header Pointer to the mapped segment header.
+ * @param size Size of the segment file.
+ * @retval true if the header is of a valid segment, false otherwise.
+ */
+static bool store_header_valid(const struct store_segment_header *header, size_t size) {
+    return (size >= STORE_SEGMENT_SIZE) && (header->magic == STORE_MAGIC)
+            && (header->version == STORE_VERSION)
+            && (header->num_blocks <= STORE_MAX_BLOCKS)
+            && (header->data_end >= STORE_DATA_OFFSET)
+            && (header->data_end <= STORE_SEGMENT_SIZE);
+}
+
+/**
+ * @brief Block validation function. This function checks a block's index
+ *        entry lies within the segment, and its data matches its CRC.
+ * @param map Mapped segment.
+ * @param block Pointer to the block's index entry.
+ * @retval true if the block is valid, false otherwise.
+ */
+static bool store_block_valid(const uint8_t *map, const struct store_block *block) {
+    uint64_t len = 0;
+    for (uint8_t col = 0; col < STORE_NUM_COLS; col++) {
+        len += block->col_len[col];
+    }
+
+    if ((block->count == 0) || (block->count > STORE_BLOCK_SAMPLES)
+            || (block->offset < STORE_DATA_OFFSET)
+            || ((block->offset + len) > STORE_SEGMENT_SIZE)) {
+        return false;
+    }
+
+    return store_crc32(&map[block->offset], len) == block->crc;
+}
+
+/**
+ * @brief Segment recovery function. This function checks every committed
+ *        block of a segment being reopened for appending, and drops the
+ *        blocks from the first invalid one onwards (e.g. blocks published
+ *        without their data reaching the disk before a power failure).
+ * @param series Pointer to the series whose segment is mapped.
+ * @retval None.
+ */
+static void store_segment_recover(struct store_series *series) {
+    struct store_segment_header *header = (struct store_segment_header *)series->map;
+    const struct store_block *index =
+            (const struct store_block *)&series->map[STORE_HEADER_SIZE];
+    uint32_t num_blocks = 0;
+    uint32_t data_end = STORE_DATA_OFFSET;
+
+    while ((num_blocks < header->num_blocks)
+            && store_block_valid(series->map, &index[num_blocks])) {
+        const struct store_block *block = &index[num_blocks];
+        data_end = block->offset;
+        for (uint8_t col = 0; col < STORE_NUM_COLS; col++) {
+            data_end += block->col_len[col];
+        }
+        num_blocks++;
+    }
+
+    if (num_blocks != header->num_blocks) {
+        fprintf(stderr, "store: %s segment %u: dropped %u invalid block(s)\n",
+                series->key, series->segment, header->num_blocks - num_blocks);
+        header->num_blocks = num_blocks;
+    }
+
+    header->data_end = data_end;
+    header->last_ts_ms = (num_blocks > 0) ? index[num_blocks - 1].last_ts_ms
+            : header->first_ts_ms;
+    series->last_ts_ms = (num_blocks > 0) ? header->last_ts_ms : INT64_MIN;
+}
+
+/**
+ * @brief Segment map function. This function opens (creating if needed) a
+ *        segment of a series for appending, and maps it.
+ * @param series Pointer to the series.
+ * @param segment Segment number.
+ * @retval true if the segment was mapped, false otherwise.
+ */
+static bool store_segment_map(struct store_series *series, uint32_t segment) {
+    char path[STORE_PATH_LEN];
+    if (!store_segment_path(path, series->dir, segment)) {
+        fprintf(stderr, "store: %s: path too long\n", series->dir);
+        return false;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        perror(path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror(path);
+        close(fd);
+        return false;
+    }
+
+    // New segments are sparse, so only pages which are written use disk
+    if ((st.st_size == 0) && (ftruncate(fd, STORE_SEGMENT_SIZE) != 0)) {
+        perror(path);
+        close(fd);
+        return false;
+    } else if ((st.st_size != 0) && (st.st_size < STORE_SEGMENT_SIZE)) {
+        fprintf(stderr, "store: %s is not a valid segment\n", path);
+        close(fd);
+        return false;
+    }
+
+    uint8_t *map = mmap(NULL, STORE_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        perror(path);
+        close(fd);
+        return false;
+    }
+
+    // The magic number is written last when a segment is created, so a
+    // segment without one (e.g. created just before a crash) is empty.
+    struct store_segment_header *header = (struct store_segment_header *)map;
+    bool created = (header->magic == 0);
+    if (created) {
+        header->version = STORE_VERSION;
+        header->num_blocks = 0;
+        header->data_end = STORE_DATA_OFFSET;
+        header->first_ts_ms = 0;
+        header->last_ts_ms = 0;
+        memcpy(header->key, series->key, STORE_KEY_LEN);
+        header->magic = STORE_MAGIC;
+    } else if (!store_header_valid(header, STORE_SEGMENT_SIZE)) {
+        fprintf(stderr, "store: %s is not a valid segment\n", path);
+        munmap(map, STORE_SEGMENT_SIZE);
+        close(fd);
+        return false;
+    }
+
+    series->fd = fd;
+    series->map = map;
+    series->segment = segment;
+
+    if (!created) {
+        store_segment_recover(series);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Segment unmap function.
+ * @param series Pointer to the series.
+ * @retval None.
+ */
+static void store_segment_unmap(struct store_series *series) {
+    if (series->map != NULL) {
+        if (series->sync) {
+            msync(series->map, STORE_SEGMENT_SIZE, MS_SYNC);
+        }
+        munmap(series->map, STORE_SEGMENT_SIZE);
+        close(series->fd);
+        series->map = NULL;
+        series->fd = -1;
+    }
+}
+
+/**
+ * @brief Page-aligned msync function. This function synchronously writes
+ *        back the pages of a mapped segment covering a range of bytes.
+ * @param map Mapped segment.
+ * @param offset Offset of the first byte.
+ * @param len Number of bytes.
+ * @retval None.
+ */
+static void store_msync_range(uint8_t *map, size_t offset, size_t len) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t start = offset - (offset % page);
+    msync(&map[start], (offset + len) - start, MS_SYNC);
+}
+
+/**
+ * @brief Run-length encode function. This function writes a column of byte
+ *        values as (value, run length varint) pairs.
+ * @param out Buffer written to.
+ * @param samples Samples being encoded.
+ * @param count Number of samples.
+ * @param col Column being encoded (STORE_COL_STATE or STORE_COL_STATUS).
+ * @retval Pointer to the byte after the column.
+ */
+static uint8_t *store_put_runs(uint8_t *out, const struct store_sample *samples,
+        uint32_t count, uint8_t col) {
+    uint32_t i = 0;
+
+    while (i < count) {
+        uint8_t value = (col == STORE_COL_STATE) ? samples[i].state : samples[i].status;
+        uint32_t run = 1;
+
+        while (((i + run) < count) && (value == ((col == STORE_COL_STATE)
+                ? samples[i + run].state : samples[i + run].status))) {
+            run++;
+        }
+
+        *out++ = value;
+        out = store_put_varint(out, run);
+        i += run;
+    }
+
+    return out;
+}
+
+/**
+ * @brief Block commit function. This function encodes a series' buffered
+ *        samples as a block, writes its column data and index entry, and
+ *        then publishes it in the segment header. A new segment is started
+ *        if the block may not fit in the current one.
+ * @param series Pointer to the series.
+ * @retval true if the block was committed, false otherwise.
+ */
+static bool store_commit_block(struct store_series *series) {
+    uint32_t count = series->buf_count;
+    if (count == 0) {
+        return true;
+    }
+
+    struct store_segment_header *header = (struct store_segment_header *)series->map;
+    if ((header->num_blocks >= STORE_MAX_BLOCKS) || ((header->data_end
+            + ((size_t)count * STORE_MAX_SAMPLE_BYTES)) > STORE_SEGMENT_SIZE)) {
+        uint32_t next = series->segment + 1;
+        store_segment_unmap(series);
+        if (!store_segment_map(series, next)) {
+            return false;
+        }
+        header = (struct store_segment_header *)series->map;
+    }
+
+    const struct store_sample *samples = series->buf;
+    struct store_block *block =
+            &((struct store_block *)&series->map[STORE_HEADER_SIZE])[header->num_blocks];
+    uint8_t *start = &series->map[header->data_end];
+    uint8_t *col_start = start;
+    uint8_t *out = start;
+
+    // Timestamps: first timestamp, first delta, then delta-of-deltas
+    int64_t prev_delta = 0;
+    out = store_put_varint(out, store_zigzag(samples[0].ts_ms));
+    for (uint32_t i = 1; i < count; i++) {
+        int64_t delta = samples[i].ts_ms - samples[i - 1].ts_ms;
+        out = store_put_varint(out, store_zigzag(delta - prev_delta));
+        prev_delta = delta;
+    }
+    block->col_len[STORE_COL_TS] = out - col_start;
+    col_start = out;
+
+    // Heights: fixed-point deltas (from zero for the first height)
+    int64_t prev_height = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        int64_t height = llroundf(samples[i].height_cm * STORE_HEIGHT_SCALE);
+        out = store_put_varint(out, store_zigzag(height - prev_height));
+        prev_height = height;
+    }
+    block->col_len[STORE_COL_HEIGHT] = out - col_start;
+    col_start = out;
+
+    out = store_put_runs(out, samples, count, STORE_COL_STATE);
+    block->col_len[STORE_COL_STATE] = out - col_start;
+    col_start = out;
+
+    out = store_put_runs(out, samples, count, STORE_COL_STATUS);
+    block->col_len[STORE_COL_STATUS] = out - col_start;
+
+    block->first_ts_ms = samples[0].ts_ms;
+    block->last_ts_ms = samples[count - 1].ts_ms;
+    block->count = count;
+    block->offset = header->data_end;
+    block->crc = store_crc32(start, out - start);
+    block->reserved = 0;
+
+    // The block's data and index entry must reach the disk before the
+    // header publishing them does.
+    if (series->sync) {
+        store_msync_range(series->map, header->data_end, out - start);
+        store_msync_range(series->map, (uint8_t *)block - series->map,
+                sizeof(struct store_block));
+    }
+
+    if (header->num_blocks == 0) {
+        header->first_ts_ms = block->first_ts_ms;
+    }
+    header->last_ts_ms = block->last_ts_ms;
+    header->data_end += out - start;
+    __atomic_store_n(&header->num_blocks, header->num_blocks + 1, __ATOMIC_RELEASE);
+
+    if (series->sync) {
+        store_msync_range(series->map, 0, sizeof(struct store_segment_header));
+    }
+
+    series->buf_count = 0;
+    return true;
+}
+
+/**
+ * @brief Store open function. This function opens a store (creating its
+ *        directory if needed). Series are opened as they are first used.
+ * @param store Pointer to the store.
+ * @param dir Directory of the store.
+ * @param sync msync() each block before publishing it (so it survives a
+ *        power failure, not just a crash of the gateway).
+ * @retval true if the store was opened, false otherwise.
+ */
+bool store_open(struct store *store, const char *dir, bool sync) {
+    if ((mkdir(dir, 0755) != 0) && (errno != EEXIST)) {
+        perror(dir);
+        return false;
+    }
+
+    snprintf(store->dir, STORE_PATH_LEN, "%s", dir);
+    store->sync = sync;
+    store->series = NULL;
+    store->num_series = 0;
+    return true;
+}
+
+/**
+ * @brief Rollup replay callback. This function adds a stored sample to the
+ *        rollups of its series.
+ * @param sample Pointer to the sample.
+ * @param ctx Pointer to the series' rollups.
+ * @retval None.
+ */
+static void store_rollup_replay(const struct store_sample *sample, void *ctx) {
+    rollup_add(ctx, sample);
+}
+
+/**
+ * @brief Series find function. This function returns a series of an open
+ *        store, if it has already been opened.
+ * @param store Pointer to the store.
+ * @param node Name of the node.
+ * @param tank Tank number.
+ * @retval Pointer to the series, or NULL if it isn't open.
+ */
+struct store_series *store_find(const struct store *store, const char *node, uint8_t tank) {
+    char key[STORE_KEY_LEN];
+    store_series_key(key, node, tank);
+
+    for (uint32_t i = 0; i < store->num_series; i++) {
+        if (strcmp(store->series[i]->key, key) == 0) {
+            return store->series[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Series function. This function returns a series of an open store
+ *        (opening the series, and its most recent segment, on first use).
+ *        Opening a series brings its rollups up to date with its stored
+ *        samples (e.g. buckets left open by a restart, or a store written
+ *        before the rollups existed).
+ * @param store Pointer to the store.
+ * @param node Name of the node.
+ * @param tank Tank number.
+ * @retval Pointer to the series, or NULL if it couldn't be opened.
+ */
+struct store_series *store_series(struct store *store, const char *node, uint8_t tank) {
+    struct store_series *found = store_find(store, node, tank);
+    if (found != NULL) {
+        return found;
+    }
+
+    char key[STORE_KEY_LEN];
+    store_series_key(key, node, tank);
+
+    struct store_series **all = realloc(store->series,
+            (store->num_series + 1) * sizeof(struct store_series *));
+    if (all == NULL) {
+        return NULL;
+    }
+    store->series = all;
+
+    struct store_series *series = calloc(1, sizeof(struct store_series));
+    if (series == NULL) {
+        return NULL;
+    }
+
+    memcpy(series->key, key, STORE_KEY_LEN);
+    if (snprintf(series->dir, STORE_PATH_LEN, "%s/%s", store->dir, key) >= STORE_PATH_LEN) {
+        free(series);
+        return NULL;
+    }
+    series->sync = store->sync;
+    series->fd = -1;
+    series->last_ts_ms = INT64_MIN;
+
+    if ((mkdir(series->dir, 0755) != 0) && (errno != EEXIST)) {
+        perror(series->dir);
+        free(series);
+        return NULL;
+    }
+
+    // Appending continues in the most recent segment
+    uint32_t segment = 0;
+    char path[STORE_PATH_LEN];
+    while (true) {
+        if (!store_segment_path(path, series->dir, segment + 1)
+                || (access(path, F_OK) != 0)) {
+            break;
+        }
+        segment++;
+    }
+
+    if (!store_segment_map(series, segment)) {
+        free(series);
+        return NULL;
+    }
+
+    if (!rollup_open(&series->rollups, series->dir)) {
+        store_segment_unmap(series);
+        free(series);
+        return NULL;
+    }
+
+    struct store_scan_stats stats;
+    store_scan_key(store->dir, key, rollup_resume_ms(&series->rollups), INT64_MAX,
+            STORE_COL_MASK(STORE_COL_HEIGHT), store_rollup_replay, &series->rollups, &stats);
+
+    store->series[store->num_series++] = series;
+    return series;
+}
+
+/**
+ * @brief Append function. This function buffers a sample of a series, and
+ *        commits the buffered samples once they fill a block. Samples must
+ *        be appended in time order, with a finite height of at most 
+ *        STORE_HEIGHT_MAX_CM.
+ * @param series Pointer to the series.
+ * @param sample Pointer to the sample.
+ * @retval true if the sample was appended, false otherwise.
+ */
+bool store_append(struct store_series *series, const struct store_sample *sample) {
+    if ((series->map == NULL) || (sample->ts_ms < series->last_ts_ms)) {
+        return false;
+    }
+
+    // Out of range heights would overflow the height varint (and rounding
+    // a non-finite one is undefined)
+    if (!isfinite(sample->height_cm) || (fabsf(sample->height_cm) > STORE_HEIGHT_MAX_CM)) {
+        return false;
+    }
+
+    // Heights are rounded to the stored precision here, so that buffered
+    // samples and the rollups match the samples read back.
+    struct store_sample *stored = &series->buf[series->buf_count++];
+    *stored = *sample;
+    stored->height_cm = llroundf(sample->height_cm * STORE_HEIGHT_SCALE) / STORE_HEIGHT_SCALE;
+    series->last_ts_ms = sample->ts_ms;
+    rollup_add(&series->rollups, stored);
+
+    if (series->buf_count == STORE_BLOCK_SAMPLES) {
+        return store_commit_block(series);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Flush function. This function commits the buffered samples of
+ *        every series (as a partly full block).
+ * @param store Pointer to the store.
+ * @retval true if every series was flushed, false otherwise.
+ */
+bool store_flush(struct store *store) {
+    bool flushed = true;
+
+    for (uint32_t i = 0; i < store->num_series; i++) {
+        if (store->series[i]->map != NULL) {
+            flushed &= store_commit_block(store->series[i]);
+        }
+    }
+
+    return flushed;
+}
+
+/**
+ * @brief Store close function. This function flushes and closes every
+ *        series of a store.
+ * @param store Pointer to the store.
+ * @retval None.
+ */
+void store_close(struct store *store) {
+    store_flush(store);
+
+    for (uint32_t i = 0; i < store->num_series; i++) {
+        store_segment_unmap(store->series[i]);
+        rollup_close(&store->series[i]->rollups);
+        free(store->series[i]);
+    }
+
+    free(store->series);
+    store->series = NULL;
+    store->num_series = 0;
+}
+
+/**
+ * @brief Block scan function. This function decodes the selected columns
+ *        of a block, and passes each sample within the time range to the
+ *        callback.
+ * @param map Mapped segment.
+ * @param block Pointer to the block's index entry.
+ * @param from_ms Start of the time range (inclusive).
+ * @param to_ms End of the time range (inclusive).
+ * @param columns Columns decoded (STORE_COL_MASK() bits).
+ * @param callback Function called with each sample.
+ * @param ctx Context passed to the callback.
+ * @param stats Pointer to the scan statistics.
+ * @retval true if the block was decoded, false if it is corrupt.
+ */
+static bool store_scan_block(const uint8_t *map, const struct store_block *block,
+        int64_t from_ms, int64_t to_ms, uint8_t columns, store_scan_cb callback,
+        void *ctx, struct store_scan_stats *stats) {
+    const uint8_t *col_in[STORE_NUM_COLS];
+    const uint8_t *col_end[STORE_NUM_COLS];
+    const uint8_t *pos = &map[block->offset];
+
+    for (uint8_t col = 0; col < STORE_NUM_COLS; col++) {
+        col_in[col] = pos;
+        pos += block->col_len[col];
+        col_end[col] = pos;
+
+        if ((col == STORE_COL_TS) || (columns & STORE_COL_MASK(col))) {
+            stats->bytes_decoded += block->col_len[col];
+        }
+    }
+
+    struct store_sample sample = {0};
+    int64_t delta = 0, height = 0;
+    uint32_t state_run = 0, status_run = 0;
+    uint64_t value;
+
+    for (uint32_t i = 0; i < block->count; i++) {
+        if (!store_get_varint(&col_in[STORE_COL_TS], col_end[STORE_COL_TS], &value)) {
+            return false;
+        }
+        if (i == 0) {
+            sample.ts_ms = store_unzigzag(value);
+        } else {
+            delta += store_unzigzag(value);
+            sample.ts_ms += delta;
+        }
+
+        if (columns & STORE_COL_MASK(STORE_COL_HEIGHT)) {
+            if (!store_get_varint(&col_in[STORE_COL_HEIGHT], col_end[STORE_COL_HEIGHT],
+                    &value)) {
+                return false;
+            }
+            height += store_unzigzag(value);
+            sample.height_cm = height / STORE_HEIGHT_SCALE;
+        }
+
+        if ((columns & STORE_COL_MASK(STORE_COL_STATE)) && (state_run-- == 0)) {
+            if ((col_in[STORE_COL_STATE] >= col_end[STORE_COL_STATE])) {
+                return false;
+            }
+            sample.state = *col_in[STORE_COL_STATE]++;
+            if (!store_get_varint(&col_in[STORE_COL_STATE], col_end[STORE_COL_STATE],
+                    &value) || (value == 0)) {
+                return false;
+            }
+            state_run = value - 1;
+        }
+
+        if ((columns & STORE_COL_MASK(STORE_COL_STATUS)) && (status_run-- == 0)) {
+            if ((col_in[STORE_COL_STATUS] >= col_end[STORE_COL_STATUS])) {
+                return false;
+            }
+            sample.status = *col_in[STORE_COL_STATUS]++;
+            if (!store_get_varint(&col_in[STORE_COL_STATUS], col_end[STORE_COL_STATUS],
+                    &value) || (value == 0)) {
+                return false;
+            }
+            status_run = value - 1;
+        }
+
+        if (sample.ts_ms > to_ms) {
+            break;
+        } else if (sample.ts_ms >= from_ms) {
+            callback(&sample, ctx);
+            stats->samples++;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Range scan function. This function passes each committed sample of
+ *        a series within a time range to a callback, in time order. Whole
+ *        segments and blocks outside the range are skipped using their
+ *        headers and index entries, so only the blocks overlapping the
+ *        range are read. Scans may run while a gateway is appending to the
+ *        store (samples it hasn't yet committed aren't seen).
+ * @param dir Directory of the store.
+ * @param node Name of the node.
+ * @param tank Tank number.
+ * @param from_ms Start of the time range (inclusive).
+ * @param to_ms End of the time range (inclusive).
+ * @param columns Columns decoded (STORE_COL_MASK() bits, other columns of
+ *        the samples passed to the callback are zero).
+ * @param callback Function called with each sample.
+ * @param ctx Context passed to the callback.
+ * @param stats Pointer to the scan statistics (zeroed by this function).
+ * @retval true if the series was scanned, false if it doesn't exist.
+ */
+bool store_scan(const char *dir, const char *node, uint8_t tank, int64_t from_ms,
+        int64_t to_ms, uint8_t columns, store_scan_cb callback, void *ctx,
+        struct store_scan_stats *stats) {
+    char key[STORE_KEY_LEN];
+    store_series_key(key, node, tank);
+
+    return store_scan_key(dir, key, from_ms, to_ms, columns, callback, ctx, stats);
+}
+
+/**
+ * @brief Range scan by key function. This function is store_scan(), for the
+ *        series with the given key.
+ * @param dir Directory of the store.
+ * @param key Key of the series (see store_series_key()).
+ * @param from_ms Start of the time range (inclusive).
+ * @param to_ms End of the time range (inclusive).
+ * @param columns Columns decoded (STORE_COL_MASK() bits).
+ * @param callback Function called with each sample.
+ * @param ctx Context passed to the callback.
+ * @param stats Pointer to the scan statistics (zeroed by this function).
+ * @retval true if the series was scanned, false if it doesn't exist.
+ */
+bool store_scan_key(const char *dir, const char *key, int64_t from_ms, int64_t to_ms,
+        uint8_t columns, store_scan_cb callback, void *ctx, struct store_scan_stats *stats) {
+    char path[STORE_PATH_LEN];
+    memset(stats, 0, sizeof(struct store_scan_stats));
+
+    for (uint32_t segment = 0; ; segment++) {
+        snprintf(path, STORE_PATH_LEN, "%s/%s/seg-%06u.tsd", dir, key, segment);
+
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return (segment > 0);
+        }
+
+        struct stat st;
+        if ((fstat(fd, &st) != 0) || (st.st_size < STORE_SEGMENT_SIZE)) {
+            close(fd);
+            stats->segments_skipped++;
+            continue;
+        }
+
+        const uint8_t *map = mmap(NULL, STORE_SEGMENT_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            stats->segments_skipped++;
+            continue;
+        }
+
+        const struct store_segment_header *header = (const struct store_segment_header *)map;
+        uint32_t num_blocks = __atomic_load_n(&header->num_blocks, __ATOMIC_ACQUIRE);
+        const struct store_block *index = (const struct store_block *)&map[STORE_HEADER_SIZE];
+
+        if (!store_header_valid(header, st.st_size) || (num_blocks == 0)
+                || (index[num_blocks - 1].last_ts_ms < from_ms)
+                || (index[0].first_ts_ms > to_ms)) {
+            munmap((void *)map, STORE_SEGMENT_SIZE);
+            stats->segments_skipped++;
+            continue;
+        }
+        stats->segments_read++;
+
+        // Blocks are in time order, so the first block ending within the
+        // range is found by binary search.
+        uint32_t low = 0, high = num_blocks;
+        while (low < high) {
+            uint32_t mid = low + ((high - low) / 2);
+            if (index[mid].last_ts_ms < from_ms) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        stats->blocks_skipped += low;
+
+        uint32_t i;
+        for (i = low; (i < num_blocks) && (index[i].first_ts_ms <= to_ms); i++) {
+            if (!store_block_valid(map, &index[i]) || !store_scan_block(map, &index[i],
+                    from_ms, to_ms, columns, callback, ctx, stats)) {
+                stats->blocks_bad++;
+                continue;
+            }
+            stats->blocks_read++;
+        }
+        stats->blocks_skipped += num_blocks - i;
+
+        munmap((void *)map, STORE_SEGMENT_SIZE);
+    }
+}
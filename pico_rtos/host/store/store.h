@@ -0,0 +1,151 @@
+ /**
+ **************************************************************
+ * @file store.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the gateway's tank reading time-series store.
+ ***************************************************************
+ */
+
+#ifndef STORE_H
+#define STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <limits.h>
+#include "rollup.h"
+
+// Segment file identification.
+#define STORE_MAGIC 0x53444b54      // "TKDS"
+#define STORE_VERSION 1
+
+// Segment files are created sparse at a fixed size and mapped whole. Page 0
+// holds the segment header, followed by the block index, followed by the
+// column data of each block.
+#define STORE_SEGMENT_SIZE (8 * 1024 * 1024)
+#define STORE_HEADER_SIZE 4096
+#define STORE_MAX_BLOCKS 4096
+#define STORE_DATA_OFFSET (STORE_HEADER_SIZE \
+        + (STORE_MAX_BLOCKS * sizeof(struct store_block)))
+
+// Samples are buffered in memory and written as one block when a block's
+// worth has been appended (or the store is flushed).
+#define STORE_BLOCK_SAMPLES 1024
+
+// Maximum length of a series key (including the terminating null), and of
+// paths within the store.
+#define STORE_KEY_LEN 64
+#define STORE_PATH_LEN PATH_MAX
+
+// Columns of each block, in the order they are written. Column masks passed
+// to store_scan() select which columns are decoded (timestamps are always
+// decoded).
+#define STORE_COL_TS 0
+#define STORE_COL_HEIGHT 1
+#define STORE_COL_STATE 2
+#define STORE_COL_STATUS 3
+#define STORE_NUM_COLS 4
+#define STORE_COL_MASK(col) (1 << (col))
+#define STORE_COL_MASK_ALL ((1 << STORE_NUM_COLS) - 1)
+
+// Heights are stored as fixed-point hundredths of a cm. Heights beyond
+// +/-STORE_HEIGHT_MAX_CM (or not finite) are rejected, which keeps every
+// height delta within a 5 byte varint.
+#define STORE_HEIGHT_SCALE 100.0
+#define STORE_HEIGHT_MAX_CM 100000.0f
+
+// Worst case encoded size of one sample: timestamp and height varints, and
+// a run (value and length varint) in each of the run-length coded columns.
+#define STORE_MAX_SAMPLE_BYTES (10 + 5 + (2 * (1 + 5)))
+
+// Status bits of a sample. The low bits are the tank's events (ALERT_EVENT_*
+// bits, unshifted), and the leak flag reported by the tank's analytics is
+// above them.
+#define STORE_STATUS_LEAK (1 << 4)
+
+// Struct holding one sample of a tank. Valve states are SERIALISE_STATE_*
+// bits (unshifted).
+struct store_sample {
+    int64_t ts_ms;              // Time since the epoch, in msec
+    float height_cm;
+    uint8_t state;
+    uint8_t status;
+};
+
+// Struct holding the header of a segment file. num_blocks is written last
+// when a block is committed, so blocks beyond it (e.g. partly written
+// before a crash) are never read.
+struct store_segment_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_blocks;        // Committed blocks
+    uint32_t data_end;          // Offset of the end of the committed data
+    int64_t first_ts_ms;
+    int64_t last_ts_ms;
+    char key[STORE_KEY_LEN];
+};
+
+// Struct holding the block index entry of a block.
+struct store_block {
+    int64_t first_ts_ms;
+    int64_t last_ts_ms;
+    uint32_t count;             // Samples in the block
+    uint32_t offset;            // Offset of the block's column data
+    uint32_t col_len[STORE_NUM_COLS];
+    uint32_t crc;               // CRC-32 of the block's column data
+    uint32_t reserved;
+};
+
+// Struct holding a series (the samples of one tank of one node) open for
+// appending.
+struct store_series {
+    char key[STORE_KEY_LEN];
+    char dir[STORE_PATH_LEN];
+    bool sync;
+    uint32_t segment;           // Number of the mapped segment
+    int fd;
+    uint8_t *map;               // Mapped segment, or NULL if none
+    int64_t last_ts_ms;         // Most recent sample appended
+    struct store_sample buf[STORE_BLOCK_SAMPLES];
+    uint32_t buf_count;
+    struct rollup_series rollups;
+};
+
+// Struct holding an open store.
+struct store {
+    char dir[STORE_PATH_LEN];
+    bool sync;                  // msync() each commit before publishing it
+    struct store_series **series;
+    uint32_t num_series;
+};
+
+// Struct holding the statistics of a range scan.
+struct store_scan_stats {
+    uint64_t segments_read;
+    uint64_t segments_skipped;
+    uint64_t blocks_read;
+    uint64_t blocks_skipped;
+    uint64_t blocks_bad;        // Blocks failing their CRC check
+    uint64_t bytes_decoded;
+    uint64_t samples;
+};
+
+// Function called with each sample of a range scan.
+typedef void (*store_scan_cb)(const struct store_sample *sample, void *ctx);
+
+// Function prototypes
+void store_series_key(char *key, const char *node, uint8_t tank);
+bool store_open(struct store *store, const char *dir, bool sync);
+struct store_series *store_series(struct store *store, const char *node, uint8_t tank);
+struct store_series *store_find(const struct store *store, const char *node, uint8_t tank);
+bool store_append(struct store_series *series, const struct store_sample *sample);
+bool store_flush(struct store *store);
+void store_close(struct store *store);
+bool store_scan(const char *dir, const char *node, uint8_t tank, int64_t from_ms,
+        int64_t to_ms, uint8_t columns, store_scan_cb callback, void *ctx,
+        struct store_scan_stats *stats);
+bool store_scan_key(const char *dir, const char *key, int64_t from_ms, int64_t to_ms,
+        uint8_t columns, store_scan_cb callback, void *ctx, struct store_scan_stats *stats);
+
+#endif
@@ -0,0 +1,518 @@
+ /**
+ **************************************************************
+ * @file store_tool.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Time-series store tool. In scan mode, this tool prints the samples
+ *        of a series within a time range (as CSV). In query mode, it sends a
+ *        range query to a gateway's query socket, and prints the response.
+ *        In bench mode, it appends simulated samples to an empty store as
+ *        fast as it can, and then times range scans of the result. In
+ *        rollup mode, it stores a long history of one series, and times
+ *        queries at several resolutions answered from the rollups against
+ *        the same queries answered from the samples (checking they agree).
+ *        Benchmarks report key=value lines.
+ *
+ *        Usage: store_tool scan [-f from (ms)] [-t to (ms)] <dir> <node> <tank>
+ *               store_tool query <socket> <node> <tank> <from (ms)> <to (ms)>
+ *                                <resolution (s)> [raw]
+ *               store_tool bench [-n samples per series] [-k series]
+ *                                [-q queries] [-y] <dir>
+ *               store_tool rollup [-D days] [-q queries] <dir>
+ ***************************************************************
+ */
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "store.h"
+
+// Defaults for the bench mode options (a day of 1 sec samples, of one tank
+// of each of 8 nodes).
+#define STORE_BENCH_DEFAULT_SAMPLES 86400
+#define STORE_BENCH_DEFAULT_SERIES 8
+#define STORE_BENCH_DEFAULT_QUERIES 1000
+
+// Time between simulated samples, and the time range of each query (in msec).
+#define STORE_BENCH_PERIOD_MS 1000
+#define STORE_BENCH_QUERY_MS (3600 * 1000)
+
+// Start time of the simulated samples (in msec since the epoch).
+#define STORE_BENCH_START_MS 1790000000000LL
+
+// Defaults for the rollup mode options (90 days of 1 sec samples).
+#define STORE_ROLLUP_DEFAULT_DAYS 90
+#define STORE_ROLLUP_DEFAULT_QUERIES 20
+
+// Number of times each query is answered from the samples (which is much
+// slower).
+#define STORE_ROLLUP_RAW_QUERIES 3
+
+// Struct holding a query benchmark case: a resolution, and a range ending
+// at the end of the stored history.
+struct rollup_case {
+    const char *name;
+    int64_t range_sec;          // 0 for the whole history
+    int64_t resolution_sec;
+};
+
+// Query benchmark cases.
+static const struct rollup_case rollup_cases[] = {
+    {"all_1d", 0, 86400},
+    {"all_1h", 0, 3600},
+    {"30d_15m", 30 * 86400, 900},
+    {"7d_1h", 7 * 86400, 3600},
+    {"1d_1m", 86400, 60},
+    {"1h_1m", 3600, 60},
+};
+
+// Struct holding the rows of a query result (for comparing results).
+struct row_list {
+    struct rollup_row *rows;
+    size_t count;
+    size_t cap;
+};
+
+// Struct holding the totals of the samples passed to a scan callback.
+struct scan_totals {
+    uint64_t samples;
+    double height_sum;
+};
+
+/**
+ * @brief Monotonic time function.
+ * @param None.
+ * @retval Monotonic time, in sec.
+ */
+static double now_sec(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1e9);
+}
+
+/**
+ * @brief Scan print callback. This function prints a sample as a CSV row.
+ * @param sample Pointer to the sample.
+ * @param ctx Unused.
+ * @retval None.
+ */
+static void scan_print(const struct store_sample *sample, void *ctx) {
+    (void)ctx;
+    printf("%lld,%.2f,%u,%u\n", (long long)sample->ts_ms, sample->height_cm,
+            sample->state, sample->status);
+}
+
+/**
+ * @brief Scan totals callback.
+ * @param sample Pointer to the sample.
+ * @param ctx Pointer to the scan totals.
+ * @retval None.
+ */
+static void scan_total(const struct store_sample *sample, void *ctx) {
+    struct scan_totals *totals = ctx;
+    totals->samples++;
+    totals->height_sum += sample->height_cm;
+}
+
+/**
+ * @brief Row collect callback. This function appends a query result row to
+ *        a list of rows.
+ * @param row Pointer to the row.
+ * @param ctx Pointer to the list of rows.
+ * @retval None.
+ */
+static void row_collect(const struct rollup_row *row, void *ctx) {
+    struct row_list *list = ctx;
+
+    if (list->count == list->cap) {
+        list->cap = (list->cap == 0) ? 1024 : (list->cap * 2);
+        list->rows = realloc(list->rows, list->cap * sizeof(struct rollup_row));
+        if (list->rows == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+
+    list->rows[list->count++] = *row;
+}
+
+/**
+ * @brief Row list compare function.
+ * @param a Pointer to the first list of rows.
+ * @param b Pointer to the second list of rows.
+ * @retval true if the lists hold the same buckets (means may differ by
+ *         rounding), false otherwise.
+ */
+static bool rows_match(const struct row_list *a, const struct row_list *b) {
+    if (a->count != b->count) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a->count; i++) {
+        const struct rollup_row *x = &a->rows[i], *y = &b->rows[i];
+        float mean_diff = x->mean - y->mean;
+        if ((x->start_ms != y->start_ms) || (x->count != y->count) || (x->min != y->min)
+                || (x->max != y->max) || (x->last != y->last)
+                || (mean_diff > 0.001) || (mean_diff < -0.001)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Scan mode function.
+ * @param argc Number of arguments (after the mode).
+ * @param argv Arguments (after the mode).
+ * @retval Exit status.
+ */
+static int scan_main(int argc, char **argv) {
+    int64_t from_ms = INT64_MIN, to_ms = INT64_MAX;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:t:")) != -1) {
+        switch (opt) {
+            case 'f':
+                from_ms = strtoll(optarg, NULL, 0);
+                break;
+            case 't':
+                to_ms = strtoll(optarg, NULL, 0);
+                break;
+            default:
+                return 2;
+        }
+    }
+
+    if ((argc - optind) != 3) {
+        fprintf(stderr, "Usage: store_tool scan [-f from (ms)] [-t to (ms)] "
+                "<dir> <node> <tank>\n");
+        return 2;
+    }
+
+    struct store_scan_stats stats;
+    printf("ts_ms,height_cm,state,status\n");
+    if (!store_scan(argv[optind], argv[optind + 1], strtoul(argv[optind + 2], NULL, 0),
+            from_ms, to_ms, STORE_COL_MASK_ALL, scan_print, NULL, &stats)) {
+        fprintf(stderr, "store_tool: no such series\n");
+        return 1;
+    }
+
+    fprintf(stderr, "samples=%llu blocks_read=%llu blocks_skipped=%llu blocks_bad=%llu\n",
+            (unsigned long long)stats.samples, (unsigned long long)stats.blocks_read,
+            (unsigned long long)stats.blocks_skipped, (unsigned long long)stats.blocks_bad);
+    return 0;
+}
+
+/**
+ * @brief Query mode function.
+ * @param argc Number of arguments (after the mode).
+ * @param argv Arguments (after the mode).
+ * @retval Exit status.
+ */
+static int query_main(int argc, char **argv) {
+    if ((argc < 7) || (argc > 8)) {
+        fprintf(stderr, "Usage: store_tool query <socket> <node> <tank> <from (ms)> "
+                "<to (ms)> <resolution (s)> [raw]\n");
+        return 2;
+    }
+
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", argv[1]);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ((fd < 0) || (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    char line[512];
+    int len = snprintf(line, sizeof(line), "%s %s %s %s %s%s%s\n", argv[2], argv[3],
+            argv[4], argv[5], argv[6], (argc == 8) ? " " : "", (argc == 8) ? argv[7] : "");
+
+    double start = now_sec();
+    if (write(fd, line, len) != len) {
+        perror("write");
+        return 1;
+    }
+    shutdown(fd, SHUT_WR);
+
+    // The gateway closes the connection once the response is written
+    char buf[4096];
+    ssize_t received;
+    while ((received = read(fd, buf, sizeof(buf))) > 0) {
+        fwrite(buf, 1, received, stdout);
+    }
+    fprintf(stderr, "round_trip_ms=%.3f\n", (now_sec() - start) * 1000.0);
+
+    close(fd);
+    return 0;
+}
+
+/**
+ * @brief Rollup mode function.
+ * @param argc Number of arguments (after the mode).
+ * @param argv Arguments (after the mode).
+ * @retval Exit status.
+ */
+static int rollup_main(int argc, char **argv) {
+    uint32_t days = STORE_ROLLUP_DEFAULT_DAYS;
+    uint32_t num_queries = STORE_ROLLUP_DEFAULT_QUERIES;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "D:q:")) != -1) {
+        switch (opt) {
+            case 'D':
+                days = strtoul(optarg, NULL, 0);
+                break;
+            case 'q':
+                num_queries = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                return 2;
+        }
+    }
+
+    if (((argc - optind) != 1) || (days == 0) || (num_queries == 0)) {
+        fprintf(stderr, "Usage: store_tool rollup [-D days] [-q queries] <dir>\n");
+        return 2;
+    }
+
+    struct store store;
+    if (!store_open(&store, argv[optind], false)) {
+        return 1;
+    }
+
+    struct store_series *series = store_series(&store, "rollup", 1);
+    if (series == NULL) {
+        return 1;
+    }
+
+    // A daily cycle of draining and refilling, with sensor noise
+    uint64_t num_samples = (uint64_t)days * 86400;
+    uint32_t rng = 1;
+    double start = now_sec();
+    for (uint64_t n = 0; n < num_samples; n++) {
+        rng = (rng * 1103515245) + 12345;
+        uint32_t sec_of_day = n % 86400;
+        float height = (sec_of_day < 64800) ? (55.0 - (sec_of_day / 1800.0))
+                : (19.0 + ((sec_of_day - 64800) / 600.0));
+        struct store_sample sample = {
+            .ts_ms = STORE_BENCH_START_MS + (n * STORE_BENCH_PERIOD_MS),
+            .height_cm = height + ((((int32_t)(rng >> 16) & 0xFF) - 127.5) / 1000.0),
+            .state = (sec_of_day >= 64800) ? 1 : 0,
+        };
+
+        if (!store_append(series, &sample)) {
+            fprintf(stderr, "store_tool: append failed\n");
+            return 1;
+        }
+    }
+    store_flush(&store);
+    printf("appends=%llu appends_per_sec=%.0f\n", (unsigned long long)num_samples,
+            num_samples / (now_sec() - start));
+
+    int64_t end_ms = STORE_BENCH_START_MS + ((int64_t)num_samples * STORE_BENCH_PERIOD_MS) - 1;
+    int status = 0;
+
+    for (size_t c = 0; c < (sizeof(rollup_cases) / sizeof(rollup_cases[0])); c++) {
+        const struct rollup_case *test = &rollup_cases[c];
+        int64_t from_ms = (test->range_sec == 0) ? STORE_BENCH_START_MS
+                : ((end_ms + 1) - (test->range_sec * 1000));
+        struct row_list lists[2] = {{0}};
+        struct rollup_query_stats stats[2];
+        double query_us[2];
+
+        // Answered from the rollups, then from the samples
+        for (uint8_t raw = 0; raw < 2; raw++) {
+            uint32_t runs = raw ? STORE_ROLLUP_RAW_QUERIES : num_queries;
+            start = now_sec();
+            for (uint32_t q = 0; q < runs; q++) {
+                lists[raw].count = 0;
+                rollup_query(&store, series, from_ms, end_ms, test->resolution_sec * 1000,
+                        !raw, row_collect, &lists[raw], &stats[raw]);
+            }
+            query_us[raw] = ((now_sec() - start) * 1e6) / runs;
+        }
+
+        bool match = rows_match(&lists[0], &lists[1]);
+        status |= !match;
+        printf("query=%s rows=%llu level_sec=%lld rollup_us=%.1f rollup_records=%llu "
+                "raw_us=%.1f raw_samples=%llu speedup=%.1f match=%d\n", test->name,
+                (unsigned long long)stats[0].rows, (long long)(stats[0].level_width_ms / 1000),
+                query_us[0], (unsigned long long)stats[0].records_read, query_us[1],
+                (unsigned long long)stats[1].samples_read, query_us[1] / query_us[0], match);
+
+        free(lists[0].rows);
+        free(lists[1].rows);
+    }
+
+    store_close(&store);
+    return status;
+}
+
+/**
+ * @brief Bench mode function.
+ * @param argc Number of arguments (after the mode).
+ * @param argv Arguments (after the mode).
+ * @retval Exit status.
+ */
+static int bench_main(int argc, char **argv) {
+    uint64_t num_samples = STORE_BENCH_DEFAULT_SAMPLES;
+    uint32_t num_series = STORE_BENCH_DEFAULT_SERIES;
+    uint32_t num_queries = STORE_BENCH_DEFAULT_QUERIES;
+    bool sync = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:k:q:y")) != -1) {
+        switch (opt) {
+            case 'n':
+                num_samples = strtoull(optarg, NULL, 0);
+                break;
+            case 'k':
+                num_series = strtoul(optarg, NULL, 0);
+                break;
+            case 'q':
+                num_queries = strtoul(optarg, NULL, 0);
+                break;
+            case 'y':
+                sync = true;
+                break;
+            default:
+                return 2;
+        }
+    }
+
+    if (((argc - optind) != 1) || (num_samples == 0) || (num_series == 0)) {
+        fprintf(stderr, "Usage: store_tool bench [-n samples per series] [-k series] "
+                "[-q queries] [-y] <dir>\n");
+        return 2;
+    }
+
+    const char *dir = argv[optind];
+    struct store store;
+    if (!store_open(&store, dir, sync)) {
+        return 1;
+    }
+
+    struct store_series **series = calloc(num_series, sizeof(struct store_series *));
+    float *heights = calloc(num_series, sizeof(float));
+    char node[32];
+    for (uint32_t i = 0; i < num_series; i++) {
+        snprintf(node, sizeof(node), "bench%u", i / 2);
+        series[i] = store_series(&store, node, (i % 2) + 1);
+        if (series[i] == NULL) {
+            return 1;
+        }
+        heights[i] = 30.0;
+    }
+
+    // Samples are a slow random walk in height (with sensor noise), and
+    // occasional valve and status changes, interleaved across the series as
+    // the gateway would append them.
+    uint32_t rng = 1;
+    double start = now_sec();
+    for (uint64_t n = 0; n < num_samples; n++) {
+        for (uint32_t i = 0; i < num_series; i++) {
+            rng = (rng * 1103515245) + 12345;
+            heights[i] += (((int32_t)(rng >> 16) & 0xFF) - 127.5) / 2000.0;
+
+            struct store_sample sample = {
+                .ts_ms = STORE_BENCH_START_MS + (n * STORE_BENCH_PERIOD_MS) + (rng & 0x7),
+                .height_cm = heights[i],
+                .state = (n / 3600) & 0x3,
+                .status = ((n % 7200) == 0) ? 0x4 : 0,
+            };
+
+            if (!store_append(series[i], &sample)) {
+                fprintf(stderr, "store_tool: append failed\n");
+                return 1;
+            }
+        }
+    }
+    store_flush(&store);
+    double append_sec = now_sec() - start;
+
+    uint64_t total_samples = num_samples * num_series;
+    uint64_t data_bytes = 0, blocks = 0;
+    for (uint32_t i = 0; i < store.num_series; i++) {
+        // Earlier segments are full, so only the mapped segment is counted
+        // here if the series rolled over.
+        const struct store_segment_header *header =
+                (const struct store_segment_header *)store.series[i]->map;
+        data_bytes += header->data_end - STORE_DATA_OFFSET;
+        blocks += header->num_blocks;
+    }
+
+    printf("appends=%llu append_sec=%.3f appends_per_sec=%.0f\n",
+            (unsigned long long)total_samples, append_sec, total_samples / append_sec);
+    if (store.series[0]->segment == 0) {
+        printf("blocks=%llu data_bytes=%llu bytes_per_sample=%.2f\n",
+                (unsigned long long)blocks, (unsigned long long)data_bytes,
+                (double)data_bytes / total_samples);
+    }
+    store_close(&store);
+
+    // Range queries of an hour, at random positions in random series
+    struct store_scan_stats stats;
+    struct scan_totals totals = {0};
+    uint64_t blocks_read = 0, blocks_skipped = 0, bytes_decoded = 0;
+    int64_t span_ms = (int64_t)num_samples * STORE_BENCH_PERIOD_MS;
+    start = now_sec();
+    for (uint32_t q = 0; q < num_queries; q++) {
+        rng = (rng * 1103515245) + 12345;
+        int64_t from_ms = STORE_BENCH_START_MS + ((rng >> 8) % span_ms);
+        snprintf(node, sizeof(node), "bench%u", (rng % num_series) / 2);
+        store_scan(dir, node, ((rng % num_series) % 2) + 1, from_ms,
+                from_ms + STORE_BENCH_QUERY_MS, STORE_COL_MASK_ALL, scan_total,
+                &totals, &stats);
+        blocks_read += stats.blocks_read;
+        blocks_skipped += stats.blocks_skipped;
+        bytes_decoded += stats.bytes_decoded;
+    }
+    double query_sec = now_sec() - start;
+
+    if (num_queries > 0) {
+        printf("queries=%u query_range_sec=%u query_avg_us=%.1f samples_per_query=%.1f "
+                "blocks_read_per_query=%.2f blocks_skipped_per_query=%.2f "
+                "bytes_decoded_per_query=%.0f\n", num_queries, STORE_BENCH_QUERY_MS / 1000,
+                (query_sec * 1e6) / num_queries, (double)totals.samples / num_queries,
+                (double)blocks_read / num_queries, (double)blocks_skipped / num_queries,
+                (double)bytes_decoded / num_queries);
+    }
+
+    // Full scan of one series, for comparison
+    totals.samples = 0;
+    start = now_sec();
+    store_scan(dir, "bench0", 1, INT64_MIN, INT64_MAX, STORE_COL_MASK_ALL, scan_total,
+            &totals, &stats);
+    double full_sec = now_sec() - start;
+    printf("full_scan_samples=%llu full_scan_ms=%.2f samples_per_sec=%.0f\n",
+            (unsigned long long)totals.samples, full_sec * 1000.0, totals.samples / full_sec);
+
+    free(series);
+    free(heights);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if ((argc >= 2) && (strcmp(argv[1], "scan") == 0)) {
+        return scan_main(argc - 1, &argv[1]);
+    } else if ((argc >= 2) && (strcmp(argv[1], "query") == 0)) {
+        return query_main(argc - 1, &argv[1]);
+    } else if ((argc >= 2) && (strcmp(argv[1], "bench") == 0)) {
+        return bench_main(argc - 1, &argv[1]);
+    } else if ((argc >= 2) && (strcmp(argv[1], "rollup") == 0)) {
+        return rollup_main(argc - 1, &argv[1]);
+    }
+
+    fprintf(stderr, "Usage: %s scan|query|bench|rollup [options] ...\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,71 @@
+ /** 
+ **************************************************************
+ * @file alert.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Alert driver file. This file handles functionality specific to 
+ *        raising events (threshold crossings, valve state changes and 
+ *        analytics alarms) out-of-band to the M5StickC Plus. Raising an 
+ *        event latches it and drives the wake line high, which wakes the 
+ *        M5StickC Plus from deep sleep. The line is released once the 
+ *        M5StickC Plus has fetched the pending events. Each protocol 
+ *        endpoint fetches events as its own reader, so the gateway polling 
+ *        events doesn't take them from the M5StickC Plus. 
+ *************************************************************** 
+ */
+
+#include "alert.h"
+
+// Events raised since each reader last fetched them (ALERT_EVENT_*). 
+static volatile uint32_t alert_pending[ALERT_NUM_READERS];
+
+/**
+ * @brief Alert initialiser function. This function initialises the wake line
+ *        (released). 
+ * @param None. 
+ * @retval None. 
+ */
+void alert_init(void) {
+    gpio_init(ALERT_WAKE_PIN);
+    gpio_set_dir(ALERT_WAKE_PIN, GPIO_OUT);
+    gpio_put(ALERT_WAKE_PIN, 0);
+}
+
+/**
+ * @brief Alert raising function. This function latches the given events and
+ *        drives the wake line. 
+ * @param events Events being raised (ALERT_TANK_EVENT()). 
+ * @retval None. 
+ */
+void alert_raise(uint32_t events) {
+    if (events == 0) {
+        return;
+    }
+
+    // Events may be raised and fetched from tasks on either core. 
+    taskENTER_CRITICAL();
+    for (uint8_t i = 0; i < ALERT_NUM_READERS; i++) {
+        alert_pending[i] |= events;
+    }
+    gpio_put(ALERT_WAKE_PIN, 1);
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Alert fetching function. This function returns and clears a 
+ *        reader's pending events, and releases the wake line if the reader
+ *        is the M5StickC Plus's. 
+ * @param reader Reader fetching the events (below ALERT_NUM_READERS). 
+ * @retval Events raised since the reader's last call. 
+ */
+uint32_t alert_take(uint8_t reader) {
+    taskENTER_CRITICAL();
+    uint32_t events = alert_pending[reader];
+    alert_pending[reader] = 0;
+    if (reader == ALERT_WAKE_READER) {
+        gpio_put(ALERT_WAKE_PIN, 0);
+    }
+    taskEXIT_CRITICAL();
+
+    return events;
+}
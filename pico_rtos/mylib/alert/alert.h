@@ -0,0 +1,41 @@
+ /** 
+ **************************************************************
+ * @file alert.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the alert driver. 
+ *************************************************************** 
+ */
+
+#ifndef ALERT_H
+#define ALERT_H
+
+#include <stdio.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "alert_events.h"
+
+// GPIO pin driving the wake line to the M5StickC Plus (active high, held 
+// until the pending events are fetched with an 'E' request). 
+#define GPIO3 3
+#define ALERT_WAKE_PIN GPIO3
+
+// Alert readers, one per protocol endpoint (see UART_ENDPOINT_* in uart.h),
+// each of which fetches every event. The wake line is held while the 
+// M5StickC Plus's reader has events pending: UART 0, or UART 1 when UART 0
+// is a multi-drop bus. 
+#define ALERT_NUM_READERS 3
+#if defined(MULTIDROP) && MULTIDROP
+#define ALERT_WAKE_READER 1
+#else
+#define ALERT_WAKE_READER 0
+#endif
+
+// Function prototypes
+void alert_init(void);
+void alert_raise(uint32_t events);
+uint32_t alert_take(uint8_t reader);
+
+#endif
@@ -0,0 +1,33 @@
+ /** 
+ **************************************************************
+ * @file alert_events.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the events raised to the M5StickC Plus. This has 
+ *        no hardware or RTOS dependencies, so events can also be determined
+ *        by the host tools. 
+ *************************************************************** 
+ */
+
+#ifndef ALERT_EVENTS_H
+#define ALERT_EVENTS_H
+
+#include <stdint.h>
+
+// Events raised for each tank. Tank n's events are shifted left by 
+// (n - 1) * ALERT_EVENT_BITS_PER_TANK. 
+#define ALERT_EVENT_HIGH_LEVEL (1 << 0)     // Level rose to max fill level
+#define ALERT_EVENT_LOW_LEVEL (1 << 1)      // Level fell to min fill level
+#define ALERT_EVENT_VALVE (1 << 2)          // Fill/drain valve state changed
+#define ALERT_EVENT_LEAK (1 << 3)           // Leak flag raised by analytics
+#define ALERT_EVENT_BITS_PER_TANK 4
+
+// Event(s) for the given tank
+#define ALERT_TANK_EVENT(event, tank) ((uint32_t)(event) << (((tank) - 1) \
+        * ALERT_EVENT_BITS_PER_TANK))
+
+// Distance (in cm) the level must move back past a max/min fill level 
+// before crossing it again raises another event. 
+#define ALERT_LEVEL_HYSTERESIS_CM 1.0
+
+#endif
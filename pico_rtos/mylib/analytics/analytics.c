@@ -0,0 +1,176 @@
+ /**
+ **************************************************************
+ * @file analytics.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Streaming tank level analytics file. This file handles
+ *        functionality specific to characterising each tank's consumption
+ *        from its stream of height readings: a rolling linear regression
+ *        (fill/drain rate) and variance, time-to-empty/time-to-full
+ *        forecasts, and CUSUM leak detection. Every update is O(1) apart
+ *        from a periodic recompute of the window sums, and it has no
+ *        hardware or RTOS dependencies.
+ ***************************************************************
+ */
+
+#include <math.h>
+#include "analytics.h"
+
+/**
+ * @brief Analytics initialiser function. This function resets the analytics
+ *        state of a tank.
+ * @param state Pointer to the analytics state being initialised.
+ * @param sample_period_sec Time between height samples, in sec.
+ * @retval None.
+ */
+void analytics_init(struct tank_analytics_state *state, float sample_period_sec) {
+    for (uint16_t i = 0; i < ANALYTICS_WINDOW_WIDTH; i++) {
+        state->window[i] = 0.0;
+    }
+
+    state->index = 0;
+    state->count = 0;
+    state->samples_since_resum = 0;
+    state->sum_y = 0.0;
+    state->sum_yy = 0.0;
+    state->sum_xy = 0.0;
+    state->last_height = 0.0;
+    state->cusum_cm = 0.0;
+    state->sample_period_sec = sample_period_sec;
+}
+
+/**
+ * @brief Window sum recompute function. This function recomputes the window
+ *        sums from the heights in the window, so rounding errors from the
+ *        incremental updates can't accumulate.
+ * @param state Pointer to the analytics state.
+ * @retval None.
+ */
+static void analytics_resum(struct tank_analytics_state *state) {
+    state->sum_y = 0.0;
+    state->sum_yy = 0.0;
+    state->sum_xy = 0.0;
+
+    for (uint16_t x = 0; x < state->count; x++) {
+        double y = state->window[(state->index + x) % ANALYTICS_WINDOW_WIDTH];
+        state->sum_y += y;
+        state->sum_yy += y * y;
+        state->sum_xy += x * y;
+    }
+
+    state->samples_since_resum = 0;
+}
+
+/**
+ * @brief Window push function. This function adds a height to the window
+ *        (dropping the oldest height once the window is full), and updates
+ *        the window sums.
+ * @param state Pointer to the analytics state.
+ * @param height Height being added, in cm.
+ * @retval None.
+ */
+static void analytics_push(struct tank_analytics_state *state, float height) {
+    double y = height;
+
+    if (state->count < ANALYTICS_WINDOW_WIDTH) {
+        // Window is still filling, so the new height goes at the next
+        // position and no other positions change.
+        state->window[(state->index + state->count) % ANALYTICS_WINDOW_WIDTH] = height;
+        state->sum_xy += state->count * y;
+        state->count++;
+    } else {
+        // Dropping the oldest height moves every other height down one
+        // position, which reduces sum_xy by the sum of the remaining heights.
+        double y_old = state->window[state->index];
+        state->sum_xy += ((ANALYTICS_WINDOW_WIDTH - 1) * y) - (state->sum_y - y_old);
+        state->sum_y -= y_old;
+        state->sum_yy -= y_old * y_old;
+
+        state->window[state->index] = height;
+        state->index = (state->index + 1) % ANALYTICS_WINDOW_WIDTH;
+    }
+
+    state->sum_y += y;
+    state->sum_yy += y * y;
+
+    // Recomputing the sums once per window keeps the cost amortised O(1)
+    state->samples_since_resum++;
+    if (state->samples_since_resum >= ANALYTICS_WINDOW_WIDTH) {
+        analytics_resum(state);
+    }
+}
+
+/**
+ * @brief Analytics update function. This function adds a new height reading
+ *        to a tank's analytics state, and calculates the tank's analytics
+ *        results.
+ * @param state Pointer to the analytics state.
+ * @param height Most recent height reading, in cm.
+ * @param draining Draining status of the tank (leak detection is suspended
+ *        while the drain valve is open).
+ * @param full_height Height at which the tank is considered to be full, in cm.
+ * @param result Pointer to struct populated with the analytics results.
+ * @retval None.
+ */
+void analytics_update(struct tank_analytics_state *state, float height,
+        bool draining, float full_height, struct tank_analytics *result) {
+    // The first reading has no previous reading to compare against
+    if (state->count == 0) {
+        state->last_height = height;
+    }
+
+    analytics_push(state, height);
+
+    // Least squares fit of height against window position. Positions are
+    // 0 to n - 1, so their sums have closed forms.
+    double n = state->count;
+    double slope = 0.0, variance = 0.0;
+    if (state->count >= 2) {
+        double sum_x = (n * (n - 1.0)) / 2.0;
+        double sum_xx = ((n - 1.0) * n * ((2.0 * n) - 1.0)) / 6.0;
+        double s_xx = sum_xx - ((sum_x * sum_x) / n);
+        double s_xy = state->sum_xy - ((sum_x * state->sum_y) / n);
+        double s_yy = state->sum_yy - ((state->sum_y * state->sum_y) / n);
+
+        slope = s_xy / s_xx;
+
+        // Variance of heights about the fitted line
+        if (state->count >= 3) {
+            variance = (s_yy - (slope * s_xy)) / (n - 2.0);
+        }
+
+        if (variance < 0.0) {
+            variance = 0.0;
+        }
+    }
+
+    result->rate_cm_per_sec = (float)(slope / state->sample_period_sec);
+    result->std_dev_cm = (float)sqrt(variance);
+
+    // Forecast time until empty/full from the fitted rate, if the level is
+    // changing faster than noise alone would explain.
+    result->time_to_empty_sec = ANALYTICS_NO_FORECAST;
+    result->time_to_full_sec = ANALYTICS_NO_FORECAST;
+
+    if (result->rate_cm_per_sec <= -ANALYTICS_MIN_RATE_CM_PER_SEC) {
+        result->time_to_empty_sec = height / -result->rate_cm_per_sec;
+    } else if ((result->rate_cm_per_sec >= ANALYTICS_MIN_RATE_CM_PER_SEC)
+            && (height < full_height)) {
+        result->time_to_full_sec = (full_height - height) / result->rate_cm_per_sec;
+    }
+
+    // Accumulate falls in level beyond the allowance while the drain valve
+    // is closed. Rises in level (e.g. filling) pull the sum back to zero.
+    if (draining) {
+        state->cusum_cm = 0.0;
+    } else {
+        state->cusum_cm += (state->last_height - height) - ANALYTICS_LEAK_ALLOWANCE_CM;
+
+        if (state->cusum_cm < 0.0) {
+            state->cusum_cm = 0.0;
+        }
+    }
+
+    result->leak = (state->cusum_cm > ANALYTICS_LEAK_THRESHOLD_CM);
+    state->last_height = height;
+}
@@ -0,0 +1,65 @@
+ /**
+ **************************************************************
+ * @file analytics.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the streaming tank level analytics.
+ ***************************************************************
+ */
+
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Number of samples in the rolling regression window (at one sample per
+// second, rates are fitted over the last minute).
+#define ANALYTICS_WINDOW_WIDTH 60
+
+// Rates with a magnitude below this (in cm/sec) are considered to be noise,
+// so no time-to-empty/time-to-full forecast is made.
+#define ANALYTICS_MIN_RATE_CM_PER_SEC 0.001
+
+// Leak detection CUSUM parameters. Each sample, the fall in level (in cm)
+// less the allowance is accumulated (floored at zero) while the drain valve
+// is closed, and a leak is flagged once the sum exceeds the threshold.
+#define ANALYTICS_LEAK_ALLOWANCE_CM 0.02
+#define ANALYTICS_LEAK_THRESHOLD_CM 1.0
+
+// Value reported for a forecast which doesn't apply (e.g. time-to-empty
+// while the level is rising).
+#define ANALYTICS_NO_FORECAST (-1.0)
+
+// Struct holding the rolling analytics state of a single tank. The window
+// sums are updated in O(1) per sample, with x being the sample's position
+// in the window (0 for the oldest). Sums are kept in double precision, as
+// the variance is the small difference of two large sums.
+struct tank_analytics_state {
+    float window[ANALYTICS_WINDOW_WIDTH];   // Heights in the window
+    uint16_t index;                         // Index of the oldest height
+    uint16_t count;                         // Number of heights in window
+    uint16_t samples_since_resum;           // Samples since sums recomputed
+    double sum_y;                           // Sum of heights
+    double sum_yy;                          // Sum of squared heights
+    double sum_xy;                          // Sum of position * height
+    float last_height;                      // Most recent height
+    float cusum_cm;                         // Leak detection sum
+    float sample_period_sec;                // Time between samples
+};
+
+// Struct holding the analytics results of a single tank.
+struct tank_analytics {
+    float rate_cm_per_sec;      // Fitted rate of level change (+ve filling)
+    float std_dev_cm;           // Std. deviation of heights about the fit
+    float time_to_empty_sec;    // Forecast time until empty, or none
+    float time_to_full_sec;     // Forecast time until full, or none
+    bool leak;                  // Level falling with the drain valve closed
+};
+
+// Function prototypes
+void analytics_init(struct tank_analytics_state *state, float sample_period_sec);
+void analytics_update(struct tank_analytics_state *state, float height,
+        bool draining, float full_height, struct tank_analytics *result);
+
+#endif
@@ -0,0 +1,103 @@
+ /**
+ **************************************************************
+ * @file bench.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Microbenchmark runner file. This file handles functionality
+ *        specific to timing the benchmark cases and formatting/parsing
+ *        their results. Results are one line per case of key=value pairs
+ *        (e.g. "bench=calc_pressure iterations=100000 ns_per_op=12.50 
+ *        spread_pct=1.2"),
+ *        so output from the host and from the target can be compared
+ *        against a stored baseline by the host benchmark tool. 
+ ***************************************************************
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+
+// Value returned by the cases, kept so their work can't be optimised away.
+static volatile uint32_t bench_sink;
+
+/**
+ * @brief Benchmark case runner function. This function times a case
+ *        BENCH_RUNS times, and reports the median run and the spread of the
+ *        runs. 
+ * @param bench_case Pointer to case being run. 
+ * @param iterations Number of iterations per run. 
+ * @param clock Clock function used to time each run. 
+ * @param result Pointer to struct populated with the result. 
+ * @retval None. 
+ */
+void bench_run_case(const struct bench_case *bench_case, uint32_t iterations,
+        bench_clock_t clock, struct bench_result *result) {
+    uint64_t elapsed[BENCH_RUNS];
+
+    // Untimed run to warm up caches (including the XIP cache on target)
+    bench_sink = bench_case->func(iterations);
+
+    // Time each run, keeping the times sorted (insertion sort)
+    for (uint8_t run = 0; run < BENCH_RUNS; run++) {
+        uint64_t start = clock();
+        bench_sink = bench_case->func(iterations);
+        uint64_t run_ns = clock() - start;
+
+        uint8_t i = run;
+        while ((i > 0) && (elapsed[i - 1] > run_ns)) {
+            elapsed[i] = elapsed[i - 1];
+            i--;
+        }
+        elapsed[i] = run_ns;
+    }
+
+    uint64_t median_ns = elapsed[BENCH_RUNS / 2];
+    uint64_t iqr_ns = elapsed[(3 * BENCH_RUNS) / 4] - elapsed[BENCH_RUNS / 4];
+
+    strncpy(result->name, bench_case->name, BENCH_NAME_LEN - 1);
+    result->name[BENCH_NAME_LEN - 1] = '\0';
+    result->iterations = iterations;
+    result->ns_per_op = (iterations == 0) ? 0.0 : ((double)median_ns / iterations);
+    result->spread_pct = (median_ns == 0) ? 0.0 : (((double)iqr_ns * 100.0) / median_ns);
+}
+
+/**
+ * @brief Benchmark result print function. This function prints a result as
+ *        a line of key=value pairs. 
+ * @param result Pointer to result being printed. 
+ * @param cpu_hz CPU clock frequency, used to convert the result to cycles
+ *        (or 0 if unknown, in which case no cycle count is printed). 
+ * @retval None. 
+ */
+void bench_print_result(const struct bench_result *result, uint32_t cpu_hz) {
+    printf("bench=%s iterations=%lu ns_per_op=%.2f spread_pct=%.1f", result->name,
+            (unsigned long)result->iterations, result->ns_per_op, result->spread_pct);
+
+    if (cpu_hz != 0) {
+        printf(" cycles_per_op=%.1f", (result->ns_per_op * cpu_hz) / 1e9);
+    }
+
+    printf("\n");
+}
+
+/**
+ * @brief Benchmark result parse function. This function parses a line
+ *        printed by bench_print_result() (the spread is 0 if the line has
+ *        none). 
+ * @param line Line being parsed. 
+ * @param result Pointer to struct populated with the result. 
+ * @retval true if the line holds a result, false otherwise. 
+ */
+bool bench_parse_result(const char *line, struct bench_result *result) {
+    unsigned long iterations;
+
+    // Name is limited to BENCH_NAME_LEN - 1 characters
+    result->spread_pct = 0.0;
+    if (sscanf(line, "bench=%31s iterations=%lu ns_per_op=%lf spread_pct=%lf", result->name,
+            &iterations, &result->ns_per_op, &result->spread_pct) < 3) {
+        return false;
+    }
+
+    result->iterations = iterations;
+    return true;
+}
@@ -0,0 +1,58 @@
+ /** 
+ **************************************************************
+ * @file bench.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the hot path microbenchmark suite, shared by the
+ *        host benchmark tool and the benchmark firmware. 
+ *************************************************************** 
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Number of times each case is timed. The median run is reported, with the
+// interquartile range as the run-to-run spread, so a few runs disturbed by
+// interference (interrupts, other processes, clock changes) don't move the
+// result. 
+#define BENCH_RUNS 11
+
+// Maximum length of a case name. 
+#define BENCH_NAME_LEN 32
+
+// Benchmark case function. Runs the case for the given number of iterations
+// and returns a value depending on every result, so the work can't be
+// optimised away. 
+typedef uint32_t (*bench_func_t)(uint32_t iterations);
+
+// Clock function, returning a monotonic time in nsec. 
+typedef uint64_t (*bench_clock_t)(void);
+
+// Struct holding a benchmark case. 
+struct bench_case {
+    const char *name;
+    bench_func_t func;
+};
+
+// Struct holding the result of a benchmark case. 
+struct bench_result {
+    char name[BENCH_NAME_LEN];
+    uint32_t iterations;
+    double ns_per_op;
+    double spread_pct;          // Interquartile range, in % of ns_per_op
+};
+
+// Cases run by the suite (see bench_cases.c). 
+extern const struct bench_case bench_cases[];
+extern const uint8_t bench_num_cases;
+
+// Function prototypes
+void bench_run_case(const struct bench_case *bench_case, uint32_t iterations,
+        bench_clock_t clock, struct bench_result *result);
+void bench_print_result(const struct bench_result *result, uint32_t cpu_hz);
+bool bench_parse_result(const char *line, struct bench_result *result);
+
+#endif
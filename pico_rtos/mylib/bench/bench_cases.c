@@ -0,0 +1,207 @@
+ /**
+ **************************************************************
+ * @file bench_cases.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Microbenchmark cases file. This file holds the cases run by the
+ *        benchmark suite: the functions which run every measurement period
+ *        or every UART request. Inputs vary between iterations (from small
+ *        tables), so results aren't computed once and reused. To benchmark
+ *        a replacement for one of these, add a case alongside it. 
+ ***************************************************************
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "bench.h"
+#include "meas_pipeline.h"
+#include "serialise.h"
+
+// Number of entries in the input tables (a power of 2, so wrapping is a
+// mask). 
+#define BENCH_INPUTS 16
+#define BENCH_INPUT_MASK (BENCH_INPUTS - 1)
+
+// Length of the readings string sent to the M5StickC Plus. 
+#define BENCH_UART_STR_LEN 20
+
+// Length of each height value split from the readings string (matches 
+// the M5StickC Plus code). 
+#define BENCH_VALUE_STR_LEN 7
+
+// Decimated pressure channel readings, around a half full tank. 
+static const uint16_t bench_raw[BENCH_INPUTS] = {
+    6180, 6195, 6210, 6172, 6188, 6201, 6230, 6166,
+    6190, 6205, 6178, 6199, 6214, 6183, 6192, 6207,
+};
+
+// Heights (in cm), spanning every control requirement branch. 
+static const float bench_heights[BENCH_INPUTS] = {
+    5.0, 9.9, 10.0, 15.2, 19.9, 20.0, 35.5, 49.9,
+    50.0, 55.1, 59.9, 60.0, 62.3, 40.0, 25.0, 12.0,
+};
+
+// Readings strings as received by the M5StickC Plus. 
+static const char *bench_readings[BENCH_INPUTS] = {
+    "T1=25.3T2=40.1", "T1=5.0T2=60.0", "T1=102.4T2=0.0", "T1=12.7T2=12.7",
+    "T1=0.0T2=100.0", "T1=33.3T2=44.4", "T1=59.9T2=10.1", "T1=9.9T2=9.9",
+    "T1=20.0T2=50.0", "T1=61.2T2=1.5", "T1=47.8T2=23.6", "T1=1.1T2=88.8",
+    "T1=70.0T2=30.0", "T1=18.4T2=56.2", "T1=3.3T2=3.3", "T1=44.0T2=44.0",
+};
+
+/**
+ * @brief Pressure calculation case. 
+ * @param iterations Number of iterations. 
+ * @retval Value depending on every result. 
+ */
+static uint32_t bench_calc_pressure(uint32_t iterations) {
+    float sum = 0.0;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        sum += calc_pressure(bench_raw[i & BENCH_INPUT_MASK], 
+                bench_raw[(i + 5) & BENCH_INPUT_MASK] >> 6);
+    }
+
+    return (uint32_t)sum;
+}
+
+/**
+ * @brief Tank level update case (averaging window update and mean, and
+ *        conversion to height). 
+ * @param iterations Number of iterations. 
+ * @retval Value depending on every result. 
+ */
+static uint32_t bench_update_tank_level(uint32_t iterations) {
+    static struct tank_state state;
+    float sum = 0.0;
+
+    memset(&state, 0, sizeof(state));
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        update_tank_level(&state, &meas_config_defaults.tanks[TANK_1 - 1], 
+                (float)bench_raw[i & BENCH_INPUT_MASK] / 8.0f);
+        sum += state.height;
+    }
+
+    return (uint32_t)sum;
+}
+
+/**
+ * @brief Control requirements check case. 
+ * @param iterations Number of iterations. 
+ * @retval Value depending on every result. 
+ */
+static uint32_t bench_check_ctrl_requirements(uint32_t iterations) {
+    bool filling = false, draining = false;
+    uint32_t commands = 0;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        commands += check_ctrl_requirements(&filling, &draining, 
+                bench_heights[i & BENCH_INPUT_MASK], 
+                &meas_config_defaults.tanks[TANK_1 - 1]);
+    }
+
+    return commands;
+}
+
+/**
+ * @brief Readings string formatting case (as done by the UART task for
+ *        each readings request). 
+ * @param iterations Number of iterations. 
+ * @retval Value depending on every result. 
+ */
+static uint32_t bench_sprintf_readings(uint32_t iterations) {
+    char uart_str[BENCH_UART_STR_LEN];
+    uint32_t sum = 0;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        sprintf(uart_str, "T1=%.1fT2=%.1f!", bench_heights[i & BENCH_INPUT_MASK], 
+                bench_heights[(i + 3) & BENCH_INPUT_MASK]);
+        sum += (uint8_t)uart_str[4];
+    }
+
+    return sum;
+}
+
+/**
+ * @brief Readings serialise case (as done by the UART task for each 
+ *        readings request, replacing sprintf_readings). 
+ * @param iterations Number of iterations. 
+ * @retval Value depending on every result. 
+ */
+static uint32_t bench_serialise_readings(uint32_t iterations) {
+    char uart_str[SERIALISE_READINGS_LEN];
+    uint32_t sum = 0;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        float heights[NUM_TANKS];
+        for (uint8_t j = 0; j < NUM_TANKS; j++) {
+            heights[j] = bench_heights[(i + (3 * j)) & BENCH_INPUT_MASK];
+        }
+        sum += serialise_readings(uart_str, heights) + (uint8_t)uart_str[4];
+    }
+
+    return sum;
+}
+
+/**
+ * @brief Readings string split function. This is a C port of split_str()
+ *        from the M5StickC Plus code (with the same loop and indexing), so
+ *        it can be benchmarked alongside the firmware. 
+ * @param string Readings string, without the termination character. 
+ * @param first_value Char array populated with the tank 1 height. 
+ * @param second_value Char array populated with the tank 2 height. 
+ * @retval None. 
+ */
+static void bench_m5_split_str(const char *string, char *first_value, 
+        char *second_value) {
+    uint8_t second_val_index = strlen(string) + 1;
+    uint8_t equal_1_index = 2, equal_2_index = -1;
+
+    for (uint8_t i = 3; i < strlen(string); i++) {
+        if (string[i] == 'T') {
+            second_val_index = i;
+            equal_2_index = (i + 2);
+        }
+
+        if (i < second_val_index) {
+            first_value[i - (equal_1_index + 1)] = string[i];
+        } else {
+            if (i > equal_2_index) {
+                second_value[i - (equal_2_index + 1)] = string[i];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Readings string split case (as done by the M5StickC Plus for each
+ *        readings response). 
+ * @param iterations Number of iterations. 
+ * @retval Value depending on every result. 
+ */
+static uint32_t bench_split_str(uint32_t iterations) {
+    uint32_t sum = 0;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        char first_value[BENCH_VALUE_STR_LEN] = {'\0'};
+        char second_value[BENCH_VALUE_STR_LEN] = {'\0'};
+        bench_m5_split_str(bench_readings[i & BENCH_INPUT_MASK], first_value, 
+                second_value);
+        sum += (uint8_t)first_value[0] + (uint8_t)second_value[0];
+    }
+
+    return sum;
+}
+
+// Cases run by the suite
+const struct bench_case bench_cases[] = {
+    {"calc_pressure", bench_calc_pressure},
+    {"update_tank_level", bench_update_tank_level},
+    {"check_ctrl_requirements", bench_check_ctrl_requirements},
+    {"sprintf_readings", bench_sprintf_readings},
+    {"serialise_readings", bench_serialise_readings},
+    {"split_str", bench_split_str},
+};
+
+const uint8_t bench_num_cases = sizeof(bench_cases) / sizeof(bench_cases[0]);
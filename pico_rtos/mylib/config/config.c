@@ -0,0 +1,454 @@
+ /**
+ **************************************************************
+ * @file config.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Runtime configuration block file. This file handles functionality
+ *        specific to the configuration block stored in flash: sealing and
+ *        checking blocks, picking the newest valid block from the A/B
+ *        slots, and the text format configuration is requested and updated
+ *        in over the protocol endpoints. It has no hardware or RTOS
+ *        dependencies, so the host can check blocks and updates too (see
+ *        config_store.c for the firmware's store).
+ ***************************************************************
+ */
+
+#include "config.h"
+
+// Configuration field value types.
+#define CONFIG_FIELD_U8 0
+#define CONFIG_FIELD_U32 1
+#define CONFIG_FIELD_FLOAT 2
+
+// Struct describing a configuration field.
+struct config_field {
+    char key;
+    bool per_tank;          // Field of struct tank_cfg rather than struct meas_config
+    uint8_t type;           // CONFIG_FIELD_*
+    size_t offset;
+};
+
+// Configuration fields, in the order they are replied with (tank fields
+// for each tank, then the rest).
+static const struct config_field config_fields[] = {
+    {CONFIG_KEY_AVG_WINDOW_WIDTH, true, CONFIG_FIELD_U8,
+            offsetof(struct tank_cfg, avg_window_width)},
+    {CONFIG_KEY_ZERO_PRESSURE_OFFSET, true, CONFIG_FIELD_FLOAT,
+            offsetof(struct tank_cfg, zero_pressure_offset)},
+    {CONFIG_KEY_USABLE_HEIGHT_OFFSET, true, CONFIG_FIELD_FLOAT,
+            offsetof(struct tank_cfg, usable_height_offset)},
+    {CONFIG_KEY_MAX_FILL_LEVEL, true, CONFIG_FIELD_FLOAT,
+            offsetof(struct tank_cfg, max_fill_level)},
+    {CONFIG_KEY_MIN_FILL_LEVEL, true, CONFIG_FIELD_FLOAT,
+            offsetof(struct tank_cfg, min_fill_level)},
+    {CONFIG_KEY_FILL_TO_LEVEL, true, CONFIG_FIELD_FLOAT,
+            offsetof(struct tank_cfg, fill_to_level)},
+    {CONFIG_KEY_DRAIN_TO_LEVEL, true, CONFIG_FIELD_FLOAT,
+            offsetof(struct tank_cfg, drain_to_level)},
+    {CONFIG_KEY_SAMPLE_PERIOD, false, CONFIG_FIELD_U32,
+            offsetof(struct meas_config, sample_period_ms)},
+};
+
+#define CONFIG_NUM_FIELDS (sizeof(config_fields) / sizeof(config_fields[0]))
+
+_Static_assert(CONFIG_NUM_FIELDS == (CONFIG_TANK_FIELDS + 1), "Field count doesn't match reply");
+_Static_assert(CONFIG_UPDATE_MAX_LEN <= UINT16_MAX, "Update too long for parser");
+
+/**
+ * @brief CRC-32 function (the reflected 0xEDB88320 polynomial, as used by
+ *        zlib). Blocks are only checked at boot and written on updates, so
+ *        it is computed bitwise rather than from a table.
+ * @param data Data the CRC is computed over.
+ * @param len Length of the data.
+ * @retval CRC of the data.
+ */
+uint32_t config_crc32(const void *data, size_t len) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (size_t i = 0; i < len; i++) {
+        crc ^= bytes[i];
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0u - (crc & 1)));
+        }
+    }
+
+    return ~crc;
+}
+
+/**
+ * @brief Range check function.
+ * @param value Value being checked.
+ * @param min Smallest value allowed.
+ * @param max Largest value allowed.
+ * @retval true if the value is within range (NaN never is).
+ */
+static bool config_in_range(float value, float min, float max) {
+    return (value >= min) && (value <= max);
+}
+
+/**
+ * @brief Configuration check function. This function checks every value is
+ *        within its limits, and that each tank's levels are in order (the
+ *        minimum fill level, below the fill to level, no higher than the
+ *        drain to level, below the maximum fill level), so the pipeline
+ *        can't be set to fill and drain a tank at once.
+ * @param meas Pointer to the configuration.
+ * @retval true if the configuration can be used, false otherwise.
+ */
+bool config_validate(const struct meas_config *meas) {
+    if ((meas->sample_period_ms < MEAS_MIN_SAMPLE_PERIOD_MSEC)
+            || (meas->sample_period_ms > MEAS_MAX_SAMPLE_PERIOD_MSEC)) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        const struct tank_cfg *cfg = &meas->tanks[i];
+
+        // Tanks and channels are fixed by the hardware
+        if ((cfg->tank != meas_config_defaults.tanks[i].tank)
+                || (cfg->pressure_channel != meas_config_defaults.tanks[i].pressure_channel)) {
+            return false;
+        }
+
+        if ((cfg->avg_window_width == 0) || (cfg->avg_window_width > AVG_WINDOW_MAX_WIDTH)) {
+            return false;
+        }
+
+        if (!config_in_range(cfg->zero_pressure_offset, -CONFIG_MAX_PRESSURE_OFFSET,
+                CONFIG_MAX_PRESSURE_OFFSET)
+                || !config_in_range(cfg->usable_height_offset, 0.0f, CONFIG_MAX_LEVEL_CM)
+                || !config_in_range(cfg->min_fill_level, 0.0f, CONFIG_MAX_LEVEL_CM)
+                || !config_in_range(cfg->max_fill_level, 0.0f, CONFIG_MAX_LEVEL_CM)) {
+            return false;
+        }
+
+        if (!(cfg->min_fill_level < cfg->fill_to_level)
+                || !(cfg->fill_to_level <= cfg->drain_to_level)
+                || !(cfg->drain_to_level < cfg->max_fill_level)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Block initialise function. This function fills a block with a
+ *        configuration, and seals it with its CRC.
+ * @param block Pointer to the block.
+ * @param sequence Sequence number of the block.
+ * @param meas Pointer to the configuration.
+ * @retval None.
+ */
+void config_block_init(struct config_block *block, uint32_t sequence,
+        const struct meas_config *meas) {
+    memset(block, 0, sizeof(*block));
+
+    block->magic = CONFIG_MAGIC;
+    block->version = CONFIG_VERSION;
+    block->size = sizeof(*block);
+    block->sequence = sequence;
+    block->meas = *meas;
+    block->crc = config_crc32(block, offsetof(struct config_block, crc));
+}
+
+/**
+ * @brief Block check function.
+ * @param block Pointer to the block (e.g. in a flash slot).
+ * @retval true if the block was written by this firmware version, is intact
+ *         and holds a configuration which can be used.
+ */
+bool config_block_valid(const struct config_block *block) {
+    return (block->magic == CONFIG_MAGIC) && (block->version == CONFIG_VERSION)
+            && (block->size == sizeof(*block))
+            && (block->crc == config_crc32(block, offsetof(struct config_block, crc)))
+            && config_validate(&block->meas);
+}
+
+/**
+ * @brief Newest slot function. This function picks the valid block with the
+ *        newest sequence number (compared so the sequence can wrap).
+ * @param slots Blocks in each slot (CONFIG_NUM_SLOTS).
+ * @retval Slot of the newest valid block, or CONFIG_NO_SLOT if neither is
+ *         valid.
+ */
+int8_t config_newest_slot(const struct config_block *const *slots) {
+    int8_t newest = CONFIG_NO_SLOT;
+
+    for (int8_t slot = 0; slot < CONFIG_NUM_SLOTS; slot++) {
+        if (!config_block_valid(slots[slot])) {
+            continue;
+        }
+
+        if ((newest == CONFIG_NO_SLOT)
+                || ((int32_t)(slots[slot]->sequence - slots[newest]->sequence) > 0)) {
+            newest = slot;
+        }
+    }
+
+    return newest;
+}
+
+/**
+ * @brief Parser initialise function.
+ * @param parser Pointer to the parser.
+ * @retval None.
+ */
+void config_parser_init(struct config_parser *parser) {
+    parser->active = false;
+    parser->overflow = false;
+    parser->len = 0;
+    parser->text[0] = '\0';
+}
+
+/**
+ * @brief Update parse function. This function adds one received character
+ *        to the parser. Characters outside an update are left to the caller
+ *        (as request characters), and a start character always begins a new
+ *        update. An overlong update completes with no text, so it is
+ *        rejected.
+ * @param parser Pointer to the parser.
+ * @param c Received character.
+ * @retval CONFIG_PARSE_DONE if the character completed an update (whose
+ *         text is left in the parser), CONFIG_PARSE_PENDING if it is part of
+ *         one, CONFIG_PARSE_NONE otherwise.
+ */
+uint8_t config_parse(struct config_parser *parser, char c) {
+    if (c == CONFIG_UPDATE_START) {
+        parser->active = true;
+        parser->overflow = false;
+        parser->len = 0;
+        return CONFIG_PARSE_PENDING;
+    } else if (!parser->active) {
+        return CONFIG_PARSE_NONE;
+    }
+
+    if (c == CONFIG_UPDATE_END) {
+        parser->active = false;
+        parser->len = parser->overflow ? 0 : parser->len;
+        parser->text[parser->len] = '\0';
+        return CONFIG_PARSE_DONE;
+    }
+
+    if (parser->len < CONFIG_UPDATE_MAX_LEN) {
+        parser->text[parser->len++] = c;
+    } else {
+        parser->overflow = true;
+    }
+
+    return CONFIG_PARSE_PENDING;
+}
+
+/**
+ * @brief Field value parse function. This function parses a decimal value
+ *        with at most 2 decimal places (and, for fractional fields, an
+ *        optional sign).
+ * @param pos Pointer to the position in the text (moved past the value).
+ * @param fractional true if the value may be negative or have decimals.
+ * @param hundredths Pointer to the value, in hundredths.
+ * @retval true if a value was parsed, false otherwise.
+ */
+static bool config_parse_value(const char **pos, bool fractional, int32_t *hundredths) {
+    const char *p = *pos;
+    bool negative = false;
+    int32_t value = 0;
+    uint8_t digits = 0;
+    int8_t decimals = -1;
+
+    if (fractional && (*p == '-')) {
+        negative = true;
+        p++;
+    }
+
+    for (; ((*p >= '0') && (*p <= '9')) || (fractional && (*p == '.')); p++) {
+        if (*p == '.') {
+            if (decimals >= 0) {
+                return false;
+            }
+            decimals = 0;
+            continue;
+        }
+
+        if ((decimals >= 2) || (value > (CONFIG_VALUE_MAX_HUNDREDTHS / 10))) {
+            return false;
+        }
+
+        value = (value * 10) + (*p - '0');
+        decimals = (decimals >= 0) ? (decimals + 1) : decimals;
+        digits++;
+    }
+
+    if (digits == 0) {
+        return false;
+    }
+
+    // Scale to hundredths for the decimals not given
+    for (int8_t i = (decimals < 0) ? 0 : decimals; i < 2; i++) {
+        if (value > (CONFIG_VALUE_MAX_HUNDREDTHS / 10)) {
+            return false;
+        }
+        value *= 10;
+    }
+
+    *hundredths = negative ? -value : value;
+    *pos = p;
+    return true;
+}
+
+/**
+ * @brief Update apply function. This function sets the fields given in an
+ *        update's text (e.g. "h1=55,p=500") in a configuration. Nothing is
+ *        checked against the limits (see config_validate()).
+ * @param text Update text (between the braces).
+ * @param meas Pointer to the configuration (only changed if the whole
+ *        update parses).
+ * @retval CONFIG_OK, or CONFIG_ERR_SYNTAX if the text isn't a list of
+ *         fields.
+ */
+uint8_t config_apply_update(const char *text, struct meas_config *meas) {
+    struct meas_config updated = *meas;
+    const char *pos = text;
+
+    if (*pos == '\0') {
+        return CONFIG_ERR_SYNTAX;
+    }
+
+    while (true) {
+        const struct config_field *field = NULL;
+        for (uint8_t i = 0; i < CONFIG_NUM_FIELDS; i++) {
+            if (config_fields[i].key == *pos) {
+                field = &config_fields[i];
+            }
+        }
+
+        if (field == NULL) {
+            return CONFIG_ERR_SYNTAX;
+        }
+        pos++;
+
+        uint8_t *base = (uint8_t *)&updated;
+        if (field->per_tank) {
+            if ((*pos < '1') || (*pos > ('0' + NUM_TANKS))) {
+                return CONFIG_ERR_SYNTAX;
+            }
+            base = (uint8_t *)&updated.tanks[*pos - '1'];
+            pos++;
+        }
+
+        int32_t hundredths;
+        if ((*pos++ != '=')
+                || !config_parse_value(&pos, field->type == CONFIG_FIELD_FLOAT, &hundredths)) {
+            return CONFIG_ERR_SYNTAX;
+        }
+
+        if (field->type == CONFIG_FIELD_FLOAT) {
+            *(float *)(base + field->offset) = (float)hundredths / 100.0f;
+        } else if (field->type == CONFIG_FIELD_U32) {
+            *(uint32_t *)(base + field->offset) = (uint32_t)(hundredths / 100);
+        } else {
+            // Out of range widths are left for the range check
+            *(uint8_t *)(base + field->offset) = (hundredths > (UINT8_MAX * 100))
+                    ? 0 : (uint8_t)(hundredths / 100);
+        }
+
+        if (*pos == '\0') {
+            break;
+        } else if (*pos++ != CONFIG_FIELD_SEPARATOR) {
+            return CONFIG_ERR_SYNTAX;
+        }
+    }
+
+    *meas = updated;
+    return CONFIG_OK;
+}
+
+/**
+ * @brief Field serialise function. This function writes one field, e.g.
+ *        ",h1=60.00".
+ * @param out Buffer written to (at least CONFIG_FIELD_MAX_LEN chars).
+ * @param field Pointer to the field.
+ * @param meas Pointer to the configuration.
+ * @param tank Tank number, for tank fields.
+ * @retval Pointer to the character after the last written.
+ */
+static char *config_serialise_field(char *out, const struct config_field *field,
+        const struct meas_config *meas, uint8_t tank) {
+    const uint8_t *base = (const uint8_t *)meas;
+
+    *out++ = CONFIG_FIELD_SEPARATOR;
+    *out++ = field->key;
+    if (field->per_tank) {
+        *out++ = '0' + tank;
+        base = (const uint8_t *)&meas->tanks[tank - 1];
+    }
+    *out++ = '=';
+
+    if (field->type == CONFIG_FIELD_FLOAT) {
+        float value = *(const float *)(base + field->offset);
+        out = serialise_fixed(out, serialise_to_fixed(value, 2, CONFIG_VALUE_MAX_HUNDREDTHS), 2);
+    } else if (field->type == CONFIG_FIELD_U32) {
+        out = serialise_u32(out, *(const uint32_t *)(base + field->offset));
+    } else {
+        out = serialise_u32(out, *(const uint8_t *)(base + field->offset));
+    }
+
+    return out;
+}
+
+/**
+ * @brief Configuration serialise function. This function writes a
+ *        configuration reply, e.g. "C=3,w1=5,z1=140.18,...,p=1000!".
+ * @param out Buffer written to (CONFIG_REPLY_LEN chars).
+ * @param block Pointer to the active block.
+ * @retval Length of the reply (excluding the terminating null).
+ */
+size_t config_serialise(char *out, const struct config_block *block) {
+    char *pos = out;
+
+    *pos++ = CONFIG_REQUEST;
+    *pos++ = '=';
+    pos = serialise_u32(pos, block->sequence);
+
+    for (uint8_t tank = 1; tank <= NUM_TANKS; tank++) {
+        for (uint8_t i = 0; i < CONFIG_NUM_FIELDS; i++) {
+            if (config_fields[i].per_tank) {
+                pos = config_serialise_field(pos, &config_fields[i], &block->meas, tank);
+            }
+        }
+    }
+
+    for (uint8_t i = 0; i < CONFIG_NUM_FIELDS; i++) {
+        if (!config_fields[i].per_tank) {
+            pos = config_serialise_field(pos, &config_fields[i], &block->meas, 0);
+        }
+    }
+
+    *pos++ = '!';
+    *pos = '\0';
+
+    return pos - out;
+}
+
+/**
+ * @brief Update error serialise function. This function writes the reply
+ *        to an update which wasn't applied, e.g. "C=RANGE!".
+ * @param out Buffer written to (CONFIG_REPLY_LEN chars).
+ * @param result Update result (CONFIG_ERR_*).
+ * @retval Length of the reply (excluding the terminating null).
+ */
+size_t config_serialise_error(char *out, uint8_t result) {
+    const char *reason = (result == CONFIG_ERR_RANGE) ? "RANGE"
+            : (result == CONFIG_ERR_FLASH) ? "FLASH" : "SYNTAX";
+    char *pos = out;
+
+    *pos++ = CONFIG_REQUEST;
+    *pos++ = '=';
+    while (*reason != '\0') {
+        *pos++ = *reason++;
+    }
+    *pos++ = '!';
+    *pos = '\0';
+
+    return pos - out;
+}
@@ -0,0 +1,115 @@
+ /**
+ **************************************************************
+ * @file config.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the runtime configuration block.
+ ***************************************************************
+ */
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include "meas_pipeline.h"
+#include "serialise.h"
+
+// Configuration block header. The version changes whenever the layout of
+// struct config_block does, so blocks written by other firmware are ignored.
+#define CONFIG_MAGIC 0x47464354     // "TCFG"
+#define CONFIG_VERSION 1
+
+// Number of slots a configuration block is stored in. Updates are written
+// to the slot not holding the active block, so a bad write leaves it intact.
+#define CONFIG_NUM_SLOTS 2
+#define CONFIG_NO_SLOT (-1)
+
+// Limits of configured values. Levels and offsets are in cm, pressure
+// offsets are in Pa (the sensor's range).
+#define CONFIG_MAX_LEVEL_CM 999.0f
+#define CONFIG_MAX_PRESSURE_OFFSET 10000.0f
+
+// Configuration update results.
+#define CONFIG_OK 0
+#define CONFIG_ERR_SYNTAX 1
+#define CONFIG_ERR_RANGE 2
+#define CONFIG_ERR_FLASH 3
+
+// Configuration requests and updates. 'C' requests the active
+// configuration, replied to as "C=<sequence>," followed by every field,
+// e.g. "C=3,w1=5,z1=140.18,u1=4.00,h1=60.00,l1=10.00,f1=20.00,d1=50.00,
+// w2=5,...,p=1000!". An update sets any fields, e.g. "{h1=55,p=500}", and
+// is replied to with the new configuration, or "C=SYNTAX!", "C=RANGE!" or
+// "C=FLASH!" if it isn't applied.
+#define CONFIG_REQUEST 'C'
+#define CONFIG_UPDATE_START '{'
+#define CONFIG_UPDATE_END '}'
+#define CONFIG_FIELD_SEPARATOR ','
+
+// Configuration field keys. Tank fields are followed by the tank number
+// (e.g. "h1").
+#define CONFIG_KEY_AVG_WINDOW_WIDTH 'w'
+#define CONFIG_KEY_ZERO_PRESSURE_OFFSET 'z'
+#define CONFIG_KEY_USABLE_HEIGHT_OFFSET 'u'
+#define CONFIG_KEY_MAX_FILL_LEVEL 'h'
+#define CONFIG_KEY_MIN_FILL_LEVEL 'l'
+#define CONFIG_KEY_FILL_TO_LEVEL 'f'
+#define CONFIG_KEY_DRAIN_TO_LEVEL 'd'
+#define CONFIG_KEY_SAMPLE_PERIOD 'p'
+
+// Number of tank fields, and the buffer sizes of the longest field value
+// (fractional values are sent to 2 decimal places, clamped to +/-99999.99)
+// and field (",h1=" and the value).
+#define CONFIG_TANK_FIELDS 7
+#define CONFIG_VALUE_MAX_HUNDREDTHS 9999999
+#define CONFIG_VALUE_MAX_LEN 9
+#define CONFIG_FIELD_MAX_LEN (4 + CONFIG_VALUE_MAX_LEN)
+
+// Buffer size (including the terminating null) of a configuration reply.
+#define CONFIG_REPLY_LEN (2 + SERIALISE_U32_MAX_LEN \
+        + (((NUM_TANKS * CONFIG_TANK_FIELDS) + 1) * CONFIG_FIELD_MAX_LEN) + 2)
+
+// Longest update (between the braces) accepted, enough to set every field.
+#define CONFIG_UPDATE_MAX_LEN (((NUM_TANKS * CONFIG_TANK_FIELDS) + 1) * CONFIG_FIELD_MAX_LEN)
+
+// Update parse results (see config_parse()).
+#define CONFIG_PARSE_NONE 0         // Not part of an update
+#define CONFIG_PARSE_PENDING 1      // Part of an update
+#define CONFIG_PARSE_DONE 2         // Update complete
+
+// Struct holding a configuration block, as stored in flash. The CRC covers
+// everything before it.
+struct config_block {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    uint32_t sequence;              // 0 for the defaults, incremented by every update
+    struct meas_config meas;
+    uint32_t crc;
+};
+
+// Struct holding the state of an update parser (one per endpoint).
+struct config_parser {
+    bool active;
+    bool overflow;
+    uint16_t len;
+    char text[CONFIG_UPDATE_MAX_LEN + 1];
+};
+
+// Function prototypes
+uint32_t config_crc32(const void *data, size_t len);
+bool config_validate(const struct meas_config *meas);
+void config_block_init(struct config_block *block, uint32_t sequence,
+        const struct meas_config *meas);
+bool config_block_valid(const struct config_block *block);
+int8_t config_newest_slot(const struct config_block *const *slots);
+void config_parser_init(struct config_parser *parser);
+uint8_t config_parse(struct config_parser *parser, char c);
+uint8_t config_apply_update(const char *text, struct meas_config *meas);
+size_t config_serialise(char *out, const struct config_block *block);
+size_t config_serialise_error(char *out, uint8_t result);
+
+#endif
@@ -0,0 +1,204 @@
+ /**
+ **************************************************************
+ * @file config_store.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Runtime configuration store file. This file handles functionality
+ *        specific to keeping the active configuration. It is loaded at boot
+ *        from the newest valid of two flash slots (or the defaults), and
+ *        updates are written to the other slot and read back before being
+ *        used, so a bad write falls back to the previous block. The active
+ *        block is an immutable snapshot published through a pointer, which
+ *        the measurement task reads without locking. An update fills the
+ *        spare snapshot, then swaps the pointer, and the spare is only
+ *        reused once no reader's hazard pointer holds it.
+ ***************************************************************
+ */
+
+#include "config_store.h"
+
+_Static_assert(sizeof(struct config_block) <= FLASH_PAGE_SIZE, "Config block exceeds a flash page");
+
+// Snapshots of the active block and the spare (filled by the next update).
+static struct config_block snapshots[2];
+
+// Active snapshot (only changed by config_store_apply(), and only read
+// with the __atomic builtins outside it).
+static struct config_block *active = &snapshots[0];
+
+// Snapshot each reader is using, or NULL.
+static struct config_block *hazards[CONFIG_NUM_READERS];
+
+// Slot holding the active block, or CONFIG_NO_SLOT for the defaults.
+static int8_t active_slot = CONFIG_NO_SLOT;
+
+// Mutex held by updates (and copies of the active block).
+static SemaphoreHandle_t update_mutex;
+
+// Struct holding a flash slot write (see config_store_program()).
+struct config_write {
+    uint32_t offset;
+    const uint8_t *page;
+};
+
+/**
+ * @brief Slot block function.
+ * @param slot Slot.
+ * @retval Pointer to the block in the slot (via XIP).
+ */
+static const struct config_block *config_slot_block(int8_t slot) {
+    return (const struct config_block *)(uintptr_t)(XIP_BASE + CONFIG_SLOT_OFFSET(slot));
+}
+
+/**
+ * @brief Configuration store initialise function. This function loads the
+ *        newest valid block from the flash slots, or the defaults if
+ *        neither slot holds one. It is called before the scheduler starts.
+ * @param None.
+ * @retval None.
+ */
+void config_store_init(void) {
+    const struct config_block *slots[CONFIG_NUM_SLOTS];
+    for (int8_t slot = 0; slot < CONFIG_NUM_SLOTS; slot++) {
+        slots[slot] = config_slot_block(slot);
+    }
+
+    active_slot = config_newest_slot(slots);
+    if (active_slot != CONFIG_NO_SLOT) {
+        snapshots[0] = *slots[active_slot];
+    } else {
+        config_block_init(&snapshots[0], 0, &meas_config_defaults);
+    }
+
+    active = &snapshots[0];
+    update_mutex = xSemaphoreCreateMutex();
+}
+
+/**
+ * @brief Read start function. This function publishes the active snapshot
+ *        in the reader's hazard pointer, and checks it is still active
+ *        (otherwise an update may already be refilling it, so the new one
+ *        is taken). It never blocks.
+ * @param reader Reader (CONFIG_READER_*).
+ * @retval Pointer to the configuration, unchanged until config_read_end().
+ */
+const struct meas_config *HOT_PATH_FUNC(config_read_begin)(uint8_t reader) {
+    struct config_block *block;
+
+    do {
+        block = __atomic_load_n(&active, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&hazards[reader], block, __ATOMIC_SEQ_CST);
+    } while (block != __atomic_load_n(&active, __ATOMIC_SEQ_CST));
+
+    return &block->meas;
+}
+
+/**
+ * @brief Read end function. This function releases the reader's snapshot.
+ * @param reader Reader (CONFIG_READER_*).
+ * @retval None.
+ */
+void HOT_PATH_FUNC(config_read_end)(uint8_t reader) {
+    __atomic_store_n(&hazards[reader], NULL, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Snapshot in use function.
+ * @param block Pointer to a snapshot.
+ * @retval true if any reader holds the snapshot, false otherwise.
+ */
+static bool config_in_use(const struct config_block *block) {
+    for (uint8_t i = 0; i < CONFIG_NUM_READERS; i++) {
+        if (__atomic_load_n(&hazards[i], __ATOMIC_SEQ_CST) == block) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Active block getter function. This function copies the active
+ *        block (e.g. for a configuration request).
+ * @param block Pointer to struct which the block is copied into.
+ * @retval None.
+ */
+void config_store_get(struct config_block *block) {
+    xSemaphoreTake(update_mutex, portMAX_DELAY);
+    *block = *active;
+    xSemaphoreGive(update_mutex);
+}
+
+/**
+ * @brief Flash program function. This function erases a slot's sector and
+ *        programs its first page. It is run by flash_safe_execute(), with
+ *        the other core kept from running from flash.
+ * @param param Pointer to the write (struct config_write).
+ * @retval None.
+ */
+static void config_store_program(void *param) {
+    const struct config_write *write = (const struct config_write *)param;
+
+    flash_range_erase(write->offset, FLASH_SECTOR_SIZE);
+    flash_range_program(write->offset, write->page, FLASH_PAGE_SIZE);
+}
+
+/**
+ * @brief Configuration update function. This function applies an update to
+ *        the active configuration, checks the result, writes it as the next
+ *        block to the slot not holding the active block, reads it back, and
+ *        only then makes it active. Updates from different endpoints are
+ *        applied one at a time. Flash writes stall the other core for up to
+ *        a sector erase.
+ * @param text Update text (see config_apply_update()).
+ * @retval CONFIG_OK, CONFIG_ERR_SYNTAX if the update doesn't parse,
+ *         CONFIG_ERR_RANGE if the configuration can't be used, or
+ *         CONFIG_ERR_FLASH if the block didn't read back intact (in each
+ *         case the active block is kept).
+ */
+uint8_t config_store_apply(const char *text) {
+    // Page programmed into the slot (the rest of the page is left erased)
+    static uint8_t page[FLASH_PAGE_SIZE];
+
+    xSemaphoreTake(update_mutex, portMAX_DELAY);
+
+    struct config_block *current = active;
+    struct config_block *next = (current == &snapshots[0]) ? &snapshots[1] : &snapshots[0];
+
+    struct meas_config meas = current->meas;
+    uint8_t result = config_apply_update(text, &meas);
+    if ((result == CONFIG_OK) && !config_validate(&meas)) {
+        result = CONFIG_ERR_RANGE;
+    }
+
+    if (result != CONFIG_OK) {
+        xSemaphoreGive(update_mutex);
+        return result;
+    }
+
+    // A reader may still hold the snapshot replaced by the last update, for
+    // at most one pass of its loop.
+    while (config_in_use(next)) {
+        vTaskDelay(1);
+    }
+
+    config_block_init(next, current->sequence + 1, &meas);
+
+    int8_t slot = (active_slot == 0) ? 1 : 0;
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, next, sizeof(*next));
+
+    struct config_write write = {CONFIG_SLOT_OFFSET(slot), page};
+    if ((flash_safe_execute(&config_store_program, &write, CONFIG_FLASH_TIMEOUT_MSEC) != PICO_OK)
+            || (memcmp(config_slot_block(slot), next, sizeof(*next)) != 0)
+            || !config_block_valid(config_slot_block(slot))) {
+        result = CONFIG_ERR_FLASH;
+    } else {
+        active_slot = slot;
+        __atomic_store_n(&active, next, __ATOMIC_SEQ_CST);
+    }
+
+    xSemaphoreGive(update_mutex);
+
+    return result;
+}
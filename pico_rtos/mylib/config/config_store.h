@@ -0,0 +1,43 @@
+ /**
+ **************************************************************
+ * @file config_store.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the runtime configuration store.
+ ***************************************************************
+ */
+
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+#include <stdio.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+#include "config.h"
+
+// Flash slots, in the last CONFIG_NUM_SLOTS sectors of flash (offsets from
+// the start of flash). Each holds one block at the start of the sector.
+#define CONFIG_SLOT_OFFSET(slot) \
+        (PICO_FLASH_SIZE_BYTES - ((CONFIG_NUM_SLOTS - (slot)) * FLASH_SECTOR_SIZE))
+
+// Longest time an update waits for the other core to stop running from
+// flash (in msec).
+#define CONFIG_FLASH_TIMEOUT_MSEC 100
+
+// Tasks which read the configuration without locking (each has its own
+// hazard pointer, see config_read_begin()).
+#define CONFIG_READER_MEAS 0
+#define CONFIG_NUM_READERS 1
+
+// Function prototypes
+void config_store_init(void);
+const struct meas_config *config_read_begin(uint8_t reader);
+void config_read_end(uint8_t reader);
+void config_store_get(struct config_block *block);
+uint8_t config_store_apply(const char *text);
+
+#endif
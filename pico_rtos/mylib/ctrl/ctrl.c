@@ -12,10 +12,15 @@
 
 #include "ctrl.h"
 
-// Semaphore which is given when control enable switch is switched on/off, 
-// which notifies the level control enable task that a logic state change 
-// has occurred on the pin connected to the switch. 
-SemaphoreHandle_t ctrl_enable_sem;
+// Queue carrying debounced control enable switch events, which notifies the 
+// level control enable task that the switch connected to GPIO2 has settled
+// at a new logic level. 
+QueueHandle_t ctrl_enable_queue;
+
+// Debouncer for the control enable switch. This is shared between the GPIO2
+// interrupt callback and the debounce alarm callback, so it is only accessed
+// from within critical sections. 
+static struct debouncer ctrl_enable_debouncer;
 
 // Semaphores that are given when control is switched off, which notifies 
 // tank level control tasks to delete themselves. 
@@ -42,6 +47,11 @@ SemaphoreHandle_t drain_t2_sem;
 SemaphoreHandle_t stop_drain_t1_sem;
 SemaphoreHandle_t stop_drain_t2_sem;
 
+// Queue sets containing the semaphores used to notify each tank level 
+// control task, which the respective task blocks on. 
+static QueueSetHandle_t t1_ctrl_queue_set;
+static QueueSetHandle_t t2_ctrl_queue_set;
+
 // Semaphores which are given to notify the water tank level measurement
 // controlling task for tank 1 whether or not control is enabled for 
 // tank 1. 
@@ -54,22 +64,67 @@ SemaphoreHandle_t ctrl_off_sem_1;
 SemaphoreHandle_t ctrl_on_sem_2;
 SemaphoreHandle_t ctrl_off_sem_2;
 
+/**
+ * @brief Control enable debounce alarm callback. This callback is executed
+ *        by the hardware timer once the control enable switch has been free
+ *        of edges for the settle time, and posts a timestamped event to the 
+ *        level control enable task if the switch has settled at a new level. 
+ * @param id Alarm ID. 
+ * @param user_data Value passed upon alarm creation. 
+ * @retval 0 if the switch has settled, otherwise the number of usec after 
+ *         which the alarm must fire again. 
+ */
+int64_t HOT_PATH_FUNC(ctrl_enable_alarm_cb)(alarm_id_t id, void *user_data) {
+    // This will be set to pdTRUE if posting the event causes a task to
+    // unblock which has a higher priority than the task which is currently
+    // running. 
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    struct debounce_event event;
+    bool emitted = false;
+
+    // Check whether the switch has settled. 
+    UBaseType_t saved_irq_status = taskENTER_CRITICAL_FROM_ISR();
+    uint32_t resample_us = debounce_poll(&ctrl_enable_debouncer, gpio_get(GPIO2),
+            time_us_64(), &event, &emitted);
+    taskEXIT_CRITICAL_FROM_ISR(saved_irq_status);
+
+    // If the switch has settled at a new level, notify the level control
+    // enable task and switch to it immediately if it has been woken. 
+    if (emitted && (ctrl_enable_queue != NULL)) {
+        xQueueSendToBackFromISR(ctrl_enable_queue, &event, &xHigherPriorityTaskWoken);
+        portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+    }
+
+    return resample_us;
+}
+
 /**
  * @brief GPIO2 interrupt callback. This callback is executed upon rising and 
- *        falling edges on GPIO2. 
+ *        falling edges on GPIO2. Edges are only recorded here, the level is 
+ *        sampled by the debounce alarm once the switch stops bouncing. 
  * @param gpio GPIO number. 
  * @param events Events that caused the interrupt to occur. 
  * @retval None. 
  */
-void gpio2_cb(uint gpio, uint32_t events) {
-    // This will be set to pdTRUE if giving the semaphore causes a task to
-    // unblock which has a priority than the task which is currently running. 
-    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+void HOT_PATH_FUNC(gpio2_cb)(uint gpio, uint32_t events) {
+    if (gpio != GPIO2) {
+        return;
+    }
 
-    // If ctrl_enable_sem isn't NULL, give the semaphore to notify of an edge
-    // change on GPIO2. 
-    if (ctrl_enable_sem != NULL) {
-        xSemaphoreGiveFromISR(ctrl_enable_sem, &xHigherPriorityTaskWoken);   
+    // Record the edge, and find out whether a debounce alarm needs to be 
+    // scheduled (only the first edge of a bounce burst schedules one). 
+    UBaseType_t saved_irq_status = taskENTER_CRITICAL_FROM_ISR();
+    bool schedule = debounce_edge(&ctrl_enable_debouncer, time_us_64());
+    taskEXIT_CRITICAL_FROM_ISR(saved_irq_status);
+
+    // If no alarm could be scheduled, forget the poll so the next edge tries
+    // again (otherwise the switch would be ignored until reset). 
+    if (schedule && (add_alarm_in_us(CTRL_ENABLE_SETTLE_US, &ctrl_enable_alarm_cb, 
+            NULL, true) < 0)) {
+        saved_irq_status = taskENTER_CRITICAL_FROM_ISR();
+        debounce_cancel(&ctrl_enable_debouncer);
+        taskEXIT_CRITICAL_FROM_ISR(saved_irq_status);
     }
 }
 
@@ -128,10 +183,36 @@ void level_ctrl_enable_pin_init(void) {
     gpio_set_dir(GPIO2, GPIO_IN);
     gpio_pull_down(GPIO2);
 
+    // Control starts disabled, so initialise the debouncer with the switch
+    // off. 
+    debounce_init(&ctrl_enable_debouncer, false, CTRL_ENABLE_SETTLE_US, 
+            CTRL_ENABLE_MIN_EVENT_INTERVAL_US);
+
     // Set up interrupt with callback to trigger on rising and falling
     // edge on control enable pin. 
     gpio_set_irq_enabled_with_callback(GPIO2, (GPIO_IRQ_EDGE_FALL 
             | GPIO_IRQ_EDGE_RISE), true, &gpio2_cb);
+
+    // Treat initialisation as an edge, so that a switch which is already on
+    // at power-up enables control once its level has been sampled. 
+    gpio2_cb(GPIO2, 0);
+}
+
+/**
+ * @brief Safe state function. This function closes every valve, whatever 
+ *        state the level control tasks are in (e.g. ahead of a reset after a
+ *        deadline miss). It only writes the valve pins, so it may be called 
+ *        from either core. 
+ * @param None. 
+ * @retval None. 
+ */
+void ctrl_safe_state(void) {
+    gpio_put(GPIO14, false);
+    gpio_put(GPIO15, false);
+    gpio_put(GPIO16, false);
+    gpio_put(GPIO17, false);
+    led_set_status((LED_STATUS_T1_FILLING | LED_STATUS_T1_DRAINING 
+            | LED_STATUS_T2_FILLING | LED_STATUS_T2_DRAINING), false);
 }
 
 /**
@@ -147,6 +228,15 @@ void init_t1_semaphores(void) {
     stop_fill_t1_sem = xSemaphoreCreateBinary();
     drain_t1_sem = xSemaphoreCreateBinary();
     stop_drain_t1_sem = xSemaphoreCreateBinary();
+
+    // Create queue set holding all of the above semaphores, so the tank 1 
+    // level control task can block until any one of them is given. 
+    t1_ctrl_queue_set = xQueueCreateSet(CTRL_QUEUE_SET_LENGTH);
+    xQueueAddToSet(delete_t1_ctrl_sem, t1_ctrl_queue_set);
+    xQueueAddToSet(fill_t1_sem, t1_ctrl_queue_set);
+    xQueueAddToSet(stop_fill_t1_sem, t1_ctrl_queue_set);
+    xQueueAddToSet(drain_t1_sem, t1_ctrl_queue_set);
+    xQueueAddToSet(stop_drain_t1_sem, t1_ctrl_queue_set);
 }
 
 /**
@@ -159,7 +249,7 @@ void init_t1_semaphores(void) {
  *        tank 1 level control task is occurring. 
  * @retval None. 
  */
-void handle_t1_ctrl_pins(bool filling, bool draining, bool deinit) {
+void HOT_PATH_FUNC(handle_t1_ctrl_pins)(bool filling, bool draining, bool deinit) {
 
     /* If deinitialisation isn't occurring, set GPIO pins which control the
     valves to the appropriate states as requested. 
@@ -169,11 +259,16 @@ void handle_t1_ctrl_pins(bool filling, bool draining, bool deinit) {
     if (!deinit) {
         gpio_put(GPIO14, filling);
         gpio_put(GPIO15, draining);
+
+        // Display valve states on the LED. 
+        led_set_status(LED_STATUS_T1_FILLING, filling);
+        led_set_status(LED_STATUS_T1_DRAINING, draining);
     } else {
         // If deinitialisation is occurring, close both of the tank 1 level 
         // control valves. 
         gpio_put(GPIO14, false);
         gpio_put(GPIO15, false);
+        led_set_status((LED_STATUS_T1_FILLING | LED_STATUS_T1_DRAINING), false);
     }
 }
 
@@ -185,12 +280,26 @@ void handle_t1_ctrl_pins(bool filling, bool draining, bool deinit) {
  * @retval None. 
  */
 void deinit_t1_level_ctrl_task(void) {
-    // Delete semaphores
-    vSemaphoreDelete(delete_t1_ctrl_sem);
-    vSemaphoreDelete(fill_t1_sem);
-    vSemaphoreDelete(stop_fill_t1_sem);
-    vSemaphoreDelete(drain_t1_sem);
-    vSemaphoreDelete(stop_drain_t1_sem);
+    SemaphoreHandle_t sems[] = {delete_t1_ctrl_sem, fill_t1_sem, stop_fill_t1_sem, 
+            drain_t1_sem, stop_drain_t1_sem};
+
+    // Clear handles so that no other task gives a deleted semaphore
+    delete_t1_ctrl_sem = NULL;
+    fill_t1_sem = NULL;
+    stop_fill_t1_sem = NULL;
+    drain_t1_sem = NULL;
+    stop_drain_t1_sem = NULL;
+
+    // Empty semaphores (as only empty semaphores can be removed from a 
+    // queue set), remove them from the queue set and delete them. 
+    for (uint8_t i = 0; i < count_of(sems); i++) {
+        xSemaphoreTake(sems[i], 0);
+        xQueueRemoveFromSet(sems[i], t1_ctrl_queue_set);
+        vSemaphoreDelete(sems[i]);
+    }
+
+    vQueueDelete(t1_ctrl_queue_set);
+    t1_ctrl_queue_set = NULL;
 
     // Close valves because tank 1 control task is being deinitialised/
     // deleted. 
@@ -203,66 +312,49 @@ void deinit_t1_level_ctrl_task(void) {
  * @param param Value passed upon task creation. 
  * @retval None. 
  */
-void t1_level_ctrl_task(void *param) {
+void HOT_PATH_FUNC(t1_level_ctrl_task)(void *param) {
     // Initialise valve controlling pins and semaphores used by this task
     t1_valve_pins_init();
     init_t1_semaphores();
+    supervisor_start(SUPERVISOR_T1_LEVEL_CTRL);
 
     // Local variables denoting tank fill and drain state
     bool filling = false, draining = false;
 
     while (1) {
-        if (filling) {
-            // If tank is filling and semaphore is given which notifies tank 
-            // no longer needs to fill, close the fill valve. 
-            if (stop_fill_t1_sem != NULL) {
-                if (xSemaphoreTake(stop_fill_t1_sem, 20) == pdTRUE) {
-                    filling = false;
-                    handle_t1_ctrl_pins(filling, draining, false);
-                }
-            }
-        } else {
-            // If tank isn't filling and semaphore is given which notifies tank
-            // needs to be filled, open the fill valve. 
-            if (fill_t1_sem != NULL) {
-                if (xSemaphoreTake(fill_t1_sem, 20) == pdTRUE) {
-                    filling = true;
-                    handle_t1_ctrl_pins(filling, draining, false);
-                }
-            }
-        }
-
-        if (draining) {
-            // If tank is draining and semaphore is given which notifies tank
-            // no longer needs drain, close the drain valve. 
-            if (stop_drain_t1_sem != NULL) {
-                if (xSemaphoreTake(stop_drain_t1_sem, 20) == pdTRUE) {
-                    draining = false;
-                    handle_t1_ctrl_pins(filling, draining, false);
-                }
-            }
-        } else {
-            if (drain_t1_sem != NULL) {
-            // If tank isn't draining and semaphore is given which notifies 
-            // tank needs to be drained, open the drain valve. 
-                if (xSemaphoreTake(drain_t1_sem, 20) == pdTRUE) {
-                    draining = true;
-                    handle_t1_ctrl_pins(filling, draining, false);
-                }
-            }
+        // Block until one of the semaphores used by this task is given, and
+        // take it (this won't block, as the semaphore has been given). The 
+        // supervisor treats the task as idle while nothing is given. 
+        supervisor_wait(SUPERVISOR_T1_LEVEL_CTRL, t1_ctrl_queue_set);
+        QueueSetMemberHandle_t given = xQueueSelectFromSet(t1_ctrl_queue_set, 
+                portMAX_DELAY);
+        supervisor_checkin(SUPERVISOR_T1_LEVEL_CTRL);
+        if ((given == NULL) || (xSemaphoreTake(given, 0) != pdTRUE)) {
+            continue;
         }
 
-        // If semaphore is given notifying that task must be deleted (occurs
-        // when control functionality is disabled), delete this task. 
-        if (delete_t1_ctrl_sem != NULL) {
-            if (xSemaphoreTake(delete_t1_ctrl_sem, 20) == pdTRUE) {
-                // Delete semaphores and close valves. 
-                deinit_t1_level_ctrl_task();
-                vTaskDelete(NULL);
-            }            
+        if (given == fill_t1_sem) {
+            // Tank needs to be filled, so open the fill valve. 
+            filling = true;
+        } else if (given == stop_fill_t1_sem) {
+            // Tank no longer needs to fill, so close the fill valve. 
+            filling = false;
+        } else if (given == drain_t1_sem) {
+            // Tank needs to be drained, so open the drain valve. 
+            draining = true;
+        } else if (given == stop_drain_t1_sem) {
+            // Tank no longer needs to drain, so close the drain valve. 
+            draining = false;
+        } else if (given == delete_t1_ctrl_sem) {
+            // Task must be deleted (occurs when control functionality is 
+            // disabled), so delete semaphores, close valves and delete this
+            // task. 
+            supervisor_stop(SUPERVISOR_T1_LEVEL_CTRL);
+            deinit_t1_level_ctrl_task();
+            vTaskDelete(NULL);
         }
 
-        vTaskDelay(20);
+        handle_t1_ctrl_pins(filling, draining, false);
     }
 }
 
@@ -279,6 +371,15 @@ void init_t2_semaphores(void) {
     stop_fill_t2_sem = xSemaphoreCreateBinary();
     drain_t2_sem = xSemaphoreCreateBinary();
     stop_drain_t2_sem = xSemaphoreCreateBinary();
+
+    // Create queue set holding all of the above semaphores, so the tank 2 
+    // level control task can block until any one of them is given. 
+    t2_ctrl_queue_set = xQueueCreateSet(CTRL_QUEUE_SET_LENGTH);
+    xQueueAddToSet(delete_t2_ctrl_sem, t2_ctrl_queue_set);
+    xQueueAddToSet(fill_t2_sem, t2_ctrl_queue_set);
+    xQueueAddToSet(stop_fill_t2_sem, t2_ctrl_queue_set);
+    xQueueAddToSet(drain_t2_sem, t2_ctrl_queue_set);
+    xQueueAddToSet(stop_drain_t2_sem, t2_ctrl_queue_set);
 }
 
 /**
@@ -291,7 +392,7 @@ void init_t2_semaphores(void) {
  *        tank 2 level control task is occurring. 
  * @retval None.
  */
-void handle_t2_ctrl_pins(bool filling, bool draining, bool deinit) {
+void HOT_PATH_FUNC(handle_t2_ctrl_pins)(bool filling, bool draining, bool deinit) {
 
     /* If deinitialisation isn't occurring, set GPIO pins which control the
     valves to the appropriate states as requested. 
@@ -301,11 +402,16 @@ void handle_t2_ctrl_pins(bool filling, bool draining, bool deinit) {
     if (!deinit) {
         gpio_put(GPIO16, filling);
         gpio_put(GPIO17, draining);
+
+        // Display valve states on the LED. 
+        led_set_status(LED_STATUS_T2_FILLING, filling);
+        led_set_status(LED_STATUS_T2_DRAINING, draining);
     } else {
         // If deinitialisation is occurring, close both of the tank 2 level 
         // control valves. 
         gpio_put(GPIO16, false);
         gpio_put(GPIO17, false);
+        led_set_status((LED_STATUS_T2_FILLING | LED_STATUS_T2_DRAINING), false);
     }
 }
 
@@ -317,12 +423,26 @@ void handle_t2_ctrl_pins(bool filling, bool draining, bool deinit) {
  * @retval None. 
  */
 void deinit_t2_level_ctrl_task(void) {
-    // Delete semaphores
-    vSemaphoreDelete(delete_t2_ctrl_sem);
-    vSemaphoreDelete(fill_t2_sem);
-    vSemaphoreDelete(stop_fill_t2_sem);
-    vSemaphoreDelete(drain_t2_sem);
-    vSemaphoreDelete(stop_drain_t2_sem);
+    SemaphoreHandle_t sems[] = {delete_t2_ctrl_sem, fill_t2_sem, stop_fill_t2_sem, 
+            drain_t2_sem, stop_drain_t2_sem};
+
+    // Clear handles so that no other task gives a deleted semaphore
+    delete_t2_ctrl_sem = NULL;
+    fill_t2_sem = NULL;
+    stop_fill_t2_sem = NULL;
+    drain_t2_sem = NULL;
+    stop_drain_t2_sem = NULL;
+
+    // Empty semaphores (as only empty semaphores can be removed from a 
+    // queue set), remove them from the queue set and delete them. 
+    for (uint8_t i = 0; i < count_of(sems); i++) {
+        xSemaphoreTake(sems[i], 0);
+        xQueueRemoveFromSet(sems[i], t2_ctrl_queue_set);
+        vSemaphoreDelete(sems[i]);
+    }
+
+    vQueueDelete(t2_ctrl_queue_set);
+    t2_ctrl_queue_set = NULL;
 
     // Close valves because tank 1 control task is being deinitialised/
     // deleted. 
@@ -335,67 +455,50 @@ void deinit_t2_level_ctrl_task(void) {
  * @param param Value passed upon task creation. 
  * @retval None. 
  */
-void t2_level_ctrl_task(void *param) {
+void HOT_PATH_FUNC(t2_level_ctrl_task)(void *param) {
     
     // Initialise valve controlling pins and semaphores used by this task
     t2_valve_pins_init();
     init_t2_semaphores();
+    supervisor_start(SUPERVISOR_T2_LEVEL_CTRL);
 
     // Local variables denoting tank fill and drain state
     bool filling = false, draining = false;
 
     while (1) {
-        if (filling) {
-            // If tank is filling and semaphore is given which notifies tank 
-            // no longer needs to fill, close the fill valve. 
-            if (stop_fill_t2_sem != NULL) {
-                if (xSemaphoreTake(stop_fill_t2_sem, 20) == pdTRUE) {
-                    filling = false;
-                    handle_t2_ctrl_pins(filling, draining, false);
-                }
-            }
-        } else {
-            // If tank isn't filling and semaphore is given which notifies tank
-            // needs to be filled, open the fill valve. 
-            if (fill_t2_sem != NULL) {
-                if (xSemaphoreTake(fill_t2_sem, 20) == pdTRUE) {
-                    filling = true;
-                    handle_t2_ctrl_pins(filling, draining, false);
-                }
-            }
+        // Block until one of the semaphores used by this task is given, and
+        // take it (this won't block, as the semaphore has been given). The 
+        // supervisor treats the task as idle while nothing is given. 
+        supervisor_wait(SUPERVISOR_T2_LEVEL_CTRL, t2_ctrl_queue_set);
+        QueueSetMemberHandle_t given = xQueueSelectFromSet(t2_ctrl_queue_set, 
+                portMAX_DELAY);
+        supervisor_checkin(SUPERVISOR_T2_LEVEL_CTRL);
+        if ((given == NULL) || (xSemaphoreTake(given, 0) != pdTRUE)) {
+            continue;
         }
 
-        if (draining) {
-            // If tank is draining and semaphore is given which notifies tank
-            // no longer needs drain, close the drain valve. 
-            if (stop_drain_t2_sem != NULL) {
-                if (xSemaphoreTake(stop_drain_t2_sem, 20) == pdTRUE) {
-                    draining = false;
-                    handle_t2_ctrl_pins(filling, draining, false);
-                }
-            }
-        } else {
-            // If tank isn't draining and semaphore is given which notifies 
-            // tank needs to be drained, open the drain valve. 
-            if (drain_t2_sem != NULL) {
-                if (xSemaphoreTake(drain_t2_sem, 20) == pdTRUE) {
-                    draining = true;
-                    handle_t2_ctrl_pins(filling, draining, false);
-                }
-            }
+        if (given == fill_t2_sem) {
+            // Tank needs to be filled, so open the fill valve. 
+            filling = true;
+        } else if (given == stop_fill_t2_sem) {
+            // Tank no longer needs to fill, so close the fill valve. 
+            filling = false;
+        } else if (given == drain_t2_sem) {
+            // Tank needs to be drained, so open the drain valve. 
+            draining = true;
+        } else if (given == stop_drain_t2_sem) {
+            // Tank no longer needs to drain, so close the drain valve. 
+            draining = false;
+        } else if (given == delete_t2_ctrl_sem) {
+            // Task must be deleted (occurs when control functionality is 
+            // disabled), so delete semaphores, close valves and delete this
+            // task. 
+            supervisor_stop(SUPERVISOR_T2_LEVEL_CTRL);
+            deinit_t2_level_ctrl_task();
+            vTaskDelete(NULL);
         }
 
-        // If semaphore is given notifying that task must be deleted (occurs
-        // when control functionality is disabled), delete this task. 
-        if (delete_t2_ctrl_sem != NULL) {
-            if (xSemaphoreTake(delete_t2_ctrl_sem, 20) == pdTRUE) {
-                // Delete semaphores and close valves. 
-                deinit_t2_level_ctrl_task();
-                vTaskDelete(NULL);
-            }            
-        }
-
-        vTaskDelay(20);
+        handle_t2_ctrl_pins(filling, draining, false);
     }
 }
 
@@ -409,25 +512,33 @@ void t2_level_ctrl_task(void *param) {
  */
 void level_ctrl_enable_task(void *param) {
 
-    // Initialise level control enable pin and interrupt callback
-    level_ctrl_enable_pin_init();
-
-    // Create semaphores used by this task
-    ctrl_enable_sem = xSemaphoreCreateBinary();
+    // Create queue and semaphores used by this task
+    ctrl_enable_queue = xQueueCreate(CTRL_ENABLE_QUEUE_LENGTH, 
+            sizeof(struct debounce_event));
     ctrl_on_sem_1 = xSemaphoreCreateBinary();
     ctrl_on_sem_2 = xSemaphoreCreateBinary();
     ctrl_off_sem_1 = xSemaphoreCreateBinary();
     ctrl_off_sem_2 = xSemaphoreCreateBinary();
 
+    // Initialise level control enable pin and interrupt callback (after the
+    // queue exists, so the initial switch state isn't dropped). 
+    level_ctrl_enable_pin_init();
+    supervisor_start(SUPERVISOR_LEVEL_CTRL_ENABLE);
+
     while (1) {
-        if (ctrl_enable_sem != NULL) {
-            // The following code will execute when rising or falling edge
-            // is detected on GPIO2, after semaphore is given by interrupt
-            // callback. 
-            if (xSemaphoreTake(ctrl_enable_sem, portMAX_DELAY) == pdTRUE) {
-                // If GPIO2 is low after an edge change, control functionality
-                // is disabled. 
-                if (!gpio_get(GPIO2)) {
+        if (ctrl_enable_queue != NULL) {
+            // The following code will execute when the switch connected to 
+            // GPIO2 has settled at a new level, after the event is posted by
+            // the debounce alarm callback. 
+            struct debounce_event event;
+            supervisor_wait(SUPERVISOR_LEVEL_CTRL_ENABLE, ctrl_enable_queue);
+            BaseType_t received = xQueueReceive(ctrl_enable_queue, &event, 
+                    portMAX_DELAY);
+            supervisor_checkin(SUPERVISOR_LEVEL_CTRL_ENABLE);
+            if (received == pdTRUE) {
+                // If GPIO2 has settled low, control functionality is 
+                // disabled. 
+                if (!event.level) {
                     // Give semaphore to delete tank 1 control task
                     if (delete_t1_ctrl_sem != NULL) {
                         xSemaphoreGive(delete_t1_ctrl_sem);
@@ -443,23 +554,28 @@ void level_ctrl_enable_task(void *param) {
                     xSemaphoreGive(ctrl_off_sem_1);
                     xSemaphoreGive(ctrl_off_sem_2);
 
-                } else {
-                    // If GPIO2 isn't low after an edge change, control 
-                    // functionality is enabled.
+                    led_set_status(LED_STATUS_CTRL_ENABLED, false);
 
-                    // Initialise tank level control tasks
-                    t1_level_ctrl_task_init();
-                    t2_level_ctrl_task_init();
+                } else {
+                    // If GPIO2 has settled high, control functionality is 
+                    // enabled.
+
+                    // Initialise tank level control tasks, and flag a fault
+                    // if either couldn't be created. 
+                    if ((t1_level_ctrl_task_init() != pdPASS) 
+                            || (t2_level_ctrl_task_init() != pdPASS)) {
+                        led_set_status(LED_STATUS_FAULT, true);
+                    }
 
                     // Give semaphores to notify level measurement tasks
                     // that level control is enabled. 
                     xSemaphoreGive(ctrl_on_sem_1);
                     xSemaphoreGive(ctrl_on_sem_2);
+
+                    led_set_status(LED_STATUS_CTRL_ENABLED, true);
                 }
             }
         }
-
-        vTaskDelay(1000);
     }
 }
 
@@ -472,8 +588,10 @@ void level_ctrl_enable_task(void *param) {
  *         created. 
  */
 BaseType_t t1_level_ctrl_task_init(void) {
-    return (xTaskCreate((void *)&t1_level_ctrl_task, 
-        (const signed char *)"Tank_1_Level_Control_Task", 256, NULL, 1, NULL));
+    return (xTaskCreateAffinitySet((void *)&t1_level_ctrl_task, 
+        (const signed char *)"Tank_1_Level_Control_Task", 
+        T1_LEVEL_CTRL_TASK_STACK_DEPTH, NULL, T1_LEVEL_CTRL_TASK_PRIORITY, 
+        T1_LEVEL_CTRL_TASK_AFFINITY, NULL));
 }
 
 /**
@@ -485,8 +603,10 @@ BaseType_t t1_level_ctrl_task_init(void) {
  *         created. 
  */
 BaseType_t t2_level_ctrl_task_init(void) {
-    return (xTaskCreate((void *)&t2_level_ctrl_task, 
-        (const signed char *)"Tank_2_Level_Control_Task", 256, NULL, 1, NULL));
+    return (xTaskCreateAffinitySet((void *)&t2_level_ctrl_task, 
+        (const signed char *)"Tank_2_Level_Control_Task", 
+        T2_LEVEL_CTRL_TASK_STACK_DEPTH, NULL, T2_LEVEL_CTRL_TASK_PRIORITY, 
+        T2_LEVEL_CTRL_TASK_AFFINITY, NULL));
 }
 
 /**
@@ -496,6 +616,8 @@ BaseType_t t2_level_ctrl_task_init(void) {
  * @retval None. 
  */
 void level_ctrl_enable_task_init(void) {
-    xTaskCreate((void *)&level_ctrl_enable_task, 
-        (const signed char *)"Level_Control_Enable_Task", 256, NULL, 1, NULL);
+    xTaskCreateAffinitySet((void *)&level_ctrl_enable_task, 
+        (const signed char *)"Level_Control_Enable_Task", 
+        LEVEL_CTRL_ENABLE_TASK_STACK_DEPTH, NULL, LEVEL_CTRL_ENABLE_TASK_PRIORITY, 
+        LEVEL_CTRL_ENABLE_TASK_AFFINITY, NULL);
 }
\ No newline at end of file
@@ -13,9 +13,14 @@
 #include <stdio.h>
 #include "FreeRTOS.h"
 #include "task.h"
+#include "queue.h"
 #include "semphr.h"
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
+#include "debounce.h"
+#include "led.h"
+#include "sys.h"
+#include "supervisor.h"
 
 // GPIO pin number declarations
 #define GPIO2 2
@@ -24,6 +29,25 @@
 #define GPIO16 16
 #define GPIO17 17
 
+// Time the control enable switch must be free of edges before its level is
+// considered stable (in usec). 
+#define CTRL_ENABLE_SETTLE_US 20000
+
+// Minimum time between control enable/disable events (in usec). Switch
+// changes within this time of the previous event are deferred, not lost. 
+#define CTRL_ENABLE_MIN_EVENT_INTERVAL_US 500000
+
+// Length of the queue sets used by the tank level control tasks (one entry 
+// per binary semaphore in the set). 
+#define CTRL_QUEUE_SET_LENGTH 5
+
+// Length of the queue carrying control enable/disable events. 
+#define CTRL_ENABLE_QUEUE_LENGTH 4
+
+// Queue carrying debounced control enable switch events (struct 
+// debounce_event) from the debounce alarm to the level control enable task. 
+extern QueueHandle_t ctrl_enable_queue;
+
 // Semaphores which are given when a level controlling task must be notified
 // that their respective water tank requires filling. 
 extern SemaphoreHandle_t fill_t1_sem;
@@ -58,9 +82,11 @@ extern SemaphoreHandle_t ctrl_off_sem_2;
 
 // Function prototypes
 void gpio2_cb(uint gpio, uint32_t events);
+int64_t ctrl_enable_alarm_cb(alarm_id_t id, void *user_data);
 void t1_valve_pins_init(void);
 void t2_valve_pins_init(void);
 void level_ctrl_enable_pin_init(void);
+void ctrl_safe_state(void);
 void init_t1_semaphores(void);
 void handle_t1_ctrl_pins(bool filling, bool draining, bool deinit);
 void deinit_t1_level_ctrl_task(void);
@@ -0,0 +1,123 @@
+ /**
+ **************************************************************
+ * @file debounce.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Switch debouncer file. This file handles functionality specific to
+ *        turning a bouncing digital input into single, rate-limited stable
+ *        level change events. It has no hardware or RTOS dependencies, so
+ *        edges and level samples are fed in (with timestamps) by the caller,
+ *        which is expected to call debounce_poll() from a hardware timer
+ *        alarm once the settle time has elapsed.
+ ***************************************************************
+ */
+
+#include "debounce.h"
+
+/**
+ * @brief Debouncer initialiser function. This function resets the debouncer
+ *        state so that the given level is treated as the current stable level.
+ * @param db Pointer to the debouncer being initialised.
+ * @param level Initial stable level of the input.
+ * @param settle_us Time the input must be free of edges before its level is
+ *        considered stable, in usec.
+ * @param min_interval_us Minimum time between two emitted events, in usec.
+ * @retval None.
+ */
+void debounce_init(struct debouncer *db, bool level, uint32_t settle_us,
+        uint32_t min_interval_us) {
+    db->stable_level = level;
+    db->event_emitted = false;
+    db->sample_pending = false;
+    db->last_edge_us = 0;
+    db->last_event_us = 0;
+    db->settle_us = settle_us;
+    db->min_interval_us = min_interval_us;
+}
+
+/**
+ * @brief Debouncer edge handler. This function records an edge on the input
+ *        (called from the GPIO interrupt callback).
+ * @param db Pointer to the debouncer.
+ * @param now_us Timestamp of the edge, in usec.
+ * @retval true if the caller must schedule a call to debounce_poll() in
+ *         settle_us usec, false if a poll is already scheduled.
+ */
+bool debounce_edge(struct debouncer *db, uint64_t now_us) {
+    db->last_edge_us = now_us;
+
+    // Only the first edge of a burst schedules a poll, later edges simply
+    // push the settle deadline back (the poll reschedules itself).
+    if (db->sample_pending) {
+        return false;
+    }
+
+    db->sample_pending = true;
+    return true;
+}
+
+/**
+ * @brief Debouncer cancel function. This function forgets the scheduled poll
+ *        (e.g. when the caller couldn't schedule one), so the next edge
+ *        schedules a poll again.
+ * @param db Pointer to the debouncer.
+ * @retval None.
+ */
+void debounce_cancel(struct debouncer *db) {
+    db->sample_pending = false;
+}
+
+/**
+ * @brief Debouncer poll function. This function checks whether the input has
+ *        settled, and emits an event if the settled level differs from the
+ *        last reported level and the rate limit allows it.
+ * @param db Pointer to the debouncer.
+ * @param level Current level of the input.
+ * @param now_us Current timestamp, in usec.
+ * @param event Pointer to event populated when an event is emitted.
+ * @param emitted Pointer to flag set to true when an event is emitted, and
+ *        false otherwise.
+ * @retval Time until debounce_poll() must be called again in usec, or 0 if
+ *         no further poll is required until the next edge.
+ */
+uint32_t debounce_poll(struct debouncer *db, bool level, uint64_t now_us,
+        struct debounce_event *event, bool *emitted) {
+    (*emitted) = false;
+
+    // If an edge has occurred within the settle time, the input is still
+    // bouncing, so check again once it has been quiet for long enough.
+    uint64_t quiet_us = now_us - db->last_edge_us;
+    if (quiet_us < db->settle_us) {
+        return (uint32_t)(db->settle_us - quiet_us);
+    }
+
+    // If the input has settled back to the level last reported, the bounce
+    // burst didn't change anything.
+    if (level == db->stable_level) {
+        db->sample_pending = false;
+        return 0;
+    }
+
+    // If the previous event was emitted too recently, hold this one back
+    // until the rate limit allows it (the level is sampled again then, so
+    // the final state is never lost).
+    if (db->event_emitted) {
+        uint64_t since_event_us = now_us - db->last_event_us;
+        if (since_event_us < db->min_interval_us) {
+            return (uint32_t)(db->min_interval_us - since_event_us);
+        }
+    }
+
+    // Emit the stable level change, timestamped with the edge from which
+    // the input has been stable.
+    db->stable_level = level;
+    db->event_emitted = true;
+    db->last_event_us = now_us;
+    db->sample_pending = false;
+
+    event->level = level;
+    event->timestamp_us = db->last_edge_us;
+    (*emitted) = true;
+
+    return 0;
+}
@@ -0,0 +1,42 @@
+ /**
+ **************************************************************
+ * @file debounce.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the switch debouncer.
+ ***************************************************************
+ */
+
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Struct holding the state of a single debounced input. All timestamps are
+// in usec.
+struct debouncer {
+    bool stable_level;          // Most recently reported stable level
+    bool event_emitted;         // Whether an event has been emitted yet
+    bool sample_pending;        // Whether a settle check is scheduled
+    uint64_t last_edge_us;      // Timestamp of the most recent edge
+    uint64_t last_event_us;     // Timestamp of the most recent event
+    uint32_t settle_us;         // Quiet time required before level is stable
+    uint32_t min_interval_us;   // Minimum time between emitted events
+};
+
+// Struct describing a single stable level change of a debounced input.
+struct debounce_event {
+    bool level;
+    uint64_t timestamp_us;
+};
+
+// Function prototypes
+void debounce_init(struct debouncer *db, bool level, uint32_t settle_us,
+        uint32_t min_interval_us);
+bool debounce_edge(struct debouncer *db, uint64_t now_us);
+void debounce_cancel(struct debouncer *db);
+uint32_t debounce_poll(struct debouncer *db, bool level, uint64_t now_us,
+        struct debounce_event *event, bool *emitted);
+
+#endif
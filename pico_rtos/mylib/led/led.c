@@ -4,40 +4,82 @@
  * @author HBN - 45300747
  * @date 30062022
  * @brief LED driver file. This file handles functionality specific to 
- *        toggling the Raspberry Pi Pico onboard LED. 
+ *        flashing the Raspberry Pi Pico onboard LED in a pattern which 
+ *        denotes the current system status (see led_pattern.c). The LED is
+ *        driven from a software timer (rather than its own task), so it 
+ *        costs no task stack. 
  *************************************************************** 
  */
 
 #include "led.h"
 
+// Current system status flags (LED_STATUS_*), set by other drivers. 
+static volatile uint32_t led_status = 0;
+
+// Software timer which steps through the current LED pattern. 
+static TimerHandle_t led_timer;
+
 /**
- * @brief LED task. This task handles toggling the Raspberry Pi Pico onboard 
- *        green LED. 
- * @param param Value passed upon task creation. 
+ * @brief LED timer callback. This callback is executed by the timer service
+ *        task at each edge of the LED pattern for the current system status.
+ *        It sets the Raspberry Pi Pico onboard green LED as per the pattern,
+ *        and sets the timer to expire at the pattern's next edge, so the 
+ *        timer doesn't wake the system at steps where the LED is unchanged.
+ *        A new status is displayed from the next edge. 
+ * @param timer Handle of the timer which expired. 
  * @retval None. 
  */
-void led_task(void *param) {
-    // Initialise the LED pin
-    const uint LED_PIN = PICO_DEFAULT_LED_PIN;
-    gpio_init(LED_PIN);
-    gpio_set_dir(LED_PIN, GPIO_OUT);
-
-    while (1) {
-        // Toggle the onboard LED every 100 ticks
-        gpio_put(LED_PIN, 1);
-        vTaskDelay(100);
-        gpio_put(LED_PIN, 0);
-        vTaskDelay(100);
+void led_timer_cb(TimerHandle_t timer) {
+    // Current step within the LED pattern
+    static uint8_t step = 0;
+
+    // Set the LED as per the current step of the pattern for the current 
+    // system status
+    uint16_t pattern = led_pattern_select(led_status);
+    gpio_put(PICO_DEFAULT_LED_PIN, (pattern >> step) & 1);
+
+    // Hold the LED until the pattern's next edge
+    uint8_t hold_steps = led_pattern_hold_steps(pattern, step);
+    step = (step + hold_steps) % LED_PATTERN_STEPS;
+    xTimerChangePeriod(timer, pdMS_TO_TICKS(hold_steps * LED_STEP_PERIOD_MSEC), 0);
+}
+
+/**
+ * @brief LED status setter function. This function sets or clears system 
+ *        status flags displayed by the LED. 
+ * @param status Status flags (LED_STATUS_*) being set or cleared. 
+ * @param set true to set the given flags, false to clear them. 
+ * @retval None. 
+ */
+void led_set_status(uint32_t status, bool set) {
+    // Status may be updated from tasks on either core. 
+    taskENTER_CRITICAL();
+    if (set) {
+        led_status |= status;
+    } else {
+        led_status &= ~status;
     }
+    taskEXIT_CRITICAL();
 }
 
 /**
- * @brief LED controlling task creation helper function. This function 
- *        creates the LED controlling task. 
+ * @brief LED initialisation function. This function initialises the LED pin 
+ *        and creates and starts the software timer which drives the LED. 
  * @param None. 
  * @retval None. 
  */
-void led_task_init(void) {
-    xTaskCreate((void *)&led_task, 
-        (const signed char *)"LED_Task", 256, NULL, 1, NULL);
-}
\ No newline at end of file
+void led_timer_init(void) {
+    // Initialise the LED pin
+    gpio_init(PICO_DEFAULT_LED_PIN);
+    gpio_set_dir(PICO_DEFAULT_LED_PIN, GPIO_OUT);
+
+    // Create timer which steps through the LED pattern (its period is set to
+    // the time to the next edge on each expiry). The start command is queued
+    // until the scheduler (and timer service) starts. 
+    led_timer = xTimerCreate("LED_Timer", pdMS_TO_TICKS(LED_STEP_PERIOD_MSEC), 
+            pdTRUE, NULL, &led_timer_cb);
+
+    if (led_timer != NULL) {
+        xTimerStart(led_timer, 0);
+    }
+}
@@ -15,11 +15,14 @@
 #include "task.h"
 #include "queue.h"
 #include "semphr.h"
+#include "timers.h"
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
+#include "led_pattern.h"
 
 // Function prototypes
-void led_task(void *param);
-void led_task_init(void);
+void led_timer_cb(TimerHandle_t timer);
+void led_set_status(uint32_t status, bool set);
+void led_timer_init(void);
 
-#endif
\ No newline at end of file
+#endif
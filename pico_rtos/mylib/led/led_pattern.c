@@ -0,0 +1,54 @@
+ /**
+ **************************************************************
+ * @file led_pattern.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief LED pattern file. This file handles selecting the LED pattern for
+ *        the system status, and finding where the LED next changes within
+ *        a pattern, so the LED timer only runs at the pattern's edges. It
+ *        has no hardware or RTOS dependencies, so the host simulator shares
+ *        it with the LED driver (see led.c).
+ ***************************************************************
+ */
+
+#include "led_pattern.h"
+
+/**
+ * @brief LED pattern select function.
+ * @param status System status flags (LED_STATUS_*).
+ * @retval Pattern displayed for the status (LED_PATTERN_*).
+ */
+uint16_t led_pattern_select(uint32_t status) {
+    if (status & LED_STATUS_FAULT) {
+        return LED_PATTERN_FAULT;
+    } else if (status & (LED_STATUS_T1_DRAINING | LED_STATUS_T2_DRAINING)) {
+        return LED_PATTERN_DRAINING;
+    } else if (status & (LED_STATUS_T1_FILLING | LED_STATUS_T2_FILLING)) {
+        return LED_PATTERN_FILLING;
+    } else if (status & LED_STATUS_CTRL_ENABLED) {
+        return LED_PATTERN_CTRL_ENABLED;
+    }
+
+    return LED_PATTERN_IDLE;
+}
+
+/**
+ * @brief LED pattern hold function. This function counts the steps for
+ *        which the LED stays as set at a step of a pattern (wrapping to the
+ *        start of the pattern).
+ * @param pattern LED pattern (LED_PATTERN_*).
+ * @param step Step within the pattern.
+ * @retval Number of steps until the LED next changes (LED_PATTERN_STEPS if
+ *         it never changes).
+ */
+uint8_t led_pattern_hold_steps(uint16_t pattern, uint8_t step) {
+    uint8_t level = (pattern >> step) & 1;
+    uint8_t steps = 1;
+
+    while ((steps < LED_PATTERN_STEPS)
+            && (((pattern >> ((step + steps) % LED_PATTERN_STEPS)) & 1) == level)) {
+        steps++;
+    }
+
+    return steps;
+}
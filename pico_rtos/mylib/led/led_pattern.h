@@ -0,0 +1,42 @@
+ /**
+ **************************************************************
+ * @file led_pattern.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the LED patterns.
+ ***************************************************************
+ */
+
+#ifndef LED_PATTERN_H
+#define LED_PATTERN_H
+
+#include <stdint.h>
+
+// Period between LED pattern steps (in msec).
+#define LED_STEP_PERIOD_MSEC 100
+
+// Number of steps in an LED pattern (one bit of a pattern per step).
+#define LED_PATTERN_STEPS 16
+
+// System status flags displayed by the LED.
+#define LED_STATUS_CTRL_ENABLED (1 << 0)
+#define LED_STATUS_T1_FILLING (1 << 1)
+#define LED_STATUS_T2_FILLING (1 << 2)
+#define LED_STATUS_T1_DRAINING (1 << 3)
+#define LED_STATUS_T2_DRAINING (1 << 4)
+#define LED_STATUS_FAULT (1 << 5)
+
+// LED patterns for each system state, where bit n is the LED state for step
+// n. Where multiple states apply, the first matching pattern in the order
+// below is displayed.
+#define LED_PATTERN_FAULT 0x5555        // Fast flashing
+#define LED_PATTERN_DRAINING 0x0033     // Double flash
+#define LED_PATTERN_FILLING 0x00FF      // Slow flashing
+#define LED_PATTERN_CTRL_ENABLED 0x000F // Single long flash
+#define LED_PATTERN_IDLE 0x0001         // Single short flash (heartbeat)
+
+// Function prototypes
+uint16_t led_pattern_select(uint32_t status);
+uint8_t led_pattern_hold_steps(uint16_t pattern, uint8_t step);
+
+#endif
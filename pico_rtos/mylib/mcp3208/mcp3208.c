@@ -0,0 +1,158 @@
+ /**
+ **************************************************************
+ * @file mcp3208.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief MCP3208 external ADC driver file. This file handles scanning all
+ *        eight channels of an MCP3208 over SPI continuously, with no CPU
+ *        involvement per conversion. A DMA timer paces a control channel,
+ *        which starts a transmit channel sending the next channel's command
+ *        from the command table on every tick. A receive channel writes
+ *        each conversion into the scan ring. Sampling a frame decimates the
+ *        ring (see mcp3208_scan.c).
+ ***************************************************************
+ */
+
+#include "mcp3208.h"
+
+// Scan ring and command table, aligned for the DMA address rings.
+static uint32_t scan_ring[MCP3208_RING_WORDS] __attribute__((aligned(MCP3208_RING_BYTES)));
+static uint32_t scan_commands[MCP3208_NUM_CHANNELS]
+        __attribute__((aligned(MCP3208_COMMANDS_BYTES)));
+
+// Transfer count written to the transmit channel on every tick (one
+// conversion).
+static const uint32_t conversion_bytes = MCP3208_CONVERSION_BYTES;
+
+// DMA channels and pacing timer used by the scan.
+static int tx_channel;
+static int rx_channel;
+static int ctrl_channel;
+static int pacing_timer;
+
+/**
+ * @brief MCP3208 initialiser function. This function handles initialisation
+ *        of the SPI peripheral, and claims the DMA channels and timer used
+ *        by the scan.
+ * @param None.
+ * @retval None.
+ */
+static void mcp3208_init(void) {
+    // The MCP3208 takes SPI mode 1,1. With the clock phase set, chip select
+    // stays low between back-to-back bytes.
+    spi_init(MCP3208_SPI, MCP3208_SPI_BAUD);
+    spi_set_format(MCP3208_SPI, 8, SPI_CPOL_1, SPI_CPHA_1, SPI_MSB_FIRST);
+
+    tx_channel = dma_claim_unused_channel(true);
+    rx_channel = dma_claim_unused_channel(true);
+    ctrl_channel = dma_claim_unused_channel(true);
+    pacing_timer = dma_claim_unused_timer(true);
+
+    // Pace conversions at MCP3208_CONVERSION_RATE (the system clock is a
+    // whole multiple of it).
+    dma_timer_set_fraction(pacing_timer, 1, clock_get_hz(clk_sys) / MCP3208_CONVERSION_RATE);
+
+    mcp3208_scan_commands(scan_commands);
+}
+
+/**
+ * @brief Scan start function. This function (re)starts the scan from
+ *        channel 0, at the start of the scan ring.
+ * @param None.
+ * @retval None.
+ */
+static void mcp3208_start(void) {
+    // Discard anything left in the receive FIFO, so received bytes stay
+    // aligned with conversions.
+    while (spi_is_readable(MCP3208_SPI)) {
+        (void)spi_get_hw(MCP3208_SPI)->dr;
+    }
+
+    // Transmit channel: one conversion's command per trigger, read from the
+    // command table (wrapping back to channel 0 after channel 7).
+    dma_channel_config tx_config = dma_channel_get_default_config(tx_channel);
+    channel_config_set_transfer_data_size(&tx_config, DMA_SIZE_8);
+    channel_config_set_read_increment(&tx_config, true);
+    channel_config_set_write_increment(&tx_config, false);
+    channel_config_set_ring(&tx_config, false, MCP3208_COMMANDS_BITS);
+    channel_config_set_dreq(&tx_config, spi_get_dreq(MCP3208_SPI, true));
+    dma_channel_configure(tx_channel, &tx_config, &spi_get_hw(MCP3208_SPI)->dr,
+            scan_commands, MCP3208_CONVERSION_BYTES, false);
+
+    // Receive channel: every received byte, into the scan ring.
+    dma_channel_config rx_config = dma_channel_get_default_config(rx_channel);
+    channel_config_set_transfer_data_size(&rx_config, DMA_SIZE_8);
+    channel_config_set_read_increment(&rx_config, false);
+    channel_config_set_write_increment(&rx_config, true);
+    channel_config_set_ring(&rx_config, true, MCP3208_RING_BITS);
+    channel_config_set_dreq(&rx_config, spi_get_dreq(MCP3208_SPI, false));
+    dma_channel_configure(rx_channel, &rx_config, scan_ring, &spi_get_hw(MCP3208_SPI)->dr,
+            MCP3208_RUN_CONVERSIONS * MCP3208_CONVERSION_BYTES, true);
+
+    // Control channel: on every timer tick, retrigger the transmit channel
+    // for one conversion (its read address carries on through the table).
+    // Chip select is released between ticks, as the FIFO drains.
+    dma_channel_config ctrl_config = dma_channel_get_default_config(ctrl_channel);
+    channel_config_set_transfer_data_size(&ctrl_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&ctrl_config, false);
+    channel_config_set_write_increment(&ctrl_config, false);
+    channel_config_set_dreq(&ctrl_config, dma_get_timer_dreq(pacing_timer));
+    dma_channel_configure(ctrl_channel, &ctrl_config,
+            &dma_hw->ch[tx_channel].al1_transfer_count_trig, &conversion_bytes,
+            MCP3208_RUN_CONVERSIONS, true);
+}
+
+/**
+ * @brief MCP3208 pin initialiser function. This function handles
+ *        initialisation of the SPI pins, and starts the scan.
+ * @param None.
+ * @retval None.
+ */
+static void mcp3208_init_pins(void) {
+    gpio_set_function(MCP3208_SCK_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(MCP3208_MOSI_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(MCP3208_MISO_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(MCP3208_CS_PIN, GPIO_FUNC_SPI);
+
+    mcp3208_start();
+}
+
+/**
+ * @brief MCP3208 frame sampling function. This function decimates the latest
+ *        MCP3208_SCAN_ROWS conversions of each channel in the scan ring into
+ *        a frame, behind the receive channel's write address. The scan runs
+ *        for MCP3208_RUN_CONVERSIONS (around 12 hours), after which it is
+ *        restarted here.
+ * @param frame Pointer to frame being populated.
+ * @retval None.
+ */
+static void HOT_PATH_FUNC(mcp3208_sample_frame)(struct adc_frame *frame) {
+    frame->timestamp_us = time_us_64();
+
+    if (!dma_channel_is_busy(ctrl_channel)) {
+        // Let the last conversion finish before restarting
+        while (dma_channel_is_busy(rx_channel)) {
+            tight_loop_contents();
+        }
+
+        mcp3208_start();
+    }
+
+    // The write address (which wraps within the ring) locates the byte the
+    // scan writes next; the transfer count only counts down the whole run
+    uint32_t write_offset = dma_hw->ch[rx_channel].write_addr - (uint32_t)(uintptr_t)scan_ring;
+    mcp3208_scan_frame(scan_ring, write_offset, frame);
+}
+
+// MCP3208 sample source. All eight channels are scanned continuously by
+// DMA, so the CPU only decimates the ring when a frame is taken. The first
+// frame waits for the ring to fill.
+const struct sample_source mcp3208_sample_source = {
+    .name = "mcp3208",
+    .num_channels = MCP3208_NUM_CHANNELS,
+    .settle_ms = (MCP3208_RING_WORDS * 1000 + MCP3208_CONVERSION_RATE - 1)
+            / MCP3208_CONVERSION_RATE,
+    .init = mcp3208_init,
+    .init_pins = mcp3208_init_pins,
+    .sample_frame = mcp3208_sample_frame,
+};
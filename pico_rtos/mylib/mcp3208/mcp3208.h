@@ -0,0 +1,35 @@
+ /**
+ **************************************************************
+ * @file mcp3208.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the MCP3208 external ADC driver.
+ ***************************************************************
+ */
+
+#ifndef MCP3208_H
+#define MCP3208_H
+
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+#include "sample_source.h"
+#include "mcp3208_scan.h"
+
+// GPIO pin number declarations
+#define GPIO10 10
+#define GPIO11 11
+#define GPIO12 12
+#define GPIO13 13
+
+// SPI instance and pins the MCP3208 is on (SPI 1's SCK, TX, RX and CSn).
+// Chip select is driven by the SPI peripheral, which holds it low across
+// each conversion's back-to-back bytes and releases it once they are sent.
+#define MCP3208_SPI spi1
+#define MCP3208_SCK_PIN GPIO10
+#define MCP3208_MOSI_PIN GPIO11
+#define MCP3208_MISO_PIN GPIO12
+#define MCP3208_CS_PIN GPIO13
+
+#endif
@@ -0,0 +1,146 @@
+ /**
+ **************************************************************
+ * @file mcp3208_scan.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief MCP3208 channel scan file. This file handles functionality
+ *        specific to the continuous scan of an MCP3208's channels: the
+ *        command sent for each conversion, decoding conversions, and
+ *        decimating the scan ring into ADC frames. It has no hardware or
+ *        RTOS dependencies, so the host's simulated MCP3208 shares it with
+ *        the firmware's DMA driver (see mcp3208.c).
+ ***************************************************************
+ */
+
+#include "mcp3208_scan.h"
+#include "hot_path.h"
+
+_Static_assert(MCP3208_RING_BYTES == (1 << MCP3208_RING_BITS), "Scan ring isn't a power of two");
+_Static_assert(MCP3208_COMMANDS_BYTES == (1 << MCP3208_COMMANDS_BITS),
+        "Command table isn't a power of two");
+_Static_assert(ADC_FRAME_CHANNELS <= MCP3208_NUM_CHANNELS, "Frame has more channels than MCP3208");
+_Static_assert((MCP3208_RUN_CONVERSIONS % MCP3208_RING_WORDS) == 0, "Scan run isn't whole rings");
+_Static_assert((MCP3208_RING_ROWS & (MCP3208_RING_ROWS - 1)) == 0, "Scan ring rows aren't a power of two");
+_Static_assert(MCP3208_SCAN_GAP_ROWS > (MCP3208_SCAN_MARGIN_ROWS + 1), "Scan gap leaves no rows ahead");
+
+/**
+ * @brief Scan command function. This function writes the command word sent
+ *        for a single-ended conversion of each channel. Each word is sent
+ *        least significant byte first: a byte of leading zeros, then the
+ *        start and single-ended bits with D2, then D1 and D0, then a byte
+ *        clocking out the rest of the result.
+ * @param commands Buffer written to (MCP3208_NUM_CHANNELS words).
+ * @retval None.
+ */
+void mcp3208_scan_commands(uint32_t *commands) {
+    for (uint8_t channel = 0; channel < MCP3208_NUM_CHANNELS; channel++) {
+        uint32_t start = 0x06 | (channel >> 2);
+        uint32_t select = (channel & 0x3) << 6;
+        commands[channel] = (start << 8) | (select << 16);
+    }
+}
+
+/**
+ * @brief Conversion decode function. The result's four most significant
+ *        bits are the low bits of the third byte received (after the null
+ *        bit), and its eight least significant bits are the fourth byte.
+ * @param word Bytes received for a conversion (first byte least
+ *        significant).
+ * @retval 12-bit conversion result.
+ */
+uint16_t HOT_PATH_FUNC(mcp3208_decode)(uint32_t word) {
+    return (uint16_t)(((word >> 8) & 0x0F00) | (word >> 24));
+}
+
+/**
+ * @brief Scan decimate function. This function decimates the latest
+ *        MCP3208_SCAN_ROWS conversions of every channel into a single
+ *        reading with OVERSAMPLE_EXTRA_BITS extra bits of resolution (as for
+ *        the RP2040's ADC). The DMA writes the ring a byte at a time while
+ *        it is read, so the rows read end MCP3208_SCAN_MARGIN_ROWS behind
+ *        the row holding the DMA write address, which is never read (its
+ *        word there may be torn). The rows ahead of it in the gap are left
+ *        for the DMA to write while the ring is read, so the reading never
+ *        includes a conversion written after the write address was taken,
+ *        provided it is finished within mcp3208_scan_read_us().
+ * @param ring Scan ring (MCP3208_RING_WORDS words).
+ * @param write_offset Offset of the DMA write address in the ring (in
+ *        bytes, taken just before the call).
+ * @param raw Buffer written to (MCP3208_NUM_CHANNELS readings).
+ * @retval None.
+ */
+void HOT_PATH_FUNC(mcp3208_scan_decimate)(const uint32_t *ring, uint32_t write_offset,
+        uint16_t *raw) {
+    uint32_t accumulators[MCP3208_NUM_CHANNELS] = {0};
+    uint32_t write_row = (write_offset % MCP3208_RING_BYTES)
+            / (MCP3208_NUM_CHANNELS * MCP3208_CONVERSION_BYTES);
+    uint32_t start_row = write_row + MCP3208_SCAN_GAP_ROWS - MCP3208_SCAN_MARGIN_ROWS;
+
+    for (uint32_t i = 0; i < MCP3208_SCAN_ROWS; i++) {
+        const uint32_t *row = &ring[((start_row + i) & (MCP3208_RING_ROWS - 1))
+                * MCP3208_NUM_CHANNELS];
+        for (uint8_t channel = 0; channel < MCP3208_NUM_CHANNELS; channel++) {
+            accumulators[channel] += mcp3208_decode(row[channel]);
+        }
+    }
+
+    // Scaled as if OVERSAMPLE_NUM_SAMPLES conversions had been accumulated
+    for (uint8_t channel = 0; channel < MCP3208_NUM_CHANNELS; channel++) {
+        raw[channel] = (uint16_t)((accumulators[channel]
+                * (OVERSAMPLE_NUM_SAMPLES >> OVERSAMPLE_EXTRA_BITS)) / MCP3208_SCAN_ROWS);
+    }
+}
+
+/**
+ * @brief Scan frame function. This function fills an ADC frame from the
+ *        scan ring, with frame channel n read from MCP3208 channel n.
+ * @param ring Scan ring (MCP3208_RING_WORDS words).
+ * @param write_offset Offset of the DMA write address in the ring (in
+ *        bytes, see mcp3208_scan_decimate()).
+ * @param frame Pointer to frame being populated (its timestamp is left as
+ *        is).
+ * @retval None.
+ */
+void HOT_PATH_FUNC(mcp3208_scan_frame)(const uint32_t *ring, uint32_t write_offset,
+        struct adc_frame *frame) {
+    uint16_t raw[MCP3208_NUM_CHANNELS];
+
+    mcp3208_scan_decimate(ring, write_offset, raw);
+
+    for (uint8_t channel = 0; channel < ADC_FRAME_CHANNELS; channel++) {
+        frame->raw[channel] = raw[channel];
+    }
+}
+
+/**
+ * @brief Conversion time function.
+ * @param baud SPI clock rate.
+ * @retval Time chip select is held low for one conversion, in nsec
+ *         (rounded up).
+ */
+uint32_t mcp3208_conversion_ns(uint32_t baud) {
+    uint64_t clocks = MCP3208_CONVERSION_BYTES * 8;
+    return (uint32_t)(((clocks * 1000000000ull) + baud - 1) / baud);
+}
+
+/**
+ * @brief Ring fill time function.
+ * @param rate Conversion rate.
+ * @retval Time for the scan to fill the ring, in msec (rounded up).
+ */
+uint32_t mcp3208_ring_fill_ms(uint32_t rate) {
+    return (uint32_t)((((uint64_t)MCP3208_RING_WORDS * 1000) + rate - 1) / rate);
+}
+
+/**
+ * @brief Read time function.
+ * @param rate Conversion rate.
+ * @retval Longest time a decimation may take, in usec (rounded down): the
+ *         time for the DMA to write the whole rows ahead of its own in the
+ *         gap.
+ */
+uint32_t mcp3208_scan_read_us(uint32_t rate) {
+    uint64_t conversions = (MCP3208_SCAN_GAP_ROWS - MCP3208_SCAN_MARGIN_ROWS - 1)
+            * MCP3208_NUM_CHANNELS;
+    return (uint32_t)((conversions * 1000000) / rate);
+}
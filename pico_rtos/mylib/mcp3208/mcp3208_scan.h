@@ -0,0 +1,71 @@
+ /**
+ **************************************************************
+ * @file mcp3208_scan.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the MCP3208 channel scan.
+ ***************************************************************
+ */
+
+#ifndef MCP3208_SCAN_H
+#define MCP3208_SCAN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "meas_pipeline.h"
+
+// Number of MCP3208 channels (all are scanned, in order).
+#define MCP3208_NUM_CHANNELS 8
+
+// Bytes clocked per conversion. A conversion needs 18 clocks after the
+// start bit's leading zeros, so it is sent as three bytes after a byte of
+// leading zeros. Four bytes make each conversion one 32-bit word of the
+// scan ring, which keeps the ring a power of two in size.
+#define MCP3208_CONVERSION_BYTES 4
+
+// Scan ring, holding the latest OVERSAMPLE_NUM_SAMPLES conversions of every
+// channel (one word per conversion, channel n in every word whose index is
+// n modulo MCP3208_NUM_CHANNELS). MCP3208_RING_BITS is log2 of its size in
+// bytes, as needed for a DMA address ring.
+#define MCP3208_RING_WORDS (MCP3208_NUM_CHANNELS * OVERSAMPLE_NUM_SAMPLES)
+#define MCP3208_RING_BYTES (MCP3208_RING_WORDS * MCP3208_CONVERSION_BYTES)
+#define MCP3208_RING_BITS 13
+
+// Rows of the scan ring (one conversion of every channel each), and the rows
+// a reading is decimated from. The receive DMA writes the ring while it is
+// read, so a reading leaves out a gap of MCP3208_SCAN_GAP_ROWS around the
+// DMA write address: MCP3208_SCAN_MARGIN_ROWS whole rows behind the row it
+// is writing (covering writes still in flight), that row (which holds the
+// torn word), and the rows ahead of it, which the DMA may write before the
+// reading is finished. See mcp3208_scan_decimate().
+#define MCP3208_RING_ROWS OVERSAMPLE_NUM_SAMPLES
+#define MCP3208_SCAN_MARGIN_ROWS 1
+#define MCP3208_SCAN_GAP_ROWS 4
+#define MCP3208_SCAN_ROWS (MCP3208_RING_ROWS - MCP3208_SCAN_GAP_ROWS)
+
+// Size in bytes (and log2 of it) of the command table, holding the command
+// word for every channel.
+#define MCP3208_COMMANDS_BYTES (MCP3208_NUM_CHANNELS * MCP3208_CONVERSION_BYTES)
+#define MCP3208_COMMANDS_BITS 5
+
+// SPI clock (the MCP3208's maximum at 2.7V, so it holds at 3.3V), and rate
+// at which conversions are started. Between conversions chip select is
+// held high for at least MCP3208_CS_HIGH_NS.
+#define MCP3208_SPI_BAUD 1000000
+#define MCP3208_CONVERSION_RATE 25000
+#define MCP3208_CS_HIGH_NS 500
+
+// Number of conversions in one run of the scan (a whole number of rings,
+// with four times as many bytes still within a DMA transfer count).
+#define MCP3208_RUN_CONVERSIONS 0x3FFFF800u
+
+// Function prototypes
+void mcp3208_scan_commands(uint32_t *commands);
+uint16_t mcp3208_decode(uint32_t word);
+void mcp3208_scan_decimate(const uint32_t *ring, uint32_t write_offset, uint16_t *raw);
+void mcp3208_scan_frame(const uint32_t *ring, uint32_t write_offset, struct adc_frame *frame);
+uint32_t mcp3208_conversion_ns(uint32_t baud);
+uint32_t mcp3208_ring_fill_ms(uint32_t rate);
+uint32_t mcp3208_scan_read_us(uint32_t rate);
+
+#endif
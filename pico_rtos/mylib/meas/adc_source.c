@@ -0,0 +1,207 @@
+ /**
+ **************************************************************
+ * @file adc_source.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief RP2040 ADC sample source file. This file handles sampling ADC
+ *        frames from the RP2040's ADC, with the pressure sensors and the
+ *        offset/reference channel on GPIO26-28 (ADC channels 0-2). Each
+ *        frame is a burst of round-robin conversions moved from the ADC
+ *        FIFO by DMA, so interrupts and preemption on the sampling core
+ *        can't overflow the FIFO and misalign samples with channels.
+ ***************************************************************
+ */
+
+#include "pico/stdlib.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "sample_source.h"
+
+// GPIO pin number declarations
+#define GPIO26 26
+#define GPIO27 27
+#define GPIO28 28
+
+// Only GPIO26-28 are free for sensors (channel 3 measures VSYS on the Pico),
+// so the RP2040 ADC can't sample more than 2 tanks (see NUM_TANKS).
+_Static_assert(ADC_FRAME_CHANNELS <= 3, "RP2040 ADC has 3 free channels, use the MCP3208 source");
+
+// Number of conversions in a frame's burst (every channel's samples, in
+// round-robin order from channel 0).
+#define ADC_SOURCE_BURST_SAMPLES (OVERSAMPLE_NUM_SAMPLES * ADC_FRAME_CHANNELS)
+
+// Number of times a burst is taken before a frame is discarded (if the FIFO
+// overflowed or a conversion failed).
+#define ADC_SOURCE_MAX_ATTEMPTS 3
+
+// Burst buffer, written by the burst DMA channel.
+static uint16_t burst[ADC_SOURCE_BURST_SAMPLES];
+
+// Written to the ADC control register's clear alias by the stop DMA
+// channel, ending free-running conversions as soon as the burst completes.
+static const uint32_t stop_bits = ADC_CS_START_MANY_BITS;
+
+// DMA channels used by the burst.
+static int burst_channel;
+static int stop_channel;
+
+// Readings of the last frame sampled, held if a frame is discarded.
+static uint16_t last_raw[ADC_FRAME_CHANNELS];
+static bool have_last_raw = false;
+
+/**
+ * @brief ADC initialiser function. This function handles initialisation of
+ *        the ADC and its FIFO, and claims and configures the DMA channels
+ *        used by the burst.
+ * @param None.
+ * @retval None.
+ */
+static void adc_source_init(void) {
+    adc_init();
+
+    // Run the ADC at its full rate, with conversions (and their error flags)
+    // written to the FIFO, requesting DMA for every conversion.
+    adc_set_clkdiv(0);
+    adc_fifo_setup(true, true, 1, true, false);
+
+    burst_channel = dma_claim_unused_channel(true);
+    stop_channel = dma_claim_unused_channel(true);
+
+    // Stop channel: clears the ADC's free-running bit once, when triggered
+    // by the end of the burst.
+    dma_channel_config stop_config = dma_channel_get_default_config(stop_channel);
+    channel_config_set_transfer_data_size(&stop_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&stop_config, false);
+    channel_config_set_write_increment(&stop_config, false);
+    dma_channel_configure(stop_channel, &stop_config, hw_clear_alias(&adc_hw->cs),
+            &stop_bits, 1, false);
+
+    // Burst channel: moves each conversion from the FIFO into the burst
+    // buffer, then triggers the stop channel.
+    dma_channel_config burst_config = dma_channel_get_default_config(burst_channel);
+    channel_config_set_transfer_data_size(&burst_config, DMA_SIZE_16);
+    channel_config_set_read_increment(&burst_config, false);
+    channel_config_set_write_increment(&burst_config, true);
+    channel_config_set_dreq(&burst_config, DREQ_ADC);
+    channel_config_set_chain_to(&burst_config, stop_channel);
+    dma_channel_configure(burst_channel, &burst_config, burst, &adc_hw->fifo,
+            ADC_SOURCE_BURST_SAMPLES, false);
+}
+
+/**
+ * @brief ADC pin initialiser function. This function handles initialisation
+ *        of the ADC pins used to measure the water pressure at the bottom of
+ *        each water tank, and the offset/reference channel.
+ * @param None.
+ * @retval None.
+ */
+static void adc_source_init_pins(void) {
+    adc_gpio_init(GPIO26);
+    adc_gpio_init(GPIO27);
+    adc_gpio_init(GPIO28);
+}
+
+/**
+ * @brief ADC burst function. This function takes one burst of round-robin
+ *        conversions of every channel in the frame (beginning at channel 0)
+ *        at the full ADC rate, moved into the burst buffer by DMA. The ADC
+ *        is stopped by DMA as soon as the burst is complete, so the FIFO
+ *        only overflows if the DMA fell behind during the burst.
+ * @param None.
+ * @retval true if every conversion in the burst is in the buffer, in order
+ *         and without error, false otherwise.
+ */
+static bool HOT_PATH_FUNC(adc_source_burst)(void) {
+    // Start from channel 0 with an empty FIFO, and clear the FIFO's
+    // overflow and underflow flags (write 1 to clear).
+    adc_select_input(CHANNEL_0);
+    adc_set_round_robin((1 << ADC_FRAME_CHANNELS) - 1);
+    adc_fifo_drain();
+    hw_set_bits(&adc_hw->fcs, ADC_FCS_OVER_BITS | ADC_FCS_UNDER_BITS);
+
+    dma_channel_transfer_to_buffer_now(burst_channel, burst, ADC_SOURCE_BURST_SAMPLES);
+    adc_run(true);
+    dma_channel_wait_for_finish_blocking(burst_channel);
+
+    // Wait for the stop channel, then for the conversion in progress when
+    // it ran, and discard that conversion.
+    while (adc_hw->cs & ADC_CS_START_MANY_BITS) {
+        tight_loop_contents();
+    }
+
+    while (!(adc_hw->cs & ADC_CS_READY_BITS)) {
+        tight_loop_contents();
+    }
+
+    bool overflow = (adc_hw->fcs & ADC_FCS_OVER_BITS) != 0;
+    adc_set_round_robin(0);
+    adc_fifo_drain();
+
+    return !overflow;
+}
+
+/**
+ * @brief ADC frame sampling function. This function samples every channel in
+ *        the frame OVERSAMPLE_NUM_SAMPLES times in a burst, and decimates
+ *        each channel's samples into a single reading with
+ *        OVERSAMPLE_EXTRA_BITS extra bits of resolution. A burst which
+ *        overflowed the FIFO or has a failed conversion is taken again, and
+ *        if none of ADC_SOURCE_MAX_ATTEMPTS bursts succeed the frame is
+ *        discarded, holding the last frame's readings.
+ * @param frame Pointer to frame being populated.
+ * @retval None.
+ */
+static void HOT_PATH_FUNC(adc_source_sample_frame)(struct adc_frame *frame) {
+    uint32_t accumulators[ADC_FRAME_CHANNELS];
+    bool valid = false;
+
+    frame->timestamp_us = time_us_64();
+
+    for (uint8_t attempt = 0; (attempt < ADC_SOURCE_MAX_ATTEMPTS) && !valid; attempt++) {
+        valid = adc_source_burst();
+
+        // Accumulate the burst of samples for each channel. Summing 4^n
+        // samples and shifting right by n gains n bits of resolution (given
+        // enough noise to dither between levels).
+        const uint16_t *sample = burst;
+        for (uint8_t channel = 0; channel < ADC_FRAME_CHANNELS; channel++) {
+            accumulators[channel] = 0;
+        }
+
+        for (uint16_t i = 0; i < OVERSAMPLE_NUM_SAMPLES; i++) {
+            for (uint8_t channel = 0; channel < ADC_FRAME_CHANNELS; channel++) {
+                if (*sample & ADC_FIFO_ERR_BITS) {
+                    valid = false;
+                }
+
+                accumulators[channel] += *sample & ADC_FIFO_VAL_BITS;
+                sample++;
+            }
+        }
+    }
+
+    // Hold the last readings rather than use a misaligned or failed burst
+    // (unless there are none yet).
+    if (valid || !have_last_raw) {
+        for (uint8_t channel = 0; channel < ADC_FRAME_CHANNELS; channel++) {
+            last_raw[channel] = (uint16_t)(accumulators[channel] >> OVERSAMPLE_EXTRA_BITS);
+        }
+
+        have_last_raw = true;
+    }
+
+    for (uint8_t channel = 0; channel < ADC_FRAME_CHANNELS; channel++) {
+        frame->raw[channel] = last_raw[channel];
+    }
+}
+
+// RP2040 ADC sample source. Frames are sampled in a burst, with DMA moving
+// every sample from the ADC FIFO.
+const struct sample_source adc_sample_source = {
+    .name = "adc",
+    .num_channels = ADC_FRAME_CHANNELS,
+    .settle_ms = 0,
+    .init = adc_source_init,
+    .init_pins = adc_source_init_pins,
+    .sample_frame = adc_source_sample_frame,
+};
@@ -7,462 +7,361 @@
  *        functionality specific to measuring outputs from the pressure
  *        sensors (on ADC) and calculating water tank level from the 
  *        pressure readings based on the developed calibration equation. 
- *        Functionality specific to checking water tank level control
- *        requirements based on current tank filling/draining status and 
- *        water tank level (which only executes of control is enabled), 
- *        is also included in this driver. 
+ *        All ADC channels are sampled together as one frame per period 
+ *        (from the sample source selected at build, see sample_source.h), 
+ *        and each frame is run through the measurement pipeline (see 
+ *        meas_pipeline.c). This driver issues the resulting level control
+ *        commands and events, and publishes the readings. 
  *************************************************************** 
  */
 
 #include "meas.h"
 
-/**
- * @brief Tank 1 ADC initialiser function. This function handles ADC 
- *        initialisation and initialisation of the ADC pins used to measure
- *        the water pressure at the bottom of water tank 1. 
- * @param None. 
- * @retval None. 
- */
-void init_t1_adc_pins(void) {
-    adc_init();
-    adc_gpio_init(GPIO26);
-    adc_gpio_init(GPIO28);
-}
+// Most recent readings, published by the measurement task. 
+static struct reading_snapshot snapshot;
+
+// Number of ADC frames taken since boot. 
+static uint32_t frame_seq = 0;
+
+_Static_assert((ADC_FRAME_CHANNELS == TELEMETRY_NUM_CHANNELS) 
+        && (NUM_TANKS == TELEMETRY_NUM_TANKS), "Telemetry record doesn't match frame");
+
+// Sample source the frames are taken from (set by the SAMPLE_SOURCE CMake 
+// option). 
+#if (SAMPLE_SOURCE == SAMPLE_SOURCE_MCP3208)
+static const struct sample_source *const source = &mcp3208_sample_source;
+#else
+static const struct sample_source *const source = &adc_sample_source;
+#endif
 
 /**
- * @brief Tank 2 ADC initialiser function. This function handles ADC 
- *        initialisation and initialisation of the ADC pins used to measure
- *        the water pressure at the bottom of water tank 2. 
+ * @brief ADC initialiser function. This function handles initialisation of 
+ *        the ADC frames are sampled from. 
  * @param None. 
  * @retval None. 
  */
-void init_t2_adc_pins(void) {
-    adc_init();
-    adc_gpio_init(GPIO27);
-    adc_gpio_init(GPIO28);
+void meas_adc_init(void) {
+    source->init();
 }
 
 /**
- * @brief Pressure calculation function. This function calculates pressure
- *        based on the given raw ADC readings. 
- * @param pressure_channel_raw raw ADC reading for the pressure channel. 
- * @param offset_channel_raw raw ADC reading for the offset channel (connected 
- *        directly to GND). 
- * @retval Instantaneous measured pressure. 
+ * @brief Warm start function. This function fills the averaging window of 
+ *        every tank before the first measurement period, so that averages 
+ *        aren't dragged towards zero while the windows fill. After a 
+ *        watchdog reset, each tank's window and valve states are restored 
+ *        from the retained state. Otherwise, a burst of frames is taken. 
+ *        Restored valve states are held for a few periods while control is
+ *        re-enabled. 
+ * @param states Array of tank states. 
+ * @param filter Pointer to the offset/reference filter state. 
+ * @param config Pointer to configuration. 
+ * @retval None. 
  */
-float calc_pressure(uint16_t pressure_channel_raw, uint16_t offset_channel_raw) {
+void warm_start(struct tank_state *states, struct ref_filter *filter, 
+        const struct meas_config *config) {
+    bool restored[NUM_TANKS] = {false};
+
+    // Restore each tank's state if it was retained through a watchdog reset
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        struct retained_tank_state retained_state;
+        if (retain_get_tank_state(config->tanks[i].tank, &retained_state)) {
+            for (uint8_t j = 0; j < AVG_WINDOW_MAX_WIDTH; j++) {
+                states[i].avg_window[j] = retained_state.avg_pressure;
+            }
 
-    // float corrected_pressure_channel = ((float)(pressure_channel_raw 
-    //         - offset_channel_raw)) * (VREF / RES_LEVELS);
+            states[i].filling = retained_state.filling;
+            states[i].draining = retained_state.draining;
+            states[i].restore_hold_periods = MEAS_RESTORE_HOLD_PERIODS;
+            restored[i] = true;
+        }
+    }
 
-    // Determine the voltage at the ADC pin
-    float corrected_pressure_channel = (float)pressure_channel_raw * (VREF / RES_LEVELS);
+    // Fill the windows of tanks which weren't restored with a burst of 
+    // frames (the offset/reference filter is always primed this way). 
+    for (uint8_t j = 0; j < meas_config_max_window_width(config); j++) {
+        struct adc_frame frame;
+        source->sample_frame(&frame);
+        meas_pipeline_prime(states, filter, config, &frame, j, restored);
 
-    // Determine the voltage at the pressure sensor output (based on the 
-    // resistances used in the voltage divider which steps 5V down to 3V). 
-    float sensor_voltage = (500.0 * corrected_pressure_channel) / 280.0;
+        busy_wait_us_32(WARM_START_SAMPLE_INTERVAL_US);
+    }
+}
 
-    // Calculate pressure with respect to the voltage at the output of the 
-    // sensor. The sensor has a linear output ranging from 0.2V - 4.7V
-    // which corresponds to the pressure range of 0Pa - 10kPa. 
-    float inst_pressure = (((20000.0 / 9.0) * sensor_voltage) - (4000.0 / 9.0));
+/**
+ * @brief Tank semaphore function. This function picks a tank's level control
+ *        semaphore (only tanks 1 and 2 have valves and level control tasks). 
+ * @param tank Tank which the semaphore is for. 
+ * @param t1_sem Tank 1's semaphore. 
+ * @param t2_sem Tank 2's semaphore. 
+ * @retval The tank's semaphore, or NULL if the tank has no valves. 
+ */
+static inline SemaphoreHandle_t tank_sem(uint8_t tank, SemaphoreHandle_t t1_sem, 
+        SemaphoreHandle_t t2_sem) {
+    if (tank == TANK_1) {
+        return t1_sem;
+    } else if (tank == TANK_2) {
+        return t2_sem;
+    }
 
-    return inst_pressure;
+    return NULL;
 }
 
 /**
- * @brief Control requirements checker function. This function checks
- *        water tank level readings for the given tank and compares
- *        the reading against the necessary fill and drain thresholds
- *        depending on the water tank filling and draining status. When
- *        valve state change for fill and drain valves is required, semaphore
- *        is given to notify the appropriate level control task. 
- * @param filling Pointer to filling status (passed by reference from
- *        measurement controlling task).
- * @param draining Pointer to draining status (passed by reference from
- *        measurement controlling task).
- * @param height Height of water level within tank. 
- * @param tank Tank which control requirements are being checked for. 
- * @retval None.
+ * @brief Control state reissue function. This function notifies a newly 
+ *        created level control task of valve states which were restored 
+ *        after a watchdog reset, so valves that were open are reopened. 
+ * @param filling Filling status. 
+ * @param draining Draining status. 
+ * @param tank Tank which control state is being reissued for. 
+ * @retval None. 
  */
-void check_ctrl_requirements(bool *filling, bool *draining, float height, uint8_t tank) {
-    if ((*filling)) {
-        // If tank for which control requirements are being checked is tank
-        // 1, and the tank is filling
-        if (tank == TANK_1) {
-            // If the level of water in the tank is equal to or above the
-            // to level, give semaphore to signal level control task to 
-            // stop filling.
-            if (height >= TANK_1_FILL_TO_LEVEL) {
-                if (stop_fill_t1_sem != NULL) {
-                    xSemaphoreGive(stop_fill_t1_sem);
-                }
-                // Set filling local variable in controlling task to false. 
-                (*filling) = false;
-            }
-        
-        // If tank for which control requirements are being checked is tank
-        // 2, and the tank is filling
-        } else if (tank == TANK_2) {
-            // If the level of water in the tank is equal to or above the
-            // to level, give semaphore to signal level control task to 
-            // stop filling.
-            if (height >= TANK_2_FILL_TO_LEVEL) {
-                if (stop_fill_t2_sem != NULL) {
-                    xSemaphoreGive(stop_fill_t2_sem);
-                }
-                // Set filling local variable in controlling task to false. 
-                (*filling) = false;
-            }
-        }
-    } else {
-        // If tank for which control requirements are being checked is tank
-        // 1, and the tank is not filling
-        if (tank == TANK_1) {
-            // If the level of water in the tank is less than or equal to the
-            // minimum fill level, give semaphore to signal level control task
-            // to start filling.
-            if (height <= TANK_1_MIN_FILL_LEVEL) {
-                if (fill_t1_sem != NULL) {
-                    xSemaphoreGive(fill_t1_sem);
-                }
-                // Set filling local variable in controlling task to true. 
-                (*filling) = true;
-            }
+void reissue_ctrl_state(bool filling, bool draining, uint8_t tank) {
+    SemaphoreHandle_t fill_sem = tank_sem(tank, fill_t1_sem, fill_t2_sem);
+    SemaphoreHandle_t drain_sem = tank_sem(tank, drain_t1_sem, drain_t2_sem);
 
-        // If tank for which control requirements are being checked is tank
-        // 2, and the tank is not filling
-        } else if (tank == TANK_2) {
-            // If the level of water in the tank is less than or equal to the
-            // minimum fill level, give semaphore to signal level control task
-            // to start filling.
-            if (height <= TANK_2_MIN_FILL_LEVEL) {
-                if (fill_t2_sem != NULL) {
-                    xSemaphoreGive(fill_t2_sem);
-                }
-                // Set filling local variable in controlling task to true. 
-                (*filling) = true;
-            }
-        }
+    if (filling && (fill_sem != NULL)) {
+        xSemaphoreGive(fill_sem);
     }
 
-    if ((*draining)) {
-        // If tank for which control requirements are being checked is tank
-        // 1, and the tank is draining
-        if (tank == TANK_1) {
-            // If the level of water in the tank is less than or equal to the
-            // drain to level, give semaphore to signal level control task to 
-            // stop draining.
-            if (height <= TANK_1_DRAIN_TO_LEVEL) {
-                if (stop_drain_t1_sem != NULL) {
-                    xSemaphoreGive(stop_drain_t1_sem);
-                }
-                // Set draining local variable in controlling task to false. 
-                (*draining) = false;
-            }
+    if (draining && (drain_sem != NULL)) {
+        xSemaphoreGive(drain_sem);
+    }
+}
 
-        // If tank for which control requirements are being checked is tank
-        // 2, and the tank is draining
-        } else if (tank == TANK_2) {
-            // If the level of water in the tank is less than or equal to the
-            // drain to level, give semaphore to signal level control task to 
-            // stop draining.
-            if (height <= TANK_2_DRAIN_TO_LEVEL) {
-                if (stop_drain_t2_sem != NULL) {
-                    xSemaphoreGive(stop_drain_t2_sem);
-                }
-                // Set draining local variable in controlling task to false. 
-                (*draining) = false;
-            }
+/**
+ * @brief Control enable update function. This function checks whether level
+ *        control has been enabled or disabled for a tank, and updates the 
+ *        tank's state accordingly. 
+ * @param state Pointer to tank state. 
+ * @param tank Tank which is being updated. 
+ * @retval None. 
+ */
+void HOT_PATH_FUNC(update_ctrl_enable)(struct tank_state *state, uint8_t tank) {
+    SemaphoreHandle_t ctrl_on_sem = tank_sem(tank, ctrl_on_sem_1, ctrl_on_sem_2);
+    SemaphoreHandle_t ctrl_off_sem = tank_sem(tank, ctrl_off_sem_1, ctrl_off_sem_2);
+
+    // If ctrl_on_sem is taken, control functionality has been enabled, so 
+    // update state and reopen any valves restored after a watchdog reset. 
+    if (ctrl_on_sem != NULL) {
+        if (xSemaphoreTake(ctrl_on_sem, 0) == pdTRUE) {
+            state->ctrl_on = true;
+            reissue_ctrl_state(state->filling, state->draining, tank);
+            state->restore_hold_periods = 0;
         }
-    } else {
-        // If tank for which control requirements are being checked is tank
-        // 1, and the tank is not draining
-        if (tank == TANK_1) {
-            // If the level of water in the tank is equal to or above the
-            // maximum fill level, give semaphore to signal level control task
-            // to start draining.
-            if (height >= TANK_1_MAX_FILL_LEVEL) {
-                if (drain_t1_sem != NULL) {
-                    xSemaphoreGive(drain_t1_sem);
-                }
-                // Set draining local variable in controlling task to true. 
-                (*draining) = true;
-            }
+    }
 
-        // If tank for which control requirements are being checked is tank
-        // 2, and the tank is not draining
-        } else if (tank == TANK_2) {
-            // If the level of water in the tank is equal to or above the
-            // maximum fill level, give semaphore to signal level control task
-            // to start draining.
-            if (height >= TANK_2_MAX_FILL_LEVEL) {
-                if (drain_t2_sem != NULL) {
-                    xSemaphoreGive(drain_t2_sem);
-                }
-                // Set draining local variable in controlling task to true. 
-                (*draining) = true;
-            }
+    // If ctrl_off_sem is taken, control functionality has been disabled, so
+    // update state. 
+    if (ctrl_off_sem != NULL) {
+        if (xSemaphoreTake(ctrl_off_sem, 0) == pdTRUE) {
+            state->ctrl_on = false;
         }
     }
 }
 
 /**
- * @brief Tank 1 water level measurement task. This task handles water level 
- *        measurement for tank 1. 
- * @param param Value passed upon task creation. 
+ * @brief Control command issuing function. This function signals a tank's 
+ *        level control task to start/stop filling or draining, as per the 
+ *        commands returned by the measurement pipeline. 
+ * @param commands Commands for the level control task (CTRL_CMD_*). 
+ * @param tank Tank which the commands are for. 
  * @retval None. 
  */
-void t1_meas_task(void *param) {
-    // Initialise ADC and appropriate pins for tank 1 level measurement
-    init_t1_adc_pins();
-
-    // Local filling, draining, and level control state variables
-    bool filling = false, draining = false, ctrl_on = false;
-
-    // Timestamp of last height calculation
-    TickType_t last_calculation = 0;
+void HOT_PATH_FUNC(issue_ctrl_commands)(uint8_t commands, uint8_t tank) {
+    SemaphoreHandle_t fill_sem = tank_sem(tank, fill_t1_sem, fill_t2_sem);
+    SemaphoreHandle_t stop_fill_sem = tank_sem(tank, stop_fill_t1_sem, stop_fill_t2_sem);
+    SemaphoreHandle_t drain_sem = tank_sem(tank, drain_t1_sem, drain_t2_sem);
+    SemaphoreHandle_t stop_drain_sem = tank_sem(tank, stop_drain_t1_sem, stop_drain_t2_sem);
+
+    if ((commands & CTRL_CMD_START_FILL) && (fill_sem != NULL)) {
+        xSemaphoreGive(fill_sem);
+    }
 
-    // Averaging window for smoothing pressure measurements, and
-    // current index within window (for adding new data). 
-    float avg_window[AVG_WINDOW_WIDTH] = {0.0}; 
-    uint8_t avg_window_index = 0;
- 
-    while (1) {
-        // Calculate current system runtime (in seconds)
-        TickType_t current_runtime = xTaskGetTickCount() / configTICK_RATE_HZ;
-
-        // If the period between samples has exceeded the specified interval,
-        // or the tick count has overflowed, take measurement. 
-        if (((current_runtime - last_calculation) > T1_SAMPLE_PERIOD) 
-                || (current_runtime < last_calculation)) {
-            // Measure ADC input at channel connected to pressure sensor
-            // being used to monitor water tank 1 level. 
-            adc_select_input(CHANNEL_0);
-            uint16_t pressure_channel_1_raw = adc_read();
-
-            // Measure ADC input at offset channel (connected to ground, 
-            // as suggested by Raspberry Pi Pico datasheet, only really
-            // necessary when shunt reference isn't being used). 
-            adc_select_input(CHANNEL_2);
-            uint16_t offset_channel_raw = adc_read();
-
-            // Calculate instantaneous pressure as per the current ADC readings. 
-            float inst_pressure = calc_pressure(pressure_channel_1_raw, offset_channel_raw);
-
-            // Add instantaneous pressure to current index in averaging window,
-            // and increment average window index. 
-            avg_window[avg_window_index] = inst_pressure;
-            avg_window_index++;
-
-            // If average window index exceeds window length, reset index
-            if (avg_window_index >= AVG_WINDOW_WIDTH) {
-                avg_window_index = 0;
-            }
+    if ((commands & CTRL_CMD_STOP_FILL) && (stop_fill_sem != NULL)) {
+        xSemaphoreGive(stop_fill_sem);
+    }
 
-            // Calculate average of samples in averaging window
-            float avg_pressure = 0.0;
-            for (uint8_t i = 0; i < AVG_WINDOW_WIDTH; i++) {
-                avg_pressure += avg_window[i];
-            }
-            avg_pressure = avg_pressure / AVG_WINDOW_WIDTH_FLOAT;
+    if ((commands & CTRL_CMD_START_DRAIN) && (drain_sem != NULL)) {
+        xSemaphoreGive(drain_sem);
+    }
 
-            // Calculate height using averaging window, using the equation
-            // derived via manual calibration. 
-            float height = (0.0124 * (avg_pressure - TANK_1_ZERO_PRESSURE_OFFSET)) + 1.656;
+    if ((commands & CTRL_CMD_STOP_DRAIN) && (stop_drain_sem != NULL)) {
+        xSemaphoreGive(stop_drain_sem);
+    }
+}
 
-            // If height is lower than the minimum usable water height, consider 
-            // tank to be empty.
-            if (height < TANK_1_USABLE_HEIGHT_OFFSET) {
-                height = 0.0;
-            }
+/**
+ * @brief Telemetry push function. This function builds the telemetry record
+ *        for an ADC frame and passes it to the telemetry stream (which never
+ *        blocks). 
+ * @param frame Pointer to ADC frame. 
+ * @param ref_channel_filtered Filtered offset/reference channel reading. 
+ * @param pressures Instantaneous pressure of each tank. 
+ * @param states Array of tank states. 
+ * @retval None. 
+ */
+void HOT_PATH_FUNC(push_telemetry)(const struct adc_frame *frame, 
+        uint16_t ref_channel_filtered, const float *pressures, 
+        const struct tank_state *states) {
+    if (!TELEMETRY_STREAM) {
+        return;
+    }
 
-            // Put height reading packet in queue if requested to by UART
-            // controlling task. 
-            if (request_tank_1_height_sem != NULL) {
-                if (xSemaphoreTake(request_tank_1_height_sem, 10) == pdTRUE) {
-                    if (readings_queue_1 != NULL) {
-                        struct packet readings_packet = {0};
-                        readings_packet.tank = TANK_1;
-                        readings_packet.height = height;
-
-                        xQueueSendToFront(readings_queue_1, (void *) &readings_packet, 
-                                portMAX_DELAY);
-                    }
-                }
-            }
+    struct telemetry_record record;
+    record.seq = frame_seq;
+    record.timestamp_us = frame->timestamp_us;
+    record.ref_filtered = ref_channel_filtered;
+    record.state = 0;
 
-            // If ctrl_on_sem_1 is taken, control functionality has been
-            // enabled, so update local variable. 
-            if (ctrl_on_sem_1 != NULL) {
-                if (xSemaphoreTake(ctrl_on_sem_1, 10) == pdTRUE) {
-                    ctrl_on = true;
-                }
-            }
+    struct supervisor_stats supervisor_stats;
+    supervisor_get_stats(&supervisor_stats);
+    record.deadline_misses = (supervisor_stats.deadline_misses > UINT16_MAX) 
+            ? UINT16_MAX : (uint16_t)supervisor_stats.deadline_misses;
+    record.worst_lateness_us = supervisor_stats.worst_lateness_us;
 
-            // If ctrl_off_sem_1 is taken, control functionality has been
-            // disabled, so update local variable. 
-            if (ctrl_off_sem_1 != NULL) {
-                if (xSemaphoreTake(ctrl_off_sem_1, 10) == pdTRUE) {
-                    ctrl_on = false;
-                }
-            }
+    for (uint8_t channel = 0; channel < ADC_FRAME_CHANNELS; channel++) {
+        record.raw[channel] = frame->raw[channel];
+    }
 
-            // Check control requirements if control is on. 
-            if (ctrl_on) {
-                check_ctrl_requirements(&filling, &draining, height, TANK_1);
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        uint32_t tank_state = 0;
+        tank_state |= states[i].filling ? TELEMETRY_STATE_FILLING : 0;
+        tank_state |= states[i].draining ? TELEMETRY_STATE_DRAINING : 0;
+        tank_state |= states[i].ctrl_on ? TELEMETRY_STATE_CTRL_ON : 0;
 
-            } else {
-                // If control is off, neither filling or draining can occur. 
-                filling = false;
-                draining = false;
-            }
+        record.pressure[i] = pressures[i];
+        record.height[i] = states[i].height;
+        record.state |= tank_state << (i * TELEMETRY_STATE_BITS_PER_TANK);
+    }
 
-            // Update last calculation timestamp
-            last_calculation = current_runtime;
-        }
+    telemetry_push(&record);
+}
 
-        vTaskDelay(100);
+/**
+ * @brief Snapshot publishing function. This function publishes the most 
+ *        recent readings of every tank. 
+ * @param states Array of tank states. 
+ * @param timestamp_us Timestamp of the ADC frame the readings were 
+ *        calculated from. 
+ * @retval None. 
+ */
+void HOT_PATH_FUNC(publish_snapshot)(const struct tank_state *states, 
+        uint64_t timestamp_us) {
+    // Snapshot may be read by tasks on either core
+    taskENTER_CRITICAL();
+    snapshot.seq++;
+    snapshot.timestamp_us = timestamp_us;
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        snapshot.height[i] = states[i].height;
+        snapshot.filling[i] = states[i].filling;
+        snapshot.draining[i] = states[i].draining;
+        snapshot.analytics[i] = states[i].analytics;
     }
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Snapshot getter function. This function copies the most recent 
+ *        readings of every tank. 
+ * @param snapshot_out Pointer to struct which the readings are copied into. 
+ * @retval None. 
+ */
+void meas_get_snapshot(struct reading_snapshot *snapshot_out) {
+    taskENTER_CRITICAL();
+    (*snapshot_out) = snapshot;
+    taskEXIT_CRITICAL();
 }
 
 /**
- * @brief Tank 2 water level measurement task. This task handles water level 
- *        measurement for tank 2. 
+ * @brief Water level measurement task. This task handles water level 
+ *        measurement for all tanks, sampling all ADC channels as one frame 
+ *        every period. The configuration is read through the configuration
+ *        store's active snapshot while a frame is processed, without 
+ *        locking, so an update takes effect from the next frame. 
  * @param param Value passed upon task creation. 
  * @retval None. 
  */
-void t2_meas_task(void *param) {
-    // Initialise ADC and appropriate pins for tank 2 level measurement
-    init_t2_adc_pins();
+void HOT_PATH_FUNC(meas_task)(void *param) {
+    // Check in with the supervisor every period from here on (the first 
+    // deadline covers settling and the warm start). 
+    supervisor_start(SUPERVISOR_MEAS);
+
+    // Initialise appropriate pins for level measurement, and give the 
+    // sample source time to settle before the first frame. 
+    source->init_pins();
+    if (source->settle_ms > 0) {
+        vTaskDelay(pdMS_TO_TICKS(source->settle_ms));
+    }
+
+    // Measurement and control state of each tank
+    static struct tank_state states[NUM_TANKS];
+    static struct ref_filter ref_filter;
+    const struct meas_config *config = config_read_begin(CONFIG_READER_MEAS);
+    meas_pipeline_init(states, &ref_filter, config);
 
-    // Local filling, draining, and level control state variables
-    bool filling = false, draining = false, ctrl_on = false;
+    // Tick count at which the last measurement period started
+    TickType_t last_wake = xTaskGetTickCount();
 
-    // Timestamp of last height calculation
-    int last_calculation = 0;
+    // Fill the averaging windows before the first measurement period. 
+    warm_start(states, &ref_filter, config);
+    uint32_t sample_period_ms = config->sample_period_ms;
+    config_read_end(CONFIG_READER_MEAS);
 
-    // Averaging window for smoothing pressure measurements, and
-    // current index within window (for adding new data). 
-    float avg_window[AVG_WINDOW_WIDTH] = {0.0};
-    uint8_t avg_window_index = 0;
- 
     while (1) {
-        // Calculate current system runtime (in seconds)
-        int current_runtime = xTaskGetTickCount() / configTICK_RATE_HZ;
-
-        // If the period between samples has exceeded the specified interval,
-        // or the tick count has overflowed, take measurement. 
-        if (((current_runtime - last_calculation) > T2_SAMPLE_PERIOD) 
-                || (current_runtime < last_calculation)) {
-            // Measure ADC input at channel connected to pressure sensor
-            // being used to monitor water tank 2 level. 
-            adc_select_input(CHANNEL_1);
-            uint16_t pressure_channel_2_raw = adc_read();
-
-            // Measure ADC input at offset channel (connected to ground, 
-            // as suggested by Raspberry Pi Pico datasheet, only really
-            // necessary when shunt reference isn't being used). 
-            adc_select_input(CHANNEL_2);
-            uint16_t offset_channel_raw = adc_read();
-
-            // Calculate instantaneous pressure as per the current ADC readings. 
-            float inst_pressure = calc_pressure(pressure_channel_2_raw, offset_channel_raw);
-
-            // Add instantaneous pressure to current index in averaging window,
-            // and increment average window index. 
-            avg_window[avg_window_index] = inst_pressure;
-            avg_window_index++;
-
-            // If average window index exceeds window length, reset index
-            if (avg_window_index >= AVG_WINDOW_WIDTH) {
-                avg_window_index = 0;
-            }
+        // Block until the next frame is due. 
+        xTaskDelayUntil(&last_wake, pdMS_TO_TICKS(sample_period_ms));
+        uint32_t loop_start_us = time_us_32();
 
-            // Calculate average of samples in averaging window
-            float avg_pressure = 0.0;
-            for (uint8_t i = 0; i < AVG_WINDOW_WIDTH; i++) {
-                avg_pressure += avg_window[i];
-            }
-            avg_pressure = avg_pressure / AVG_WINDOW_WIDTH_FLOAT;
+        // Sample every channel once
+        struct adc_frame frame;
+        source->sample_frame(&frame);
 
-            // Calculate height using averaging window, using the equation
-            // derived via manual calibration. 
-            float height = (0.0124 * (avg_pressure - TANK_2_ZERO_PRESSURE_OFFSET)) + 1.656;
+        config = config_read_begin(CONFIG_READER_MEAS);
 
-            // If height is lower than the minimum usable water height, consider 
-            // tank to be empty.
-            if (height < TANK_2_USABLE_HEIGHT_OFFSET) {
-                height = 0.0;
-            }
+        // Pick up control being enabled/disabled before the frame is 
+        // processed. 
+        for (uint8_t i = 0; i < NUM_TANKS; i++) {
+            update_ctrl_enable(&states[i], config->tanks[i].tank);
+        }
 
-            // Put height reading packet in queue if requested to by UART
-            // controlling task. 
-            if (request_tank_2_height_sem != NULL) {
-                if (xSemaphoreTake(request_tank_2_height_sem, 10) == pdTRUE) {
-                    if (readings_queue_2 != NULL) {
-                        struct packet readings_packet = {0};
-                        readings_packet.tank = TANK_2;
-                        readings_packet.height = height;
-
-                        xQueueSendToFront(readings_queue_2, (void *) &readings_packet, 
-                                portMAX_DELAY);
-                    }
-                }
-            }
+        struct pipeline_output output;
+        meas_pipeline_process(states, &ref_filter, config, &frame, &output);
 
-            // If ctrl_on_sem_2 is taken, control functionality has been
-            // enabled, so update local variable. 
-            if (ctrl_on_sem_2 != NULL) {
-                if (xSemaphoreTake(ctrl_on_sem_2, 10) == pdTRUE) {
-                    ctrl_on = true;
-                }
-            }
+        for (uint8_t i = 0; i < NUM_TANKS; i++) {
+            struct tank_state *state = &states[i];
+            uint8_t tank = config->tanks[i].tank;
 
-            // If ctrl_off_sem_2 is taken, control functionality has been
-            // disabled, so update local variable. 
-            if (ctrl_off_sem_2 != NULL) {
-                if (xSemaphoreTake(ctrl_off_sem_2, 10) == pdTRUE) {
-                    ctrl_on = false;
-                }
-            }
+            issue_ctrl_commands(output.ctrl_commands[i], tank);
 
-            // Check control requirements if control is on. 
-            if (ctrl_on) {
-                check_ctrl_requirements(&filling, &draining, height, TANK_2);
+            // Update the state retained through a watchdog reset
+            struct retained_tank_state retained_state = {state->avg_pressure, 
+                    state->filling, state->draining};
+            retain_set_tank_state(tank, &retained_state);
+        }
 
-            } else {
-                // If control is off, neither filling or draining can occur.
-                filling = false;
-                draining = false;
-            }
+        sample_period_ms = config->sample_period_ms;
+        config_read_end(CONFIG_READER_MEAS);
 
-            // Update last calculation timestamp
-            last_calculation = current_runtime;
-        }
+        // Raise events for the M5StickC Plus as conditions change
+        alert_raise(output.events);
+
+        publish_snapshot(states, frame.timestamp_us);
+        push_telemetry(&frame, output.ref_channel_filtered, output.pressures, states);
+        frame_seq++;
 
-        vTaskDelay(100);
+        // Record time taken by this pass of the measurement loop
+        sys_record_meas_loop_time(time_us_32() - loop_start_us);
+        supervisor_checkin(SUPERVISOR_MEAS);
     }
 }
 
 /**
- * @brief Tank 1 level measurement controlling task creation helper function.
- *        This function creates the tank 1 level measurement controlling task. 
+ * @brief Level measurement controlling task creation helper function.
+ *        This function creates the level measurement controlling task. 
  * @param None. 
  * @retval None. 
  */
-void t1_meas_task_init(void) {
-    xTaskCreate((void *)&t1_meas_task, (const signed char *)"Tank_1_Measurement_Task", 
-        256, NULL, 1, NULL);
+void meas_task_init(void) {
+    xTaskCreateAffinitySet((void *)&meas_task, (const signed char *)"Measurement_Task", 
+        MEAS_TASK_STACK_DEPTH, NULL, MEAS_TASK_PRIORITY, MEAS_TASK_AFFINITY, NULL);
 }
-
-/**
- * @brief Tank 2 level measurement controlling task creation helper function.
- *        This function creates the tank 2 level measurement controlling task. 
- * @param None. 
- * @retval None. 
- */
-void t2_meas_task_init(void) {
-    xTaskCreate((void *)&t2_meas_task, (const signed char *)"Tank_2_Measurement_Task", 
-        256, NULL, 1, NULL);
-}
\ No newline at end of file
@@ -16,68 +16,44 @@
 #include "queue.h"
 #include "semphr.h"
 #include "pico/stdlib.h"
-#include "hardware/adc.h"
 #include "uart.h"
 #include "ctrl.h"
-
-#define VREF 3.0            // ADC reference voltage
-#define RES_LEVELS 4095     // ADC resolution levels (12-bit)
-
-// GPIO pin number declarations
-#define GPIO26 26
-#define GPIO27 27
-#define GPIO28 28
-
-// ADC channel number declarations
-#define CHANNEL_0 0
-#define CHANNEL_1 1
-#define CHANNEL_2 2
-
-// Time between pressure sensor samples for each tank (in sec)
-#define T1_SAMPLE_PERIOD 1
-#define T2_SAMPLE_PERIOD 1
-
-// Tank number declarations
-#define TANK_1 1
-#define TANK_2 2
-
-// Critical water tank levels (i.e., levels which cause tank filling/draining
-// to be initiated). 
-#define TANK_1_MAX_FILL_LEVEL 60.0
-#define TANK_2_MAX_FILL_LEVEL 60.0
-#define TANK_1_MIN_FILL_LEVEL 10.0
-#define TANK_2_MIN_FILL_LEVEL 10.0
-
-// Safe water levels for fill and drain (i.e., when filling, tank will fill
-// to the fill to level, when draining, tank will drain to the drain 
-// to level). 
-#define TANK_1_FILL_TO_LEVEL 20.0
-#define TANK_2_FILL_TO_LEVEL 20.0
-#define TANK_1_DRAIN_TO_LEVEL 50.0
-#define TANK_2_DRAIN_TO_LEVEL 50.0
-
-// Water height offsets for the usable water level range. Everything
-// below these measurements (which are in cm) will be considered as 
-// "empty". 
-#define TANK_1_USABLE_HEIGHT_OFFSET 4.0
-#define TANK_2_USABLE_HEIGHT_OFFSET 2.0
-
-// Pressure sensor zero offsets (determined via experimentation). 
-#define TANK_1_ZERO_PRESSURE_OFFSET 140.183
-#define TANK_2_ZERO_PRESSURE_OFFSET 221.583
-
-// Width of averaging window being used to smooth pressure readings. 
-#define AVG_WINDOW_WIDTH 20
-#define AVG_WINDOW_WIDTH_FLOAT 20.0
+#include "sys.h"
+#include "retain.h"
+#include "meas_pipeline.h"
+#include "sample_source.h"
+#include "alert.h"
+#include "telemetry.h"
+#include "supervisor.h"
+#include "config_store.h"
+
+// Time between ADC frames taken in a burst to fill the averaging windows at 
+// startup (in usec). 
+#define WARM_START_SAMPLE_INTERVAL_US 100
+
+// Struct holding the most recent readings of all tanks, published by the 
+// measurement task every period. Tank n is at index n - 1. 
+struct reading_snapshot {
+    uint32_t seq;
+    uint64_t timestamp_us;
+    float height[NUM_TANKS];
+    bool filling[NUM_TANKS];
+    bool draining[NUM_TANKS];
+    struct tank_analytics analytics[NUM_TANKS];
+};
 
 // Function prototypes 
-void init_t1_adc_pins(void);
-void init_t2_adc_pins(void);
-float calc_pressure(uint16_t pressure_channel_raw, uint16_t offset_channel_raw);
-void check_ctrl_requirements(bool *filling, bool *draining, float height, uint8_t tank);
-void t1_meas_task(void *param);
-void t2_meas_task(void *param);
-void t1_meas_task_init(void);
-void t2_meas_task_init(void);
-
-#endif
\ No newline at end of file
+void meas_adc_init(void);
+void warm_start(struct tank_state *states, struct ref_filter *filter,
+        const struct meas_config *config);
+void reissue_ctrl_state(bool filling, bool draining, uint8_t tank);
+void update_ctrl_enable(struct tank_state *state, uint8_t tank);
+void issue_ctrl_commands(uint8_t commands, uint8_t tank);
+void push_telemetry(const struct adc_frame *frame, uint16_t ref_channel_filtered, 
+        const float *pressures, const struct tank_state *states);
+void publish_snapshot(const struct tank_state *states, uint64_t timestamp_us);
+void meas_get_snapshot(struct reading_snapshot *snapshot);
+void meas_task(void *param);
+void meas_task_init(void);
+
+#endif
@@ -0,0 +1,437 @@
+ /** 
+ **************************************************************
+ * @file meas_pipeline.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Water tank level measurement pipeline file. This file handles 
+ *        functionality specific to turning ADC frames into tank levels 
+ *        (offset/reference correction, pressure calculation and averaging),
+ *        checking water tank level control requirements, and updating the 
+ *        per-tank analytics and alert conditions. It has no hardware or 
+ *        RTOS dependencies, so the exact pipeline run by the measurement 
+ *        task can also be run on the host (e.g. to replay captured frames).
+ *        Control commands and events are returned to the caller rather than
+ *        issued here. 
+ *************************************************************** 
+ */
+
+#include "meas_pipeline.h"
+
+// Default configuration of tanks 3 to NUM_TANKS (tank n's sensor is on 
+// ADC channel n, after the offset/reference channel). 
+#define MEAS_TANK_N_DEFAULTS(tank) {(tank), (tank), AVG_WINDOW_WIDTH, \
+        TANK_N_ZERO_PRESSURE_OFFSET, TANK_N_USABLE_HEIGHT_OFFSET, TANK_N_MAX_FILL_LEVEL, \
+        TANK_N_MIN_FILL_LEVEL, TANK_N_FILL_TO_LEVEL, TANK_N_DRAIN_TO_LEVEL}
+
+// Default configuration (tank n is at index n - 1). 
+const struct meas_config meas_config_defaults = {
+    .tanks = {
+        {TANK_1, CHANNEL_0, AVG_WINDOW_WIDTH, TANK_1_ZERO_PRESSURE_OFFSET, 
+                TANK_1_USABLE_HEIGHT_OFFSET, TANK_1_MAX_FILL_LEVEL, TANK_1_MIN_FILL_LEVEL, 
+                TANK_1_FILL_TO_LEVEL, TANK_1_DRAIN_TO_LEVEL},
+        {TANK_2, CHANNEL_1, AVG_WINDOW_WIDTH, TANK_2_ZERO_PRESSURE_OFFSET, 
+                TANK_2_USABLE_HEIGHT_OFFSET, TANK_2_MAX_FILL_LEVEL, TANK_2_MIN_FILL_LEVEL, 
+                TANK_2_FILL_TO_LEVEL, TANK_2_DRAIN_TO_LEVEL},
+#if (NUM_TANKS >= 3)
+        MEAS_TANK_N_DEFAULTS(3),
+#endif
+#if (NUM_TANKS >= 4)
+        MEAS_TANK_N_DEFAULTS(4),
+#endif
+#if (NUM_TANKS >= 5)
+        MEAS_TANK_N_DEFAULTS(5),
+#endif
+#if (NUM_TANKS >= 6)
+        MEAS_TANK_N_DEFAULTS(6),
+#endif
+#if (NUM_TANKS >= 7)
+        MEAS_TANK_N_DEFAULTS(7),
+#endif
+    },
+    .sample_period_ms = MEAS_SAMPLE_PERIOD * 1000,
+};
+
+/**
+ * @brief Offset/reference channel filter function. This function filters the
+ *        offset/reference channel reading with an exponential moving 
+ *        average, independently of the pressure channels. 
+ * @param filter Pointer to the pipeline's filter state. 
+ * @param ref_channel_raw Decimated offset/reference channel reading. 
+ * @param reset true to reset the filter to the given reading. 
+ * @retval Filtered offset/reference channel reading. 
+ */
+uint16_t HOT_PATH_FUNC(filter_ref_channel)(struct ref_filter *filter, 
+        uint16_t ref_channel_raw, bool reset) {
+    // The filtered value is scaled up by 2^REF_FILTER_SHIFT to keep 
+    // fractional bits. 
+    if (reset) {
+        filter->filtered = (int32_t)ref_channel_raw << REF_FILTER_SHIFT;
+    } else {
+        filter->filtered += (int32_t)ref_channel_raw - (filter->filtered >> REF_FILTER_SHIFT);
+    }
+
+    return (uint16_t)(filter->filtered >> REF_FILTER_SHIFT);
+}
+
+/**
+ * @brief Pressure calculation function. This function calculates pressure
+ *        based on the given decimated ADC readings. 
+ * @param pressure_channel_raw decimated ADC reading for the pressure channel. 
+ * @param offset_channel_raw filtered ADC reading for the offset/reference 
+ *        channel (see REF_CHANNEL_MODE). 
+ * @retval Instantaneous measured pressure. 
+ */
+float HOT_PATH_FUNC(calc_pressure)(uint16_t pressure_channel_raw, uint16_t offset_channel_raw) {
+
+    // Determine the voltage at the ADC pin, corrected for the ADC offset
+    // or for supply drift if enabled (as per the offset/reference channel 
+    // mode). 
+#if (REF_CHANNEL_MODE == REF_CHANNEL_SUPPLY)
+    float corrected_pressure_channel = (offset_channel_raw == 0) ? 0.0 
+            : ((float)pressure_channel_raw * (REF_CHANNEL_NOMINAL / offset_channel_raw)) 
+            * (VREF / OVERSAMPLED_RES_LEVELS);
+#elif (REF_CHANNEL_MODE == REF_CHANNEL_GND)
+    float corrected_pressure_channel = ((float)((int32_t)pressure_channel_raw 
+            - offset_channel_raw)) * (VREF / OVERSAMPLED_RES_LEVELS);
+#else
+    (void)offset_channel_raw;
+    float corrected_pressure_channel = (float)pressure_channel_raw 
+            * (VREF / OVERSAMPLED_RES_LEVELS);
+#endif
+
+    // Determine the voltage at the pressure sensor output (based on the 
+    // resistances used in the voltage divider which steps 5V down to 3V). 
+    float sensor_voltage = (500.0 * corrected_pressure_channel) / 280.0;
+
+    // Calculate pressure with respect to the voltage at the output of the 
+    // sensor. The sensor has a linear output ranging from 0.2V - 4.7V
+    // which corresponds to the pressure range of 0Pa - 10kPa. 
+    float inst_pressure = (((20000.0 / 9.0) * sensor_voltage) - (4000.0 / 9.0));
+
+    return inst_pressure;
+}
+
+/**
+ * @brief Frame pressure calculation function. This function calculates the 
+ *        instantaneous pressure of every tank from an ADC frame in a single
+ *        pass, applying the same filtered offset/reference reading to each. 
+ * @param frame Pointer to ADC frame. 
+ * @param config Pointer to configuration. 
+ * @param ref_channel_filtered Filtered offset/reference channel reading. 
+ * @param pressures Array populated with each tank's pressure (tank n is at 
+ *        index n - 1). 
+ * @retval None. 
+ */
+void HOT_PATH_FUNC(calc_frame_pressures)(const struct adc_frame *frame, 
+        const struct meas_config *config, uint16_t ref_channel_filtered, float *pressures) {
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        pressures[i] = calc_pressure(frame->raw[config->tanks[i].pressure_channel], 
+                ref_channel_filtered);
+    }
+}
+
+/**
+ * @brief Control requirements checker function. This function checks 
+ *        whether a tank needs to start/stop filling or draining, given its
+ *        current filling/draining status and water level. 
+ * @param filling Pointer to filling status (updated as per any command). 
+ * @param draining Pointer to draining status (updated as per any command). 
+ * @param height Water level of the tank. 
+ * @param cfg Pointer to configuration of the tank. 
+ * @retval Commands for the level control task (CTRL_CMD_*). 
+ */
+uint8_t HOT_PATH_FUNC(check_ctrl_requirements)(bool *filling, bool *draining, 
+        float height, const struct tank_cfg *cfg) {
+    uint8_t commands = 0;
+
+    if ((*filling)) {
+        // If the level of water in the tank is equal to or above the fill to
+        // level, signal the level control task to stop filling. 
+        if (height >= cfg->fill_to_level) {
+            commands |= CTRL_CMD_STOP_FILL;
+            (*filling) = false;
+        }
+    } else {
+        // If the level of water in the tank is less than or equal to the 
+        // minimum fill level, signal the level control task to start 
+        // filling. 
+        if (height <= cfg->min_fill_level) {
+            commands |= CTRL_CMD_START_FILL;
+            (*filling) = true;
+        }
+    }
+
+    if ((*draining)) {
+        // If the level of water in the tank is less than or equal to the 
+        // drain to level, signal the level control task to stop draining. 
+        if (height <= cfg->drain_to_level) {
+            commands |= CTRL_CMD_STOP_DRAIN;
+            (*draining) = false;
+        }
+    } else {
+        // If the level of water in the tank is equal to or above the 
+        // maximum fill level, signal the level control task to start 
+        // draining. 
+        if (height >= cfg->max_fill_level) {
+            commands |= CTRL_CMD_START_DRAIN;
+            (*draining) = true;
+        }
+    }
+
+    return commands;
+}
+
+/**
+ * @brief Tank level update function. This function adds a tank's 
+ *        instantaneous pressure to its averaging window, and calculates the 
+ *        tank's water height from the window average. If the window width 
+ *        has been changed, the window is first refilled with the current 
+ *        average at the new width. 
+ * @param state Pointer to tank state. 
+ * @param cfg Pointer to tank configuration. 
+ * @param inst_pressure Instantaneous pressure of the tank. 
+ * @retval None. 
+ */
+void HOT_PATH_FUNC(update_tank_level)(struct tank_state *state, 
+        const struct tank_cfg *cfg, float inst_pressure) {
+    if (state->avg_window_width != cfg->avg_window_width) {
+        for (uint8_t i = 0; i < cfg->avg_window_width; i++) {
+            state->avg_window[i] = state->avg_pressure;
+        }
+
+        state->avg_window_index = 0;
+        state->avg_window_width = cfg->avg_window_width;
+    }
+
+    // Add instantaneous pressure to current index in averaging window,
+    // and increment average window index. 
+    state->avg_window[state->avg_window_index] = inst_pressure;
+    state->avg_window_index++;
+
+    // If average window index exceeds window length, reset index
+    if (state->avg_window_index >= state->avg_window_width) {
+        state->avg_window_index = 0;
+    }
+
+    // Calculate average of samples in averaging window
+    float avg_pressure = 0.0;
+    for (uint8_t i = 0; i < state->avg_window_width; i++) {
+        avg_pressure += state->avg_window[i];
+    }
+    state->avg_pressure = avg_pressure / (float)state->avg_window_width;
+
+    // Calculate height using averaging window, using the equation
+    // derived via manual calibration. 
+    float height = (0.0124 * (state->avg_pressure - cfg->zero_pressure_offset)) + 1.656;
+
+    // If height is lower than the minimum usable water height, consider 
+    // tank to be empty.
+    if (height < cfg->usable_height_offset) {
+        height = 0.0;
+    }
+
+    state->height = height;
+}
+
+/**
+ * @brief Tank alert update function. This function determines which alert 
+ *        conditions currently apply to a tank, and returns the events to be
+ *        raised for conditions which have changed since the last period 
+ *        (level reaching the max/min fill level, either valve opening or 
+ *        closing, and the leak flag being raised). 
+ * @param state Pointer to tank state. 
+ * @param cfg Pointer to tank configuration. 
+ * @retval Events to be raised for the tank (ALERT_TANK_EVENT()). 
+ */
+uint32_t HOT_PATH_FUNC(update_tank_alerts)(struct tank_state *state, 
+        const struct tank_cfg *cfg) {
+    uint32_t conditions = 0;
+
+    // Level conditions stay set until the level has moved back past the 
+    // threshold by the hysteresis, so noise at a threshold isn't reported
+    // as repeated crossings. 
+    float high_threshold = cfg->max_fill_level;
+    if (state->alert_conditions & ALERT_EVENT_HIGH_LEVEL) {
+        high_threshold -= ALERT_LEVEL_HYSTERESIS_CM;
+    }
+
+    float low_threshold = cfg->min_fill_level;
+    if (state->alert_conditions & ALERT_EVENT_LOW_LEVEL) {
+        low_threshold += ALERT_LEVEL_HYSTERESIS_CM;
+    }
+
+    if (state->height >= high_threshold) {
+        conditions |= ALERT_EVENT_HIGH_LEVEL;
+    }
+
+    if (state->height <= low_threshold) {
+        conditions |= ALERT_EVENT_LOW_LEVEL;
+    }
+
+    if (state->analytics.leak) {
+        conditions |= ALERT_EVENT_LEAK;
+    }
+
+    // Level and leak conditions are reported when they start to apply
+    uint32_t events = conditions & ~state->alert_conditions;
+
+    // Valve changes are reported both when a valve opens and closes
+    bool valve_changed = ((state->filling != state->alert_filling) 
+            || (state->draining != state->alert_draining));
+    if (valve_changed) {
+        events |= ALERT_EVENT_VALVE;
+    }
+
+    state->alert_conditions = conditions;
+    state->alert_filling = state->filling;
+    state->alert_draining = state->draining;
+
+    return ALERT_TANK_EVENT(events, cfg->tank);
+}
+
+/**
+ * @brief Widest averaging window function. 
+ * @param config Pointer to configuration. 
+ * @retval Widest averaging window of any tank (i.e., the number of frames 
+ *         needed to prime every window). 
+ */
+uint8_t meas_config_max_window_width(const struct meas_config *config) {
+    uint8_t width = 0;
+
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        if (config->tanks[i].avg_window_width > width) {
+            width = config->tanks[i].avg_window_width;
+        }
+    }
+
+    return width;
+}
+
+/**
+ * @brief Pipeline initialiser function. This function resets the state of 
+ *        every tank, and the offset/reference filter. 
+ * @param states Array of tank states. 
+ * @param filter Pointer to the offset/reference filter state. 
+ * @param config Pointer to configuration. 
+ * @retval None. 
+ */
+void meas_pipeline_init(struct tank_state *states, struct ref_filter *filter, 
+        const struct meas_config *config) {
+    filter->filtered = 0;
+
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        struct tank_state *state = &states[i];
+
+        for (uint8_t j = 0; j < AVG_WINDOW_MAX_WIDTH; j++) {
+            state->avg_window[j] = 0.0;
+        }
+
+        state->avg_window_index = 0;
+        state->avg_window_width = config->tanks[i].avg_window_width;
+        state->sample_period_ms = config->sample_period_ms;
+        state->avg_pressure = 0.0;
+        state->height = 0.0;
+        state->filling = false;
+        state->draining = false;
+        state->ctrl_on = false;
+        state->restore_hold_periods = 0;
+        state->alert_conditions = 0;
+        state->alert_filling = false;
+        state->alert_draining = false;
+
+        analytics_init(&state->analytics_state, config->sample_period_ms / 1000.0f);
+    }
+}
+
+/**
+ * @brief Pipeline priming function. This function fills one slot of every
+ *        tank's averaging window from an ADC frame, so averages aren't 
+ *        dragged towards zero while the windows fill. It is called for 
+ *        frames 0 to AVG_WINDOW_WIDTH - 1 before the first frame is 
+ *        processed (frame 0 also resets the offset/reference filter). 
+ *        Frames past a tank's window width (see 
+ *        meas_config_max_window_width()) leave its window as it is. 
+ * @param states Array of tank states. 
+ * @param filter Pointer to the offset/reference filter state. 
+ * @param config Pointer to configuration. 
+ * @param frame Pointer to ADC frame. 
+ * @param frame_index Index of the frame (i.e., the window slot filled). 
+ * @param restored Array denoting tanks whose windows were restored from 
+ *        retained state (which are left as they are), or NULL. 
+ * @retval None. 
+ */
+void meas_pipeline_prime(struct tank_state *states, struct ref_filter *filter, 
+        const struct meas_config *config, const struct adc_frame *frame, 
+        uint8_t frame_index, const bool *restored) {
+    float pressures[NUM_TANKS];
+
+    uint16_t ref_channel_filtered = filter_ref_channel(filter, frame->raw[REF_CHANNEL], 
+            (frame_index == 0));
+    calc_frame_pressures(frame, config, ref_channel_filtered, pressures);
+
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        if (((restored == NULL) || !restored[i]) 
+                && (frame_index < states[i].avg_window_width)) {
+            states[i].avg_window[frame_index] = pressures[i];
+        }
+    }
+}
+
+/**
+ * @brief Pipeline processing function. This function processes one ADC 
+ *        frame: the offset/reference channel is filtered, every tank's 
+ *        level is updated, control requirements are checked for tanks with
+ *        control on, and analytics and alert conditions are updated. If the 
+ *        sample period has been changed, analytics are restarted at the new 
+ *        period. 
+ * @param states Array of tank states (ctrl_on must be up to date). 
+ * @param filter Pointer to the offset/reference filter state. 
+ * @param config Pointer to configuration (only read, and only for the 
+ *        duration of the call). 
+ * @param frame Pointer to ADC frame. 
+ * @param output Pointer to struct populated with the results, including the
+ *        control commands to be issued and events to be raised. 
+ * @retval None. 
+ */
+void HOT_PATH_FUNC(meas_pipeline_process)(struct tank_state *states, 
+        struct ref_filter *filter, const struct meas_config *config, 
+        const struct adc_frame *frame, struct pipeline_output *output) {
+    // Filter the offset/reference channel shared by all tanks, and 
+    // calculate instantaneous pressures of all tanks as per the frame. 
+    output->ref_channel_filtered = filter_ref_channel(filter, frame->raw[REF_CHANNEL], false);
+    calc_frame_pressures(frame, config, output->ref_channel_filtered, output->pressures);
+    output->events = 0;
+
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        struct tank_state *state = &states[i];
+        const struct tank_cfg *cfg = &config->tanks[i];
+
+        if (state->sample_period_ms != config->sample_period_ms) {
+            analytics_init(&state->analytics_state, config->sample_period_ms / 1000.0f);
+            state->sample_period_ms = config->sample_period_ms;
+        }
+
+        update_tank_level(state, cfg, output->pressures[i]);
+        output->ctrl_commands[i] = 0;
+
+        // Check control requirements if control is on. 
+        if (state->ctrl_on) {
+            output->ctrl_commands[i] = check_ctrl_requirements(&state->filling, 
+                    &state->draining, state->height, cfg);
+
+        } else if (state->restore_hold_periods == 0) {
+            // If control is off, neither filling or draining can occur. 
+            state->filling = false;
+            state->draining = false;
+        } else {
+            state->restore_hold_periods--;
+        }
+
+        // Update rate, forecasts and leak detection with the new height
+        analytics_update(&state->analytics_state, state->height, state->draining, 
+                cfg->max_fill_level, &state->analytics);
+
+        // Determine events for the M5StickC Plus as conditions change
+        output->events |= update_tank_alerts(state, cfg);
+    }
+}
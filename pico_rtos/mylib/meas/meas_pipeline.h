@@ -0,0 +1,236 @@
+ /**
+ **************************************************************
+ * @file meas_pipeline.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the water tank level measurement pipeline.
+ ***************************************************************
+ */
+
+#ifndef MEAS_PIPELINE_H
+#define MEAS_PIPELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "hot_path.h"
+#include "analytics.h"
+#include "alert_events.h"
+
+#define VREF 3.0            // ADC reference voltage
+#define RES_LEVELS 4095     // ADC resolution levels (12-bit)
+
+// Number of extra bits of resolution gained by oversampling each ADC
+// reading. Each reading accumulates 4^OVERSAMPLE_EXTRA_BITS samples taken
+// at the full ADC rate, and is decimated to 12 + OVERSAMPLE_EXTRA_BITS
+// bits (at most 4 extra bits, so decimated readings fit in 16 bits).
+#define OVERSAMPLE_EXTRA_BITS 4
+#define OVERSAMPLE_NUM_SAMPLES (1 << (2 * OVERSAMPLE_EXTRA_BITS))
+
+// Resolution levels of decimated ADC readings
+#define OVERSAMPLED_RES_LEVELS (RES_LEVELS << OVERSAMPLE_EXTRA_BITS)
+
+// Number of tanks (set by the NUM_TANKS CMake option). Tanks 1 and 2 are
+// on ADC channels 0 and 1, and tank n from 3 on is on channel n (after the
+// offset/reference channel), so more than 2 tanks need the MCP3208 sample
+// source (see sample_source.h). With the reference channel, an MCP3208's 8
+// channels take at most 7 tanks (tank numbers are sent as a single digit,
+// and the event and valve state masks have 4 bits per tank).
+#ifndef NUM_TANKS
+#define NUM_TANKS 2
+#endif
+
+_Static_assert((NUM_TANKS >= 2) && (NUM_TANKS <= 7), "NUM_TANKS must be 2 to 7");
+
+// ADC channel number declarations
+#define CHANNEL_0 0
+#define CHANNEL_1 1
+#define CHANNEL_2 2
+
+// Number of ADC channels sampled in each ADC frame (channels 0 to
+// ADC_FRAME_CHANNELS - 1 are sampled in round-robin), one per tank and the
+// offset/reference channel.
+#define ADC_FRAME_CHANNELS (NUM_TANKS + 1)
+
+// ADC channel used as the offset/reference channel, shared by all tanks.
+#define REF_CHANNEL CHANNEL_2
+
+// Offset/reference channel modes. In REF_CHANNEL_NONE mode pressure
+// channels are used as read (the channel is still filtered and reported).
+// In REF_CHANNEL_GND mode the channel is connected to GND and its reading
+// (the ADC offset) is subtracted from each pressure channel. In
+// REF_CHANNEL_SUPPLY mode the channel is connected to the sensor supply
+// through the same divider as the sensor outputs, and pressure channels are
+// scaled ratiometrically to the nominal supply. The zero pressure offsets
+// were calibrated without correction, so they must be recalibrated before
+// either correction is used (each shifts every pressure by a constant).
+#define REF_CHANNEL_NONE 0
+#define REF_CHANNEL_GND 1
+#define REF_CHANNEL_SUPPLY 2
+
+#ifndef REF_CHANNEL_MODE
+#define REF_CHANNEL_MODE REF_CHANNEL_NONE
+#endif
+
+// Nominal decimated reading of the reference channel in REF_CHANNEL_SUPPLY
+// mode (5V sensor supply through the 500:280 divider).
+#define REF_CHANNEL_NOMINAL ((5.0 * 280.0 / 500.0) / VREF * OVERSAMPLED_RES_LEVELS)
+
+// Shift used by the offset/reference channel's exponential moving average
+// filter (each frame moves the filtered value 1/2^n of the way to the new
+// reading).
+#define REF_FILTER_SHIFT 3
+
+// Time between ADC frames (in sec). This is the default, the period can be
+// changed at runtime (see struct meas_config).
+#define MEAS_SAMPLE_PERIOD 1
+
+// Limits of the time between ADC frames set at runtime (in msec). The
+// measurement task's deadline must hold at the longest period.
+#define MEAS_MIN_SAMPLE_PERIOD_MSEC 100
+#define MEAS_MAX_SAMPLE_PERIOD_MSEC 1000
+
+// Tank number declarations. Only tanks 1 and 2 have fill/drain valves and
+// level control tasks, further tanks are monitored only.
+#define TANK_1 1
+#define TANK_2 2
+
+// Whether a tank has fill/drain valves (and so level control).
+#define TANK_HAS_VALVES(tank) ((tank) <= TANK_2)
+
+// Critical water tank levels (i.e., levels which cause tank filling/draining
+// to be initiated).
+#define TANK_1_MAX_FILL_LEVEL 60.0
+#define TANK_2_MAX_FILL_LEVEL 60.0
+#define TANK_1_MIN_FILL_LEVEL 10.0
+#define TANK_2_MIN_FILL_LEVEL 10.0
+
+// Safe water levels for fill and drain (i.e., when filling, tank will fill
+// to the fill to level, when draining, tank will drain to the drain
+// to level).
+#define TANK_1_FILL_TO_LEVEL 20.0
+#define TANK_2_FILL_TO_LEVEL 20.0
+#define TANK_1_DRAIN_TO_LEVEL 50.0
+#define TANK_2_DRAIN_TO_LEVEL 50.0
+
+// Water height offsets for the usable water level range. Everything
+// below these measurements (which are in cm) will be considered as
+// "empty".
+#define TANK_1_USABLE_HEIGHT_OFFSET 4.0
+#define TANK_2_USABLE_HEIGHT_OFFSET 2.0
+
+// Pressure sensor zero offsets (determined via experimentation).
+#define TANK_1_ZERO_PRESSURE_OFFSET 140.183
+#define TANK_2_ZERO_PRESSURE_OFFSET 221.583
+
+// Defaults for tanks 3 to NUM_TANKS, whose sensors haven't been calibrated
+// (the zero pressure offset must be set at runtime, see config.h).
+#define TANK_N_MAX_FILL_LEVEL 60.0
+#define TANK_N_MIN_FILL_LEVEL 10.0
+#define TANK_N_FILL_TO_LEVEL 20.0
+#define TANK_N_DRAIN_TO_LEVEL 50.0
+#define TANK_N_USABLE_HEIGHT_OFFSET 0.0
+#define TANK_N_ZERO_PRESSURE_OFFSET 0.0
+
+// Width of averaging window being used to smooth pressure readings. Each
+// reading is already oversampled, so the window only needs to smooth out
+// disturbances such as ripples on the water surface. This is the default,
+// any width up to AVG_WINDOW_MAX_WIDTH can be set at runtime.
+#define AVG_WINDOW_WIDTH 5
+#define AVG_WINDOW_MAX_WIDTH 16
+
+// Number of sample periods for which valve states restored after a watchdog
+// reset are held while waiting for control to be re-enabled.
+#define MEAS_RESTORE_HOLD_PERIODS 5
+
+// Level control commands issued by the control requirements check.
+#define CTRL_CMD_START_FILL (1 << 0)
+#define CTRL_CMD_STOP_FILL (1 << 1)
+#define CTRL_CMD_START_DRAIN (1 << 2)
+#define CTRL_CMD_STOP_DRAIN (1 << 3)
+
+// Struct holding one ADC frame (a decimated reading of every channel).
+struct adc_frame {
+    uint64_t timestamp_us;
+    uint16_t raw[ADC_FRAME_CHANNELS];
+};
+
+// Struct holding configuration of a tank.
+struct tank_cfg {
+    uint8_t tank;
+    uint8_t pressure_channel;
+    uint8_t avg_window_width;
+    float zero_pressure_offset;
+    float usable_height_offset;
+    float max_fill_level;
+    float min_fill_level;
+    float fill_to_level;
+    float drain_to_level;
+};
+
+// Struct holding the configuration the pipeline is run with (tank n is at
+// index n - 1). The pipeline only reads it, so it can be swapped for a new
+// configuration between frames.
+struct meas_config {
+    struct tank_cfg tanks[NUM_TANKS];
+    uint32_t sample_period_ms;
+};
+
+// Struct holding the measurement and control state of a tank.
+struct tank_state {
+    float avg_window[AVG_WINDOW_MAX_WIDTH];
+    uint8_t avg_window_index;
+    uint8_t avg_window_width;
+    uint32_t sample_period_ms;
+    float avg_pressure;
+    float height;
+    bool filling;
+    bool draining;
+    bool ctrl_on;
+    uint8_t restore_hold_periods;
+    struct tank_analytics_state analytics_state;
+    struct tank_analytics analytics;
+    uint32_t alert_conditions;
+    bool alert_filling;
+    bool alert_draining;
+};
+
+// Struct holding the state of the offset/reference channel filter (one per
+// pipeline, shared by its tanks).
+struct ref_filter {
+    int32_t filtered;                   // Scaled up by 2^REF_FILTER_SHIFT
+};
+
+// Struct holding the results of processing one ADC frame. Tank n is at
+// index n - 1.
+struct pipeline_output {
+    uint16_t ref_channel_filtered;
+    float pressures[NUM_TANKS];
+    uint8_t ctrl_commands[NUM_TANKS];   // CTRL_CMD_* bits
+    uint32_t events;                    // ALERT_TANK_EVENT() bits
+};
+
+// Default configuration (used until a configuration is loaded).
+extern const struct meas_config meas_config_defaults;
+
+// Function prototypes
+uint16_t filter_ref_channel(struct ref_filter *filter, uint16_t ref_channel_raw, bool reset);
+float calc_pressure(uint16_t pressure_channel_raw, uint16_t offset_channel_raw);
+void calc_frame_pressures(const struct adc_frame *frame, const struct meas_config *config,
+        uint16_t ref_channel_filtered, float *pressures);
+uint8_t check_ctrl_requirements(bool *filling, bool *draining, float height,
+        const struct tank_cfg *cfg);
+void update_tank_level(struct tank_state *state, const struct tank_cfg *cfg,
+        float inst_pressure);
+uint32_t update_tank_alerts(struct tank_state *state, const struct tank_cfg *cfg);
+uint8_t meas_config_max_window_width(const struct meas_config *config);
+void meas_pipeline_init(struct tank_state *states, struct ref_filter *filter,
+        const struct meas_config *config);
+void meas_pipeline_prime(struct tank_state *states, struct ref_filter *filter,
+        const struct meas_config *config, const struct adc_frame *frame,
+        uint8_t frame_index, const bool *restored);
+void meas_pipeline_process(struct tank_state *states, struct ref_filter *filter,
+        const struct meas_config *config, const struct adc_frame *frame,
+        struct pipeline_output *output);
+
+#endif
@@ -0,0 +1,47 @@
+ /**
+ **************************************************************
+ * @file sample_source.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the ADC frame sample sources. A sample source
+ *        fills ADC frames (see meas_pipeline.h) from some ADC, so the
+ *        measurement task doesn't depend on which ADC the sensors are on.
+ ***************************************************************
+ */
+
+#ifndef SAMPLE_SOURCE_H
+#define SAMPLE_SOURCE_H
+
+#include <stdint.h>
+#include "meas_pipeline.h"
+
+// Sample source selections (set by the SAMPLE_SOURCE CMake option).
+// SAMPLE_SOURCE_ADC samples the RP2040's ADC (GPIO26-28),
+// SAMPLE_SOURCE_MCP3208 scans an external MCP3208 over SPI (see
+// mylib/mcp3208).
+#define SAMPLE_SOURCE_ADC 0
+#define SAMPLE_SOURCE_MCP3208 1
+
+#ifndef SAMPLE_SOURCE
+#define SAMPLE_SOURCE SAMPLE_SOURCE_ADC
+#endif
+
+// Struct holding a sample source. The init function is called once before
+// the scheduler starts, and the pin init function from the measurement task
+// before the first frame. The first frame may be taken settle_ms after the
+// pins are initialised. Every frame is filled in the same format (channels
+// 0 to ADC_FRAME_CHANNELS - 1, decimated to OVERSAMPLED_RES_LEVELS).
+struct sample_source {
+    const char *name;
+    uint8_t num_channels;               // Channels the source converts
+    uint32_t settle_ms;
+    void (*init)(void);
+    void (*init_pins)(void);
+    void (*sample_frame)(struct adc_frame *frame);
+};
+
+// Sample sources
+extern const struct sample_source adc_sample_source;
+extern const struct sample_source mcp3208_sample_source;
+
+#endif
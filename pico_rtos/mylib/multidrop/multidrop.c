@@ -0,0 +1,197 @@
+ /**
+ **************************************************************
+ * @file multidrop.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Multi-drop bus framing file. This file handles functionality
+ *        specific to addressing requests to one of many nodes sharing a
+ *        half-duplex (RS-485 style) serial line: parsing and writing request
+ *        frames and reply prefixes, and the line timing which keeps the
+ *        stations from driving the line at the same time. It has no
+ *        hardware or RTOS dependencies, so the host gateway and stand-in
+ *        node share it with the firmware.
+ ***************************************************************
+ */
+
+#include "multidrop.h"
+
+// Hex digits, upper case.
+static const char multidrop_hex_digits[] = "0123456789ABCDEF";
+
+/**
+ * @brief Hex digit parse function.
+ * @param c Character.
+ * @retval Value of the digit, or -1 if not an upper case hex digit.
+ */
+static int8_t multidrop_hex_value(char c) {
+    if ((c >= '0') && (c <= '9')) {
+        return c - '0';
+    } else if ((c >= 'A') && (c <= 'F')) {
+        return (c - 'A') + 10;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief ID write function. This function writes a node ID as two hex
+ *        digits.
+ * @param out Buffer written to (at least 2 chars).
+ * @param id Node ID.
+ * @retval None.
+ */
+static void multidrop_put_id(char *out, uint8_t id) {
+    out[0] = multidrop_hex_digits[id >> 4];
+    out[1] = multidrop_hex_digits[id & 0xF];
+}
+
+/**
+ * @brief Parser initialise function.
+ * @param parser Pointer to the parser.
+ * @retval None.
+ */
+void multidrop_parser_init(struct multidrop_parser *parser) {
+    parser->state = MULTIDROP_PARSE_IDLE;
+    parser->id = 0;
+    parser->num_commands = 0;
+}
+
+/**
+ * @brief Request frame parse function. This function adds one received
+ *        character to the parser. Characters outside a frame (e.g. other
+ *        nodes' replies) are ignored, a start character always begins a new
+ *        frame, and malformed or overlong frames are discarded.
+ * @param parser Pointer to the parser.
+ * @param c Received character.
+ * @retval true if the character completed a frame (whose ID and commands
+ *         are left in the parser), false otherwise.
+ */
+bool multidrop_parse(struct multidrop_parser *parser, char c) {
+    int8_t digit;
+
+    if (c == MULTIDROP_START) {
+        parser->state = MULTIDROP_PARSE_ID_HIGH;
+        parser->num_commands = 0;
+        return false;
+    }
+
+    switch (parser->state) {
+        case MULTIDROP_PARSE_ID_HIGH:
+        case MULTIDROP_PARSE_ID_LOW:
+            digit = multidrop_hex_value(c);
+            if (digit < 0) {
+                parser->state = MULTIDROP_PARSE_IDLE;
+            } else if (parser->state == MULTIDROP_PARSE_ID_HIGH) {
+                parser->id = digit << 4;
+                parser->state = MULTIDROP_PARSE_ID_LOW;
+            } else {
+                parser->id |= digit;
+                parser->state = MULTIDROP_PARSE_COMMANDS;
+            }
+            return false;
+        case MULTIDROP_PARSE_COMMANDS:
+            if (c == MULTIDROP_END) {
+                parser->state = MULTIDROP_PARSE_IDLE;
+                return (parser->num_commands > 0);
+            } else if (parser->num_commands >= MULTIDROP_MAX_COMMANDS) {
+                parser->state = MULTIDROP_PARSE_IDLE;
+            } else {
+                parser->commands[parser->num_commands++] = c;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Request frame write function.
+ * @param out Buffer written to (MULTIDROP_REQUEST_LEN chars).
+ * @param id Node ID (or MULTIDROP_BROADCAST_ID).
+ * @param commands Request characters.
+ * @param num_commands Number of request characters (at most
+ *        MULTIDROP_MAX_COMMANDS).
+ * @retval Length of the frame (excluding the terminating null).
+ */
+size_t multidrop_request(char *out, uint8_t id, const char *commands, size_t num_commands) {
+    size_t len = 0;
+
+    out[len++] = MULTIDROP_START;
+    multidrop_put_id(&out[len], id);
+    len += 2;
+
+    for (size_t i = 0; (i < num_commands) && (i < MULTIDROP_MAX_COMMANDS); i++) {
+        out[len++] = commands[i];
+    }
+
+    out[len++] = MULTIDROP_END;
+    out[len] = '\0';
+    return len;
+}
+
+/**
+ * @brief Reply prefix write function.
+ * @param out Buffer written to (MULTIDROP_PREFIX_LEN chars, not null
+ *        terminated).
+ * @param id ID of the replying node.
+ * @retval Length of the prefix.
+ */
+size_t multidrop_reply_prefix(char *out, uint8_t id) {
+    out[0] = MULTIDROP_REPLY_START;
+    multidrop_put_id(&out[1], id);
+    return MULTIDROP_PREFIX_LEN;
+}
+
+/**
+ * @brief Reply ID parse function.
+ * @param reply Received reply (null terminated).
+ * @param id Pointer to the ID of the node which sent the reply.
+ * @retval true if the reply has a valid prefix, false otherwise.
+ */
+bool multidrop_reply_id(const char *reply, uint8_t *id) {
+    if (reply[0] != MULTIDROP_REPLY_START) {
+        return false;
+    }
+
+    int8_t high = multidrop_hex_value(reply[1]);
+    int8_t low = (high < 0) ? -1 : multidrop_hex_value(reply[2]);
+    if (low < 0) {
+        return false;
+    }
+
+    *id = (high << 4) | low;
+    return true;
+}
+
+/**
+ * @brief Character time function.
+ * @param baud Baud rate.
+ * @retval Time to send one character, in usec (rounded up).
+ */
+uint32_t multidrop_char_us(uint32_t baud) {
+    return ((MULTIDROP_BITS_PER_CHAR * 1000000) + baud - 1) / baud;
+}
+
+/**
+ * @brief Turnaround time function.
+ * @param baud Baud rate.
+ * @retval Minimum gap between receiving the last character of a frame and
+ *         driving the line, in usec.
+ */
+uint32_t multidrop_turnaround_us(uint32_t baud) {
+    return MULTIDROP_TURNAROUND_CHARS * multidrop_char_us(baud);
+}
+
+/**
+ * @brief Transaction time function. This function gives the time one
+ *        request frame and its replies occupy the line: both frames, and a
+ *        turnaround before each (not counting the node's processing time).
+ * @param baud Baud rate.
+ * @param request_len Length of the request frame.
+ * @param reply_len Total length of the replies.
+ * @retval Transaction time, in usec.
+ */
+uint32_t multidrop_transaction_us(uint32_t baud, size_t request_len, size_t reply_len) {
+    return ((request_len + reply_len) * multidrop_char_us(baud))
+            + (2 * multidrop_turnaround_us(baud));
+}
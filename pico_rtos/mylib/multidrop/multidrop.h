@@ -0,0 +1,77 @@
+ /**
+ **************************************************************
+ * @file multidrop.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the multi-drop bus framing.
+ ***************************************************************
+ */
+
+#ifndef MULTIDROP_H
+#define MULTIDROP_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Frame characters. A request frame is "@<id><commands>!", with the node ID
+// in two upper case hex digits and one or more request characters (e.g.
+// "@07RAES!"). The addressed node answers each command in order, with its
+// usual reply prefixed by "#<id>" (e.g. "#07T1=25.3T2=40.1!"). Replies
+// never contain MULTIDROP_START, so nodes can ignore each other's replies.
+#define MULTIDROP_START '@'
+#define MULTIDROP_REPLY_START '#'
+#define MULTIDROP_END '!'
+
+// Node IDs. Frames sent to MULTIDROP_BROADCAST_ID are acted on by every
+// node, and never answered.
+#define MULTIDROP_MIN_ID 0x01
+#define MULTIDROP_MAX_ID 0xFE
+#define MULTIDROP_BROADCAST_ID 0xFF
+
+// Latch command. Broadcast, it makes every node copy its latest readings at
+// the same moment. Addressed, it is answered with the latched readings, as
+// "L" followed by the fields of a readings reply (e.g. "#07LT1=25.3T2=40.1!"),
+// which releases the latch. A node with no latch (it missed the broadcast, 
+// or has already answered for it) answers "L!" ("#07L!").
+#define MULTIDROP_LATCH 'L'
+
+// Maximum number of commands in one frame.
+#define MULTIDROP_MAX_COMMANDS 8
+
+// Length of a reply prefix ("#07"), and buffer size (including the
+// terminating null) of the longest request frame.
+#define MULTIDROP_PREFIX_LEN 3
+#define MULTIDROP_REQUEST_LEN (MULTIDROP_PREFIX_LEN + MULTIDROP_MAX_COMMANDS + 2)
+
+// Bits on the line per character (8N1), and the minimum gap a station
+// leaves after the last character it received before driving the line, in
+// character times. The gap covers the other end releasing its driver.
+#define MULTIDROP_BITS_PER_CHAR 10
+#define MULTIDROP_TURNAROUND_CHARS 2
+
+// Request frame parser states.
+#define MULTIDROP_PARSE_IDLE 0
+#define MULTIDROP_PARSE_ID_HIGH 1
+#define MULTIDROP_PARSE_ID_LOW 2
+#define MULTIDROP_PARSE_COMMANDS 3
+
+// Struct holding a request frame parser, and the last frame parsed.
+struct multidrop_parser {
+    uint8_t state;
+    uint8_t id;
+    uint8_t num_commands;
+    char commands[MULTIDROP_MAX_COMMANDS];
+};
+
+// Function prototypes
+void multidrop_parser_init(struct multidrop_parser *parser);
+bool multidrop_parse(struct multidrop_parser *parser, char c);
+size_t multidrop_request(char *out, uint8_t id, const char *commands, size_t num_commands);
+size_t multidrop_reply_prefix(char *out, uint8_t id);
+bool multidrop_reply_id(const char *reply, uint8_t *id);
+uint32_t multidrop_char_us(uint32_t baud);
+uint32_t multidrop_turnaround_us(uint32_t baud);
+uint32_t multidrop_transaction_us(uint32_t baud, size_t request_len, size_t reply_len);
+
+#endif
@@ -0,0 +1,184 @@
+ /**
+ **************************************************************
+ * @file power.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Low power idle driver file. This file handles sleeping the cores
+ *        while there is nothing to run (when enabled by the LOW_POWER_IDLE
+ *        CMake option). The tick core stops the kernel tick while idle, and
+ *        sleeps until a hardware timer alarm at the next tick the kernel
+ *        needs (or until any other interrupt). The other core has no tick,
+ *        and sleeps from the idle hook until an interrupt. Peripheral
+ *        clocks which aren't needed are gated while both cores sleep.
+ ***************************************************************
+ */
+
+#include "power.h"
+
+// Statistics (each core updates only its own counters).
+static volatile uint32_t wakeups[configNUM_CORES];
+static volatile uint32_t slept_us[configNUM_CORES];
+
+// Hardware alarm which wakes the tick core, and the system clock in cycles
+// per usec (the kernel tick is counted in system clock cycles).
+static uint wake_alarm;
+static uint32_t cycles_per_us;
+
+/**
+ * @brief Wake alarm callback. The alarm only has to wake the tick core, so
+ *        nothing is done here.
+ * @param alarm_num Hardware alarm which fired.
+ * @retval None.
+ */
+static void power_wake_alarm_cb(uint alarm_num) {
+    (void)alarm_num;
+}
+
+/**
+ * @brief Low power idle initialise function. This function claims the wake
+ *        alarm and selects the clocks gated in sleep. It does nothing unless
+ *        low power idle is enabled.
+ * @param None.
+ * @retval None.
+ */
+void power_init(void) {
+    if (!LOW_POWER_IDLE) {
+        return;
+    }
+
+    wake_alarm = (uint)hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(wake_alarm, &power_wake_alarm_cb);
+    cycles_per_us = clock_get_hz(clk_sys) / 1000000;
+
+    // Only applies while both cores are in deep sleep
+    clocks_hw->sleep_en0 = ~POWER_SLEEP_GATED_EN0;
+    clocks_hw->sleep_en1 = ~POWER_SLEEP_GATED_EN1;
+}
+
+/**
+ * @brief Sleep function. This function sleeps the calling core until an
+ *        interrupt, in deep sleep so gated clocks stop once both cores
+ *        sleep. An interrupt which is already pending ends the sleep at
+ *        once, even if interrupts are disabled.
+ * @param None.
+ * @retval None.
+ */
+static void power_sleep(void) {
+    scb_hw->scr |= M0PLUS_SCR_SLEEPDEEP_BITS;
+    __dsb();
+    __wfi();
+    scb_hw->scr &= ~M0PLUS_SCR_SLEEPDEEP_BITS;
+}
+
+/**
+ * @brief Tickless idle function. This function is called by the kernel's
+ *        idle task (with the scheduler suspended) when no task is expected
+ *        to run for at least configEXPECTED_IDLE_TIME_BEFORE_SLEEP ticks.
+ *        The tick is stopped and the core sleeps until the last of those
+ *        ticks, or until another interrupt. The ticks which passed are then
+ *        stepped, and the tick is restarted in phase with its boundaries.
+ *        Only the tick core stops its tick.
+ * @param expected_idle_ticks Ticks until the kernel next has a task to run.
+ * @retval None.
+ */
+void power_suppress_ticks_and_sleep(TickType_t expected_idle_ticks) {
+    if (get_core_num() != configTICK_CORE) {
+        return;
+    }
+
+    if (expected_idle_ticks > POWER_MAX_SUPPRESSED_TICKS) {
+        expected_idle_ticks = POWER_MAX_SUPPRESSED_TICKS;
+    }
+
+    // Interrupts are disabled until the tick is restarted. Any which come
+    // in the meantime still end the sleep.
+    uint32_t interrupts = save_and_disable_interrupts();
+
+    if (eTaskConfirmSleepModeStatus() == eAbortSleep) {
+        restore_interrupts(interrupts);
+        return;
+    }
+
+    // Stop the tick, and find when its next boundary would have been
+    uint32_t tick_cycles = systick_hw->rvr + 1;
+    uint64_t tick_us = tick_cycles / cycles_per_us;
+    systick_hw->csr &= ~M0PLUS_SYST_CSR_ENABLE_BITS;
+    uint64_t start_us = time_us_64();
+    uint64_t next_tick_us = start_us + (systick_hw->cvr / cycles_per_us);
+
+    // Sleep until the last expected idle tick (the alarm isn't set if that
+    // has already passed)
+    uint64_t wake_us = next_tick_us + ((uint64_t)(expected_idle_ticks - 1) * tick_us);
+    bool sleeping = !hardware_alarm_set_target(wake_alarm, from_us_since_boot(wake_us));
+    if (sleeping) {
+        power_sleep();
+    }
+    hardware_alarm_cancel(wake_alarm);
+
+    // Count the tick boundaries passed while asleep
+    uint64_t now_us = time_us_64();
+    TickType_t ticks = 0;
+    if (now_us >= next_tick_us) {
+        ticks = 1 + (TickType_t)((now_us - next_tick_us) / tick_us);
+        next_tick_us += ticks * tick_us;
+    }
+
+    // The kernel must process the last expected idle tick itself (to run
+    // the task due then), so that tick is left to the tick interrupt, which
+    // is restarted to come at once
+    if (ticks >= expected_idle_ticks) {
+        ticks = expected_idle_ticks - 1;
+        next_tick_us = now_us;
+    }
+
+    // Restart the tick at the next boundary, then carry on with the usual
+    // tick period
+    uint32_t cycles = (uint32_t)(next_tick_us - now_us) * cycles_per_us;
+    cycles = (cycles < 2) ? 2 : ((cycles > tick_cycles) ? tick_cycles : cycles);
+    systick_hw->rvr = cycles - 1;
+    systick_hw->cvr = 0;
+    systick_hw->csr |= M0PLUS_SYST_CSR_ENABLE_BITS;
+    systick_hw->rvr = tick_cycles - 1;
+
+    vTaskStepTick(ticks);
+
+    if (sleeping) {
+        wakeups[configTICK_CORE]++;
+        slept_us[configTICK_CORE] += (uint32_t)(now_us - start_us);
+    }
+
+    restore_interrupts(interrupts);
+}
+
+/**
+ * @brief Idle hook. This hook is called by the kernel's idle task on each
+ *        pass of its loop. The core which has no tick sleeps until an
+ *        interrupt (e.g. the other core asking it to run a task).
+ * @param None.
+ * @retval None.
+ */
+void vApplicationIdleHook(void) {
+    uint core = get_core_num();
+
+    if (core == configTICK_CORE) {
+        return;
+    }
+
+    uint64_t start_us = time_us_64();
+    power_sleep();
+
+    wakeups[core]++;
+    slept_us[core] += (uint32_t)(time_us_64() - start_us);
+}
+
+/**
+ * @brief Low power idle statistics getter function.
+ * @param stats Pointer to struct which statistics are copied into.
+ * @retval None.
+ */
+void power_get_stats(struct power_stats *stats) {
+    for (uint8_t core = 0; core < configNUM_CORES; core++) {
+        stats->wakeups[core] = wakeups[core];
+        stats->sleep_us[core] = slept_us[core];
+    }
+}
@@ -0,0 +1,53 @@
+ /**
+ **************************************************************
+ * @file power.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the low power idle driver.
+ ***************************************************************
+ */
+
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdio.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/clocks.h"
+#include "hardware/structs/scb.h"
+#include "hardware/structs/systick.h"
+
+// Clocks gated while both cores sleep. These peripherals are unused, or (as
+// with the ADC) only used while a core is awake. The timer (which wakes the
+// tick core), watchdog, UARTs, USB, DMA and SPI 1 (the MCP3208 scan), and the
+// memories and bus fabric, keep running.
+#define POWER_SLEEP_GATED_EN0 (CLOCKS_SLEEP_EN0_CLK_SYS_ADC_BITS \
+        | CLOCKS_SLEEP_EN0_CLK_ADC_ADC_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_PIO0_BITS \
+        | CLOCKS_SLEEP_EN0_CLK_SYS_PIO1_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_PWM_BITS \
+        | CLOCKS_SLEEP_EN0_CLK_SYS_I2C0_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_I2C1_BITS \
+        | CLOCKS_SLEEP_EN0_CLK_SYS_SPI0_BITS | CLOCKS_SLEEP_EN0_CLK_PERI_SPI0_BITS \
+        | CLOCKS_SLEEP_EN0_CLK_SYS_RTC_BITS | CLOCKS_SLEEP_EN0_CLK_RTC_RTC_BITS \
+        | CLOCKS_SLEEP_EN0_CLK_SYS_JTAG_BITS | CLOCKS_SLEEP_EN0_CLK_SYS_ROM_BITS)
+#define POWER_SLEEP_GATED_EN1 (CLOCKS_SLEEP_EN1_CLK_SYS_TBMAN_BITS)
+
+// Longest time the tick is suppressed for (in ticks), whatever the kernel
+// expects.
+#define POWER_MAX_SUPPRESSED_TICKS pdMS_TO_TICKS(10000)
+
+// Struct holding low power idle statistics (counted from boot).
+struct power_stats {
+    uint32_t wakeups[configNUM_CORES];      // Sleeps each core woke from
+    uint32_t sleep_us[configNUM_CORES];     // Time each core slept (wraps)
+};
+
+// Function prototypes
+void power_init(void);
+void power_suppress_ticks_and_sleep(TickType_t expected_idle_ticks);
+void vApplicationIdleHook(void);
+void power_get_stats(struct power_stats *stats);
+
+#endif
@@ -0,0 +1,275 @@
+ /** 
+ **************************************************************
+ * @file retain.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Retained state driver file. This file handles functionality 
+ *        specific to keeping a snapshot of filter and control state in RAM 
+ *        which survives a watchdog reset, so it can be restored at boot, 
+ *        and a log of faults (stack overflow, heap exhaustion, deadline 
+ *        misses) which survives resets, and is copied to flash at boot so 
+ *        it also survives power loss. 
+ *************************************************************** 
+ */
+
+#include "retain.h"
+
+_Static_assert(sizeof(struct retained_fault_log) <= FLASH_PAGE_SIZE, 
+        "Fault log exceeds a flash page");
+
+// Retained state, placed in RAM which isn't zeroed at boot. 
+static struct retained_state __uninitialized_ram(retained);
+
+// Fault log, placed in RAM which isn't zeroed at boot. 
+static struct retained_fault_log __uninitialized_ram(fault_log);
+
+// Whether the retained state was valid at boot (i.e., the reset was caused 
+// by the watchdog, and the state was intact). 
+static bool retained_valid_at_boot = false;
+
+// Whether the retained valve states have been cleared ahead of a reset, 
+// after which valves are retained as closed. 
+static bool valve_states_cleared = false;
+
+/**
+ * @brief Hash function. This function calculates the FNV-1a hash of a block
+ *        of memory. 
+ * @param data Pointer to the start of the block. 
+ * @param len Length of the block, in bytes. 
+ * @retval Hash of the block. 
+ */
+static uint32_t retain_hash(const void *data, size_t len) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint32_t hash = 0x811C9DC5;
+
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ bytes[i]) * 0x01000193;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Retained state checksum function. This function calculates a 
+ *        checksum over the retained state (excluding the checksum itself). 
+ * @param state Pointer to retained state. 
+ * @retval Checksum of the retained state. 
+ */
+uint32_t retain_checksum(const struct retained_state *state) {
+    return retain_hash(state, offsetof(struct retained_state, checksum));
+}
+
+/**
+ * @brief Fault log checksum function. This function calculates a checksum
+ *        over the fault log (excluding the checksum itself). 
+ * @param log Pointer to fault log. 
+ * @retval Checksum of the fault log. 
+ */
+uint32_t retain_fault_log_checksum(const struct retained_fault_log *log) {
+    return retain_hash(log, offsetof(struct retained_fault_log, checksum));
+}
+
+/**
+ * @brief Fault log flash copy getter function. 
+ * @param None. 
+ * @retval Pointer to the copy of the fault log in flash (via XIP). 
+ */
+static const struct retained_fault_log *retain_fault_log_copy(void) {
+    return (const struct retained_fault_log *)(uintptr_t)(XIP_BASE 
+            + RETAIN_FAULT_LOG_FLASH_OFFSET);
+}
+
+/**
+ * @brief Flash program function. This function erases the fault log sector 
+ *        and programs its first page. It is run by flash_safe_execute(), 
+ *        with the other core kept from running from flash. 
+ * @param param Pointer to the page programmed (FLASH_PAGE_SIZE bytes). 
+ * @retval None. 
+ */
+static void retain_program_fault_log(void *param) {
+    flash_range_erase(RETAIN_FAULT_LOG_FLASH_OFFSET, FLASH_SECTOR_SIZE);
+    flash_range_program(RETAIN_FAULT_LOG_FLASH_OFFSET, (const uint8_t *)param, 
+            FLASH_PAGE_SIZE);
+}
+
+/**
+ * @brief Fault log flash copy function. This function makes the copy of the
+ *        fault log in flash match the log in RAM, if the log holds faults. 
+ *        The sector is only rewritten when the log has changed, so it is 
+ *        erased at most once per boot after a fault. 
+ * @param None. 
+ * @retval None. 
+ */
+static void retain_copy_fault_log(void) {
+    // Page programmed into the sector (the rest of the page is left erased)
+    static uint8_t page[FLASH_PAGE_SIZE];
+    const struct retained_fault_log *copy = retain_fault_log_copy();
+
+    if ((fault_log.count == 0) || (memcmp(copy, &fault_log, sizeof(fault_log)) == 0)) {
+        return;
+    }
+
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, &fault_log, sizeof(fault_log));
+
+    // A failed write keeps the previous copy, and is retried at the next boot
+    flash_safe_execute(&retain_program_fault_log, page, RETAIN_FLASH_TIMEOUT_MSEC);
+}
+
+/**
+ * @brief Retained state initialiser function. This function checks whether 
+ *        the retained state can be restored, and resets it if not. It then 
+ *        restores the fault log from flash if it wasn't kept in RAM, or 
+ *        copies it to flash if it has changed. Must be called at boot 
+ *        (before the scheduler starts) before any other retained state 
+ *        function. 
+ * @param None. 
+ * @retval None. 
+ */
+void retain_init(void) {
+    // Retained state is only restored after a watchdog reset, as it is
+    // meaningless after power-up and may be stale after a manual reset. 
+    retained_valid_at_boot = watchdog_caused_reboot() 
+            && (retained.magic == RETAIN_MAGIC) 
+            && (retained.checksum == retain_checksum(&retained));
+
+    if (!retained_valid_at_boot) {
+        memset(&retained, 0, sizeof(retained));
+        retained.magic = RETAIN_MAGIC;
+        retained.checksum = retain_checksum(&retained);
+    }
+
+    // The fault log is kept across every reset for which it is intact, and
+    // otherwise restored from its copy in flash (if that is intact)
+    const struct retained_fault_log *copy = retain_fault_log_copy();
+    if ((fault_log.magic != RETAIN_FAULT_MAGIC) 
+            || (fault_log.checksum != retain_fault_log_checksum(&fault_log))) {
+        if ((copy->magic == RETAIN_FAULT_MAGIC) 
+                && (copy->checksum == retain_fault_log_checksum(copy))) {
+            fault_log = *copy;
+        } else {
+            memset(&fault_log, 0, sizeof(fault_log));
+            fault_log.magic = RETAIN_FAULT_MAGIC;
+            fault_log.checksum = retain_fault_log_checksum(&fault_log);
+        }
+    }
+
+    retain_copy_fault_log();
+}
+
+/**
+ * @brief Retained tank state getter function. This function copies the 
+ *        retained state of the given tank, if it was valid at boot. 
+ * @param tank Tank number (starting at 1). 
+ * @param tank_state Pointer to struct which the tank state is copied into. 
+ * @retval true if the retained state was valid at boot, false otherwise. 
+ */
+bool retain_get_tank_state(uint8_t tank, struct retained_tank_state *tank_state) {
+    if (!retained_valid_at_boot || (tank < 1) || (tank > RETAIN_MAX_TANKS)) {
+        return false;
+    }
+
+    taskENTER_CRITICAL();
+    (*tank_state) = retained.tanks[tank - 1];
+    taskEXIT_CRITICAL();
+
+    return true;
+}
+
+/**
+ * @brief Retained tank state setter function. This function updates the 
+ *        retained state of the given tank. 
+ * @param tank Tank number (starting at 1). 
+ * @param tank_state Pointer to the current tank state. 
+ * @retval None. 
+ */
+void retain_set_tank_state(uint8_t tank, const struct retained_tank_state *tank_state) {
+    if ((tank < 1) || (tank > RETAIN_MAX_TANKS)) {
+        return;
+    }
+
+    // Tanks may be updated from tasks on either core
+    taskENTER_CRITICAL();
+    retained.tanks[tank - 1] = (*tank_state);
+    if (valve_states_cleared) {
+        retained.tanks[tank - 1].filling = false;
+        retained.tanks[tank - 1].draining = false;
+    }
+    retained.checksum = retain_checksum(&retained);
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Retained valve state clear function. This function retains every 
+ *        tank's valves as closed from now on (keeping the filter state), so 
+ *        valves closed ahead of a reset aren't reopened at boot. 
+ * @param None. 
+ * @retval None. 
+ */
+void retain_clear_valve_states(void) {
+    taskENTER_CRITICAL();
+    valve_states_cleared = true;
+    for (uint8_t i = 0; i < RETAIN_MAX_TANKS; i++) {
+        retained.tanks[i].filling = false;
+        retained.tanks[i].draining = false;
+    }
+    retained.checksum = retain_checksum(&retained);
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Fault logging function. This function records a fault in the fault
+ *        log. It may be called from kernel hooks (with the kernel's locks 
+ *        held, or with a corrupt task stack), so it doesn't take any locks 
+ *        or call into the kernel. 
+ * @param type Type of fault (RETAIN_FAULT_*). 
+ * @param task_name Name of the task running at the time of the fault (or 
+ *        NULL if none). 
+ * @param free_heap_bytes Free heap at the time of the fault. 
+ * @retval None. 
+ */
+void retain_log_fault(uint8_t type, const char *task_name, uint32_t free_heap_bytes) {
+    fault_log.count++;
+    fault_log.last_type = type;
+    memset(fault_log.last_task, 0, sizeof(fault_log.last_task));
+    if (task_name != NULL) {
+        strncpy(fault_log.last_task, task_name, RETAIN_FAULT_TASK_NAME_LEN - 1);
+    }
+    fault_log.last_free_heap_bytes = free_heap_bytes;
+    fault_log.last_uptime_ms = to_ms_since_boot(get_absolute_time());
+    fault_log.last_lateness_us = 0;
+    fault_log.checksum = retain_fault_log_checksum(&fault_log);
+}
+
+/**
+ * @brief Deadline miss logging function. This function records a supervised
+ *        task missing its deadline in the fault log, with its lateness, and 
+ *        updates the deadline miss count and worst lateness. 
+ * @param task_name Name of the task which missed its deadline. 
+ * @param lateness_us Time by which the deadline was missed, in usec. 
+ * @param free_heap_bytes Free heap at the time of the miss. 
+ * @retval None. 
+ */
+void retain_log_deadline_miss(const char *task_name, uint32_t lateness_us, 
+        uint32_t free_heap_bytes) {
+    taskENTER_CRITICAL();
+    retain_log_fault(RETAIN_FAULT_DEADLINE_MISS, task_name, free_heap_bytes);
+    fault_log.last_lateness_us = lateness_us;
+    fault_log.deadline_misses++;
+    if (lateness_us > fault_log.worst_lateness_us) {
+        fault_log.worst_lateness_us = lateness_us;
+    }
+    fault_log.checksum = retain_fault_log_checksum(&fault_log);
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Fault log getter function. This function copies the fault log. 
+ * @param log Pointer to struct which the fault log is copied into. 
+ * @retval None. 
+ */
+void retain_get_fault_log(struct retained_fault_log *log) {
+    taskENTER_CRITICAL();
+    (*log) = fault_log;
+    taskEXIT_CRITICAL();
+}
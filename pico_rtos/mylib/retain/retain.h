@@ -0,0 +1,96 @@
+ /** 
+ **************************************************************
+ * @file retain.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the retained state driver. 
+ *************************************************************** 
+ */
+
+#ifndef RETAIN_H
+#define RETAIN_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "pico/stdlib.h"
+#include "hardware/watchdog.h"
+#include "config_store.h"
+
+// Value denoting that the retained state has been written by this firmware.
+#define RETAIN_MAGIC 0x52544E31
+
+// Value denoting that the fault log has been written by this firmware. 
+#define RETAIN_FAULT_MAGIC 0x464C5431
+
+// Types of fault logged across resets. 
+#define RETAIN_FAULT_NONE 0
+#define RETAIN_FAULT_STACK_OVERFLOW 1
+#define RETAIN_FAULT_MALLOC_FAILED 2
+#define RETAIN_FAULT_DEADLINE_MISS 3
+
+// Flash sector holding a copy of the fault log, just below the configuration
+// slots (offset from the start of flash). The copy is written at boot, so a 
+// log survives power loss. 
+#define RETAIN_FAULT_LOG_FLASH_OFFSET (CONFIG_SLOT_OFFSET(0) - FLASH_SECTOR_SIZE)
+
+// Longest time the fault log copy waits for the other core to stop running 
+// from flash (in msec). 
+#define RETAIN_FLASH_TIMEOUT_MSEC 100
+
+// Length of the task name kept in the fault log (including the terminating
+// null, matches the kernel's default configMAX_TASK_NAME_LEN). 
+#define RETAIN_FAULT_TASK_NAME_LEN 16
+
+// Maximum number of tanks for which state is retained. 
+#define RETAIN_MAX_TANKS 8
+
+// Struct holding the state of a single tank which is retained across 
+// watchdog resets. 
+struct retained_tank_state {
+    float avg_pressure;
+    bool filling;
+    bool draining;
+};
+
+// Struct holding all state retained across watchdog resets. This is kept in
+// RAM which isn't initialised at boot, and is protected by a checksum. 
+struct retained_state {
+    uint32_t magic;
+    struct retained_tank_state tanks[RETAIN_MAX_TANKS];
+    uint32_t checksum;
+};
+
+// Struct holding the fault log. This is kept in RAM which isn't initialised
+// at boot, separately from the retained state, so it survives any reset 
+// which keeps RAM powered (not only watchdog resets). It is protected by a 
+// checksum. A log with faults is copied to flash at the next boot, and the 
+// copy is restored when RAM wasn't kept (e.g. after power loss). 
+struct retained_fault_log {
+    uint32_t magic;
+    uint32_t count;                                 // Faults since cleared
+    uint8_t last_type;                              // RETAIN_FAULT_*
+    char last_task[RETAIN_FAULT_TASK_NAME_LEN];     // Task running at fault
+    uint32_t last_free_heap_bytes;                  // Free heap at fault
+    uint32_t last_uptime_ms;                        // Time since boot
+    uint32_t last_lateness_us;                      // Deadline miss lateness
+    uint32_t deadline_misses;                       // Misses since cleared
+    uint32_t worst_lateness_us;                     // Worst miss lateness
+    uint32_t checksum;
+};
+
+// Function prototypes
+uint32_t retain_checksum(const struct retained_state *state);
+uint32_t retain_fault_log_checksum(const struct retained_fault_log *log);
+void retain_log_fault(uint8_t type, const char *task_name, uint32_t free_heap_bytes);
+void retain_log_deadline_miss(const char *task_name, uint32_t lateness_us, 
+        uint32_t free_heap_bytes);
+void retain_get_fault_log(struct retained_fault_log *log);
+void retain_init(void);
+bool retain_get_tank_state(uint8_t tank, struct retained_tank_state *tank_state);
+void retain_set_tank_state(uint8_t tank, const struct retained_tank_state *tank_state);
+void retain_clear_valve_states(void);
+
+#endif
@@ -0,0 +1,297 @@
+ /**
+ **************************************************************
+ * @file serialise.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Outbound message serialiser file. This file handles functionality
+ *        specific to writing the responses sent to the M5StickC Plus. Values
+ *        are converted to scaled integers (fixed-point) once, and digits are
+ *        written straight into the caller's buffer, which is sized at
+ *        compile time for the largest response (see serialise.h). This 
+ *        avoids printf, its float to double conversions, and any heap or
+ *        large stack use. It has no hardware or RTOS dependencies. 
+ ***************************************************************
+ */
+
+#include <string.h>
+#include "serialise.h"
+
+// Powers of 10 used to scale fixed-point values (index is the number of
+// decimal places). 
+static const int32_t serialise_scales[] = {1, 10, 100};
+#define SERIALISE_MAX_DECIMALS 2
+
+// IEEE 754 single precision layout: sign, biased exponent and mantissa bits,
+// and the bias (plus the 23 mantissa bits) making the value 
+// mantissa * 2^(exponent - SERIALISE_FLOAT_EXP_BIAS). 
+#define SERIALISE_FLOAT_SIGN_SHIFT 31
+#define SERIALISE_FLOAT_EXP_SHIFT 23
+#define SERIALISE_FLOAT_EXP_MASK 0xFF
+#define SERIALISE_FLOAT_MANT_MASK 0x7FFFFF
+#define SERIALISE_FLOAT_EXP_BIAS 150
+
+// Largest shifts of the scaled mantissa (at most 31 bits) within 32 bits. 
+#define SERIALISE_MAX_SHIFT 31
+
+/**
+ * @brief Unsigned integer serialise function. This function writes a value
+ *        in decimal (without leading zeros). 
+ * @param out Buffer written to (at least SERIALISE_U32_MAX_LEN chars). 
+ * @param value Value being written. 
+ * @retval Pointer to the character after the last written. 
+ */
+char *serialise_u32(char *out, uint32_t value) {
+    char digits[SERIALISE_U32_MAX_LEN];
+    uint8_t num_digits = 0;
+
+    // Digits are produced least significant first
+    do {
+        digits[num_digits++] = '0' + (value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    while (num_digits > 0) {
+        *out++ = digits[--num_digits];
+    }
+
+    return out;
+}
+
+/**
+ * @brief Hex serialise function. This function writes a value in upper
+ *        case hex (without leading zeros). 
+ * @param out Buffer written to (at least SERIALISE_HEX_U32_MAX_LEN chars). 
+ * @param value Value being written. 
+ * @retval Pointer to the character after the last written. 
+ */
+char *serialise_hex_u32(char *out, uint32_t value) {
+    static const char hex_digits[] = "0123456789ABCDEF";
+    int8_t shift = 28;
+
+    // Skip leading zeros (but always write the last digit)
+    while ((shift > 0) && (((value >> shift) & 0xF) == 0)) {
+        shift -= 4;
+    }
+
+    for (; shift >= 0; shift -= 4) {
+        *out++ = hex_digits[(value >> shift) & 0xF];
+    }
+
+    return out;
+}
+
+/**
+ * @brief Fixed-point conversion function. This function scales a value to
+ *        an integer number of units of the last decimal place, and clamps it
+ *        to +/-limit. The value is scaled exactly from its bits, and rounded
+ *        half to even, so the digits match printf's "%.*f" (a float scaled in
+ *        single precision can round a value just below a half up). 
+ * @param value Value being converted. 
+ * @param decimals Number of decimal places (at most 2). 
+ * @param limit Largest magnitude of the result. 
+ * @retval Scaled value (0 for NaN). 
+ */
+int32_t serialise_to_fixed(float value, uint8_t decimals, int32_t limit) {
+    if (decimals > SERIALISE_MAX_DECIMALS) {
+        decimals = SERIALISE_MAX_DECIMALS;
+    }
+
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bool negative = (bits >> SERIALISE_FLOAT_SIGN_SHIFT) != 0;
+    int32_t exponent = (bits >> SERIALISE_FLOAT_EXP_SHIFT) & SERIALISE_FLOAT_EXP_MASK;
+    uint32_t mantissa = bits & SERIALISE_FLOAT_MANT_MASK;
+    int32_t clamped = negative ? -limit : limit;
+
+    if (exponent == SERIALISE_FLOAT_EXP_MASK) {
+        // Infinity is clamped, and NaN is sent as 0
+        return (mantissa == 0) ? clamped : 0;
+    } else if (exponent == 0) {
+        exponent = 1;   // Subnormal (no implicit leading 1)
+    } else {
+        mantissa |= SERIALISE_FLOAT_MANT_MASK + 1;
+    }
+
+    // The value is mantissa * 2^-shift, so the scaled value is the product
+    // below (at most 31 bits, so no 64-bit arithmetic is needed) shifted 
+    // right by shift. 
+    int32_t shift = SERIALISE_FLOAT_EXP_BIAS - exponent;
+    uint32_t product = mantissa * (uint32_t)serialise_scales[decimals];
+    uint32_t magnitude;
+
+    if (shift <= 0) {
+        if ((shift < -SERIALISE_MAX_SHIFT) || (product > (UINT32_MAX >> -shift))) {
+            return clamped;
+        }
+        magnitude = product << -shift;
+    } else if (shift > SERIALISE_MAX_SHIFT) {
+        magnitude = 0;  // Less than half a unit
+    } else {
+        magnitude = product >> shift;
+        uint32_t remainder = product - (magnitude << shift);
+        uint32_t half = (uint32_t)1 << (shift - 1);
+
+        if ((remainder > half) || ((remainder == half) && ((magnitude & 1) != 0))) {
+            magnitude++;
+        }
+    }
+
+    if (magnitude >= (uint32_t)limit) {
+        return clamped;
+    }
+
+    return negative ? -(int32_t)magnitude : (int32_t)magnitude;
+}
+
+/**
+ * @brief Fixed-point serialise function. This function writes a scaled value
+ *        (see serialise_to_fixed()) with the given number of decimal places.
+ * @param out Buffer written to (at least SERIALISE_U32_MAX_LEN + decimals + 2 
+ *        chars). 
+ * @param scaled Scaled value being written. 
+ * @param decimals Number of decimal places (at most 2). 
+ * @retval Pointer to the character after the last written. 
+ */
+char *serialise_fixed(char *out, int32_t scaled, uint8_t decimals) {
+    if (decimals > SERIALISE_MAX_DECIMALS) {
+        decimals = SERIALISE_MAX_DECIMALS;
+    }
+
+    uint32_t magnitude = (scaled < 0) ? (0u - (uint32_t)scaled) : (uint32_t)scaled;
+    if (scaled < 0) {
+        *out++ = '-';
+    }
+
+    uint32_t scale = serialise_scales[decimals];
+    out = serialise_u32(out, magnitude / scale);
+
+    if (decimals > 0) {
+        uint32_t fraction = magnitude % scale;
+        *out++ = '.';
+
+        // Fraction digits keep their leading zeros
+        for (scale /= 10; scale > 0; scale /= 10) {
+            *out++ = '0' + ((fraction / scale) % 10);
+        }
+    }
+
+    return out;
+}
+
+/**
+ * @brief Readings serialise function. This function writes a readings 
+ *        response, e.g. "T1=25.3T2=40.1!". 
+ * @param out Buffer written to (SERIALISE_READINGS_LEN chars). 
+ * @param heights Tank heights in cm (tank n is at index n - 1). 
+ * @retval Length of the response (excluding the terminating null). 
+ */
+size_t serialise_readings(char *out, const float *heights) {
+    char *pos = out;
+
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        *pos++ = 'T';
+        *pos++ = '0' + (i + 1);
+        *pos++ = '=';
+
+        // Heights are never negative (see update_tank_level())
+        int32_t tenths = serialise_to_fixed(heights[i], 1, SERIALISE_HEIGHT_MAX_TENTHS);
+        pos = serialise_fixed(pos, (tenths < 0) ? 0 : tenths, 1);
+    }
+
+    *pos++ = '!';
+    *pos = '\0';
+
+    return pos - out;
+}
+
+/**
+ * @brief Forecast conversion function. This function converts a forecast
+ *        to whole min, or -1 if the forecast doesn't apply. 
+ * @param forecast_sec Forecast, in sec (or negative if not applicable). 
+ * @retval Forecast in min, or -1. 
+ */
+static int32_t serialise_forecast_min(float forecast_sec) {
+    if (forecast_sec < 0.0f) {
+        return -1;
+    }
+
+    return serialise_to_fixed(forecast_sec / SERIALISE_MIN_TO_SEC, 0, 
+            SERIALISE_FORECAST_MAX_MIN);
+}
+
+/**
+ * @brief Analytics serialise function. This function writes an analytics
+ *        response, e.g. "A1=-0.25,120,-1,0A2=0.00,-1,-1,0!". 
+ * @param out Buffer written to (SERIALISE_ANALYTICS_LEN chars). 
+ * @param analytics Tank analytics (tank n is at index n - 1). 
+ * @retval Length of the response (excluding the terminating null). 
+ */
+size_t serialise_analytics(char *out, const struct tank_analytics *analytics) {
+    char *pos = out;
+
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        *pos++ = 'A';
+        *pos++ = '0' + (i + 1);
+        *pos++ = '=';
+
+        pos = serialise_fixed(pos, serialise_to_fixed(analytics[i].rate_cm_per_sec 
+                * SERIALISE_MIN_TO_SEC, 2, SERIALISE_RATE_MAX_HUNDREDTHS), 2);
+        *pos++ = ',';
+        pos = serialise_fixed(pos, serialise_forecast_min(analytics[i].time_to_empty_sec), 0);
+        *pos++ = ',';
+        pos = serialise_fixed(pos, serialise_forecast_min(analytics[i].time_to_full_sec), 0);
+        *pos++ = ',';
+        *pos++ = analytics[i].leak ? '1' : '0';
+    }
+
+    *pos++ = '!';
+    *pos = '\0';
+
+    return pos - out;
+}
+
+/**
+ * @brief Events serialise function. This function writes an events 
+ *        response, e.g. "E=1C!". 
+ * @param out Buffer written to (SERIALISE_EVENTS_LEN chars). 
+ * @param events Event mask (see alert_events.h). 
+ * @retval Length of the response (excluding the terminating null). 
+ */
+size_t serialise_events(char *out, uint32_t events) {
+    char *pos = out;
+
+    *pos++ = 'E';
+    *pos++ = '=';
+    pos = serialise_hex_u32(pos, events);
+    *pos++ = '!';
+    *pos = '\0';
+
+    return pos - out;
+}
+
+/**
+ * @brief Valve state serialise function. This function writes a valve 
+ *        state response, e.g. "S=21!". 
+ * @param out Buffer written to (SERIALISE_STATE_LEN chars). 
+ * @param filling Filling status of each tank (tank n is at index n - 1). 
+ * @param draining Draining status of each tank. 
+ * @retval Length of the response (excluding the terminating null). 
+ */
+size_t serialise_state(char *out, const bool *filling, const bool *draining) {
+    uint32_t state = 0;
+    char *pos = out;
+
+    for (uint8_t i = 0; i < NUM_TANKS; i++) {
+        uint32_t tank_state = (filling[i] ? SERIALISE_STATE_FILLING : 0) 
+                | (draining[i] ? SERIALISE_STATE_DRAINING : 0);
+        state |= tank_state << (i * SERIALISE_STATE_BITS_PER_TANK);
+    }
+
+    *pos++ = 'S';
+    *pos++ = '=';
+    pos = serialise_hex_u32(pos, state);
+    *pos++ = '!';
+    *pos = '\0';
+
+    return pos - out;
+}
@@ -0,0 +1,82 @@
+ /** 
+ **************************************************************
+ * @file serialise.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the outbound message serialiser. 
+ *************************************************************** 
+ */
+
+#ifndef SERIALISE_H
+#define SERIALISE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "meas_pipeline.h"
+#include "analytics.h"
+
+// Number of seconds in one minute. 
+#define SERIALISE_MIN_TO_SEC 60
+
+// Maximum number of characters written by serialise_u32() and 
+// serialise_hex_u32(). 
+#define SERIALISE_U32_MAX_LEN 10
+#define SERIALISE_HEX_U32_MAX_LEN 8
+
+// Length of the "Tn=" and "An=" field prefixes (tank numbers are a single
+// digit). 
+#define SERIALISE_PREFIX_LEN 3
+
+// Heights are sent in cm to 1 decimal place, clamped to 0 - 999.9 cm (at 
+// most 5 characters). 
+#define SERIALISE_HEIGHT_MAX_TENTHS 9999
+#define SERIALISE_HEIGHT_MAX_LEN 5
+
+// Rates are sent in cm/min to 2 decimal places, clamped to +/-999.99 cm/min
+// (at most 7 characters). 
+#define SERIALISE_RATE_MAX_HUNDREDTHS 99999
+#define SERIALISE_RATE_MAX_LEN 7
+
+// Forecasts are sent in whole min (or -1 if not applicable), clamped to 
+// 99999 min (at most 5 characters). 
+#define SERIALISE_FORECAST_MAX_MIN 99999
+#define SERIALISE_FORECAST_MAX_LEN 5
+
+// Buffer size (including the terminating null) of a readings response, 
+// e.g. "T1=25.3T2=40.1!". 
+#define SERIALISE_READINGS_LEN \
+        ((NUM_TANKS * (SERIALISE_PREFIX_LEN + SERIALISE_HEIGHT_MAX_LEN)) + 2)
+
+// Buffer size (including the terminating null) of an analytics response, 
+// e.g. "A1=-0.25,120,-1,0A2=0.00,-1,-1,0!" (rate in cm/min, time-to-empty 
+// and time-to-full in min or -1 if not applicable, leak flag). 
+#define SERIALISE_ANALYTICS_LEN \
+        ((NUM_TANKS * (SERIALISE_PREFIX_LEN + SERIALISE_RATE_MAX_LEN \
+        + (2 * (SERIALISE_FORECAST_MAX_LEN + 1)) + 2)) + 2)
+
+// Buffer size (including the terminating null) of an events response, e.g. 
+// "E=1C!" (event mask in hex). 
+#define SERIALISE_EVENTS_LEN (2 + SERIALISE_HEX_U32_MAX_LEN + 2)
+
+// Buffer size (including the terminating null) of a valve state response, 
+// e.g. "S=21!" (state mask in hex). 
+#define SERIALISE_STATE_LEN (2 + SERIALISE_HEX_U32_MAX_LEN + 2)
+
+// Valve state bits for tank n, shifted left by (n - 1) * 
+// SERIALISE_STATE_BITS_PER_TANK (the same layout as the telemetry record's 
+// state). 
+#define SERIALISE_STATE_FILLING (1 << 0)
+#define SERIALISE_STATE_DRAINING (1 << 1)
+#define SERIALISE_STATE_BITS_PER_TANK 4
+
+// Function prototypes
+char *serialise_u32(char *out, uint32_t value);
+char *serialise_hex_u32(char *out, uint32_t value);
+int32_t serialise_to_fixed(float value, uint8_t decimals, int32_t limit);
+char *serialise_fixed(char *out, int32_t scaled, uint8_t decimals);
+size_t serialise_readings(char *out, const float *heights);
+size_t serialise_analytics(char *out, const struct tank_analytics *analytics);
+size_t serialise_events(char *out, uint32_t events);
+size_t serialise_state(char *out, const bool *filling, const bool *draining);
+
+#endif
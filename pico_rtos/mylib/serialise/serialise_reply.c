@@ -0,0 +1,62 @@
+ /**
+ **************************************************************
+ * @file serialise_reply.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Request reply dispatch file. This file handles functionality
+ *        specific to answering a request character with its serialised
+ *        reply. It has no hardware or RTOS dependencies, so the firmware's
+ *        UART task and the host's node stand-in share it, each supplying
+ *        its own source of readings (see serialise_reply.h).
+ ***************************************************************
+ */
+
+#include "serialise_reply.h"
+
+/**
+ * @brief Request reply function. This function serialises the reply to a
+ *        request character.
+ * @param source Pointer to the functions the reply is read from.
+ * @param param Value passed to the source's functions.
+ * @param request Request character ('R' for recent tank heights, 'A' for
+ *        analytics, 'E' for the events raised since the last request, 'S'
+ *        for valve states, 'L' for latched heights, and 'C' for the
+ *        configuration).
+ * @param out Buffer the reply is written to (CONFIG_REPLY_LEN chars).
+ * @retval Length of the reply, or 0 if the character isn't a request.
+ */
+size_t serialise_reply(const struct serialise_reply_source *source, void *param, char request,
+        char *out) {
+    float heights[NUM_TANKS];
+
+    if (request == 'R') {
+        source->get_heights(param, heights);
+        return serialise_readings(out, heights);
+    } else if (request == 'A') {
+        struct tank_analytics analytics[NUM_TANKS];
+        source->get_analytics(param, analytics);
+        return serialise_analytics(out, analytics);
+    } else if (request == 'E') {
+        return serialise_events(out, source->take_events(param));
+    } else if (request == 'S') {
+        bool filling[NUM_TANKS], draining[NUM_TANKS];
+        source->get_valves(param, filling, draining);
+        return serialise_state(out, filling, draining);
+    } else if (request == MULTIDROP_LATCH) {
+        // "L" and a readings reply, or "L!" if the latch broadcast was missed
+        // (the latch is released once answered)
+        out[0] = MULTIDROP_LATCH;
+        if (!source->take_latched(param, heights)) {
+            out[1] = MULTIDROP_END;
+            out[2] = '\0';
+            return 2;
+        }
+        return 1 + serialise_readings(&out[1], heights);
+    } else if (request == CONFIG_REQUEST) {
+        struct config_block block;
+        source->get_config(param, &block);
+        return config_serialise(out, &block);
+    }
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+ /**
+ **************************************************************
+ * @file serialise_reply.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the request reply dispatch.
+ ***************************************************************
+ */
+
+#ifndef SERIALISE_REPLY_H
+#define SERIALISE_REPLY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "serialise.h"
+#include "multidrop.h"
+#include "config.h"
+
+// Struct holding the functions a node's replies are read from: the UART
+// task's (from the measurement task's snapshot) or the host node
+// stand-in's (from its simulated tanks). Each is only called for the
+// request which needs it, and is passed the param given with the request.
+struct serialise_reply_source {
+    void (*get_heights)(void *param, float *heights);
+    void (*get_analytics)(void *param, struct tank_analytics *analytics);
+    uint32_t (*take_events)(void *param);
+    void (*get_valves)(void *param, bool *filling, bool *draining);
+    bool (*take_latched)(void *param, float *heights);
+    void (*get_config)(void *param, struct config_block *block);
+};
+
+// Function prototypes
+size_t serialise_reply(const struct serialise_reply_source *source, void *param, char request,
+        char *out);
+
+#endif
@@ -0,0 +1,221 @@
+ /**
+ **************************************************************
+ * @file supervisor.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Deadline supervisor file. This file handles functionality
+ *        specific to monitoring the tasks which keep the valves safe. Each
+ *        declares a deadline and checks in every cycle (or, for event driven
+ *        tasks, after every event). The supervisor feeds
+ *        the hardware watchdog only while every check-in is on time. When a
+ *        task misses its deadline, the valves are closed, the miss is
+ *        logged to the fault log and the system is reset.
+ ***************************************************************
+ */
+
+#include "supervisor.h"
+#include "ctrl.h"
+
+// Supervised tasks (indexed by SUPERVISOR_*).
+static struct supervisor_entry entries[SUPERVISOR_NUM_TASKS] = {
+    {"Measurement_Task", SUPERVISOR_MEAS_DEADLINE_MSEC * 1000, false, 0, 0, NULL},
+    {"Tank_1_Level_Control_Task", SUPERVISOR_CTRL_DEADLINE_MSEC * 1000, false, 0, 0, NULL},
+    {"Tank_2_Level_Control_Task", SUPERVISOR_CTRL_DEADLINE_MSEC * 1000, false, 0, 0, NULL},
+    {"Level_Control_Enable_Task", SUPERVISOR_CTRL_DEADLINE_MSEC * 1000, false, 0, 0, NULL},
+};
+
+/**
+ * @brief Supervision start function. This function starts supervising a
+ *        task, with its first deadline counted from now.
+ * @param task Supervised task (SUPERVISOR_*).
+ * @retval None.
+ */
+void supervisor_start(uint8_t task) {
+    if (task >= SUPERVISOR_NUM_TASKS) {
+        return;
+    }
+
+    // Tasks check in from either core
+    taskENTER_CRITICAL();
+    entries[task].active = true;
+    entries[task].last_checkin_us = time_us_64();
+    entries[task].lateness_us = 0;
+    entries[task].waiting_on = NULL;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Supervision stop function. This function stops supervising a task
+ *        (e.g. before a level control task deletes itself).
+ * @param task Supervised task (SUPERVISOR_*).
+ * @retval None.
+ */
+void supervisor_stop(uint8_t task) {
+    if (task >= SUPERVISOR_NUM_TASKS) {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    entries[task].active = false;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Wait function. This function records that a supervised task is
+ *        about to block until an event arrives on a queue (or queue set).
+ *        The task is idle, rather than late, for as long as the queue is
+ *        empty. Its next check-in ends the wait.
+ * @param task Supervised task (SUPERVISOR_*).
+ * @param queue Queue (or queue set) waited on.
+ * @retval None.
+ */
+void supervisor_wait(uint8_t task, QueueHandle_t queue) {
+    if (task >= SUPERVISOR_NUM_TASKS) {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    entries[task].waiting_on = queue;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Check-in function. This function records a supervised task's
+ *        check-in. A check-in later than the task's deadline is kept for the
+ *        supervisor, with its lateness.
+ * @param task Supervised task (SUPERVISOR_*).
+ * @retval None.
+ */
+void HOT_PATH_FUNC(supervisor_checkin)(uint8_t task) {
+    if (task >= SUPERVISOR_NUM_TASKS) {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    struct supervisor_entry *entry = &entries[task];
+    uint64_t now = time_us_64();
+    uint64_t interval = now - entry->last_checkin_us;
+
+    if (entry->active && (interval > entry->deadline_us) && (entry->lateness_us == 0)) {
+        entry->lateness_us = (uint32_t)(interval - entry->deadline_us);
+    }
+
+    entry->last_checkin_us = now;
+    entry->waiting_on = NULL;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Deadline check function. This function checks every supervised
+ *        task for a late check-in, or a check-in which is now overdue (the
+ *        lateness of which is how overdue it is so far). A task waiting on
+ *        an empty queue is idle, so its deadline is restarted.
+ * @param task Pointer to the task which missed its deadline.
+ * @param lateness_us Pointer to the lateness of the miss, in usec.
+ * @retval true if a task missed its deadline, false otherwise.
+ */
+bool supervisor_check(uint8_t *task, uint32_t *lateness_us) {
+    bool missed = false;
+
+    taskENTER_CRITICAL();
+    uint64_t now = time_us_64();
+
+    for (uint8_t i = 0; (i < SUPERVISOR_NUM_TASKS) && !missed; i++) {
+        struct supervisor_entry *entry = &entries[i];
+        uint64_t overdue = now - entry->last_checkin_us;
+
+        if (!entry->active) {
+            continue;
+        }
+
+        if (entry->lateness_us > 0) {
+            *lateness_us = entry->lateness_us;
+            missed = true;
+        } else if ((entry->waiting_on != NULL)
+                && (uxQueueMessagesWaiting(entry->waiting_on) == 0)) {
+            entry->last_checkin_us = now;
+        } else if (overdue > entry->deadline_us) {
+            *lateness_us = (uint32_t)(overdue - entry->deadline_us);
+            missed = true;
+        }
+
+        if (missed) {
+            *task = i;
+        }
+    }
+    taskEXIT_CRITICAL();
+
+    return missed;
+}
+
+/**
+ * @brief Deadline miss handler. This function closes every valve (whatever
+ *        state the level control tasks are in), clears the valve states
+ *        retained through the reset so they aren't reopened, logs the miss
+ *        to the fault log and resets the system via the watchdog.
+ * @param task Supervised task which missed its deadline (SUPERVISOR_*).
+ * @param lateness_us Lateness of the miss, in usec.
+ * @retval None.
+ */
+void supervisor_fail(uint8_t task, uint32_t lateness_us) {
+    ctrl_safe_state();
+    retain_clear_valve_states();
+    retain_log_deadline_miss(entries[task].task_name, lateness_us, xPortGetFreeHeapSize());
+    watchdog_reboot(0, 0, 0);
+
+    while (true) {
+        tight_loop_contents();
+    }
+}
+
+/**
+ * @brief Deadline miss statistics getter function. This function copies the
+ *        deadline miss count and worst lateness from the fault log.
+ * @param stats Pointer to struct which statistics are copied into.
+ * @retval None.
+ */
+void supervisor_get_stats(struct supervisor_stats *stats) {
+    struct retained_fault_log log;
+    retain_get_fault_log(&log);
+
+    stats->deadline_misses = log.deadline_misses;
+    stats->worst_lateness_us = log.worst_lateness_us;
+}
+
+/**
+ * @brief Supervisor task. This task enables the hardware watchdog, then
+ *        every supervisor period checks the supervised tasks' deadlines and
+ *        feeds the watchdog only if none have been missed.
+ * @param param Value passed upon task creation.
+ * @retval None.
+ */
+void supervisor_task(void *param) {
+    // Pause the watchdog while a debugger has the cores halted
+    watchdog_enable(SUPERVISOR_WATCHDOG_TIMEOUT_MSEC, true);
+
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (1) {
+        uint8_t task;
+        uint32_t lateness_us;
+
+        if (supervisor_check(&task, &lateness_us)) {
+            supervisor_fail(task, lateness_us);
+        }
+
+        watchdog_update();
+        xTaskDelayUntil(&last_wake, pdMS_TO_TICKS(SUPERVISOR_PERIOD_MSEC));
+    }
+}
+
+/**
+ * @brief Supervisor task initialise function. This function creates the
+ *        supervisor task.
+ * @param None.
+ * @retval None.
+ */
+void supervisor_task_init(void) {
+    xTaskCreateAffinitySet((void *)&supervisor_task, (const signed char *)"Supervisor_Task",
+            SUPERVISOR_TASK_STACK_DEPTH, NULL, SUPERVISOR_TASK_PRIORITY,
+            SUPERVISOR_TASK_AFFINITY, NULL);
+}
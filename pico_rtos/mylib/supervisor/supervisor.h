@@ -0,0 +1,73 @@
+ /**
+ **************************************************************
+ * @file supervisor.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the deadline supervisor.
+ ***************************************************************
+ */
+
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <stdio.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "pico/stdlib.h"
+#include "hardware/watchdog.h"
+#include "sys.h"
+#include "retain.h"
+
+// Supervised tasks. Each checks in at least once per deadline while it is
+// supervised.
+#define SUPERVISOR_MEAS 0
+#define SUPERVISOR_T1_LEVEL_CTRL 1
+#define SUPERVISOR_T2_LEVEL_CTRL 2
+#define SUPERVISOR_LEVEL_CTRL_ENABLE 3
+#define SUPERVISOR_NUM_TASKS 4
+
+// Deadlines (the longest allowed time between check-ins, in msec). The
+// measurement task checks in once per sample period. The event driven
+// tasks check in as each event arrives, and declare the queue they are
+// waiting on in between, so they needn't wake up just to check in. While
+// its queue is empty such a task is idle, and its deadline is counted from
+// when an event arrives (to within a supervisor period).
+#define SUPERVISOR_MEAS_DEADLINE_MSEC 1500
+#define SUPERVISOR_CTRL_DEADLINE_MSEC 1000
+
+// Period at which the supervisor checks deadlines and feeds the hardware
+// watchdog, and the watchdog's timeout (in msec). The watchdog resets the
+// system if the supervisor itself stops running.
+#define SUPERVISOR_PERIOD_MSEC 500
+#define SUPERVISOR_WATCHDOG_TIMEOUT_MSEC 2000
+
+// Struct holding a supervised task's deadline and check-in state.
+struct supervisor_entry {
+    const char *task_name;
+    uint32_t deadline_us;
+    bool active;
+    uint64_t last_checkin_us;
+    uint32_t lateness_us;           // Lateness of a late check-in (0 if none)
+    QueueHandle_t waiting_on;       // Queue waited on since the last check-in
+};
+
+// Struct holding deadline miss statistics (kept in the fault log, so they
+// count misses across the resets which follow them).
+struct supervisor_stats {
+    uint32_t deadline_misses;
+    uint32_t worst_lateness_us;
+};
+
+// Function prototypes
+void supervisor_start(uint8_t task);
+void supervisor_stop(uint8_t task);
+void supervisor_wait(uint8_t task, QueueHandle_t queue);
+void supervisor_checkin(uint8_t task);
+bool supervisor_check(uint8_t *task, uint32_t *lateness_us);
+void supervisor_fail(uint8_t task, uint32_t lateness_us);
+void supervisor_get_stats(struct supervisor_stats *stats);
+void supervisor_task(void *param);
+void supervisor_task_init(void);
+
+#endif
@@ -0,0 +1,32 @@
+ /** 
+ **************************************************************
+ * @file hot_path.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for placement of the measurement/control hot path. 
+ *        This has no dependencies unless HOT_PATH_IN_RAM is set, so it can
+ *        be used by hardware independent code which is also built on the 
+ *        host. 
+ *************************************************************** 
+ */
+
+#ifndef HOT_PATH_H
+#define HOT_PATH_H
+
+// Whether the measurement/control hot path is placed in SRAM (set by the 
+// HOT_PATH_IN_RAM CMake option). 
+#ifndef HOT_PATH_IN_RAM
+#define HOT_PATH_IN_RAM 0
+#endif
+
+// Hot path function declarator. Functions declared with this run from SRAM 
+// when HOT_PATH_IN_RAM is set, rather than from flash via the XIP cache 
+// (which stalls on cache misses). 
+#if HOT_PATH_IN_RAM
+#include "pico/platform.h"
+#define HOT_PATH_FUNC(func_name) __not_in_flash_func(func_name)
+#else
+#define HOT_PATH_FUNC(func_name) func_name
+#endif
+
+#endif
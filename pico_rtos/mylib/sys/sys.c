@@ -0,0 +1,370 @@
+ /** 
+ **************************************************************
+ * @file sys.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief System housekeeping driver file. This file handles periodic 
+ *        housekeeping which is run from a software timer, such as 
+ *        gathering context switch and heap usage statistics, and the 
+ *        kernel's stack overflow and heap exhaustion hooks. 
+ *************************************************************** 
+ */
+
+#include <string.h>
+#include "sys.h"
+
+// Number of context switches since boot. 
+volatile uint32_t sys_context_switch_count = 0;
+
+// Most recent system statistics, and context switch count at the time they
+// were gathered. 
+static struct sys_stats stats;
+static uint32_t last_context_switch_count = 0;
+
+// Software timer which runs periodic housekeeping. 
+static TimerHandle_t housekeeping_timer;
+
+// Status of each task, as last fetched from the kernel. 
+static TaskStatus_t task_status[SYS_MAX_TASKS];
+
+// Stack budget of each task created by the firmware (the timer service 
+// task's name is the kernel's default). Names are compared up to the 
+// kernel's maximum task name length. 
+static const struct sys_stack_budget stack_budgets[] = {
+    {"Measurement_Task", "MEAS_TASK_STACK_DEPTH", MEAS_TASK_STACK_DEPTH},
+    {"Tank_1_Level_Control_Task", "T1_LEVEL_CTRL_TASK_STACK_DEPTH", 
+            T1_LEVEL_CTRL_TASK_STACK_DEPTH},
+    {"Tank_2_Level_Control_Task", "T2_LEVEL_CTRL_TASK_STACK_DEPTH", 
+            T2_LEVEL_CTRL_TASK_STACK_DEPTH},
+    {"Level_Control_Enable_Task", "LEVEL_CTRL_ENABLE_TASK_STACK_DEPTH", 
+            LEVEL_CTRL_ENABLE_TASK_STACK_DEPTH},
+    {"UART0_Task", "UART_TASK_STACK_DEPTH", UART_TASK_STACK_DEPTH},
+    {"UART1_Task", "UART_TASK_STACK_DEPTH", UART_TASK_STACK_DEPTH},
+    {"USB_Task", "UART_TASK_STACK_DEPTH", UART_TASK_STACK_DEPTH},
+    {"Telemetry_Task", "TELEMETRY_TASK_STACK_DEPTH", TELEMETRY_TASK_STACK_DEPTH},
+    {"Supervisor_Task", "SUPERVISOR_TASK_STACK_DEPTH", SUPERVISOR_TASK_STACK_DEPTH},
+    {"Tmr Svc", "TIMER_SERVICE_TASK_STACK_DEPTH", TIMER_SERVICE_TASK_STACK_DEPTH},
+};
+#define NUM_STACK_BUDGETS (sizeof(stack_budgets) / sizeof(stack_budgets[0]))
+
+// Names of the fault types (RETAIN_FAULT_* n is name n). 
+static const char *fault_names[] = {"none", "stack_overflow", "malloc_failed", 
+        "deadline_miss"};
+#define NUM_FAULT_NAMES (sizeof(fault_names) / sizeof(fault_names[0]))
+
+// Run time counters of each task and the total run time at the time 
+// per-core utilisation was last calculated (tasks are identified by task 
+// number, as handles may be reused after a task is deleted). 
+static UBaseType_t last_task_numbers[SYS_MAX_TASKS];
+static uint32_t last_task_run_times[SYS_MAX_TASKS];
+static UBaseType_t last_num_task_run_times = 0;
+static uint32_t last_total_run_time = 0;
+
+// Low power idle statistics at the time sleep statistics were last 
+// calculated. 
+static struct power_stats last_power_stats;
+
+// Worst-case measurement loop time since boot (in usec), and number of
+// measurement loops timed. 
+static volatile uint32_t meas_loop_worst_us = 0;
+static volatile uint32_t meas_loop_count = 0;
+
+/**
+ * @brief Measurement loop time recording function. This function records the
+ *        time taken by one pass of a measurement task loop (sampling, 
+ *        filtering and checking control requirements), so the worst case 
+ *        can be compared between memory layouts. 
+ * @param loop_time_us Time taken by the loop, in usec. 
+ * @retval None. 
+ */
+void HOT_PATH_FUNC(sys_record_meas_loop_time)(uint32_t loop_time_us) {
+    // Loop times may be recorded by measurement tasks on either core
+    taskENTER_CRITICAL();
+    if (loop_time_us > meas_loop_worst_us) {
+        meas_loop_worst_us = loop_time_us;
+    }
+    meas_loop_count++;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Run time counter getter function. This function provides the time 
+ *        base used by the kernel to gather task run time statistics. 
+ * @param None. 
+ * @retval Current time, in usec. 
+ */
+uint32_t sys_get_run_time_counter(void) {
+    return time_us_32();
+}
+
+/**
+ * @brief Per-core utilisation update function. This function calculates the
+ *        proportion of time each core spent running tasks pinned to it since
+ *        the last update. Idle time (and time spent in the idle tasks, which
+ *        aren't pinned) counts as unutilised. 
+ * @param current Pointer to statistics struct which utilisation is stored in.
+ * @retval None. 
+ */
+void sys_update_core_utilisation(struct sys_stats *current) {
+    uint32_t total_run_time = 0;
+    uint32_t core_run_time[configNUM_CORES] = {0};
+
+    UBaseType_t num_tasks = uxTaskGetSystemState(task_status, SYS_MAX_TASKS, 
+            &total_run_time);
+    uint32_t elapsed = total_run_time - last_total_run_time;
+
+    for (UBaseType_t i = 0; i < num_tasks; i++) {
+        // Find the task's run time counter from the last update (a task 
+        // created since then has run for its entire counter value). 
+        uint32_t last_run_time = 0;
+        for (UBaseType_t j = 0; j < last_num_task_run_times; j++) {
+            if (last_task_numbers[j] == task_status[i].xTaskNumber) {
+                last_run_time = last_task_run_times[j];
+                break;
+            }
+        }
+
+        // Attribute the task's run time to its core, if pinned to one. 
+        UBaseType_t affinity = vTaskCoreAffinityGet(task_status[i].xHandle);
+        for (uint8_t core = 0; core < configNUM_CORES; core++) {
+            if (affinity == (1 << core)) {
+                core_run_time[core] += task_status[i].ulRunTimeCounter - last_run_time;
+            }
+        }
+
+        last_task_numbers[i] = task_status[i].xTaskNumber;
+        last_task_run_times[i] = task_status[i].ulRunTimeCounter;
+    }
+
+    last_num_task_run_times = num_tasks;
+    last_total_run_time = total_run_time;
+
+    for (uint8_t core = 0; core < configNUM_CORES; core++) {
+        current->core_utilisation_permille[core] = (elapsed == 0) ? 0 
+                : (uint16_t)(((uint64_t)core_run_time[core] * 1000) / elapsed);
+    }
+}
+
+/**
+ * @brief Sleep statistics update function. This function calculates the 
+ *        number of times the cores woke from low power idle per second, and
+ *        the proportion of time each core slept (its idle residency), since
+ *        the last update. 
+ * @param current Pointer to statistics struct which sleep statistics are 
+ *        stored in. 
+ * @retval None. 
+ */
+void sys_update_sleep_stats(struct sys_stats *current) {
+    struct power_stats power_stats;
+    power_get_stats(&power_stats);
+
+    uint32_t wakeups = 0;
+    for (uint8_t core = 0; core < configNUM_CORES; core++) {
+        wakeups += power_stats.wakeups[core] - last_power_stats.wakeups[core];
+        current->sleep_permille[core] = (uint16_t)(((uint64_t)(power_stats.sleep_us[core] 
+                - last_power_stats.sleep_us[core]) * 1000) 
+                / (SYS_HOUSEKEEPING_PERIOD_MSEC * 1000));
+    }
+
+    current->wakeups_per_sec = (wakeups * 1000) / SYS_HOUSEKEEPING_PERIOD_MSEC;
+    last_power_stats = power_stats;
+}
+
+/**
+ * @brief Housekeeping timer callback. This callback is executed by the timer
+ *        service task every housekeeping period, and updates the system 
+ *        statistics. 
+ * @param timer Handle of the timer which expired. 
+ * @retval None. 
+ */
+void sys_housekeeping_cb(TimerHandle_t timer) {
+    // Number of housekeeping periods since statistics were last reported
+    static uint32_t periods_since_report = 0;
+
+    // The timer service task is created by the scheduler, so it is placed 
+    // on its core the first time it runs housekeeping. 
+    static bool timer_service_placed = false;
+    if (!timer_service_placed) {
+        vTaskCoreAffinitySet(xTimerGetTimerDaemonTaskHandle(), 
+                TIMER_SERVICE_TASK_AFFINITY);
+        timer_service_placed = true;
+    }
+
+    // Gather statistics for the period that has just elapsed
+    uint32_t context_switch_count = sys_context_switch_count;
+    struct sys_stats current = {0};
+    current.context_switches_per_sec = ((context_switch_count - last_context_switch_count) 
+            * 1000) / SYS_HOUSEKEEPING_PERIOD_MSEC;
+    current.free_heap_bytes = xPortGetFreeHeapSize();
+    current.min_free_heap_bytes = xPortGetMinimumEverFreeHeapSize();
+    current.num_tasks = uxTaskGetNumberOfTasks();
+    last_context_switch_count = context_switch_count;
+    sys_update_core_utilisation(&current);
+    current.meas_loop_worst_us = meas_loop_worst_us;
+    current.meas_loop_count = meas_loop_count;
+    sys_update_sleep_stats(&current);
+
+    taskENTER_CRITICAL();
+    stats = current;
+    taskEXIT_CRITICAL();
+
+    // Report statistics over stdio if enabled
+    if (SYS_STATS_REPORT || STACK_BUDGET_REPORT) {
+        periods_since_report++;
+    }
+
+    if (periods_since_report >= SYS_STATS_REPORT_PERIODS) {
+        sys_report_fault_log();
+
+        if (STACK_BUDGET_REPORT) {
+            sys_report_stack_budget();
+        }
+
+        if (SYS_STATS_REPORT) {
+            printf("SYS ctx_sw/s=%lu heap_free=%lu heap_min=%lu tasks=%lu", 
+                    (unsigned long)current.context_switches_per_sec, 
+                    (unsigned long)current.free_heap_bytes, 
+                    (unsigned long)current.min_free_heap_bytes, 
+                    (unsigned long)current.num_tasks);
+            for (uint8_t core = 0; core < configNUM_CORES; core++) {
+                printf(" core%u=%u.%u%%", core, 
+                        current.core_utilisation_permille[core] / 10, 
+                        current.core_utilisation_permille[core] % 10);
+            }
+            printf(" loop_max_us=%lu loops=%lu", 
+                    (unsigned long)current.meas_loop_worst_us, 
+                    (unsigned long)current.meas_loop_count);
+            if (LOW_POWER_IDLE) {
+                printf(" wakeups/s=%lu", (unsigned long)current.wakeups_per_sec);
+                for (uint8_t core = 0; core < configNUM_CORES; core++) {
+                    printf(" sleep%u=%u.%u%%", core, current.sleep_permille[core] / 10, 
+                            current.sleep_permille[core] % 10);
+                }
+            }
+            printf("\n");
+        }
+
+        periods_since_report = 0;
+    }
+}
+
+/**
+ * @brief Stack budget report function. This function prints the stack depth
+ *        and peak stack use (in words) of each task, and the size and peak 
+ *        use (in bytes) of the kernel heap, in the format read by 
+ *        host/stack_budget. Tasks which haven't been created are skipped. 
+ * @param None. 
+ * @retval None. 
+ */
+void sys_report_stack_budget(void) {
+    UBaseType_t num_tasks = uxTaskGetSystemState(task_status, SYS_MAX_TASKS, NULL);
+
+    for (uint8_t i = 0; i < NUM_STACK_BUDGETS; i++) {
+        for (UBaseType_t j = 0; j < num_tasks; j++) {
+            if (strncmp(stack_budgets[i].task_name, task_status[j].pcTaskName, 
+                    configMAX_TASK_NAME_LEN - 1) != 0) {
+                continue;
+            }
+
+            // The high water mark is the least free stack since creation
+            uint32_t peak = stack_budgets[i].depth_words - task_status[j].usStackHighWaterMark;
+            printf("STACK define=%s depth=%lu peak=%lu\n", stack_budgets[i].depth_define, 
+                    (unsigned long)stack_budgets[i].depth_words, (unsigned long)peak);
+            break;
+        }
+    }
+
+    printf("HEAP define=SYS_HEAP_SIZE_BYTES size=%lu peak=%lu\n", 
+            (unsigned long)configTOTAL_HEAP_SIZE, 
+            (unsigned long)(configTOTAL_HEAP_SIZE - xPortGetMinimumEverFreeHeapSize()));
+}
+
+/**
+ * @brief Fault log report function. This function prints the fault log, if
+ *        any faults have been logged. 
+ * @param None. 
+ * @retval None. 
+ */
+void sys_report_fault_log(void) {
+    struct retained_fault_log log;
+    retain_get_fault_log(&log);
+
+    if (log.count == 0) {
+        return;
+    }
+
+    printf("FAULT count=%lu last=%s task=%s heap_free=%lu uptime_ms=%lu late_us=%lu "
+            "deadline_misses=%lu worst_late_us=%lu\n", 
+            (unsigned long)log.count, 
+            (log.last_type < NUM_FAULT_NAMES) ? fault_names[log.last_type] : "unknown", 
+            (log.last_task[0] != '\0') ? log.last_task : "none", 
+            (unsigned long)log.last_free_heap_bytes, (unsigned long)log.last_uptime_ms, 
+            (unsigned long)log.last_lateness_us, (unsigned long)log.deadline_misses, 
+            (unsigned long)log.worst_lateness_us);
+}
+
+/**
+ * @brief Stack overflow hook. This hook is called by the kernel when it 
+ *        finds that a task has overflowed its stack (checked on every 
+ *        context switch). The overflow is logged to the fault log, and the
+ *        system is reset by the watchdog, as the stack (and possibly the 
+ *        heap around it) is corrupt. The filter and valve state is restored
+ *        after the reset (see retain.c). 
+ * @param task Handle of the task which overflowed. 
+ * @param task_name Name of the task which overflowed. 
+ * @retval None. 
+ */
+void vApplicationStackOverflowHook(TaskHandle_t task, char *task_name) {
+    (void)task;
+
+    retain_log_fault(RETAIN_FAULT_STACK_OVERFLOW, task_name, xPortGetFreeHeapSize());
+    watchdog_reboot(0, 0, 0);
+
+    while (true) {
+        tight_loop_contents();
+    }
+}
+
+/**
+ * @brief Heap exhaustion hook. This hook is called by the kernel when an 
+ *        allocation from the kernel heap fails. The failure is logged to the
+ *        fault log, and the allocation returns NULL to its caller as usual 
+ *        (e.g. task creation returns errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY).
+ * @param None. 
+ * @retval None. 
+ */
+void vApplicationMallocFailedHook(void) {
+    // Allocations made before the scheduler starts have no calling task
+    const char *task_name = (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED) 
+            ? NULL : pcTaskGetName(NULL);
+
+    retain_log_fault(RETAIN_FAULT_MALLOC_FAILED, task_name, xPortGetFreeHeapSize());
+}
+
+/**
+ * @brief System statistics getter function. This function copies the most 
+ *        recent system statistics. 
+ * @param stats_out Pointer to struct which statistics are copied into. 
+ * @retval None. 
+ */
+void sys_get_stats(struct sys_stats *stats_out) {
+    taskENTER_CRITICAL();
+    (*stats_out) = stats;
+    taskEXIT_CRITICAL();
+}
+
+/**
+ * @brief Housekeeping initialisation function. This function creates and 
+ *        starts the software timer which runs periodic housekeeping. 
+ * @param None. 
+ * @retval None. 
+ */
+void sys_housekeeping_init(void) {
+    housekeeping_timer = xTimerCreate("Housekeeping_Timer", 
+            pdMS_TO_TICKS(SYS_HOUSEKEEPING_PERIOD_MSEC), pdTRUE, NULL, 
+            &sys_housekeeping_cb);
+
+    if (housekeeping_timer != NULL) {
+        xTimerStart(housekeeping_timer, 0);
+    }
+}
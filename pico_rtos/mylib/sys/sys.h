@@ -0,0 +1,126 @@
+ /** 
+ **************************************************************
+ * @file sys.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the system housekeeping driver. 
+ *************************************************************** 
+ */
+
+#ifndef SYS_H
+#define SYS_H
+
+#include <stdio.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include "pico/stdlib.h"
+#include "pico/platform.h"
+#include "hot_path.h"
+#include "retain.h"
+#include "power.h"
+
+// Core affinity masks (bit n set denotes that a task may run on core n). 
+#define SYS_CORE_0 (1 << 0)
+#define SYS_CORE_1 (1 << 1)
+
+// Cores dedicated to the measurement/control hot path (sampling, filtering,
+// valve actuation) and to communications/housekeeping respectively, so that
+// control loop timing isn't affected by communications load. 
+#define SYS_CORE_CTRL SYS_CORE_1
+#define SYS_CORE_COMMS SYS_CORE_0
+
+// Task placement. Priorities are assigned rate-monotonically between the 
+// tasks sharing a core, i.e., the shorter a task's period (or, for event
+// driven tasks, its minimum time between events/deadline) the higher its 
+// priority. The timer service task (LED pattern edges at least 100 msec 
+// apart, housekeeping every 1 sec) runs at configTIMER_TASK_PRIORITY on the 
+// communications core.
+//
+// Control core: 
+//   Tank level control tasks - valve actuation, deadline of a few msec
+//   Measurement task - configured sample period (1 sec by default, at 
+//     most MEAS_MAX_SAMPLE_PERIOD_MSEC)
+// Communications core: 
+//   Supervisor task - SUPERVISOR_PERIOD_MSEC (500 msec), so deadline misses
+//     on the control core are caught whatever that core is doing
+//   Timer service task - 100 msec (shortest LED pattern step)
+//   Level control enable task - CTRL_ENABLE_MIN_EVENT_INTERVAL_US (500 msec)
+//   UART/USB endpoint tasks - M5StickC Plus UART scan timeout (10 sec), 
+//     equal priorities so no endpoint holds off another
+//   Telemetry task - best effort (drops records rather than delaying others)
+#define T1_LEVEL_CTRL_TASK_PRIORITY 3
+#define T1_LEVEL_CTRL_TASK_AFFINITY SYS_CORE_CTRL
+#define T2_LEVEL_CTRL_TASK_PRIORITY 3
+#define T2_LEVEL_CTRL_TASK_AFFINITY SYS_CORE_CTRL
+#define MEAS_TASK_PRIORITY 2
+#define MEAS_TASK_AFFINITY SYS_CORE_CTRL
+#define SUPERVISOR_TASK_PRIORITY 3
+#define SUPERVISOR_TASK_AFFINITY SYS_CORE_COMMS
+#define TIMER_SERVICE_TASK_AFFINITY SYS_CORE_COMMS
+#define LEVEL_CTRL_ENABLE_TASK_PRIORITY 2
+#define LEVEL_CTRL_ENABLE_TASK_AFFINITY SYS_CORE_COMMS
+#define UART_TASK_PRIORITY 1
+#define UART_TASK_AFFINITY SYS_CORE_COMMS
+#define TELEMETRY_TASK_PRIORITY 1
+#define TELEMETRY_TASK_AFFINITY SYS_CORE_COMMS
+
+// Maximum number of tasks tracked for per-core utilisation statistics. 
+#define SYS_MAX_TASKS 16
+
+// Period of the housekeeping timer (in msec). 
+#define SYS_HOUSEKEEPING_PERIOD_MSEC 1000
+
+// Whether system statistics are periodically printed over stdio (set by the
+// SYS_STATS_REPORT CMake option). 
+#ifndef SYS_STATS_REPORT
+#define SYS_STATS_REPORT 0
+#endif
+
+// Whether each task's peak stack use and the peak heap use are periodically
+// printed over stdio, for host/stack_budget (set by the STACK_BUDGET_REPORT 
+// CMake option). 
+#ifndef STACK_BUDGET_REPORT
+#define STACK_BUDGET_REPORT 0
+#endif
+
+// Number of housekeeping periods between system statistics reports. 
+#define SYS_STATS_REPORT_PERIODS 10
+
+// Struct holding the stack budget of a task (its stack depth, and the name
+// of the define in task_stacks.h which sets it). 
+struct sys_stack_budget {
+    const char *task_name;
+    const char *depth_define;
+    uint32_t depth_words;
+};
+
+// Struct holding system statistics, updated every housekeeping period. 
+struct sys_stats {
+    uint32_t context_switches_per_sec;
+    uint32_t free_heap_bytes;
+    uint32_t min_free_heap_bytes;
+    uint32_t num_tasks;
+    uint16_t core_utilisation_permille[configNUM_CORES];
+    uint32_t meas_loop_worst_us;
+    uint32_t meas_loop_count;
+    uint32_t wakeups_per_sec;                           // Low power idle only
+    uint16_t sleep_permille[configNUM_CORES];           // Low power idle only
+};
+
+// Number of context switches since boot (incremented by the kernel trace 
+// hook defined in FreeRTOSConfig.h). 
+extern volatile uint32_t sys_context_switch_count;
+
+// Function prototypes
+uint32_t sys_get_run_time_counter(void);
+void sys_record_meas_loop_time(uint32_t loop_time_us);
+void sys_update_core_utilisation(struct sys_stats *current);
+void sys_update_sleep_stats(struct sys_stats *current);
+void sys_housekeeping_cb(TimerHandle_t timer);
+void sys_get_stats(struct sys_stats *stats);
+void sys_report_stack_budget(void);
+void sys_report_fault_log(void);
+void sys_housekeeping_init(void);
+
+#endif
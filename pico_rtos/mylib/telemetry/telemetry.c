@@ -0,0 +1,133 @@
+ /** 
+ **************************************************************
+ * @file telemetry.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief USB telemetry stream driver file. This file handles functionality
+ *        specific to streaming a telemetry record for every ADC frame over 
+ *        USB CDC (for commissioning and calibration with a laptop 
+ *        attached). Records are passed from the measurement task through a
+ *        ring buffer which drops the oldest record when full, so a slow or 
+ *        absent USB host never blocks the measurement path. 
+ *************************************************************** 
+ */
+
+#include "telemetry.h"
+
+// Ring buffer of records waiting to be sent. 
+static struct telemetry_record ring[TELEMETRY_BUFFER_RECORDS];
+static uint8_t ring_head = 0;       // Index of the oldest record
+static uint8_t ring_count = 0;      // Number of records in the buffer
+
+// Number of records dropped since the last record was taken (saturating). 
+static uint16_t ring_dropped = 0;
+
+// Handle of the telemetry task, notified when a record is pushed. 
+static TaskHandle_t telemetry_task_handle;
+
+/**
+ * @brief Record push function. This function seals a record and adds it to 
+ *        the ring buffer, dropping the oldest record if the buffer is full. 
+ *        It never blocks. 
+ * @param record Pointer to record, with its payload populated. 
+ * @retval None. 
+ */
+void HOT_PATH_FUNC(telemetry_push)(struct telemetry_record *record) {
+    if (!TELEMETRY_STREAM || (telemetry_task_handle == NULL)) {
+        return;
+    }
+
+    record->dropped = 0;
+    telemetry_record_seal(record);
+
+    // The ring buffer is shared with the telemetry task on the other core
+    taskENTER_CRITICAL();
+    if (ring_count >= TELEMETRY_BUFFER_RECORDS) {
+        ring_head = (ring_head + 1) % TELEMETRY_BUFFER_RECORDS;
+        ring_count--;
+
+        if (ring_dropped < UINT16_MAX) {
+            ring_dropped++;
+        }
+    }
+
+    ring[(ring_head + ring_count) % TELEMETRY_BUFFER_RECORDS] = (*record);
+    ring_count++;
+    taskEXIT_CRITICAL();
+
+    xTaskNotifyGive(telemetry_task_handle);
+}
+
+/**
+ * @brief Record take function. This function removes the oldest record from 
+ *        the ring buffer, recording in it how many records were dropped 
+ *        before it. 
+ * @param record Pointer to record populated with the oldest record. 
+ * @retval true if a record was taken, false if the buffer was empty. 
+ */
+static bool telemetry_take(struct telemetry_record *record) {
+    bool taken = false;
+
+    taskENTER_CRITICAL();
+    if (ring_count > 0) {
+        (*record) = ring[ring_head];
+        ring_head = (ring_head + 1) % TELEMETRY_BUFFER_RECORDS;
+        ring_count--;
+        taken = true;
+
+        record->dropped = ring_dropped;
+        ring_dropped = 0;
+    }
+    taskEXIT_CRITICAL();
+
+    // The drop count changed, so the record must be resealed
+    if (taken && (record->dropped != 0)) {
+        telemetry_record_seal(record);
+    }
+
+    return taken;
+}
+
+/**
+ * @brief Telemetry task. This task sends buffered records over USB CDC while
+ *        a USB host is connected (and discards them otherwise). 
+ * @param param Value passed upon task creation. 
+ * @retval None. 
+ */
+void telemetry_task(void *param) {
+    while (1) {
+        // Block until the measurement task pushes a record
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        struct telemetry_record record;
+        while (telemetry_take(&record)) {
+            if (!stdio_usb_connected()) {
+                continue;
+            }
+
+            // Raw output, so bytes aren't subject to CR/LF translation. If
+            // the host stalls, this task blocks and the measurement task 
+            // drops the oldest buffered records. 
+            const uint8_t *bytes = (const uint8_t *)&record;
+            for (size_t i = 0; i < sizeof(record); i++) {
+                putchar_raw(bytes[i]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Telemetry task creation helper function. This function creates the
+ *        telemetry task, if telemetry streaming is enabled. 
+ * @param None. 
+ * @retval None. 
+ */
+void telemetry_task_init(void) {
+    if (!TELEMETRY_STREAM) {
+        return;
+    }
+
+    xTaskCreateAffinitySet((void *)&telemetry_task, (const signed char *)"Telemetry_Task", 
+            TELEMETRY_TASK_STACK_DEPTH, NULL, TELEMETRY_TASK_PRIORITY, 
+            TELEMETRY_TASK_AFFINITY, &telemetry_task_handle);
+}
@@ -0,0 +1,36 @@
+ /** 
+ **************************************************************
+ * @file telemetry.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the USB telemetry stream driver. 
+ *************************************************************** 
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdio.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "pico/stdlib.h"
+#include "telemetry_record.h"
+#include "sys.h"
+
+// Whether telemetry records are streamed over USB CDC (set by the 
+// TELEMETRY_STREAM CMake option). 
+#ifndef TELEMETRY_STREAM
+#define TELEMETRY_STREAM 0
+#endif
+
+// Number of records buffered between the measurement task and the USB 
+// stream. When the buffer is full, the oldest record is dropped. 
+#define TELEMETRY_BUFFER_RECORDS 32
+
+// Function prototypes
+void telemetry_push(struct telemetry_record *record);
+void telemetry_task(void *param);
+void telemetry_task_init(void);
+
+#endif
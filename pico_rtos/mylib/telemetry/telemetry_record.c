@@ -0,0 +1,104 @@
+ /** 
+ **************************************************************
+ * @file telemetry_record.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Telemetry record format file. This file handles functionality 
+ *        specific to sealing (filling in the header and CRC) and validating
+ *        telemetry records. It has no hardware or RTOS dependencies, so it 
+ *        is shared by the firmware and the host tools. 
+ *************************************************************** 
+ */
+
+#include "telemetry_record.h"
+
+/**
+ * @brief CRC function. This function calculates the CRC-16/CCITT-FALSE 
+ *        (polynomial 0x1021, initial value 0xFFFF) of the given data. 
+ * @param data Pointer to data. 
+ * @param len Length of data, in bytes. 
+ * @retval CRC of the data. 
+ */
+uint16_t telemetry_crc16(const uint8_t *data, size_t len) {
+    uint16_t crc = 0xFFFF;
+
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+/**
+ * @brief Record sealing function. This function fills in the sync, version,
+ *        length, tank count and CRC fields of a record whose payload has 
+ *        been populated.
+ * @param record Pointer to record. 
+ * @retval None. 
+ */
+void telemetry_record_seal(struct telemetry_record *record) {
+    record->sync = TELEMETRY_SYNC;
+    record->version = TELEMETRY_VERSION;
+    record->length = sizeof(struct telemetry_record);
+    record->num_tanks = TELEMETRY_NUM_TANKS;
+    record->crc = telemetry_crc16((const uint8_t *)record, 
+            offsetof(struct telemetry_record, crc));
+}
+
+/**
+ * @brief Record validation function. This function checks that a record has
+ *        a valid header (with this build's tank count) and CRC. 
+ * @param record Pointer to record. 
+ * @retval true if the record is valid, false otherwise. 
+ */
+bool telemetry_record_valid(const struct telemetry_record *record) {
+    if ((record->sync != TELEMETRY_SYNC) || (record->version != TELEMETRY_VERSION)
+            || (record->length != sizeof(struct telemetry_record))
+            || (record->num_tanks != TELEMETRY_NUM_TANKS)) {
+        return false;
+    }
+
+    return (record->crc == telemetry_crc16((const uint8_t *)record, 
+            offsetof(struct telemetry_record, crc)));
+}
+
+/**
+ * @brief Record length function. 
+ * @param num_tanks Number of tanks in the record. 
+ * @retval Length of a record of this version with the given number of 
+ *         tanks, in bytes. 
+ */
+size_t telemetry_record_length(uint8_t num_tanks) {
+    return (sizeof(struct telemetry_record) - (TELEMETRY_NUM_TANKS * TELEMETRY_TANK_LEN)) 
+            + (num_tanks * TELEMETRY_TANK_LEN);
+}
+
+/**
+ * @brief Record tank count function. This function reads the tank count 
+ *        from a record header of this version, which may be from a build 
+ *        with a different NUM_TANKS (so the record can't be read as a 
+ *        struct telemetry_record). The CRC isn't checked. 
+ * @param data Pointer to the start of the record. 
+ * @param len Number of bytes available (at least TELEMETRY_HEADER_LEN). 
+ * @retval Number of tanks, or 0 if the header isn't a record header of this
+ *         version (or its length doesn't match its tank count). 
+ */
+uint8_t telemetry_record_tanks(const uint8_t *data, size_t len) {
+    if ((len < TELEMETRY_HEADER_LEN) || (data[0] != (TELEMETRY_SYNC & 0xFF)) 
+            || (data[1] != (TELEMETRY_SYNC >> 8)) 
+            || (data[TELEMETRY_VERSION_OFFSET] != TELEMETRY_VERSION)) {
+        return 0;
+    }
+
+    uint8_t num_tanks = data[TELEMETRY_NUM_TANKS_OFFSET];
+    if ((num_tanks == 0) 
+            || (data[TELEMETRY_LENGTH_OFFSET] != telemetry_record_length(num_tanks))) {
+        return 0;
+    }
+
+    return num_tanks;
+}
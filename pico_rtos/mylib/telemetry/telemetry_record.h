@@ -0,0 +1,83 @@
+ /** 
+ **************************************************************
+ * @file telemetry_record.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Header file for the telemetry record format, shared by the 
+ *        firmware and the host tools. 
+ *************************************************************** 
+ */
+
+#ifndef TELEMETRY_RECORD_H
+#define TELEMETRY_RECORD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Bytes at the start of every record, used to find record boundaries when
+// joining a stream part way through (sent as 0xA5 0x5A). 
+#define TELEMETRY_SYNC 0x5AA5
+
+// Record format version, incremented whenever the record layout changes. 
+#define TELEMETRY_VERSION 3
+
+// Number of tanks and ADC channels in a record (these must match NUM_TANKS
+// and ADC_FRAME_CHANNELS in meas_pipeline.h, so the NUM_TANKS build option
+// sets both). Each record carries its tank count, so the host tools can 
+// tell records from a build with a different count apart from corrupt ones. 
+#ifdef NUM_TANKS
+#define TELEMETRY_NUM_TANKS NUM_TANKS
+#else
+#define TELEMETRY_NUM_TANKS 2
+#endif
+#define TELEMETRY_NUM_CHANNELS (TELEMETRY_NUM_TANKS + 1)
+
+// Valve/control state bits for tank n, shifted left by (n - 1) * 
+// TELEMETRY_STATE_BITS_PER_TANK. 
+#define TELEMETRY_STATE_FILLING (1 << 0)
+#define TELEMETRY_STATE_DRAINING (1 << 1)
+#define TELEMETRY_STATE_CTRL_ON (1 << 2)
+#define TELEMETRY_STATE_BITS_PER_TANK 4
+
+// Bytes each tank adds to a record (a decimated reading, pressure and 
+// height). 
+#define TELEMETRY_TANK_LEN (sizeof(uint16_t) + (2 * sizeof(float)))
+
+// Offsets of the header fields. 
+#define TELEMETRY_VERSION_OFFSET 2
+#define TELEMETRY_LENGTH_OFFSET 3
+#define TELEMETRY_NUM_TANKS_OFFSET 4
+#define TELEMETRY_HEADER_LEN 5
+
+// Struct holding one telemetry record, sent for every ADC frame. Records 
+// are packed and little-endian, and end with a CRC-16/CCITT-FALSE of every
+// preceding byte. 
+struct __attribute__((packed)) telemetry_record {
+    uint16_t sync;                                  // TELEMETRY_SYNC
+    uint8_t version;                                // TELEMETRY_VERSION
+    uint8_t length;                                 // Record length (bytes)
+    uint8_t num_tanks;                              // TELEMETRY_NUM_TANKS
+    uint32_t seq;                                   // Frame number
+    uint64_t timestamp_us;                          // Frame timestamp
+    uint16_t raw[TELEMETRY_NUM_CHANNELS];           // Decimated readings
+    uint16_t ref_filtered;                          // Filtered ref. channel
+    float pressure[TELEMETRY_NUM_TANKS];            // Instantaneous pressure
+    float height[TELEMETRY_NUM_TANKS];              // Filtered height (cm)
+    uint32_t state;                                 // TELEMETRY_STATE_* bits
+    uint16_t deadline_misses;                       // Supervisor deadline
+                                                    // misses (saturating)
+    uint32_t worst_lateness_us;                     // Worst miss lateness
+    uint16_t dropped;                               // Records dropped before
+                                                    // this one (saturating)
+    uint16_t crc;                                   // CRC of preceding bytes
+};
+
+// Function prototypes
+uint16_t telemetry_crc16(const uint8_t *data, size_t len);
+void telemetry_record_seal(struct telemetry_record *record);
+bool telemetry_record_valid(const struct telemetry_record *record);
+size_t telemetry_record_length(uint8_t num_tanks);
+uint8_t telemetry_record_tanks(const uint8_t *data, size_t len);
+
+#endif
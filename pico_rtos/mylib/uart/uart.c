@@ -1,115 +1,600 @@
- /** 
+/** 
  **************************************************************
  * @file uart.c
  * @author HBN - 45300747
  * @date 30062022
  * @brief UART driver file. This file handles functionality specific to 
- *        fetching water tank height readings from the measurement
- *        controlling tasks upon request (requested via UART) by the 
- *        M5StickC Plus, and transmitting the level readings back to the 
- *        M5StickC Plus. 
+ *        answering requests for the most recent water tank readings from 
+ *        the measurement task. Each protocol endpoint (UART 0, and UART 1 
+ *        and USB CDC if enabled) is served by its own task, reading the 
+ *        same snapshot, so the M5StickC Plus and the site gateway are 
+ *        served concurrently. Replies are sent from a per-endpoint buffer 
+ *        by the UART's transmit interrupt, so no endpoint waits on another's
+ *        line. Point-to-point endpoints also take configuration updates. 
  *************************************************************** 
  */
 
 #include "uart.h"
 
-// Queues used for passing data between measurement tasks and the UART
-// controlling task. 
-QueueHandle_t readings_queue_1;
-QueueHandle_t readings_queue_2;
+// Struct holding the state of a protocol endpoint (defined here, as meas.h
+// includes this driver's header before the snapshot struct). 
+struct uart_endpoint {
+    const char *task_name;
+    bool enabled;
+    uart_inst_t *uart;                  // NULL for USB CDC
+    uint8_t tx_pin;
+    uint8_t rx_pin;
+    uint32_t baud_rate;
+    bool multidrop;
+    volatile uint8_t bus_state;         // UART_BUS_* (multi-drop only)
+    uint32_t char_us;                   // Character time on the line
+    uint8_t reader;                     // Alert reader (see alert.h)
+    TaskHandle_t task_handle;
+    struct multidrop_parser parser;
+    struct config_parser config_parser;
+    struct reading_snapshot latched;    // Readings latched by a broadcast
+    bool latched_valid;
+    char tx[UART_TX_BUFFER_LEN];        // Replies not yet in the TX FIFO
+    size_t tx_head;
+    size_t tx_len;
+};
 
-// Semaphores used to request readings from the measurement controlling
-// tasks. When semaphore is given by UART controlling task, the measurement 
-// controlling task puts data in its respective queue for the UART task. 
-SemaphoreHandle_t request_tank_1_height_sem;
-SemaphoreHandle_t request_tank_2_height_sem;
+// Protocol endpoints (UART_ENDPOINT_*). The UART instances are set when the
+// tasks are created. 
+static struct uart_endpoint endpoints[UART_NUM_ENDPOINTS] = {
+    [UART_ENDPOINT_UART0] = {
+        .task_name = "UART0_Task",
+        .enabled = true,
+        .tx_pin = GPIO0,
+        .rx_pin = GPIO1,
+        .baud_rate = UART_BAUD_RATE,
+        .multidrop = MULTIDROP,
+        .reader = UART_ENDPOINT_UART0,
+    },
+    [UART_ENDPOINT_UART1] = {
+        .task_name = "UART1_Task",
+        .enabled = UART1_ENDPOINT,
+        .tx_pin = GPIO4,
+        .rx_pin = GPIO5,
+        .baud_rate = UART1_BAUD_RATE,
+        .multidrop = false,
+        .reader = UART_ENDPOINT_UART1,
+    },
+    [UART_ENDPOINT_USB] = {
+        .task_name = "USB_Task",
+        .enabled = USB_ENDPOINT,
+        .multidrop = false,
+        .reader = UART_ENDPOINT_USB,
+    },
+};
 
+_Static_assert(UART_NUM_ENDPOINTS == ALERT_NUM_READERS, "Each endpoint needs an alert reader");
+_Static_assert(CONFIG_REPLY_LEN >= SERIALISE_ANALYTICS_LEN, "Configuration isn't the longest reply");
 
 /**
- * @brief
- * @param param Value passed upon task creation. 
+ * @brief UART interrupt handler. This function notifies an endpoint's task 
+ *        that data has been received, or that its transmit FIFO is running 
+ *        low. The UART's interrupts are disabled until the task has serviced
+ *        it. 
+ * @param endpoint Pointer to the endpoint. 
  * @retval None. 
  */
-void uart_task(void *param) {
-    // Initialise UART 0
-    uart_init(uart0, 9600);
- 
-    // Set UART to be on GPIO0 and GPIO1 (TX and RX respectively)
-    gpio_set_function(GPIO0, GPIO_FUNC_UART);
-    gpio_set_function(GPIO1, GPIO_FUNC_UART);
-
-    // Local tank height variables
-    float tank_1_height = 0.0, tank_2_height = 0.0;
-
-    // Create queues for passing data between measurement controlling tasks
-    // and this task. 
-    readings_queue_1 = xQueueCreate(10, sizeof(struct packet));
-    readings_queue_2 = xQueueCreate(10, sizeof(struct packet));
-
-    // Create semaphores used to request tank height data from measurement
-    // controlling tasks. 
-    request_tank_1_height_sem = xSemaphoreCreateBinary();
-    request_tank_2_height_sem = xSemaphoreCreateBinary();
+static inline void uart_irq_notify(struct uart_endpoint *endpoint) {
+    // This will be set to pdTRUE if notifying the endpoint's task causes it
+    // to unblock with a higher priority than the running task. 
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
 
-    while (1) {
-        // Read data from UART (will be a request from the M5StickC Plus)
-        uint8_t buffer = '\0';
-        uart_read_blocking(uart0, (uint8_t *)&buffer, 1);
-
-        // 'R' received on UART denotes a request for recent tank heights
-        // from the M5StickC Plus. 
-        if (buffer == 'R') {
-            // Request new tank height reading from tank 1 measurement 
-            // controlling task. 
-            if (request_tank_1_height_sem != NULL) {
-                xSemaphoreGive(request_tank_1_height_sem);
-            }
+    uart_set_irq_enables(endpoint->uart, false, false);
+
+    if (endpoint->task_handle != NULL) {
+        vTaskNotifyGiveFromISR(endpoint->task_handle, &xHigherPriorityTaskWoken);
+    }
+
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+/**
+ * @brief UART 0 interrupt handler. 
+ * @param None. 
+ * @retval None. 
+ */
+void HOT_PATH_FUNC(uart0_irq_handler)(void) {
+    uart_irq_notify(&endpoints[UART_ENDPOINT_UART0]);
+}
+
+/**
+ * @brief UART 1 interrupt handler. 
+ * @param None. 
+ * @retval None. 
+ */
+void HOT_PATH_FUNC(uart1_irq_handler)(void) {
+    uart_irq_notify(&endpoints[UART_ENDPOINT_UART1]);
+}
+
+/**
+ * @brief Alarm notify function. This function notifies an endpoint's task 
+ *        from a multi-drop alarm callback. 
+ * @param endpoint Pointer to the endpoint. 
+ * @retval None. 
+ */
+static inline void uart_alarm_notify(struct uart_endpoint *endpoint) {
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    if (endpoint->task_handle != NULL) {
+        vTaskNotifyGiveFromISR(endpoint->task_handle, &xHigherPriorityTaskWoken);
+    }
+
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+/**
+ * @brief Turnaround alarm callback. This callback is executed by the 
+ *        hardware timer once the turnaround time has passed since a frame 
+ *        addressed to this node, and enables the transceiver so the task 
+ *        can send its replies. 
+ * @param id Alarm ID. 
+ * @param user_data Pointer to the endpoint. 
+ * @retval 0 (the alarm doesn't repeat). 
+ */
+static int64_t HOT_PATH_FUNC(uart_turnaround_alarm_cb)(alarm_id_t id, void *user_data) {
+    struct uart_endpoint *endpoint = (struct uart_endpoint *)user_data;
+
+    gpio_put(MULTIDROP_DE_PIN, 1);
+    endpoint->bus_state = UART_BUS_DRIVING;
+    uart_alarm_notify(endpoint);
+
+    return 0;
+}
+
+/**
+ * @brief Release alarm callback. This callback is executed by the hardware
+ *        timer once per character time after the last reply has been moved
+ *        into the transmit FIFO, and releases the transceiver once the UART 
+ *        has finished sending (so the task can read requests again). 
+ * @param id Alarm ID. 
+ * @param user_data Pointer to the endpoint. 
+ * @retval 0 if the transceiver was released, otherwise minus the number of 
+ *         usec after which the alarm must fire again. 
+ */
+static int64_t HOT_PATH_FUNC(uart_release_alarm_cb)(alarm_id_t id, void *user_data) {
+    struct uart_endpoint *endpoint = (struct uart_endpoint *)user_data;
+
+    if (uart_get_hw(endpoint->uart)->fr & UART_UARTFR_BUSY_BITS) {
+        return -(int64_t)endpoint->char_us;
+    }
+
+    gpio_put(MULTIDROP_DE_PIN, 0);
+    endpoint->bus_state = UART_BUS_RECEIVING;
+    uart_alarm_notify(endpoint);
+
+    return 0;
+}
+
+/**
+ * @brief Tick conversion function. This function converts a wait to the 
+ *        number of ticks a task must block for to wait at least that long. 
+ * @param us Wait, in usec. 
+ * @retval Number of ticks. 
+ */
+static TickType_t uart_us_to_ticks(uint32_t us) {
+    // A delay of n ticks can end up to a tick early, so one is added
+    return pdMS_TO_TICKS((us + 999) / 1000) + 1;
+}
+
+/**
+ * @brief Heights source function. This function copies the most recent tank
+ *        height readings published by the measurement task. 
+ * @param param Pointer to the endpoint (unused). 
+ * @param heights Buffer written to (NUM_TANKS heights). 
+ * @retval None. 
+ */
+static void uart_get_heights(void *param, float *heights) {
+    struct reading_snapshot snapshot;
+    meas_get_snapshot(&snapshot);
+
+    memcpy(heights, snapshot.height, sizeof(snapshot.height));
+}
+
+/**
+ * @brief Analytics source function. This function copies the most recent 
+ *        tank analytics published by the measurement task. 
+ * @param param Pointer to the endpoint (unused). 
+ * @param analytics Buffer written to (NUM_TANKS analytics). 
+ * @retval None. 
+ */
+static void uart_get_analytics(void *param, struct tank_analytics *analytics) {
+    struct reading_snapshot snapshot;
+    meas_get_snapshot(&snapshot);
+
+    memcpy(analytics, snapshot.analytics, sizeof(snapshot.analytics));
+}
+
+/**
+ * @brief Events source function. This function takes the events raised 
+ *        since the endpoint's last request (see alert.h for the event bits),
+ *        releasing the wake line if the endpoint is the M5StickC Plus's. 
+ * @param param Pointer to the endpoint. 
+ * @retval Events raised. 
+ */
+static uint32_t uart_take_events(void *param) {
+    struct uart_endpoint *endpoint = (struct uart_endpoint *)param;
+
+    return alert_take(endpoint->reader);
+}
+
+/**
+ * @brief Valve state source function. This function copies the most recent 
+ *        valve states published by the measurement task. 
+ * @param param Pointer to the endpoint (unused). 
+ * @param filling Buffer written to (NUM_TANKS fill valve states). 
+ * @param draining Buffer written to (NUM_TANKS drain valve states). 
+ * @retval None. 
+ */
+static void uart_get_valves(void *param, bool *filling, bool *draining) {
+    struct reading_snapshot snapshot;
+    meas_get_snapshot(&snapshot);
+
+    memcpy(filling, snapshot.filling, sizeof(snapshot.filling));
+    memcpy(draining, snapshot.draining, sizeof(snapshot.draining));
+}
+
+/**
+ * @brief Latch broadcast handler. This function latches the most recent 
+ *        readings, so every node on a multi-drop bus reports readings taken
+ *        at the same moment however late it is polled. 
+ * @param endpoint Pointer to the endpoint. 
+ * @retval None. 
+ */
+void handle_latch_broadcast(struct uart_endpoint *endpoint) {
+    meas_get_snapshot(&endpoint->latched);
+    endpoint->latched_valid = true;
+}
+
+/**
+ * @brief Latched heights source function. This function copies the heights
+ *        latched by the endpoint's last latch broadcast, and releases the 
+ *        latch so the same readings are never sent twice. 
+ * @param param Pointer to the endpoint. 
+ * @param heights Buffer written to (NUM_TANKS heights). 
+ * @retval true if a broadcast has been received since the last reply, false
+ *         otherwise. 
+ */
+static bool uart_take_latched(void *param, float *heights) {
+    struct uart_endpoint *endpoint = (struct uart_endpoint *)param;
+
+    if (!endpoint->latched_valid) {
+        return false;
+    }
+
+    endpoint->latched_valid = false;
+    memcpy(heights, endpoint->latched.height, sizeof(endpoint->latched.height));
+    return true;
+}
+
+/**
+ * @brief Configuration source function. This function copies the active 
+ *        configuration, with its sequence number (see config.h). 
+ * @param param Pointer to the endpoint (unused). 
+ * @param block Pointer to struct which the block is copied into. 
+ * @retval None. 
+ */
+static void uart_get_config(void *param, struct config_block *block) {
+    config_store_get(block);
+}
+
+// Sources of the replies to requests (see serialise_reply.h). 
+static const struct serialise_reply_source uart_reply_source = {
+    .get_heights = uart_get_heights,
+    .get_analytics = uart_get_analytics,
+    .take_events = uart_take_events,
+    .get_valves = uart_get_valves,
+    .take_latched = uart_take_latched,
+    .get_config = uart_get_config,
+};
+
+/**
+ * @brief Request dispatch function. This function serialises the reply to a
+ *        request character (see serialise_reply()). 
+ * @param endpoint Pointer to the endpoint the request was received on. 
+ * @param request Request character. 
+ * @param out Buffer the reply is written to (CONFIG_REPLY_LEN chars).
+ * @retval Length of the reply, or 0 if the character isn't a request. 
+ */
+static size_t uart_handle_request(struct uart_endpoint *endpoint, char request, char *out) {
+    return serialise_reply(&uart_reply_source, endpoint, request, out);
+}
 
-            // Request new tank height reading from tank 2 measurement 
-            // controlling task. 
-            if (request_tank_2_height_sem != NULL) {
-                xSemaphoreGive(request_tank_2_height_sem);
+/**
+ * @brief Configuration update handler. This function applies the update 
+ *        held in the endpoint's update parser (written to flash before it 
+ *        takes effect), and serialises the new configuration, or why the 
+ *        update wasn't applied. 
+ * @param endpoint Pointer to the endpoint. 
+ * @param out Buffer the reply is written to (CONFIG_REPLY_LEN chars). 
+ * @retval Length of the reply. 
+ */
+size_t handle_config_update(struct uart_endpoint *endpoint, char *out) {
+    uint8_t result = config_store_apply(endpoint->config_parser.text);
+    if (result != CONFIG_OK) {
+        return config_serialise_error(out, result);
+    }
+
+    return uart_handle_request(endpoint, CONFIG_REQUEST, out);
+}
+
+/**
+ * @brief Character dispatch function. This function serialises the reply 
+ *        to a character received on a point-to-point endpoint, which is 
+ *        either part of a configuration update or a request character. 
+ * @param endpoint Pointer to the endpoint. 
+ * @param c Received character. 
+ * @param out Buffer the reply is written to (CONFIG_REPLY_LEN chars). 
+ * @retval Length of the reply, or 0 if there is none. 
+ */
+static size_t uart_handle_char(struct uart_endpoint *endpoint, char c, char *out) {
+    switch (config_parse(&endpoint->config_parser, c)) {
+        case CONFIG_PARSE_DONE:
+            return handle_config_update(endpoint, out);
+        case CONFIG_PARSE_PENDING:
+            return 0;
+        default:
+            return uart_handle_request(endpoint, c, out);
+    }
+}
+
+/**
+ * @brief Transmit buffer space function. This function finds room for one
+ *        more reply at the end of an endpoint's transmit buffer, moving the
+ *        replies not yet sent to its start if needed. 
+ * @param endpoint Pointer to the endpoint. 
+ * @retval Pointer to UART_REPLY_LEN free chars, or NULL if there is no room.
+ */
+static char *uart_tx_space(struct uart_endpoint *endpoint) {
+    if ((endpoint->tx_head + endpoint->tx_len + UART_REPLY_LEN) > UART_TX_BUFFER_LEN) {
+        memmove(endpoint->tx, &endpoint->tx[endpoint->tx_head], endpoint->tx_len);
+        endpoint->tx_head = 0;
+    }
+
+    if ((endpoint->tx_len + UART_REPLY_LEN) > UART_TX_BUFFER_LEN) {
+        return NULL;
+    }
+
+    return &endpoint->tx[endpoint->tx_head + endpoint->tx_len];
+}
+
+/**
+ * @brief Multi-drop frame handler. This function acts on a complete request
+ *        frame. Broadcast latches are acted on silently. Frames addressed to
+ *        this node have a prefixed reply to each command buffered, and the 
+ *        transceiver is enabled after the turnaround time. 
+ * @param endpoint Pointer to the endpoint (holding the frame). 
+ * @retval None. 
+ */
+static void uart_handle_frame(struct uart_endpoint *endpoint) {
+    const struct multidrop_parser *frame = &endpoint->parser;
+
+    if (frame->id == MULTIDROP_BROADCAST_ID) {
+        for (uint8_t i = 0; i < frame->num_commands; i++) {
+            if (frame->commands[i] == MULTIDROP_LATCH) {
+                handle_latch_broadcast(endpoint);
             }
+        }
+        return;
+    } else if (frame->id != MULTIDROP_NODE_ID) {
+        return;
+    }
+
+    // Frames are only read with the transmit buffer empty, so every reply 
+    // fits. 
+    for (uint8_t i = 0; i < frame->num_commands; i++) {
+        char *out = uart_tx_space(endpoint);
+        size_t len = multidrop_reply_prefix(out, MULTIDROP_NODE_ID);
+        size_t reply_len = uart_handle_request(endpoint, frame->commands[i], &out[len]);
+        if (reply_len > 0) {
+            endpoint->tx_len += len + reply_len;
+        }
+    }
 
-            // Receive tank 1 level reading via queue
-            if (readings_queue_1 != NULL) {
-                struct packet reading_packet;
-                if (xQueueReceive(readings_queue_1, &reading_packet, (10 * (T1_SAMPLE_PERIOD * SEC_TO_MILLI)))) {
-                    tank_1_height = reading_packet.height;
-                }
+    // The controller releases the bus after the frame's last character, so
+    // the transceiver is enabled by an alarm after the turnaround time (the 
+    // task blocks meanwhile). If no alarm is free, the task blocks for the 
+    // turnaround itself, rounded up to whole ticks. 
+    if (endpoint->tx_len > 0) {
+        endpoint->bus_state = UART_BUS_TURNAROUND;
+        if (add_alarm_in_us(multidrop_turnaround_us(endpoint->baud_rate), 
+                &uart_turnaround_alarm_cb, endpoint, true) < 0) {
+            vTaskDelay(uart_us_to_ticks(multidrop_turnaround_us(endpoint->baud_rate)));
+            gpio_put(MULTIDROP_DE_PIN, 1);
+            endpoint->bus_state = UART_BUS_DRIVING;
+        }
+    }
+}
+
+/**
+ * @brief Receive function. This function reads requests from an endpoint's
+ *        receive FIFO while its transmit buffer has room for their replies
+ *        (on a multi-drop bus, while it isn't replying). 
+ * @param endpoint Pointer to the endpoint. 
+ * @retval None. 
+ */
+static void uart_receive(struct uart_endpoint *endpoint) {
+    while (uart_is_readable(endpoint->uart)) {
+        if (endpoint->multidrop) {
+            if (endpoint->bus_state != UART_BUS_RECEIVING) {
+                return;
             }
 
-            // Receive tank 2 level reading via queue
-            if (readings_queue_2 != NULL) {
-                struct packet reading_packet;
-                if (xQueueReceive(readings_queue_2, &reading_packet, (10 * (T2_SAMPLE_PERIOD * SEC_TO_MILLI)))) {
-                    tank_2_height = reading_packet.height;
-                }
+            if (multidrop_parse(&endpoint->parser, uart_getc(endpoint->uart))) {
+                uart_handle_frame(endpoint);
+            }
+        } else {
+            char *out = uart_tx_space(endpoint);
+            if (out == NULL) {
+                return;
             }
 
-            // Format string to send back to M5StickC Plus (agreed format 
-            // between the two devices). 
-            char uart_str[20] = {'\0'};
-            sprintf(uart_str, "T1=%.1fT2=%.1f!", tank_1_height, tank_2_height);
+            endpoint->tx_len += uart_handle_char(endpoint, uart_getc(endpoint->uart), out);
+        }
+    }
+}
 
-            // Send formatted string to M5StickC Plus, and ensure 
-            // transmission won't be interrupted. 
-            vTaskSuspendAll();
-            uart_puts(uart0, uart_str);
-            xTaskResumeAll();
+/**
+ * @brief Transmit function. This function moves buffered replies into an 
+ *        endpoint's transmit FIFO. On a multi-drop bus, replies are only 
+ *        sent while the transceiver is enabled, and it is released by an 
+ *        alarm once the last character has left the line. 
+ * @param endpoint Pointer to the endpoint. 
+ * @retval None. 
+ */
+static void uart_transmit(struct uart_endpoint *endpoint) {
+    if (endpoint->multidrop && (endpoint->bus_state != UART_BUS_DRIVING)) {
+        return;
+    }
+
+    while ((endpoint->tx_len > 0) && uart_is_writable(endpoint->uart)) {
+        uart_putc_raw(endpoint->uart, endpoint->tx[endpoint->tx_head++]);
+        endpoint->tx_len--;
+    }
+
+    if (endpoint->tx_len == 0) {
+        endpoint->tx_head = 0;
+    }
+
+    // The transmit interrupt wakes the task with at most 1/8 of the FIFO 
+    // left to send. From then, the release alarm checks once per character
+    // time whether the last character has left the shift register, so the
+    // bus is released well within the turnaround time. If no alarm is free,
+    // the task blocks a tick at a time instead. 
+    if (endpoint->multidrop && (endpoint->tx_len == 0) 
+            && (uart_get_hw(endpoint->uart)->ris & UART_UARTRIS_TXRIS_BITS)) {
+        endpoint->bus_state = UART_BUS_RELEASING;
+        if (add_alarm_in_us(endpoint->char_us, &uart_release_alarm_cb, endpoint, true) < 0) {
+            while (uart_get_hw(endpoint->uart)->fr & UART_UARTFR_BUSY_BITS) {
+                vTaskDelay(uart_us_to_ticks(endpoint->char_us));
+            }
+
+            gpio_put(MULTIDROP_DE_PIN, 0);
+            endpoint->bus_state = UART_BUS_RECEIVING;
         }
+    }
+}
+
+/**
+ * @brief UART endpoint task. This task answers requests received on a UART,
+ *        from the M5StickC Plus or the site gateway (or, on a multi-drop 
+ *        bus, request frames from the gateway). 
+ * @param param Pointer to the endpoint. 
+ * @retval None. 
+ */
+void uart_task(void *param) {
+    struct uart_endpoint *endpoint = (struct uart_endpoint *)param;
+
+    uart_init(endpoint->uart, endpoint->baud_rate);
+    gpio_set_function(endpoint->tx_pin, GPIO_FUNC_UART);
+    gpio_set_function(endpoint->rx_pin, GPIO_FUNC_UART);
+
+    config_parser_init(&endpoint->config_parser);
+
+    if (endpoint->multidrop) {
+        multidrop_parser_init(&endpoint->parser);
+        endpoint->char_us = multidrop_char_us(endpoint->baud_rate);
+        endpoint->bus_state = UART_BUS_RECEIVING;
+
+        // Transceiver released (receiving) until this node is addressed
+        gpio_init(MULTIDROP_DE_PIN);
+        gpio_set_dir(MULTIDROP_DE_PIN, GPIO_OUT);
+        gpio_put(MULTIDROP_DE_PIN, 0);
+    }
+
+    // Enable the receive interrupt, so this task only runs when data is 
+    // received (or, while replies are buffered, the transmit FIFO runs low)
+    uint irq = (endpoint->uart == uart0) ? UART0_IRQ : UART1_IRQ;
+    irq_set_exclusive_handler(irq, (endpoint->uart == uart0) ? &uart0_irq_handler 
+            : &uart1_irq_handler);
+    irq_set_enabled(irq, true);
+    uart_set_irq_enables(endpoint->uart, true, false);
+
+    while (1) {
+        // Block until the interrupt notifies this task
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        uart_receive(endpoint);
+        uart_transmit(endpoint);
+
+        // Re-enable the receive interrupt if requests can be read, and the
+        // transmit interrupt while there is more to send (on a multi-drop 
+        // bus, while the transceiver is enabled and not being released, as 
+        // the alarms wake the task otherwise). Both are level triggered, so
+        // nothing is missed while they're disabled. 
+        bool rx_ready = endpoint->multidrop ? (endpoint->bus_state == UART_BUS_RECEIVING)
+                : (uart_tx_space(endpoint) != NULL);
+        bool tx_wait = endpoint->multidrop ? (endpoint->bus_state == UART_BUS_DRIVING)
+                : (endpoint->tx_len > 0);
+        uart_set_irq_enables(endpoint->uart, rx_ready, tx_wait);
+    }
+}
+
+/**
+ * @brief USB characters available callback. This function notifies the USB
+ *        endpoint's task that data has been received. 
+ * @param param Pointer to the endpoint. 
+ * @retval None. 
+ */
+static void usb_chars_available_cb(void *param) {
+    struct uart_endpoint *endpoint = (struct uart_endpoint *)param;
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    vTaskNotifyGiveFromISR(endpoint->task_handle, &xHigherPriorityTaskWoken);
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
+/**
+ * @brief USB endpoint task. This task answers requests received over USB 
+ *        CDC (e.g. from a laptop). Replies are written raw, and if the host
+ *        stops reading, only this task waits on it. 
+ * @param param Pointer to the endpoint. 
+ * @retval None. 
+ */
+void usb_task(void *param) {
+    struct uart_endpoint *endpoint = (struct uart_endpoint *)param;
+    char reply[UART_REPLY_LEN];
+    int c;
+
+    config_parser_init(&endpoint->config_parser);
+    stdio_set_chars_available_callback(&usb_chars_available_cb, endpoint);
+
+    while (1) {
+        // Block until the USB stack notifies this task
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
-        vTaskDelay(100);
+        while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+            size_t len = uart_handle_char(endpoint, (char)c, reply);
+            for (size_t i = 0; i < len; i++) {
+                putchar_raw(reply[i]);
+            }
+        }
     }
 }
 
 /**
- * @brief UART controlling task creation helper function. This function 
- *        creates the UART controlling task. 
+ * @brief UART endpoint task creation helper function. This function creates
+ *        a task for each enabled endpoint. 
  * @param None. 
  * @retval None. 
  */
 void uart_task_init(void) {
-    xTaskCreate((void *)&uart_task, (const signed char *)"UART_Task", 
-            256, NULL, 1, NULL);
-}
\ No newline at end of file
+    endpoints[UART_ENDPOINT_UART0].uart = uart0;
+    endpoints[UART_ENDPOINT_UART1].uart = uart1;
+
+    for (uint8_t i = 0; i < UART_NUM_ENDPOINTS; i++) {
+        struct uart_endpoint *endpoint = &endpoints[i];
+        if (!endpoint->enabled) {
+            continue;
+        }
+
+        xTaskCreateAffinitySet((i == UART_ENDPOINT_USB) ? (void *)&usb_task 
+                : (void *)&uart_task, (const signed char *)endpoint->task_name, 
+                UART_TASK_STACK_DEPTH, endpoint, UART_TASK_PRIORITY, UART_TASK_AFFINITY, 
+                &endpoint->task_handle);
+    }
+}
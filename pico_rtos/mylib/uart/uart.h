@@ -11,40 +11,104 @@
 #define UART_H
 
 #include <stdio.h>
+#include <string.h>
 #include "FreeRTOS.h"
 #include "task.h"
 #include "queue.h"
 #include "semphr.h"
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
+#include "hardware/uart.h"
+#include "hardware/irq.h"
 #include "meas.h"
+#include "sys.h"
+#include "alert.h"
+#include "serialise.h"
+#include "serialise_reply.h"
+#include "multidrop.h"
+#include "config_store.h"
 
 // GPIO pin number declarations
 #define GPIO0 0
 #define GPIO1 1
+#define GPIO4 4
+#define GPIO5 5
+#define GPIO6 6
 
 // Number of milliseconds in one second. 
 #define SEC_TO_MILLI 1000
 
-// Queues used for passing data between measurement tasks and the UART
-// controlling task. 
-extern QueueHandle_t readings_queue_1;
-extern QueueHandle_t readings_queue_2;
+// UART 0 baud rate (set by the UART_BAUD_RATE CMake option). 
+#ifndef UART_BAUD_RATE
+#define UART_BAUD_RATE 9600
+#endif
 
-// Semaphores used to request readings from the measurement controlling
-// tasks. When semaphore is given by UART controlling task, the measurement 
-// controlling task puts data in its respective queue for the UART task. 
-extern SemaphoreHandle_t request_tank_1_height_sem;
-extern SemaphoreHandle_t request_tank_2_height_sem;
+// UART 1 baud rate (the M5StickC Plus's). 
+#define UART1_BAUD_RATE 9600
 
-// Struct used for passing data between UART and measurement tasks via queue. 
-struct packet {
-    uint8_t tank;
-    float height;
-};
+// Whether UART 0 is a multi-drop bus shared with other nodes, answering only
+// frames addressed to MULTIDROP_NODE_ID (set by the MULTIDROP and 
+// MULTIDROP_NODE_ID CMake options, see multidrop.h). Otherwise every 
+// request character received is answered. 
+#ifndef MULTIDROP
+#define MULTIDROP 0
+#endif
+
+#ifndef MULTIDROP_NODE_ID
+#define MULTIDROP_NODE_ID 1
+#endif
+
+// RS-485 transceiver driver enable, driven high only while this node is 
+// replying on the multi-drop bus. 
+#define MULTIDROP_DE_PIN GPIO6
+
+// Multi-drop bus states of an endpoint. Frames are read while receiving. 
+// Once replies are buffered, the transceiver is enabled by an alarm after 
+// the turnaround time, and released by another once the last character 
+// has been sent. 
+#define UART_BUS_RECEIVING 0
+#define UART_BUS_TURNAROUND 1           // Waiting to enable the transceiver
+#define UART_BUS_DRIVING 2
+#define UART_BUS_RELEASING 3            // Waiting for the UART to finish
+
+// Protocol endpoints, each served by its own task, so a busy or stalled 
+// requester never delays the others. UART 0 (GPIO0/1) is always served. 
+// UART 1 (TX on GPIO4, RX on GPIO5) and USB CDC are served if set by the 
+// UART1_ENDPOINT and USB_ENDPOINT CMake options (UART 1 by default when 
+// UART 0 is a multi-drop bus, so the M5StickC Plus can stay attached). 
+// Endpoint n fetches events as alert reader n (see alert.h). 
+#define UART_ENDPOINT_UART0 0
+#define UART_ENDPOINT_UART1 1
+#define UART_ENDPOINT_USB 2
+#define UART_NUM_ENDPOINTS 3
+
+#ifndef UART1_ENDPOINT
+#define UART1_ENDPOINT 0
+#endif
+
+#ifndef USB_ENDPOINT
+#define USB_ENDPOINT 0
+#endif
+
+// Buffer size (including the terminating null) of the longest reply (the 
+// configuration), with a multi-drop prefix. 
+#define UART_REPLY_LEN (MULTIDROP_PREFIX_LEN + CONFIG_REPLY_LEN)
+
+// Size of an endpoint's transmit buffer (the replies to a full multi-drop
+// frame). Requests are left in the receive FIFO while it has no room for 
+// another reply. 
+#define UART_TX_BUFFER_LEN (MULTIDROP_MAX_COMMANDS * UART_REPLY_LEN)
+
+// Protocol endpoint (see uart.c). 
+struct uart_endpoint;
 
 // Function prototypes
+void uart0_irq_handler(void);
+void uart1_irq_handler(void);
+size_t handle_config_update(struct uart_endpoint *endpoint, char *out);
+void handle_latch_broadcast(struct uart_endpoint *endpoint);
 void uart_task(void *param);
+void usb_task(void *param);
 void uart_task_init(void);
 
 #endif
\ No newline at end of file
@@ -40,14 +40,26 @@
  * See http://www.freertos.org/a00110.html
  *----------------------------------------------------------*/
 
+/* Task stack depths and heap size, generated by host/stack_budget. */
+#include "task_stacks.h"
+
+/* Low power idle (set by the LOW_POWER_IDLE CMake option, see power.c). The
+tick is suppressed by the application's own routine (configUSE_TICKLESS_IDLE
+2), and the idle hook sleeps the core which has no tick. */
+#ifndef LOW_POWER_IDLE
+#define LOW_POWER_IDLE                          0
+#endif
+
 /* Scheduler Related */
 #define configUSE_PREEMPTION                    1
-#define configUSE_TICKLESS_IDLE                 0
-#define configUSE_IDLE_HOOK                     0
+#define configUSE_TICKLESS_IDLE                 ( LOW_POWER_IDLE ? 2 : 0 )
+#define configEXPECTED_IDLE_TIME_BEFORE_SLEEP   2
+#define configUSE_IDLE_HOOK                     LOW_POWER_IDLE
 #define configUSE_TICK_HOOK                     0
 #define configTICK_RATE_HZ                      ( ( TickType_t ) 1000 )
 #define configMAX_PRIORITIES                    32
 #define configMINIMAL_STACK_SIZE                ( configSTACK_DEPTH_TYPE ) 256
+#define configMAX_TASK_NAME_LEN                 16
 #define configUSE_16_BIT_TICKS                  0
 
 #define configIDLE_SHOULD_YIELD                 1
@@ -71,16 +83,16 @@
 /* Memory allocation related definitions. */
 #define configSUPPORT_STATIC_ALLOCATION         0
 #define configSUPPORT_DYNAMIC_ALLOCATION        1
-#define configTOTAL_HEAP_SIZE                   (128*1024)
+#define configTOTAL_HEAP_SIZE                   SYS_HEAP_SIZE_BYTES   /* See task_stacks.h */
 #define configAPPLICATION_ALLOCATED_HEAP        0
 
 /* Hook function related definitions. */
-#define configCHECK_FOR_STACK_OVERFLOW          0
-#define configUSE_MALLOC_FAILED_HOOK            0
+#define configCHECK_FOR_STACK_OVERFLOW          2     /* Hooks log to the fault log, see sys.c */
+#define configUSE_MALLOC_FAILED_HOOK            1
 #define configUSE_DAEMON_TASK_STARTUP_HOOK      0
 
 /* Run time and task stats gathering related definitions. */
-#define configGENERATE_RUN_TIME_STATS           0
+#define configGENERATE_RUN_TIME_STATS           1
 #define configUSE_TRACE_FACILITY                1
 #define configUSE_STATS_FORMATTING_FUNCTIONS    0
 
@@ -90,9 +102,9 @@
 
 /* Software timer related definitions. */
 #define configUSE_TIMERS                        1
-#define configTIMER_TASK_PRIORITY               ( configMAX_PRIORITIES - 1 )
+#define configTIMER_TASK_PRIORITY               3    /* Rate-monotonic, see sys.h */
 #define configTIMER_QUEUE_LENGTH                10
-#define configTIMER_TASK_STACK_DEPTH            1024
+#define configTIMER_TASK_STACK_DEPTH            TIMER_SERVICE_TASK_STACK_DEPTH
 
 /* Interrupt nesting behaviour configuration. */
 /*
@@ -104,7 +116,8 @@
 /* SMP port only */
 #define configNUM_CORES                         2
 #define configTICK_CORE                         0
-#define configRUN_MULTIPLE_PRIORITIES           0
+#define configRUN_MULTIPLE_PRIORITIES           1
+#define configUSE_CORE_AFFINITY                 1
 
 /* RP2040 specific */
 #define configSUPPORT_PICO_SYNC_INTEROP         1
@@ -135,5 +148,21 @@ to exclude the API function. */
 
 /* A header file that defines trace macro can be included here. */
 
+/* Count context switches and gather task run times for the housekeeping
+statistics (see sys.c). */
+#ifndef __ASSEMBLER__
+#include <stdint.h>
+extern volatile uint32_t sys_context_switch_count;
+extern uint32_t sys_get_run_time_counter(void);
+extern void power_suppress_ticks_and_sleep(uint32_t expected_idle_ticks);
+#endif
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()
+#define portGET_RUN_TIME_COUNTER_VALUE()        sys_get_run_time_counter()
+#define traceTASK_SWITCHED_IN()                 ( sys_context_switch_count++ )
+
+/* Stop the tick while idle (see power.c). */
+#define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime ) \
+        power_suppress_ticks_and_sleep( xExpectedIdleTime )
+
 #endif /* FREERTOS_CONFIG_H */
 
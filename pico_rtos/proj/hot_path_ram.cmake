@@ -0,0 +1,61 @@
+# Places the measurement/control hot path in SRAM (the HOT_PATH_IN_RAM
+# option). HOT_PATH_FUNC only moves the firmware's own hot path functions,
+# so this also moves the code they call: the FreeRTOS kernel and port, the
+# SDK's timer, alarm, IRQ, GPIO, ADC and DMA drivers, and the SDK's float,
+# double, divider and memory helpers. The kernel and driver objects are
+# excluded from flash in a copy of the SDK's default linker script (the SDK
+# then places them with the rest of .data, copied to SRAM at boot), and the
+# helpers are moved with the SDK's own *_IN_RAM definitions.
+
+# Objects moved to SRAM, as linker script file patterns.
+set(HOT_PATH_RAM_OBJECTS
+        */tasks.c.obj
+        */queue.c.obj
+        */list.c.obj
+        */timers.c.obj
+        */RP2040/port.c.obj
+        */hardware_timer/timer.c.obj
+        */pico_time/time.c.obj
+        */hardware_irq/irq.c.obj
+        */hardware_gpio/gpio.c.obj
+        */hardware_adc/adc.c.obj
+        */hardware_dma/dma.c.obj
+)
+
+# Function placing a target's hot path in SRAM.
+function(hot_path_in_ram target)
+    target_compile_definitions(${target} PRIVATE
+            HOT_PATH_IN_RAM=1
+            PICO_FLOAT_IN_RAM=1
+            PICO_DOUBLE_IN_RAM=1
+            PICO_DIVIDER_IN_RAM=1
+            PICO_MEM_IN_RAM=1
+    )
+
+    # The default linker script moved from pico_standard_link to pico_crt0
+    # in SDK 2.0.
+    set(default_script ${PICO_SDK_PATH}/src/rp2_common/pico_crt0/rp2040/memmap_default.ld)
+    if (NOT EXISTS ${default_script})
+        set(default_script ${PICO_SDK_PATH}/src/rp2_common/pico_standard_link/memmap_default.ld)
+    endif()
+
+    # The default script keeps libgcc, libm and the mem* functions out of
+    # flash with EXCLUDE_FILE lists (for .text and .rodata), which the hot
+    # path objects are added to.
+    set(exclude_list "EXCLUDE_FILE(*libgcc.a: *libc.a:*lib_a-mem*.o *libm.a:)")
+    file(READ ${default_script} script)
+    string(FIND "${script}" "${exclude_list}" exclude_pos)
+    if (exclude_pos EQUAL -1)
+        message(FATAL_ERROR "HOT_PATH_IN_RAM: ${default_script} has no "
+                "${exclude_list} to extend")
+    endif()
+
+    string(REPLACE ";" " " objects "${HOT_PATH_RAM_OBJECTS}")
+    string(REPLACE "${exclude_list}"
+            "EXCLUDE_FILE(${objects} *libgcc.a: *libc.a:*lib_a-mem*.o *libm.a:)"
+            script "${script}")
+
+    set(hot_path_script ${CMAKE_CURRENT_BINARY_DIR}/memmap_hot_path_${target}.ld)
+    file(WRITE ${hot_path_script} "${script}")
+    pico_set_linker_script(${target} ${hot_path_script})
+endfunction()
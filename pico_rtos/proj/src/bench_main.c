@@ -0,0 +1,60 @@
+ /**
+ **************************************************************
+ * @file bench_main.c
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Hot path microbenchmark firmware. This firmware runs the benchmark
+ *        suite (see mylib/bench) on the RP2040 without the scheduler, and
+ *        prints the results over USB stdio in the same format as the host
+ *        benchmark tool, so they can be compared against a stored baseline
+ *        (see README.md). The Cortex-M0+ has no cycle counter, so runs are
+ *        timed with the microsecond timer, and cycles are derived from the
+ *        system clock frequency. 
+ ***************************************************************
+ */
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "bench.h"
+
+// Iterations per run of each case (long enough that the microsecond timer
+// resolution is negligible). 
+#define BENCH_TARGET_ITERATIONS 20000
+
+// Time between runs of the suite (in msec). 
+#define BENCH_REPEAT_PERIOD_MS 10000
+
+/**
+ * @brief Benchmark clock function. 
+ * @param None. 
+ * @retval Time since boot, in nsec. 
+ */
+static uint64_t bench_clock_ns(void) {
+    return time_us_64() * 1000;
+}
+
+int main(void) {
+    stdio_init_all();
+
+    while (true) {
+        // Wait until the results can be read
+        while (!stdio_usb_connected()) {
+            sleep_ms(100);
+        }
+
+        uint32_t cpu_hz = clock_get_hz(clk_sys);
+        printf("bench_target=rp2040 cpu_hz=%lu\n", (unsigned long)cpu_hz);
+
+        for (uint8_t i = 0; i < bench_num_cases; i++) {
+            struct bench_result result;
+            bench_run_case(&bench_cases[i], BENCH_TARGET_ITERATIONS, bench_clock_ns, &result);
+            bench_print_result(&result, cpu_hz);
+        }
+
+        printf("bench_done\n");
+        sleep_ms(BENCH_REPEAT_PERIOD_MS);
+    }
+
+    return 0;
+}
@@ -19,19 +19,42 @@ void main(void) {
     // https://raspberrypi.github.io/pico-sdk-doxygen/group__hardware__adc.html#adc_example)
     stdio_init_all();
 
-    // Initialise level measurement controlling tasks
-    t1_meas_task_init();
-    t2_meas_task_init();
+    // Check whether state retained through a watchdog reset can be restored
+    retain_init();
+
+    // Load the runtime configuration from flash (or the defaults)
+    config_store_init();
+
+    // Initialise ADC used by the level measurement controlling task
+    meas_adc_init();
+
+    // Initialise wake line to the M5StickC Plus (released)
+    alert_init();
+
+    // Initialise level measurement controlling task
+    meas_task_init();
 
     // Initialise control enable controlling task
     level_ctrl_enable_task_init();
 
-    // Initialise LED controlling task
-    led_task_init();
+    // Initialise LED controlling timer
+    led_timer_init();
+
+    // Initialise housekeeping timer
+    sys_housekeeping_init();
 
     // Initialise UART controlling task
     uart_task_init();
 
+    // Initialise USB telemetry streaming task (if enabled)
+    telemetry_task_init();
+
+    // Initialise deadline supervisor task (enables the hardware watchdog)
+    supervisor_task_init();
+
+    // Initialise low power idle (if enabled)
+    power_init();
+
     // Start the RTOS scheduler
     vTaskStartScheduler();
 }
\ No newline at end of file
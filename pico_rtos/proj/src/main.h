@@ -15,5 +15,12 @@
 #include "led.h"
 #include "uart.h"
 #include "ctrl.h"
+#include "sys.h"
+#include "retain.h"
+#include "alert.h"
+#include "telemetry.h"
+#include "supervisor.h"
+#include "power.h"
+#include "config_store.h"
 
 #endif
\ No newline at end of file
@@ -0,0 +1,28 @@
+ /** 
+ **************************************************************
+ * @file task_stacks.h
+ * @author HBN - 45300747
+ * @date 18102026
+ * @brief Task stack depths (in words) and kernel heap size. Regenerate
+ *        with host/stack_budget from the output of a STACK_BUDGET_REPORT
+ *        build which has been put through a representative workload (see
+ *        README.md). These are the sizes used before the budget (and 
+ *        the UART task's raise for the configuration reply), as no report 
+ *        has been taken on hardware yet. 
+ *************************************************************** 
+ */
+
+#ifndef TASK_STACKS_H
+#define TASK_STACKS_H
+
+#define MEAS_TASK_STACK_DEPTH 256
+#define T1_LEVEL_CTRL_TASK_STACK_DEPTH 256
+#define T2_LEVEL_CTRL_TASK_STACK_DEPTH 256
+#define LEVEL_CTRL_ENABLE_TASK_STACK_DEPTH 256
+#define UART_TASK_STACK_DEPTH 384
+#define TELEMETRY_TASK_STACK_DEPTH 256
+#define SUPERVISOR_TASK_STACK_DEPTH 256
+#define TIMER_SERVICE_TASK_STACK_DEPTH 1024
+#define SYS_HEAP_SIZE_BYTES 131072
+
+#endif